@@ -110,13 +110,24 @@
 #endif
 
 /* Enabling creation of nearest neighbor tables, using the COVALENT tables */
-/* Combining covalent interaction with ADA or NYETENSOR may by risky*/
-#ifdef ADA
+/* Combining covalent interaction with ADA, PTM or NYETENSOR may by risky*/
+#if defined(ADA) || defined(PTM) || defined(RDF)
 #define NNBR_TABLE
+#endif
+#ifdef ADA
 #define ADA_ACKLAND_CONFIG   0
 #define ADA_FCC_CONFIG 1
 #define ADA_BCC_CONFIG 2
 #endif
+#ifdef PTM
+#define PTM_OTHER 0
+#define PTM_FCC   1
+#define PTM_HCP   2
+#define PTM_BCC   3
+#define PTM_ICO   4
+#define PTM_SC    5
+#define PTM_NDAT  11   /* rmsd, quaternion, strain (xx yy zz yz zx xy) */
+#endif
 
 
 /* percentage of r2_cut, in which generated potentials are corrected
@@ -173,14 +184,14 @@
 *
 ******************************************************************************/
 
-#if defined(CG) || defined(MIK) || defined(GLOK) || defined(DEFORM)
+#if defined(CG) || defined(MIK) || defined(GLOK) || defined(DEFORM) || defined(LBFGS) || defined(FIRE2)
 #ifndef FNORM
 #define FNORM
 #endif
 #endif
 
 /* relaxation integrators */
-#if defined(MIK) || defined(GLOK) || defined(CG)
+#if defined(MIK) || defined(GLOK) || defined(CG) || defined(LBFGS) || defined(FIRE2)
 #define RELAX
 #endif
 
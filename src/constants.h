@@ -42,6 +42,20 @@
 #define ENS_CG       15
 #define ENS_FINNIS   16
 #define ENS_TTM      17
+#define ENS_LBFGS    18
+#define ENS_FIRE2    19
+#define ENS_LANGEVIN 20
+
+/* ensembles which relax to a minimum instead of doing dynamics */
+#define IS_RELAX_ENS(e) (((e)==ENS_MIK) || ((e)==ENS_GLOK) || ((e)==ENS_CG) || \
+                         ((e)==ENS_LBFGS) || ((e)==ENS_FIRE2))
+
+/* streams of the counter-based random numbers */
+#define RNG_MAXWELL   1
+#define RNG_UNIAX     2
+#define RNG_LASER     3
+#define RNG_EPITAX    4
+#define RNG_LANGEVIN  5
 
 /* FCS methods */
 #define FCS_METH_EMPTY  0
@@ -69,6 +83,7 @@
 #define INBUF_TAG  400
 #define AT_BUF_TAG 500
 #define ANNOUNCE_TAG 600
+#define DIFFPAT_TAG  700
 
 /* Definition of the value that should be minimized */
 #define CGE  0 /* completely based on energy, no use of gradient information */
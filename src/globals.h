@@ -235,7 +235,8 @@ EXTERN int dist_presstens_flag   INIT(0); /* write presstens dists? */
 EXTERN int dist_dens_flag   INIT(0); /* write density dists? */
 EXTERN int dist_vxavg_flag  INIT(0); /* write average sample velocity dists? */
 EXTERN int dist_int              INIT(0); /* Period of distribution writes */
-EXTERN int dist_chunk_size       INIT(2*1024*1024); /* size of dist reduct. */
+EXTERN int dist_av_int           INIT(0); /* Period of samples averaged in dists */
+EXTERN int dist_chunk_size       INIT(2*1024*1024); /* size of dist reduct., thread bins, passes */
 EXTERN ivektor dist_dim          INIT(einsivektor); /* resolution of dist */
 EXTERN vektor  dist_ur           INIT(nullvektor);  /* lower left  corner */
 EXTERN vektor  dist_ll           INIT(nullvektor);  /* upper right corner */
@@ -435,6 +436,10 @@ EXTERN imd_timer time_fft_plan;
 EXTERN imd_timer time_input;
 EXTERN imd_timer time_integrate;
 EXTERN imd_timer time_forces;
+#ifdef USEFCS
+EXTERN imd_timer time_fcs_pack;    /* FCS data copies and unpacking */
+EXTERN imd_timer time_fcs_run;     /* FCS solver proper */
+#endif
 
 /* Parameters for the various ensembles */
 
@@ -646,6 +651,45 @@ EXTERN real   dgg           INIT(0.0);      /* see Num. Rec. p.320 */
 EXTERN real   cg_gamma      INIT(0.0);      /* see Num. Rec. p.320 */
 #endif
 
+#ifdef LBFGS
+/* Parameters used by L-BFGS */
+EXTERN int    lbfgs_m       INIT(5);      /* number of stored step pairs */
+EXTERN real   lbfgs_maxstep INIT(0.2);    /* max. atomic displacement */
+EXTERN real   lbfgs_alpha   INIT(70.0);   /* initial inverse Hessian 1/alpha */
+
+/* Variables needed by L-BFGS */
+EXTERN int    lbfgs_len      INIT(0);     /* reals per atom in history */
+EXTERN int    lbfgs_pos      INIT(0);     /* history slot of the next pair */
+EXTERN int    lbfgs_count    INIT(0);     /* number of valid pairs */
+EXTERN int    lbfgs_have_prev INIT(0);    /* previous step is available */
+EXTERN real   lbfgs_gamma    INIT(0.0);   /* scaling of initial Hessian */
+EXTERN real   lbfgs_epot_old INIT(0.0);   /* potential energy of last step */
+#endif
+
+#ifdef LANGEVIN
+EXTERN real   langevin_gamma INIT(0.0);   /* friction coefficient (1/time) */
+#endif
+
+#ifdef FIRE2
+/* Parameters used by FIRE 2.0 */
+EXTERN real   fire2_dtmax    INIT(0.0);   /* max. timestep, 0: 10*timestep */
+EXTERN real   fire2_dtmin    INIT(0.0);   /* min. timestep, 0: timestep/50 */
+EXTERN real   fire2_finc     INIT(1.1);   /* timestep increase factor */
+EXTERN real   fire2_fdec     INIT(0.5);   /* timestep decrease factor */
+EXTERN real   fire2_alpha0   INIT(0.25);  /* initial mixing parameter */
+EXTERN real   fire2_falpha   INIT(0.99);  /* mixing parameter decrease */
+EXTERN int    fire2_ndelay   INIT(20);    /* steps before dt increases */
+EXTERN int    fire2_nnegmax  INIT(2000);  /* max. number of uphill steps */
+EXTERN int    fire2_initdelay INIT(1);    /* no dt decrease in first steps */
+
+/* Variables needed by FIRE 2.0 */
+EXTERN real   fire2_alpha    INIT(0.0);
+EXTERN real   fire2_starttimestep INIT(0.0);
+EXTERN int    fire2_npos     INIT(0);
+EXTERN int    fire2_nneg     INIT(0);
+EXTERN int    fire2_iter     INIT(0);
+#endif
+
 #ifdef ACG
 EXTERN real   acg_alpha         INIT(0.005);  /* Kai Nordlunds adaptive CG */
 EXTERN real   acg_init_alpha    INIT(0.005);  /* Kai Nordlunds adaptive CG */
@@ -675,7 +719,6 @@ EXTERN int cna_write_statistics INIT(0);
 EXTERN char cna_crist INIT(0);
 EXTERN int cna_cristv[4];
 EXTERN int cna_crist_n INIT(0);
-EXTERN int bondlist[MAX_BONDS][3];
 EXTERN int type_list[MAX_TYPES];
 EXTERN int type_count[MAX_TYPES];
 EXTERN int type_sort[MAX_TYPES];
@@ -695,6 +738,22 @@ EXTERN vektor nye_rotationAxis_z  INIT(nullvektor); /* Crystal orientation in z-
 #endif
 #endif
 
+#ifdef PTM
+EXTERN int  ptm_int INIT(0);            /* interval of template matching */
+EXTERN real ptm_r2cut INIT(0.0);        /* squared neighbor cutoff radius */
+EXTERN real ptm_rmsd_max INIT(0.1);     /* max. RMSD of a matched structure */
+EXTERN real ptm_latticeConst INIT(0.0); /* reference lattice constant for strain */
+#endif
+
+#ifdef RDF
+EXTERN int  rdf_int INIT(0);            /* interval of g(r) sampling */
+EXTERN int  rdf_write_int INIT(0);      /* interval of reduction and output */
+EXTERN real rdf_r2cut INIT(0.0);        /* squared cutoff radius of g(r) */
+EXTERN int  rdf_nbins INIT(100);        /* number of g(r) bins */
+EXTERN real rdf_bond_r2cut INIT(0.0);   /* squared bond cutoff for angles and coordination */
+EXTERN int  rdf_angle_nbins INIT(180);  /* number of bond angle bins */
+#endif
+
 #ifdef DISLOC
 EXTERN int  dem_int INIT(0);          /* Period of dem output */
 EXTERN int  dsp_int INIT(0);          /* Period of dsp output */
@@ -752,6 +811,9 @@ EXTERN int diffpat_int INIT(0);     /* interval between atoms dist updates */
 EXTERN int diffpat_start INIT(0);   /* start step of atoms distribution */
 EXTERN int diffpat_end INIT(0);     /* stop step of atoms distribution */
 EXTERN int diffpat_size INIT(0);    /* size of atoms distribution */
+EXTERN int diffpat_batch INIT(1);   /* snapshots transformed together */
+EXTERN int diffpat_nx INIT(0);      /* number of local x-planes (MPI) */
+EXTERN int diffpat_x0 INIT(0);      /* first local x-plane (MPI) */
 EXTERN fftwf_plan diffpat_plan;     /* plan for FFT */
 #endif
 
@@ -789,15 +851,16 @@ EXTERN integer ***GS INIT(NULL);   /* histogram array for self correlation */
 #if defined(HC) || defined(NVX)
 EXTERN int hc_start INIT(2000);        /* heat current starting time */
 EXTERN int hc_int   INIT(0);           /* heat current writing interval */
+EXTERN int  hc_nlayers  INIT(0);       /* number of layers */
 #endif
 #ifdef HC
 EXTERN int hc_av_start INIT(1000);     /* energy average starting time  */
+EXTERN int hc_prof_int INIT(0);        /* layer profile writing interval */
 EXTERN vektor hc;                      /* heat current */
 EXTERN FILE *hc_file   INIT(NULL);     /* heat current file */
 EXTERN real heat_cond  INIT(0.0);      /* heat conductivity */
 #endif
 #ifdef NVX
-EXTERN int  hc_nlayers  INIT(0);       /* number of layers */
 EXTERN int  hc_count    INIT(0);       /* running index of temp. profile */
 EXTERN real hc_heatcurr INIT(0.0);     /* induced heat current density */
 #endif
@@ -815,11 +878,24 @@ EXTERN ivektor force_celldim_divisor INIT(einsivektor); /* if you want cell dime
 EXTERN  ttm_Element *** l1, *** l2, *** l3;
   /* These will be used to allocate and free the nets in bulk */
 EXTERN  ttm_Element * lattice1, * lattice2;
+  /* Contiguous per-field copies of the net used by the FD stencil,
+     same layout as lattice1 incl. ghost layers */
+EXTERN int  fd_n INIT(0);           /* number of elements incl. ghosts */
+EXTERN real *fd_t1 INIT(NULL), *fd_t2 INIT(NULL); /* T_el, new and old */
+EXTERN real *fd_md_temp INIT(NULL); /* lattice temperature */
+EXTERN real *fd_source INIT(NULL);  /* source term */
+EXTERN real *fd_xi INIT(NULL);      /* xi, summed over FD steps */
+EXTERN real *fd_act INIT(NULL);     /* 1 for active cells, 0 otherwise */
 EXTERN real fd_k INIT(1.0); /* electronic thermal conductivity */
 EXTERN real fd_c INIT(0.0); /* electronic thermal capacity */
 EXTERN real fd_gamma INIT(0.0); /* fd_c / T_e, proport. const. */
 EXTERN real fd_g INIT(1.0);        /* electron-phonon coupling constant */
 EXTERN int fd_n_timesteps INIT(1); /* how many FD steps to a MD timestep? */
+EXTERN int fd_implicit INIT(0);    /* implicit (theta scheme) FD steps? */
+EXTERN real fd_theta INIT(0.5);    /* 0.5: Crank-Nicolson, 1: backward Euler */
+EXTERN real fd_cg_tol INIT(1.0e-8);/* rel. residual of implicit FD solver */
+EXTERN int fd_cg_max_itr INIT(200);/* max. CG iterations per FD step */
+EXTERN real *fd_cg_buf INIT(NULL); /* CG work arrays */
 EXTERN int fd_update_steps INIT(1);/* how often are FD cells updated
 				      by averaging over atoms ? */
 EXTERN int fd_min_atoms INIT(3);   /* minimum number of atoms needed in a
@@ -840,15 +916,10 @@ EXTERN vektor fd_h	  INIT(nullvektor); /* lattice constants in coordinate direct
 EXTERN ivektor global_fd_dim INIT(nullivektor); /* global FD dimensions, w/o BC cells */
 EXTERN ivektor local_fd_dim INIT(nullivektor); /* local FD dimensions incl. 2 ghost layers in every direction */
 #ifdef MPI
-/* MPI Datatypes for parts of the 3d Array.
- *  mpi_*_block are the ones to be used,
- * the others are intermediate and used to build other types */
-EXTERN MPI_Datatype  mpi_element, mpi_element2,
-	             mpi_zrow, mpi_zrow_block,
-		     mpi_xplane, mpi_xplane_block,
-		     mpi_yplane, mpi_yplane_block,
-		     mpi_yrow, mpi_yrow_block,
-		     mpi_zplane, mpi_zplane_block;
+/* MPI Datatypes: lattice element for output, and the ghost planes
+ * of a field array perpendicular to x, y and z */
+EXTERN MPI_Datatype  mpi_element2,
+		     mpi_xplane_block, mpi_yplane_block, mpi_zplane_block;
 EXTERN MPI_Status stati[6];
 EXTERN MPI_Request reque[6];
 #endif /*MPI*/
@@ -881,6 +952,7 @@ EXTERN real laser_p_peak  INIT(0.0);   /* Peak power density (calculated in imd.
 EXTERN real laser_p_peak1  INIT(0.0);   /* Peak power density (calculated in imd.c from previous parameters)*/
 EXTERN real laser_atom_vol INIT(16.6);  /* Volume per particle (inverse density) ATTENTION: THIS VALUE IS VOR ALUMINUM ONLY*/
 EXTERN int  laser_rescale_mode INIT(1); /* Mode for laser velocity rescaling */
+EXTERN int  laser_surface_int INIT(0);  /* steps between surface updates, 0: never */
 
 #ifdef LASERYZ
 EXTERN real laser_sigma_w_y INIT(0.0); /* y-center of gaussian laser-pulse  */
@@ -905,6 +977,16 @@ EXTERN int pdecay_mode INIT (1);        /* which form of the damping function is
 #ifdef SM
 EXTERN int  charge_update_steps INIT(0); /* number of steps between charge updates */
 EXTERN int  sm_fixed_charges INIT(0);    /* if 1, keep charges fixed */
+EXTERN real sm_tol INIT(1e-5);           /* residual tolerance of charge solver */
+EXTERN int  sm_max_itr INIT(10);         /* max. iterations of charge solver */
+EXTERN int  sm_adapt INIT(0);            /* adaptive charge updates? */
+EXTERN real sm_adapt_dmax INIT(0.05);    /* displacement worth sm_tol residual */
+EXTERN int  sm_adapt_itr INIT(2);        /* iterations of a truncated solve */
+EXTERN int  sm_have_ref INIT(0);         /* SM_POS and sm_res are valid */
+EXTERN real sm_res INIT(0.0);            /* residual of the last solution */
+EXTERN int  sm_nsolve INIT(0);           /* number of full solves */
+EXTERN int  sm_ntrunc INIT(0);           /* number of truncated solves */
+EXTERN int  sm_nskip INIT(0);            /* number of skipped solves */
 EXTERN real sm_chi_0[2]; /* Initial value of the electronegativity */
 EXTERN real sm_Z[2];     /* Initial value of the effecitve core charge */
 EXTERN real sm_J_0[2];   /* atomic hardness or self-Coulomb repulsion */
@@ -954,6 +1036,12 @@ EXTERN real lj_aaa  [10][10];
 EXTERN real lj_epsilon_vec[55] INIT(zero55);
 EXTERN real lj_sigma2_vec[55] INIT(zero55);
 #endif
+#ifdef ANAPOT
+EXTERN ana_pot_t ana_pot[100];   /* analytic potentials, by i*ntypes+j */
+EXTERN int ana_have_ljg   INIT(0);  /* families present for any type pair */
+EXTERN int ana_have_morse INIT(0);
+EXTERN int ana_have_buck  INIT(0);
+#endif
 /* Lennard-Jones-Gauss */
 EXTERN real ljg_eps_lin[55] INIT(zero55);
 EXTERN real ljg_eps[10][10];
@@ -1184,6 +1272,7 @@ EXTERN real *neightab_r2cut INIT(NULL);    /* cutoff of neighbor table */
 
 #ifdef NNBR_TABLE
 EXTERN int nnbr_done INIT(0);              /* Flag indicating if nearest neighbors are computed during this time step */
+EXTERN real nnbr_r2cut INIT(0.0);          /* cutoff of nearest neighbor table, max. of all analyses */
 #endif
 
 #ifdef EPITAX
@@ -1241,6 +1330,7 @@ EXTERN int      fcs_pp3mg_degree         INIT(0);
 EXTERN int      fcs_pp3mg_max_part       INIT(0);
 EXTERN int      fcs_p2nfft_intpol_order  INIT(0);
 EXTERN real     fcs_p2nfft_epsI          INIT(0.0);
+EXTERN ivektor  fcs_direct_images        INIT(nullivektor);
 #endif
 #if defined(EWALD) || defined(COULOMB)
 EXTERN imd_timer ewald_time;
@@ -1278,6 +1368,10 @@ EXTERN real     coul_begin INIT(0.2); /* start of function table */
 EXTERN real     coul_shift;
 EXTERN real     coul_fshift;
 #endif /* EWALD or COULOMB */
+#ifdef RESPA
+EXTERN int      respa_n     INIT(1); /* long-range forces every respa_n steps */
+EXTERN int      respa_outer INIT(1); /* long-range forces due in this step? */
+#endif
 #ifdef DIPOLE
 EXTERN int      dp_fix     INIT(0); /* Keep dipoles fixed? */
 EXTERN real     dp_mix     INIT(0.8); /* dipole field mixing parameter */
@@ -1360,6 +1454,8 @@ EXTERN int  *dsf_k0     INIT(NULL);
 EXTERN int  *dsf_kdir   INIT(NULL);
 EXTERN int  *dsf_kmax   INIT(NULL);
 EXTERN real *dsf_weight INIT(NULL);
+EXTERN int  dsf_nt      INIT(0);      /* samples per time window of S(k,w) */
+EXTERN int  dsf_raw     INIT(1);      /* write rho(k,t) to .dsf file */
 #endif
 
 #ifdef CBE
@@ -1390,6 +1486,12 @@ EXTERN real phi_dl INIT(0.0);
 EXTERN real phi_dr INIT(0.0);
 EXTERN real phi_lr INIT(0.0);
 EXTERN real neb_maxmove INIT(0.0);
+EXTERN MPI_Comm neb_rep_comm;               /* same CPU in all images */
+#ifdef MPI
+EXTERN MPI_Comm neb_img_comm;               /* all CPUs of my image */
+#endif
+EXTERN int  neb_nfirst INIT(0);             /* first atom of my NEB block */
+EXTERN int  neb_nblk   INIT(0);             /* number of atoms in block */
 #endif
 
 
@@ -1422,6 +1524,47 @@ EXTERN int bflag2 INIT(0);		/* flag to switch the testing mode or safe mode for
 EXTERN int bflag3 INIT(0);		/* flag for time windows used to apply minimization to boost MD */
 #endif
 
+#ifdef PRD
+#define PRD_NSAVE (3*DIM)                  /* reference minimum, saved x and p */
+EXTERN int  prd_nrep INIT(1);              /* number of replicas */
+EXTERN int  prd_dephase INIT(1000);        /* steps of dephasing */
+EXTERN int  prd_check_int INIT(200);       /* steps between transition checks */
+EXTERN int  prd_corr INIT(1000);           /* correlation steps after a transition */
+EXTERN int  prd_quench_steps INIT(2000);   /* max steps of a quench */
+EXTERN real prd_quench_fmax INIT(1.0e-3);  /* largest force ending a quench */
+EXTERN real prd_dmax INIT(0.5);            /* displacement indicating a transition */
+EXTERN real prd_time INIT(0.0);            /* accumulated time of all replicas */
+EXTERN int  prd_nevent INIT(0);            /* number of transitions */
+EXTERN char *prd_outfilename INIT(NULL);   /* outfiles without replica suffix */
+EXTERN FILE *prd_file INIT(NULL);          /* pointer to .prd file */
+#ifdef MPI
+EXTERN MPI_Comm prd_comm;                  /* all CPUs of my replica */
+EXTERN MPI_Comm prd_rep_comm;              /* same CPU in all replicas */
+#endif
+#endif
+
+#ifdef MTAU
+EXTERN int  mtau_int INIT(0);              /* steps between samples */
+EXTERN int  mtau_start INIT(0);            /* step of the first sample */
+EXTERN int  mtau_write_int INIT(0);        /* steps between writes, 0: at end */
+EXTERN int  mtau_p INIT(16);               /* values per level */
+EXTERN int  mtau_m INIT(2);                /* averaging factor between levels */
+EXTERN int  mtau_levels INIT(8);           /* number of levels */
+EXTERN int  mtau_msqd INIT(1);             /* correlate displacements */
+EXTERN int  mtau_vacf INIT(1);             /* correlate velocities */
+EXTERN int  mtau_hc INIT(1);               /* correlate heat current */
+EXTERN int  mtau_len INIT(0);              /* length of per atom history */
+#endif
+
+#ifdef SHAKE
+EXTERN str255 shake_file INIT("\0");       /* file with the constraints */
+EXTERN real shake_tol INIT(1.0e-8);        /* relative tolerance of d^2 */
+EXTERN int  shake_maxit INIT(500);         /* max number of iterations */
+EXTERN int  shake_n INIT(0);               /* number of constraints */
+EXTERN int  *shake_atoms INIT(NULL);       /* atom numbers of constraints */
+EXTERN real *shake_dist INIT(NULL);        /* constrained distances */
+#endif
+
 #ifdef KIM
 EXTERN str255 kim_model_name;
 EXTERN char **kim_el_names INIT(NULL);
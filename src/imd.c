@@ -66,6 +66,10 @@ int main(int argc, char **argv)
   imd_init_timer( &time_input,      1, "input",     "orange");
   imd_init_timer( &time_integrate,  1, "integrate", "green" );
   imd_init_timer( &time_forces,     1, "forces",    "yellow");
+#ifdef USEFCS
+  imd_init_timer( &time_fcs_pack,   1, "fcs_pack",  "red"   );
+  imd_init_timer( &time_fcs_run,    1, "fcs_run",   "blue"  );
+#endif
 #if defined(CBE)
   tick0 = ticks();
 #endif
@@ -173,7 +177,7 @@ int main(int argc, char **argv)
 #ifdef RELAX
   if ((imdrestart==0) && (eng_int>0))
   {
-      if ( (ensemble==ENS_MIK) || (ensemble==ENS_GLOK) || (ensemble==ENS_CG) )
+      if (IS_RELAX_ENS(ensemble))
           write_ssdef_header();
   }
 #endif
@@ -191,6 +195,18 @@ int main(int argc, char **argv)
   init_bboost();
 #endif
 
+#ifdef SHAKE
+  init_shake();
+#endif
+
+#ifdef PRD
+  init_prd();
+#endif
+
+#ifdef MTAU
+  if (mtau_int > 0) init_mtau();
+#endif
+
 #ifdef BEND
   init_bend();
 #endif
@@ -212,6 +228,12 @@ int main(int argc, char **argv)
 #ifdef NYETENSOR
   init_NyeTensor();
 #endif
+#ifdef PTM
+  if (ptm_int > 0) init_ptm();
+#endif
+#ifdef RDF
+  if (rdf_int > 0) init_rdf();
+#endif
 
 #ifdef LASER
   init_laser();
@@ -292,6 +314,12 @@ int main(int argc, char **argv)
     if (0 == myid) printf("EPITAX: %d atoms created.\n", nepitax);
 #endif
 
+#ifdef SM
+    if (sm_adapt)
+      printf("SM: %d full, %d truncated and %d skipped charge updates\n\n",
+             sm_nsolve, sm_ntrunc, sm_nskip);
+#endif
+
 #ifdef OMP
     num_threads = omp_get_max_threads();
 #else
@@ -336,6 +364,15 @@ int main(int argc, char **argv)
            time_input.total,100*time_input.total/time_main.total);
     printf("Force  time:   %e seconds or %.1f %% of main loop\n",
            time_forces.total,100*time_forces.total/time_main.total);
+#ifdef USEFCS
+    printf("FCS solve time:     %e seconds or %.1f %% of main loop\n",
+           time_fcs_run.total, 100*time_fcs_run.total/time_main.total);
+    if (time_fcs_run.total > 0.0)
+      printf("FCS pack/unpack:    %e seconds or %.1f %% of FCS solve time\n",
+             time_fcs_pack.total, 100*time_fcs_pack.total/time_fcs_run.total);
+    else
+      printf("FCS pack/unpack:    %e seconds\n", time_fcs_pack.total);
+#endif
 #endif
 
      fflush(stdout);
@@ -396,7 +433,7 @@ int main(int argc, char **argv)
   real Emax=-999999;
   real Emin=999999;
   int maxi=0;
-  if (myrank==0)
+  if ((myrank==0) && (myid==0))
     {
       printf ("NEB:\n # Image Epot\n");
       for(i=0;i<neb_nrep;i++)
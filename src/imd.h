@@ -57,10 +57,14 @@
 #include <omp.h>
 #endif
 
-/* FFT for diffraction patterns */
-#ifdef DIFFPAT
+/* FFT for diffraction patterns and dynamical structure factor */
+#if defined(DIFFPAT) || defined(DSF)
+#ifdef MPI
+#include <fftw3-mpi.h>
+#else
 #include <fftw3.h>
 #endif
+#endif
 
 /* IMD version */
 #include "version.h"
@@ -37,6 +37,8 @@ void init_ada(void) {
 		}
 	}
 
+	nnbr_r2cut = MAX(nnbr_r2cut, ada_nbr_r2cut);
+
 	if (ada_crystal_structure == ADA_FCC_CONFIG) {
 		ada_default_type = 1;
 	} else if (ada_crystal_structure == ADA_BCC_CONFIG) {
@@ -63,15 +65,18 @@ void init_ada(void) {
 	}
 }
 
-void do_ada(void) {
-	real v1_length, v2_length, angle;
+static real **ada_scr    = NULL;	/* unit bond vectors, per thread */
+static int  *ada_scrlen = NULL;
+
+/* classify an atom from the angles between the unit vectors u to its n
+ * neighbors */
+static shortint ada_classify(real *u, int nneigh) {
 	int co_x0, co_x1, co_x2, co_x3, co_x4, co_x5, co_x6, co_x7;
-	real delta_bcc, delta_cp, delta_fcc, delta_hcp;
-	int nneigh, k, i, j, ii, jj;
-	shortint type = 0;
-	vektor v1, v2;
+	real delta_bcc, delta_cp, delta_fcc, delta_hcp, angle;
+	int j, jj;
+
+	co_x0 = co_x1 = co_x2 = co_x3 = co_x4 = co_x5 = co_x6 = co_x7 = 0;
 
-	do_neightab_complete();
 	if (ada_crystal_structure == ADA_FCC_CONFIG) {
 		/*
 		 * typ=0: bcc
@@ -83,62 +88,33 @@ void do_ada(void) {
 		 * typ=6: less than 10 neighbors
 		 * typ=7: more than 14 neighbors
 		 */
-
-		for (k = 0; k < ncells; k++) {
-			cell *p = CELLPTR(k);
-			for (i = 0; i < p->n; i++) {
-				nneigh = NEIGH(p, i)->n;
-
-				if (nneigh < 10)
-					type = 6;
-				else if (nneigh < 12)
-					type = 4;
-				else if (nneigh > 14)
-					type = 7;
-				else {
-					co_x0 = 0;
-					co_x1 = 0;
-					co_x2 = 0;
-
-					for (j = 0; j < nneigh; j++) {
-						real *tmp_ptr = &(NEIGH(p,i)->dist[3*j]);
-						v1.x = *tmp_ptr; tmp_ptr++;
-						v1.y = *tmp_ptr; tmp_ptr++;
-						v1.z = *tmp_ptr;
-						v1_length = sqrt(SPROD(v1,v1));
-						for (jj = 0; jj < j; jj++) {
-							real *tmp_ptr  = &NEIGH(p,i)->dist[3*jj];
-							v2.x = *tmp_ptr; tmp_ptr++;
-							v2.y = *tmp_ptr; tmp_ptr++;
-							v2.z = *tmp_ptr;
-							v2_length = sqrt(SPROD(v2,v2));
-							angle = SPROD(v1,v2);
-							angle /= (v1_length * v2_length);
-							if (angle < -.945)
-								co_x0++;
-							else if (angle < -.915)
-								co_x1++;
-							else if (angle < -.775)
-								co_x2++;
-						}
-					}
-
-					if (co_x0 == 7 && nneigh == 14)
-						type = 0;
-					else if (co_x0 == 6 && nneigh == 12)
-						type = 1;
-					else if (co_x0 == 3 && co_x1 <= 1 && co_x2 > 2 && nneigh == 12)
-						type = 2;
-					else if (nneigh > 12)
-						type = 5;
-					else if (nneigh == 12)
-						type = 3;
-					else
-						type = 4;
-				}
-				ADATYPE(p, i) = type;
+		if (nneigh < 10) return 6;
+		if (nneigh < 12) return 4;
+		if (nneigh > 14) return 7;
+
+		for (j = 0; j < nneigh; j++)
+			for (jj = 0; jj < j; jj++) {
+				angle = u[3*j]*u[3*jj] + u[3*j+1]*u[3*jj+1] + u[3*j+2]*u[3*jj+2];
+				if (angle < -.945)
+					co_x0++;
+				else if (angle < -.915)
+					co_x1++;
+				else if (angle < -.775)
+					co_x2++;
 			}
-		}
+
+		if (co_x0 == 7 && nneigh == 14)
+			return 0;
+		else if (co_x0 == 6 && nneigh == 12)
+			return 1;
+		else if (co_x0 == 3 && co_x1 <= 1 && co_x2 > 2 && nneigh == 12)
+			return 2;
+		else if (nneigh > 12)
+			return 5;
+		else if (nneigh == 12)
+			return 3;
+		else
+			return 4;
 	} else if (ada_crystal_structure == ADA_BCC_CONFIG) {
 		/*
 		 * type=0: bcc
@@ -150,64 +126,31 @@ void do_ada(void) {
 		 * type=6: less than 11 neighbors
 		 * type=7: unknown
 		 */
-		for (k = 0; k < ncells; k++) {
-			cell *p = CELLPTR(k);
-			for (i = 0; i < p->n; i++) {
-				nneigh = NEIGH(p, i)->n;
-
-				if (nneigh < 11) type = 6;
-				else if (nneigh == 13) type = 4;
-				else if (nneigh == 15) type = 5;
-				else if (nneigh > 15) type = 7;
-				else {
-					co_x0 = 0;
-					co_x1 = 0;
-					co_x2 = 0;
-					co_x3 = 0;
-					co_x4 = 0;
-
-					for (j = 0; j < nneigh; j++) {
-						real *tmp_ptr = &(NEIGH(p,i)->dist[3*j]);
-						v1.x = *tmp_ptr; tmp_ptr++;
-						v1.y = *tmp_ptr; tmp_ptr++;
-						v1.z = *tmp_ptr;
-						v1_length = sqrt(SPROD(v1,v1));
-						for (jj = 0; jj < j; jj++) {
-							real *tmp_ptr  = &NEIGH(p,i)->dist[3*jj];
-							v2.x = *tmp_ptr; tmp_ptr++;
-							v2.y = *tmp_ptr; tmp_ptr++;
-							v2.z = *tmp_ptr;
-							v2_length = sqrt(SPROD(v2,v2));
-							angle = SPROD(v1,v2);
-							angle /= (v1_length * v2_length);
-
-							if (angle < -.945)
-								co_x0++;
-							else if (angle < -.915)
-								co_x1++;
-							else if (angle < -.755)
-								co_x2++;
-							else if (angle < -.705)
-								co_x3++;
-							else if ((angle > -.195) & (angle < .195))
-								co_x4++;
-						}
-					}
-
-					if (co_x0 > 5 && co_x0+co_x1==7 && nneigh==14)
-						type = 0;
-					else if (co_x0 == 6 && nneigh == 12)
-						type = 1;
-					else if (co_x0 == 3 && nneigh == 12)
-						type = 2;
-					else if (nneigh == 12)
-						type = 4;
-					else type = 3;
-				}
-				ADATYPE(p, i) = type;
+		if (nneigh < 11) return 6;
+		if (nneigh == 13) return 4;
+		if (nneigh == 15) return 5;
+		if (nneigh > 15) return 7;
+
+		for (j = 0; j < nneigh; j++)
+			for (jj = 0; jj < j; jj++) {
+				angle = u[3*j]*u[3*jj] + u[3*j+1]*u[3*jj+1] + u[3*j+2]*u[3*jj+2];
+				if (angle < -.945)
+					co_x0++;
+				else if (angle < -.915)
+					co_x1++;
 			}
-		}
-	} else if (ada_crystal_structure == ADA_ACKLAND_CONFIG) {
+
+		if (co_x0 > 5 && co_x0+co_x1==7 && nneigh==14)
+			return 0;
+		else if (co_x0 == 6 && nneigh == 12)
+			return 1;
+		else if (co_x0 == 3 && nneigh == 12)
+			return 2;
+		else if (nneigh == 12)
+			return 4;
+		else
+			return 3;
+	} else {
 		/*
 		 * type=0: bcc
 		 * type=1: fcc
@@ -215,83 +158,112 @@ void do_ada(void) {
 		 * type=3: unassigned
 		 * type=4: unknown (usually surface)
 		 */
-		for (k = 0; k < ncells; k++) {
-			cell *p = CELLPTR(k);
-			for (i = 0; i < p->n; i++) {
-				nneigh = NEIGH(p, i)->n;
+		if (nneigh == 0) return 4;
+
+		for (j = 0; j < nneigh; j++)
+			for (jj = 0; jj < j; jj++) {
+				angle = u[3*j]*u[3*jj] + u[3*j+1]*u[3*jj+1] + u[3*j+2]*u[3*jj+2];
+				if (angle < -.945)
+					co_x0++;
+				else if (angle < -.915)
+					co_x1++;
+				else if (angle < -.755)
+					co_x2++;
+				else if (angle < -.705)
+					co_x3++;
+				else if ((angle > -.195) && (angle < 195))
+					co_x4++;
+				else if (angle < -.245)
+					co_x5++;
+				else if (angle < -.795)
+					co_x6++;
+				else co_x7++;
+			}
+		delta_bcc = (0.35 * co_x4)
+				/ (co_x5 + co_x6 + co_x7 - co_x4);
+		delta_cp = 0.61 * ABS(1.-co_x6/24.);
+		delta_fcc = 0.61 * (ABS(co_x0+co_x1-6) + co_x2) / 6.;
+		delta_hcp = (ABS(co_x0-3) + ABS(co_x0+co_x1+co_x2+co_x3-9))
+				/ 12.;
+
+		if (nneigh < 11 || co_x7 > 0)
+			return 4;
+		else if (co_x0 == 7)
+			return 0;
+		else if (co_x0 == 6)
+			return 1;
+		else if (co_x0 == 3)
+			return 2;
+		else if (delta_bcc < 0.1 && delta_fcc < 0.1
+				&& delta_hcp < 0.1 && delta_cp < 0.1)
+			return 3;
+		else if (delta_bcc < delta_cp && 10 < nneigh && nneigh < 13)
+			return 0;
+		else if (nneigh > 12)
+			return 3;
+		else if (delta_hcp < delta_fcc)
+			return 2;
+		else
+			return 1;
+	}
+}
 
-				co_x0 = 0;
-				co_x1 = 0;
-				co_x2 = 0;
-				co_x3 = 0;
-				co_x4 = 0;
-				co_x5 = 0;
-				co_x6 = 0;
-				co_x7 = 0;
+void do_ada(void) {
+	int k, nthreads = 1;
 
-				for (j = 0; j < nneigh; j++) {
-					real *tmp_ptr = &(NEIGH(p,i)->dist[3*j]);
-					v1.x = *tmp_ptr; tmp_ptr++;
-					v1.y = *tmp_ptr; tmp_ptr++;
-					v1.z = *tmp_ptr;
-					v1_length = sqrt(SPROD(v1,v1));
-					for (jj = 0; jj < j; jj++) {
-						real *tmp_ptr  = &NEIGH(p,i)->dist[3*jj];
-						v2.x = *tmp_ptr; tmp_ptr++;
-						v2.y = *tmp_ptr; tmp_ptr++;
-						v2.z = *tmp_ptr;
-						v2_length = sqrt(SPROD(v2,v2));
-						angle = SPROD(v1,v2);
-						angle /= (v1_length * v2_length);
-
-						if (angle < -.945)
-							co_x0++;
-						else if (angle < -.915)
-							co_x1++;
-						else if (angle < -.755)
-							co_x2++;
-						else if (angle < -.705)
-							co_x3++;
-						else if ((angle > -.195) && (angle < 195))
-							co_x4++;
-						else if (angle < -.245)
-							co_x5++;
-						else if (angle < -.795)
-							co_x6++;
-						else co_x7++;
-					}
-					delta_bcc = (0.35 * co_x4)
-							/ (co_x5 + co_x6 + co_x7 - co_x4);
-					delta_cp = 0.61 * ABS(1.-co_x6/24.);
-					delta_fcc = 0.61 * (ABS(co_x0+co_x1-6) + co_x2) / 6.;
-					delta_hcp = (ABS(co_x0-3) + ABS(co_x0+co_x1+co_x2+co_x3-9))
-							/ 12.;
-
-					if (nneigh < 11 || co_x7 > 0)
-						type = 4;
-					else if (co_x0 == 7)
-						type = 0;
-					else if (co_x0 == 6)
-						type = 1;
-					else if (co_x0 == 3)
-						type = 2;
-					else if (delta_bcc < 0.1 && delta_fcc < 0.1
-							&& delta_hcp < 0.1 && delta_cp < 0.1)
-						type = 3;
-					else if (delta_bcc < delta_cp && 10 < nneigh && nneigh < 13)
-						type = 0;
-					else if (nneigh > 12)
-						type = 3;
-					else if (delta_hcp < delta_fcc)
-						type = 2;
-					else
-						type = 1;
-				}
-				ADATYPE(p, i) = type;
+	if ((ada_crystal_structure != ADA_FCC_CONFIG) &&
+			(ada_crystal_structure != ADA_BCC_CONFIG) &&
+			(ada_crystal_structure != ADA_ACKLAND_CONFIG))
+		error("Crystal structure not supported by ADA");
+
+#ifdef _OPENMP
+	nthreads = omp_get_max_threads();
+#endif
+	if (NULL == ada_scr) {
+		ada_scr    = (real **) calloc(nthreads, sizeof(real *));
+		ada_scrlen = (int   *) calloc(nthreads, sizeof(int));
+		if ((NULL == ada_scr) || (NULL == ada_scrlen))
+			error("cannot allocate ADA scratch");
+	}
+
+	do_neightab_complete();
+
+	/* atoms are classified independently from their neighbor tables */
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (k = 0; k < ncells; k++) {
+		cell *p = CELLPTR(k);
+		int i, j, tid = 0;
+#ifdef _OPENMP
+		tid = omp_get_thread_num();
+#endif
+		for (i = 0; i < p->n; i++) {
+			neightab *neigh = NEIGH(p, i);
+			real *u, *d = neigh->dist, l, r2;
+			int nneigh = 0;
+
+			if (ada_scrlen[tid] < neigh->n) {
+				ada_scrlen[tid] = neigh->n;
+				ada_scr[tid] = (real *) realloc(ada_scr[tid], 3*neigh->n*sizeof(real));
+				if (NULL == ada_scr[tid])
+					error("cannot allocate ADA scratch");
+			}
+			u = ada_scr[tid];
+
+			/* unit bond vectors, normalized once per neighbor; the table
+			   may be longer if it is shared with other analyses */
+			for (j = 0; j < neigh->n; j++) {
+				r2 = SQR(d[3*j]) + SQR(d[3*j+1]) + SQR(d[3*j+2]);
+				if (r2 > ada_nbr_r2cut) continue;
+				l = 1.0 / sqrt(r2);
+				u[3*nneigh  ] = d[3*j  ] * l;
+				u[3*nneigh+1] = d[3*j+1] * l;
+				u[3*nneigh+2] = d[3*j+2] * l;
+				nneigh++;
 			}
+			ADATYPE(p, i) = ada_classify(u, nneigh);
 		}
-	} else {
-		error("Crystal structure not supported by ADA");
 	}
 }
 
@@ -485,6 +457,7 @@ void copy_hopsToDefect(int k, int l, int m, int r, int s, int t) {
 
 void send_fromBufferToCells(void(*add_func)(int, int, int, int, int, int),
 		void(*pack_func)(msgbuf*, int, int, int), void(*unpack_func)(msgbuf*, int, int, int)) {
+#ifdef BUFCELLS /* without buffer cells, all neighbors are in original cells */
 	int i, j;
 
 #ifdef MPI
@@ -614,6 +587,7 @@ void send_fromBufferToCells(void(*add_func)(int, int, int, int, int, int),
 				(*unpack_func)(&recv_buf_up, i, j, 1);
 #endif
 	}
+#endif /* BUFCELLS */
 }
 
 /******************************************************************************
@@ -621,6 +595,7 @@ void send_fromBufferToCells(void(*add_func)(int, int, int, int, int, int),
  ******************************************************************************/
 void send_fromCellsToBuffer(void(*copy_func)(int, int, int, int, int, int),
 		void(*pack_func)(msgbuf*, int, int, int), void(*unpack_func)(msgbuf*, int, int, int)) {
+#ifdef BUFCELLS /* without buffer cells, all neighbors are in original cells */
 	int i, j;
 
 #ifdef MPI
@@ -761,4 +736,5 @@ void send_fromCellsToBuffer(void(*copy_func)(int, int, int, int, int, int),
 				(*unpack_func)(&recv_buf_east, 0, i, j);
 #endif
 	}
+#endif /* BUFCELLS */
 }
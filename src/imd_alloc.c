@@ -199,6 +199,13 @@ void copy_atom_cell_cell(cell *to, int i, cell *from, int j)
 #ifdef VARCHG
   to->charge[i] = from->charge[j];
 #endif
+#ifdef SM
+  to->sm_pos X(i) = from->sm_pos X(j);
+  to->sm_pos Y(i) = from->sm_pos Y(j);
+#ifndef TWOD
+  to->sm_pos Z(i) = from->sm_pos Z(j);
+#endif
+#endif
 #ifdef DIPOLE
   to->dp_p_ind  X(i)   = from->dp_p_ind X(j);
   to->dp_p_ind  Y(i)   = from->dp_p_ind Y(j);
@@ -230,6 +237,23 @@ void copy_atom_cell_cell(cell *to, int i, cell *from, int j)
   to->old_ort  Z(i) = from->old_ort Z(j); 
 #endif
 #endif
+#ifdef LBFGS
+  for (k=0; k<lbfgs_len; k++)
+    to->lbfgs[i*lbfgs_len+k] = from->lbfgs[j*lbfgs_len+k];
+#endif
+#ifdef PRD
+  for (k=0; k<PRD_NSAVE; k++)
+    to->prd_save[i*PRD_NSAVE+k] = from->prd_save[j*PRD_NSAVE+k];
+#endif
+#ifdef MTAU
+  for (k=0; k<mtau_len; k++)
+    to->mtau[i*mtau_len+k] = from->mtau[j*mtau_len+k];
+#endif
+#ifdef SHAKE
+  to->shake_d  X(i) = from->shake_d X(j);
+  to->shake_d  Y(i) = from->shake_d Y(j);
+  to->shake_d  Z(i) = from->shake_d Z(j);
+#endif
 #ifdef DISLOC
   to->Epot_ref  [i] = from->Epot_ref[j];
   to->ort_ref X (i) = from->ort_ref X(j);
@@ -245,6 +269,11 @@ void copy_atom_cell_cell(cell *to, int i, cell *from, int j)
   to->adaType[i] = from->adaType[j];
   to->hopsToDefect[i] = from->hopsToDefect[j];
 #endif
+#ifdef PTM
+  to->ptm_type[i] = from->ptm_type[j];
+  for (k=0; k<PTM_NDAT; k++)
+    to->ptm_dat[i*PTM_NDAT+k] = from->ptm_dat[j*PTM_NDAT+k];
+#endif
 #ifdef AVPOS
   to->av_epot[i] = from->av_epot[j];
   to->avpos X(i) = from->avpos X(j);
@@ -608,6 +637,7 @@ void alloc_cell(cell *p, int n)
   memalloc(&p->d_sm,   n, sizeof(real),   al, ncopy, 0, "d_sm");
   memalloc(&p->s_sm,   n, sizeof(real),   al, ncopy, 0, "s_sm");
   memalloc(&p->q_sm,   n, sizeof(real),   al, ncopy, 0, "q_sm");
+  memalloc(&p->sm_pos, n*SDIM, sizeof(real), al, ncopy*SDIM, 0, "sm_pos");
 #endif
 #ifdef DIPOLE
   memalloc( &p->dp_E_stat, n*DIM, sizeof(real), al, ncopy*DIM, 0, "dp_E_stat");
@@ -623,6 +653,20 @@ void alloc_cell(cell *p, int n)
   memalloc( &p->g,        n*SDIM, sizeof(real), al, ncopy*SDIM, 0, "g" );
   memalloc( &p->old_ort,  n*SDIM, sizeof(real), al, ncopy*SDIM, 0, "old_ort" );
 #endif
+#ifdef LBFGS
+  memalloc( &p->lbfgs, n*lbfgs_len, sizeof(real), al, ncopy*lbfgs_len, 1,
+            "lbfgs" );
+#endif
+#ifdef PRD
+  memalloc( &p->prd_save, n*PRD_NSAVE, sizeof(real), al, ncopy*PRD_NSAVE, 0,
+            "prd_save" );
+#endif
+#ifdef MTAU
+  memalloc( &p->mtau, n*mtau_len, sizeof(real), al, ncopy*mtau_len, 0, "mtau" );
+#endif
+#ifdef SHAKE
+  memalloc( &p->shake_d,  n*SDIM, sizeof(real), al, ncopy*SDIM, 0, "shake_d" );
+#endif
 #ifdef NNBR
   memalloc( &p->nbanz,    n, sizeof(shortint), al, ncopy, 0, "nbanz" );
 #endif
@@ -637,8 +681,12 @@ void alloc_cell(cell *p, int n)
   memalloc( &p->adaType,  n, sizeof(shortint), al, ncopy, 127, "adaType" );
   memalloc( &p->hopsToDefect,  n, sizeof(shortint), al, ncopy, 127, "hopsToDefect" );
 #endif
+#ifdef PTM
+  memalloc( &p->ptm_type, n, sizeof(shortint), al, ncopy, 1, "ptm_type" );
+  memalloc( &p->ptm_dat,  n*PTM_NDAT, sizeof(real), al, ncopy*PTM_NDAT, 1, "ptm_dat" );
+#endif
 #ifdef NYETENSOR
-  memalloc( &p->nyeTens, n, sizeof(nyeTensorInfo*), al, ncopy, 1, "nyeTensorInfo" );
+  memalloc( &p->nyeTens, n, sizeof(nyeTensorInfo), al, ncopy, 1, "nyeTensorInfo" );
 #endif
 #ifdef AVPOS
   memalloc( &p->av_epot,  n,      sizeof(real), al, ncopy,      1, "av_epot" );
@@ -52,6 +52,12 @@ void  init_bboost(void)
 #ifdef CG
     if (ensemble == ENS_CG) reset_cg();
 #endif
+#ifdef LBFGS
+    if (ensemble == ENS_LBFGS) reset_lbfgs();
+#endif
+#ifdef FIRE2
+    if (ensemble == ENS_FIRE2) reset_fire2();
+#endif
 
 #ifdef DEFORM
     deform_int = 0; 
@@ -259,13 +265,14 @@ int bb_minimize(int simulation)
 		     ((force_int  > 0) && (0 == steps % force_int )) ||
 #endif /* FORCE */
                      ((dist_int  > 0) && (0 == steps % dist_int )) ||
+                     ((dist_av_int > 0) && (0 == steps % dist_av_int)) ||
                      (relax_rate > 0.0) );
 #endif
 
 #ifdef EXTPOT
     /* update extpot position if necessary */
 #ifdef RELAX
-    if ( ((ensemble==ENS_MIK) || (ensemble==ENS_GLOK) || (ensemble==ENS_CG)) &&
+    if ( IS_RELAX_ENS(ensemble) &&
          (ep_max_int > 0) ) {
         if ((is_relaxed) || (ep_int > ep_max_int)) {
             write_ssdef(steps);    /* write info for quasistat simulations */
@@ -280,6 +287,12 @@ int bb_minimize(int simulation)
             {
                 reset_glok();
             }
+#endif
+#ifdef LBFGS
+            if (ensemble==ENS_LBFGS) reset_lbfgs();
+#endif
+#ifdef FIRE2
+            if (ensemble==ENS_FIRE2) reset_fire2();
 #endif
         }
         ep_int++;
@@ -375,11 +388,12 @@ int bb_minimize(int simulation)
     if ((checkpt_int > 0) && (0 == steps % checkpt_int)) 
        write_config( steps/checkpt_int, steps);
     if ((eng_int  > 0) && (0 == steps % eng_int )) write_eng_file(steps);
+    if ((dist_av_int > 0) && (0 == steps % dist_av_int)) update_distrib();
     if ((dist_int > 0) && (0 == steps % dist_int)) write_distrib(steps);
     if ((pic_int  > 0) && (0 == steps % pic_int )) write_pictures(steps);
 #ifdef EXTPOT
 #ifdef RELAX
-    if ( ((ensemble==ENS_MIK) || (ensemble==ENS_GLOK) || (ensemble==ENS_CG)) &&
+    if ( IS_RELAX_ENS(ensemble) &&
          (ep_max_int <= 0) )
 #endif
     if ((eng_int > 0) && (0 == steps % eng_int )) write_fext(steps);
@@ -453,7 +467,7 @@ int bb_minimize(int simulation)
       /* finish, if max deformation steps in quasistatic simulation are done */
 #ifdef RELAX
 #if defined (DEFORM) || defined (HOMDEF) || defined (EXTPOT) || defined (FBC)
-    if ( (ensemble==ENS_MIK) || (ensemble==ENS_GLOK) || (ensemble==ENS_CG) ) {
+    if (IS_RELAX_ENS(ensemble)) {
         if ( (max_sscount>0) && (sscount>max_sscount) ) {
                  finished = 1 ;
                  steps_max = steps;
@@ -475,7 +489,7 @@ int bb_minimize(int simulation)
   imdrestart=0;
   if (0==myid) {
     write_itr_file(-1, steps_max,"");
-    if (0==myrank) printf( "End of simulation %d\n", simulation );
+    if ((0==myrank) && (0==myid)) printf( "End of simulation %d\n", simulation );
   }  
   return finished;
 }
@@ -21,299 +21,10 @@
 
 #include "imd.h"
 
-/******************************************************************************
-*
-*  do_cna -- Perform Common-Neighbour Analysis
-*
-******************************************************************************/
-
-#ifdef NBLIST
-
-void do_cna(void)
-{
-  vektor pbc = {0.0, 0.0, 0.0}; /* atoms in buffer cells have pbc applied */
-  int c, c1, c2, m;
-#ifdef BBOOST
-    printf("    ************************* \n");fflush(stdout);
-    printf("********************************* \n");fflush(stdout);
-    printf("passing "" do_cna 1 start, without ipbc"" checking by Lo! \n");fflush(stdout);
-    printf("********************************* \n");fflush(stdout);
-    printf("    ************************* \n");fflush(stdout);
-#endif
-  for (c=0; c<ncells; c++) {
-    c1 = cnbrs[c].np;
-    for (m=0; m<14; m++) {
-      c2 = cnbrs[c].nq[m];
-      if (c2<0) continue;
-      do_cna_func(cell_array + c1, cell_array + c2, pbc);
-    }
-  }
-  /* collect mark variables */
-  send_forces(add_mark,pack_mark,unpack_add_mark);
-#ifdef BBOOST
-    printf("    ************************* \n");fflush(stdout);
-    printf("********************************* \n");fflush(stdout);
-    printf("passing "" do_cna 1 end, without ipbc"" checking by Lo! \n");fflush(stdout);
-    printf("********************************* \n");fflush(stdout);
-    printf("    ************************* \n");fflush(stdout);
-#endif
-
-}
-
-#else
-
-void do_cna(void)
-{
-  vektor pbc;
-  int n, k;
-    printf("    ************************* \n");fflush(stdout);
-    printf("********************************* \n");fflush(stdout);
-    printf("passing "" do_cna 2 start, with ipbc"" checking by Lo! \n");fflush(stdout);
-    printf("********************************* \n");fflush(stdout);
-    printf("    ************************* \n");fflush(stdout); 
-  for (n=0; n<nlists; ++n) {
-    for (k=0; k<npairs[n]; ++k) {
-      pair *P = pairs[n] + k;
-      pbc.x = P->ipbc[0]*box_x.x + P->ipbc[1]*box_y.x + P->ipbc[2]*box_z.x;
-      pbc.y = P->ipbc[0]*box_x.y + P->ipbc[1]*box_y.y + P->ipbc[2]*box_z.y;
-      pbc.z = P->ipbc[0]*box_x.z + P->ipbc[1]*box_y.z + P->ipbc[2]*box_z.z;
-      do_cna_func(cell_array + P->np, cell_array + P->nq, pbc);
-    }
-  }
-#ifdef MPI
-  /* collect mark variables */
-  send_forces(add_mark,pack_mark,unpack_add_mark);
-#endif
-    printf("    ************************* \n");fflush(stdout);
-    printf("********************************* \n");fflush(stdout);
-    printf("passing "" do_cna 2 end, with ipbc"" checking by Lo! \n");fflush(stdout);
-    printf("********************************* \n");fflush(stdout);
-    printf("    ************************* \n");fflush(stdout); 
-}
-
-#endif
-
-void do_cna_func(cell *p, cell *q, vektor pbc) {
-
-  int       i, j, jstart, k, l, m;
-  neightab  *ineigh, *neigh;
-  vektor    tmp_d;
-  real      *qptr;
-  int       cna_neigh, cna_atoms, cna_bonds, cna_chain, tmp_cna_chain;
-  cell      *cna_cell[MAX_NEIGH];
-  int       cna_num[MAX_NEIGH];
-  vektor    cna_d[MAX_NEIGH];
-  cell      *cptr;
-  int       start, end;
-  int       type;
-  int       pair_index;
-  vektor    d, dj;
-  static vektor *di = NULL;
-  static int    curr_len = 0;
-  real      *tmpptr, dj2;
-  real      r2, distance;
-  int       index;
-  vektor    dk, dlk;
-  real      dlk2;
-  real      EPS = 0.001;
-
-  if (curr_len < neigh_len) {
-    di = (vektor *) realloc( di, neigh_len * sizeof(vektor) );
-   if ( di==NULL )
-      error("cannot allocate memory for temporary neighbor data");
-    curr_len = neigh_len;
-  }
+/* number of pair indices: four digits, and -1 for other pairs */
+#define CNA_NIDX 10001
 
-  /* For each atom in first cell */
-  for (i=0; i<p->n; ++i) {
-
-    tmp_d.x = ORT(p,i,X) - pbc.x;
-    tmp_d.y = ORT(p,i,Y) - pbc.y;
-    tmp_d.z = ORT(p,i,Z) - pbc.z;
-
-    ineigh  = NEIGH(p,i);
-
-    jstart = (((p==q) && (pbc.x==0) && (pbc.y==0) && (pbc.z==0)) ? i+1 : 0);
-
-    qptr   = &ORT(q,jstart,X);
-
-    /* For each atom in neighbouring cell */
-    for (j=jstart; j<q->n; ++j) {
-
-      /* calculate distance */
-      d.x = *qptr - tmp_d.x; ++qptr;
-      d.y = *qptr - tmp_d.y; ++qptr;
-      d.z = *qptr - tmp_d.z; ++qptr;
-	
-      cna_neigh = 2;
-      cna_atoms = 0;
-      cna_bonds = 0;
-      cna_chain = 0; 
-	
-      /* distance between neighbours */
-      r2 = SPROD(d,d);
-
-      /* consider only first neighbours */
-      if (r2 < cna_r2cut) {
-
-	tmpptr = ineigh->dist;
-
-	/* For all neighbours of atom i */
-	for (k=0; k<ineigh->n; k++) {
-	    
-	  /* Check whether j is neighbour of i */
-	  /* ist nur notwendig, wenn auch zweite Nachbarn betrachtet werden */
-	  if ( ineigh->cl[k] == q && ineigh->num[k] == j )
-	    cna_neigh = 1;
-
-	  /* distance between i and k */
-	  di[k].x    = *tmpptr++;
-	  di[k].y    = *tmpptr++;
-	  di[k].z    = *tmpptr++;	  
-
-	  /* Check whether k is neighbour of j */
-	  /* distance between j and k */
-	  dj.x = di[k].x - d.x;
-	  dj.y = di[k].y - d.y;
-	  dj.z = di[k].z - d.z;
-
-	  dj2 = SPROD(dj,dj);
-
-	  /* Count number of common neighbours and store them */
-	  if ( dj2 < cna_r2cut && dj2 > EPS) {
-
-	    if ( cna_atoms >= MAX_NEIGH )
-	      error("Too many common neighbours");
-	    cna_cell[cna_atoms]  = ineigh->cl[k];
-	    cna_num[cna_atoms]   = ineigh->num[k];
-	    cna_d[cna_atoms].x   = di[k].x;
-	    cna_d[cna_atoms].y   = di[k].y;
-	    cna_d[cna_atoms].z   = di[k].z;
-	    ++cna_atoms;
-	  }
-	} /* k */
-
-	if( cna_atoms > 0 ) {
-
-	  /* Count total number of pairs */
-	  ++cna_pairs;
-	    
-	  /* Count number of bonds and store them */
-	  for (k=0; k<cna_atoms; k++) {
-	    dk.x = cna_d[k].x;
-	    dk.y = cna_d[k].y;
-	    dk.z = cna_d[k].z;
-
-	    for (l=k+1; l<cna_atoms; l++) {
-
-	      dlk.x = dk.x - cna_d[l].x; 
-	      dlk.y = dk.y - cna_d[l].y; 
-	      dlk.z = dk.z - cna_d[l].z; 
-	      dlk2  = SPROD(dlk,dlk);
-
-	      if ( dlk2 < cna_r2cut ) {
-
-		if (cna_bonds>=MAX_BONDS)
-		  error("Too many bonds");
-		bondlist[cna_bonds][0] = k;
-		bondlist[cna_bonds][1] = l;
-		bondlist[cna_bonds][2] = 0;
-		cna_bonds++;
-	      }
-	    }
-	  }
-	      
-	  /* Count longest continuous chain of bonds */
-	  for (k=0; k<cna_bonds; k++) {
-	      
-	    /* Initialize bond data */
-	    start          = bondlist[k][0];
-	    end            = bondlist[k][1];
-	    for (l=0; l<cna_bonds; l++)
-	      bondlist[l][2] = 0;
-	    bondlist[k][2] = 1;
-	      
-	    tmp_cna_chain = 1;
-	    cna_chain = MAX(cna_chain,tmp_cna_chain);
-	    if (cna_chain==cna_bonds) 
-	      break;
-	      
-	    /* Add further bonds to start bond recursively */
-	    domino(start, end, cna_bonds, &cna_chain, &tmp_cna_chain);
-	      
-	    if (cna_chain==cna_bonds) 
-	      break;		
-	      
-	  }
-
-	  /* convert pair_type into integer form */
-	  if (cna_atoms<10 && cna_bonds<10)
-	    pair_index = ((cna_neigh*10+cna_atoms)*10+cna_bonds)*10+cna_chain;
-	  else
-	    pair_index = -1;
-
-	  /* count pair types according to crystallinity */
-	  if ( cna_crist > 0 ) {
-	    if ( pair_index == 1421 ) {
-	      MARK(p,i) += 10000;
-	      MARK(q,j) += 10000;
-	    }
-	    else if ( pair_index == 1422 ) {
-	      MARK(p,i) += 100;
-	      MARK(q,j) += 100;
-	    }
-	    else {
-	      ++MARK(p,i);
-	      ++MARK(q,j);
-	    }
-	  }
-
-	  /* Mark atoms to be written out */
-	  if ( cna_write_n > 0 ) {
-	    l = 1;
-	    for(k=0; k<cna_write_n; k++) {
-	      if ( pair_index == cna_writev[k] ) {
-		if ( MARK(p,i)%(2*l) < l ) MARK(p,i) += l;
-		if ( MARK(q,j)%(2*l) < l ) MARK(q,j) += l;
-	      }
-	      l *= 2;
-	    }
-	  }
-
-	  /* Count number of pairs of specific type */
-	  if (cna_write_statistics) {
-
-	    if ( type_list_length == 0 ) {
-	      type_list[type_list_length++] = pair_index;
-	      type = 0;
-	      type_count[type] = 0;
-	    }
-	    else {
-	      type = -1;
-	      for (k=0; k<type_list_length; k++)
-		if ( type_list[k] == pair_index ) {
-		  type = k;
-		  break;
-		}
-	    }
-	    
-	    if ( type == -1 ) {
-	      if (type_list_length>=MAX_TYPES)
-		error("Too many pair types");
-	      type_list[type_list_length++] = pair_index;
-	      type = type_list_length - 1;
-	      type_count[type]    = 0;
-	    }
-	    
-	    ++type_count[type];
-	  } 
-
-	} /* cna_atoms > 0 && ... */
-      } /* radius < r_cut */
-      
-    } /* j */
-  } /* i */
-}
+static long *cna_hist = NULL;     /* pair index histogram, per thread */
 
 /******************************************************************************
 *
@@ -321,7 +32,8 @@ void do_cna_func(cell *p, cell *q, vektor pbc) {
 *
 ******************************************************************************/
 
-void domino(int start, int end, int listlength, int *max_chain, int *chain) 
+static void domino(int bondlist[][3], int start, int end, int listlength,
+                   int *max_chain, int *chain)
 {
   int i, start_old, end_old;
 
@@ -354,7 +66,7 @@ void domino(int start, int end, int listlength, int *max_chain, int *chain)
       if (*max_chain==listlength)
 	break;
       
-      domino(start, end, listlength, max_chain, chain);
+      domino(bondlist, start, end, listlength, max_chain, chain);
       
       /* Reset bond data */
       --(*chain);
@@ -364,6 +76,207 @@ void domino(int start, int end, int listlength, int *max_chain, int *chain)
     }
 }
 
+/******************************************************************************
+*
+*  cna_atom -- classify the pairs of atom i with its neighbours
+*
+*  Only atom i is marked; its neighbours classify the same pairs from
+*  their own neighbour tables. Returns the number of pairs found.
+*
+******************************************************************************/
+
+static int cna_atom(cell *p, int i, long *hist)
+{
+  neightab  *ineigh = NEIGH(p,i);
+  real      *di = ineigh->dist;
+  vektor    d, dj, dk, dlk, cna_d[MAX_NEIGH];
+  int       bondlist[MAX_BONDS][3];
+  int       j, k, l, npairs = 0;
+  int       cna_atoms, cna_bonds, cna_chain, tmp_cna_chain;
+  int       start, end, pair_index;
+  real      dj2, dlk2, EPS = 0.001;
+
+  MARK(p,i) = 0;
+
+  /* For each neighbour of atom i */
+  for (j=0; j<ineigh->n; ++j) {
+
+    d.x = di[3*j  ];
+    d.y = di[3*j+1];
+    d.z = di[3*j+2];
+
+    /* consider only first neighbours */
+    if (SPROD(d,d) >= cna_r2cut) continue;
+
+    cna_atoms = 0;
+    cna_bonds = 0;
+    cna_chain = 0; 
+
+    /* Count number of common neighbours and store them */
+    for (k=0; k<ineigh->n; k++) {
+      dj.x = di[3*k  ] - d.x;
+      dj.y = di[3*k+1] - d.y;
+      dj.z = di[3*k+2] - d.z;
+      dj2  = SPROD(dj,dj);
+      if ( dj2 < cna_r2cut && dj2 > EPS) {
+        if ( cna_atoms >= MAX_NEIGH )
+          error("Too many common neighbours");
+        cna_d[cna_atoms].x = di[3*k  ];
+        cna_d[cna_atoms].y = di[3*k+1];
+        cna_d[cna_atoms].z = di[3*k+2];
+        ++cna_atoms;
+      }
+    }
+
+    if (0 == cna_atoms) continue;
+
+    /* Count total number of pairs */
+    ++npairs;
+
+    /* Count number of bonds and store them */
+    for (k=0; k<cna_atoms; k++) {
+      dk = cna_d[k];
+      for (l=k+1; l<cna_atoms; l++) {
+        dlk.x = dk.x - cna_d[l].x; 
+        dlk.y = dk.y - cna_d[l].y; 
+        dlk.z = dk.z - cna_d[l].z; 
+        dlk2  = SPROD(dlk,dlk);
+        if ( dlk2 < cna_r2cut ) {
+          if (cna_bonds>=MAX_BONDS)
+            error("Too many bonds");
+          bondlist[cna_bonds][0] = k;
+          bondlist[cna_bonds][1] = l;
+          bondlist[cna_bonds][2] = 0;
+          cna_bonds++;
+        }
+      }
+    }
+
+    /* Count longest continuous chain of bonds */
+    for (k=0; k<cna_bonds; k++) {
+
+      /* Initialize bond data */
+      start = bondlist[k][0];
+      end   = bondlist[k][1];
+      for (l=0; l<cna_bonds; l++)
+        bondlist[l][2] = 0;
+      bondlist[k][2] = 1;
+
+      tmp_cna_chain = 1;
+      cna_chain = MAX(cna_chain,tmp_cna_chain);
+      if (cna_chain==cna_bonds) 
+        break;
+
+      /* Add further bonds to start bond recursively */
+      domino(bondlist, start, end, cna_bonds, &cna_chain, &tmp_cna_chain);
+
+      if (cna_chain==cna_bonds) 
+        break;		
+    }
+
+    /* convert pair_type into integer form; j is a first neighbour */
+    if (cna_atoms<10 && cna_bonds<10)
+      pair_index = ((10+cna_atoms)*10+cna_bonds)*10+cna_chain;
+    else
+      pair_index = -1;
+
+    /* count pair types according to crystallinity */
+    if ( cna_crist > 0 ) {
+      if      ( pair_index == 1421 ) MARK(p,i) += 10000;
+      else if ( pair_index == 1422 ) MARK(p,i) += 100;
+      else                           ++MARK(p,i);
+    }
+
+    /* Mark atom to be written out */
+    if ( cna_write_n > 0 ) {
+      l = 1;
+      for(k=0; k<cna_write_n; k++) {
+        if ( pair_index == cna_writev[k] )
+          if ( MARK(p,i)%(2*l) < l ) MARK(p,i) += l;
+        l *= 2;
+      }
+    }
+
+    /* Count number of pairs of specific type */
+    if (NULL != hist) hist[pair_index+1]++;
+  }
+  return npairs;
+}
+
+/******************************************************************************
+*
+*  do_cna -- Perform Common-Neighbour Analysis
+*
+*  The neighbour tables built in the force computation are complete for
+*  the atoms of the local cells, so the atoms are classified independently
+*  and distributed over threads. Each pair is seen from both of its atoms
+*  and counted twice in the statistics.
+*
+******************************************************************************/
+
+void do_cna(void)
+{
+  int  k, t, nthreads = 1;
+  long npairs = 0;
+
+#ifdef _OPENMP
+  nthreads = omp_get_max_threads();
+#endif
+  if (cna_write_statistics) {
+    if (NULL==cna_hist) {
+      cna_hist = (long *) calloc( nthreads * CNA_NIDX, sizeof(long) );
+      if (NULL==cna_hist) error("cannot allocate CNA histogram");
+    }
+    else
+      for (k=0; k<nthreads*CNA_NIDX; k++) cna_hist[k] = 0;
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:npairs)
+#endif
+  for (k=0; k<NCELLS; k++) {
+    cell *p = CELLPTR(k);
+    long *hist = cna_hist;
+    int  i;
+#ifdef _OPENMP
+    if (NULL != hist) hist += CNA_NIDX * omp_get_thread_num();
+#endif
+    for (i=0; i<p->n; i++)
+      npairs += cna_atom(p, i, hist);
+  }
+  cna_pairs = npairs / 2;
+
+  if (!cna_write_statistics) return;
+
+  /* add up the histograms of the threads and CPUs */
+  for (t=1; t<nthreads; t++)
+    for (k=0; k<CNA_NIDX; k++) cna_hist[k] += cna_hist[t*CNA_NIDX+k];
+#ifdef MPI
+  if (0==myid) {
+    MPI_Reduce( MPI_IN_PLACE, cna_hist, CNA_NIDX, MPI_LONG, MPI_SUM, 0,
+                cpugrid);
+    MPI_Reduce( MPI_IN_PLACE, &npairs, 1, MPI_LONG, MPI_SUM, 0, cpugrid);
+  }
+  else {
+    MPI_Reduce( cna_hist, NULL, CNA_NIDX, MPI_LONG, MPI_SUM, 0, cpugrid);
+    MPI_Reduce( &npairs,  NULL, 1,        MPI_LONG, MPI_SUM, 0, cpugrid);
+  }
+  cna_pairs = npairs / 2;
+  if (0!=myid) return;
+#endif
+
+  /* list of pair types found */
+  type_list_length = 0;
+  for (k=0; k<CNA_NIDX; k++)
+    if (cna_hist[k] > 0) {
+      if (type_list_length>=MAX_TYPES)
+        error("Too many pair types");
+      type_list [type_list_length] = k - 1;
+      type_count[type_list_length] = cna_hist[k] / 2;
+      type_list_length++;
+    }
+}
+
 /******************************************************************************
 *
 *  init_cna
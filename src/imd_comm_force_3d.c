@@ -757,7 +757,7 @@ void copy_cell( int k, int l, int m, int r, int s, int t, vektor v )
 #ifdef VARCHG
     CHARGE(to,i)  = CHARGE(from,i);
 #endif
-#ifdef DIPOLE
+#if defined(DIPOLE) || defined(SHAKE)
     NUMMER(to,i)     = NUMMER(from,i);
 /*     DP_E_IND(to,i,X) = DP_E_IND(from,i,X); */
 /*     DP_E_IND(to,i,Y) = DP_E_IND(from,i,Y); */
@@ -802,7 +802,7 @@ void pack_cell( msgbuf *b, int k, int l, int m, vektor v )
 #ifdef VARCHG
     b->data[ j++ ] = CHARGE(from,i);
 #endif
-#ifdef DIPOLE
+#if defined(DIPOLE) || defined(SHAKE)
     b->data[ j++ ] = NUMMER(from,i);
 /*     b->data[ j++ ] = DP_E_IND(from,i,X); */
 /*     b->data[ j++ ] = DP_E_IND(from,i,Y); */
@@ -865,7 +865,7 @@ void unpack_cell( msgbuf *b, int k, int l, int m )
 #ifdef VARCHG
     CHARGE(to,i)  = b->data[ j++ ];
 #endif
-#ifdef DIPOLE
+#if defined(DIPOLE) || defined(SHAKE)
     NUMMER(to,i)     = b->data[ j++ ];
 /*     DP_E_IND(to,i,X) = b->data[ j++ ]; */
 /*     DP_E_IND(to,i,Y) = b->data[ j++ ]; */
@@ -1838,3 +1838,74 @@ void unpack_add_sm_chi( msgbuf *b, int k, int l, int m )
 }
 
 #endif /* SM */
+
+#ifdef SHAKE
+
+/******************************************************************************
+*
+*  add SHAKE corrections of one cell to another cell
+*
+******************************************************************************/
+
+void add_shake( int k, int l, int m, int r, int s, int t )
+{
+  int i;
+  minicell *from, *to;
+
+  from = PTR_3D_V(cell_array, k, l, m, cell_dim);
+  to   = PTR_3D_V(cell_array, r, s, t, cell_dim);
+
+  for (i=0; i<to->n; ++i) {
+    SHAKE_D(to,i,X) += SHAKE_D(from,i,X);
+    SHAKE_D(to,i,Y) += SHAKE_D(from,i,Y);
+    SHAKE_D(to,i,Z) += SHAKE_D(from,i,Z);
+  }
+}
+
+/******************************************************************************
+*
+*  pack SHAKE corrections into MPI buffer
+*
+******************************************************************************/
+
+void pack_shake( msgbuf *b, int k, int l, int m )
+{
+  int i, j = b->n;
+  minicell *from;
+
+  from = PTR_3D_V(cell_array, k, l, m, cell_dim);
+
+  for (i=0; i<from->n; ++i) {
+    b->data[j++] = SHAKE_D(from,i,X);
+    b->data[j++] = SHAKE_D(from,i,Y);
+    b->data[j++] = SHAKE_D(from,i,Z);
+  }
+  b->n = j;
+  if (b->n_max < b->n)
+    error("Buffer overflow in pack_shake - increase msgbuf_size");
+}
+
+/******************************************************************************
+*
+*  unpack and add SHAKE corrections from MPI buffer into cell
+*
+******************************************************************************/
+
+void unpack_add_shake( msgbuf *b, int k, int l, int m )
+{
+  int i, j = b->n;
+  minicell *to;
+
+  to = PTR_3D_V(cell_array, k, l, m, cell_dim);
+
+  for (i=0; i<to->n; ++i) {
+    SHAKE_D(to,i,X) += b->data[j++];
+    SHAKE_D(to,i,Y) += b->data[j++];
+    SHAKE_D(to,i,Z) += b->data[j++];
+  }
+  b->n = j;
+  if (b->n_max < b->n)
+    error("Buffer overflow in unpack_add_shake - increase msgbuf_size");
+}
+
+#endif /* SHAKE */
@@ -21,20 +21,97 @@
 
 #include "imd.h"
 
-float *dat_1 = NULL, *dat_2 = NULL;
-float *num_1 = NULL, *num_2 = NULL;
+/* quantities for which distributions can be written */
+#define DQ_DENS         0
+#define DQ_EKIN         1
+#define DQ_EPOT         2
+#define DQ_PRESS        3
+#define DQ_PRESSTENS    4
+#define DQ_PT_XX        5
+#define DQ_PT_YY        6
+#define DQ_PT_ZZ        7
+#define DQ_PT_YZ        8
+#define DQ_PT_ZX        9
+#define DQ_PT_XY       10
+#define DQ_VXAVG       11
+#define DQ_EKIN_LONG   12
+#define DQ_EKIN_TRANS  13
+#define DQ_EKIN_COMP   14
+#define DQ_SHOCK_SHEAR 15
+#define DQ_SHEAR_ANISO 16
+
+#define DIST_MAX_QUANT 24
+
+/* a distribution file: quantity, components, format, and its offset 
+   in dist_dat; dist_dat holds the bin counts first, then the quantities
+   of one binning pass, each with its components interleaved */
+typedef struct {
+  int  id, n, mode, off;
+  char *suffix, *cont;
+} dist_quant;
+
+static dist_quant dist_q[DIST_MAX_QUANT];
+static int   dist_nq, dist_len;
+static int   dist_ngrp;                   /* number of binning passes */
+static int   dist_grp[DIST_MAX_QUANT+1];  /* first quantity of each pass */
+static float *dist_dat = NULL;
+static int   dist_nsamp = 0;   /* number of samples summed up in dist_dat */
 int   dist_size;
 
 /******************************************************************************
 *
-*  write distributions
+*  split the quantities into binning passes
+*
+*  Usually all quantities are binned in a single pass over the atoms.
+*  If their data would exceed dist_chunk_size, a snapshot is binned in
+*  several passes, so that only the bin counts and the quantities of
+*  one pass are held at a time. With BG, to save memory, each quantity
+*  gets a pass of its own. Averages over dist_av_int need all quantities
+*  of every sample, and are therefore always binned in one pass.
 *
 ******************************************************************************/
 
-void write_distrib(int steps)
+static void dist_make_groups(void)
 {
-  char contents[255];
-  int fzhlr, n, i, j, k;
+  int q, l, len = 0, max_len = 0, bound;
+
+#ifdef BG
+  bound = 0;
+#else
+  bound = dist_chunk_size;
+#endif
+
+  dist_ngrp   = 1;
+  dist_grp[0] = 0;
+  for (q=0; q<dist_nq; q++) {
+    /* the density is computed from the bin counts */
+    if (DQ_DENS==dist_q[q].id) {
+      dist_q[q].off = 0;
+      continue;
+    }
+    l = dist_q[q].n * dist_size;
+    if ((len > 0) && (0==dist_av_int) && (len + l > bound)) {
+      dist_grp[dist_ngrp++] = q;
+      len = 0;
+    }
+    dist_q[q].off = dist_size + len;
+    len += l;
+    max_len = MAX(max_len, len);
+  }
+  dist_grp[dist_ngrp] = dist_nq;
+  dist_len = dist_size + max_len;
+}
+
+/******************************************************************************
+*
+*  collect the requested quantities and allocate the distribution array
+*
+******************************************************************************/
+
+static void init_distrib(void)
+{
+  static char contents[255];
+  int  i;
 
   is_big_endian = endian();
 
@@ -51,329 +128,234 @@ void write_distrib(int steps)
 #ifndef TWOD
   dist_size *= dist_dim.z;
 #endif
-#ifdef BG
-  n = 1; /* here we write presstens components in separate files */
-#else
-  n = dist_presstens_flag ? DIM*(DIM+1)/2 : 1; 
-#endif
-#ifndef MPI
-  dist_chunk_size = dist_size;
-#endif
-#if defined(BGL) && (defined(TIMING) || defined(DEBUG))
-  if (myid==0) 
-    printf("%d MB free before distribution allocation\n", get_free_mem());
-#endif
-#if defined(BG) && defined(NBLIST)
-  deallocate_nblist();
-#endif
-#if defined(BGL) && defined(NBLIST) && (defined(TIMING) || defined(DEBUG))
-  if (myid==0) 
-    printf("%d MB free after nblist deallocation\n", get_free_mem());
-#endif
-
-  /* allocate distribution arrays */
-#ifdef MPI2
-  MPI_Alloc_mem( n *       dist_size * sizeof(float), MPI_INFO_NULL, &dat_1 );
-  MPI_Alloc_mem(           dist_size * sizeof(float), MPI_INFO_NULL, &num_1 );
-  MPI_Alloc_mem( n * dist_chunk_size * sizeof(float), MPI_INFO_NULL, &dat_2 );
-  num_2 = dat_1;
-#elif defined(MPI)
-  dat_1 = (float *) malloc( n *       dist_size * sizeof(float) );
-  num_1 = (float *) malloc(           dist_size * sizeof(float) );
-  dat_2 = (float *) malloc( n * dist_chunk_size * sizeof(float) );
-  num_2 = dat_1;
-#else
-  dat_1 = (float *) malloc( n * dist_size * sizeof(float) );
-  num_1 = (float *) malloc(     dist_size * sizeof(float) );
-  dat_2 = dat_1;
-  num_2 = num_1;
-#endif
-  if ((NULL==dat_1) || (NULL==num_1) || (NULL==dat_2) || (NULL==num_2))
-    error("Cannot allocate distribution data.");
-
-#if defined(BGL) && (defined(TIMING) || defined(DEBUG))
-  if (myid==0) 
-    printf("%d MB free after distribution allocation\n", get_free_mem());
-#endif
-
-  fzhlr = steps / dist_int;
-
-  /* make number density distribution */
-  make_distrib_density();
-
-  if (dist_Ekin_flag) {
-    make_write_distrib_select( 1, dist_Ekin_fun, 
-      dist_Ekin_flag, fzhlr, "Ekin", "Ekin");
-  }
-  if (dist_Epot_flag) {
-    make_write_distrib_select( 1, dist_Epot_fun, 
-      dist_Epot_flag, fzhlr, "Epot", "Epot");
-  }
 
+  /* collect requested quantities */
+  dist_nq  = 0;
+  if (dist_Ekin_flag)
+    dist_add_quant(DQ_EKIN, 1, dist_Ekin_flag, "Ekin", "Ekin");
+  if (dist_Epot_flag)
+    dist_add_quant(DQ_EPOT, 1, dist_Epot_flag, "Epot", "Epot");
 #ifdef STRESS_TENS
-  if (dist_press_flag) {
-    make_write_distrib_select( 1, dist_press_fun, 
-      dist_press_flag, fzhlr, "press", "press");
-  }
+  if (dist_press_flag)
+    dist_add_quant(DQ_PRESS, 1, dist_press_flag, "press", "press");
   if (dist_presstens_flag) {
+#ifdef BG
+    /* to save memory, we write each componend in separate file */
+    dist_add_quant(DQ_PT_XX, 1, dist_presstens_flag, 
+                   "presstens_xx", "presstens_xx");
+    dist_add_quant(DQ_PT_YY, 1, dist_presstens_flag, 
+                   "presstens_yy", "presstens_yy");
+#ifndef TWOD
+    dist_add_quant(DQ_PT_ZZ, 1, dist_presstens_flag, 
+                   "presstens_zz", "presstens_zz");
+    dist_add_quant(DQ_PT_YZ, 1, dist_presstens_flag, 
+                   "presstens_yz", "presstens_yz");
+    dist_add_quant(DQ_PT_ZX, 1, dist_presstens_flag, 
+                   "presstens_zx", "presstens_zx");
+#endif
+    dist_add_quant(DQ_PT_XY, 1, dist_presstens_flag, 
+                   "presstens_xy", "presstens_xy");
+#else
 #ifdef TWOD
     sprintf(contents, "P_xx P_yy P_xy");
 #else
     sprintf(contents, "P_xx P_yy P_zz P_yz P_zx P_xy");
 #endif
-#ifdef BG
-    /* to save memory, we write each componend in separate file */
-    make_write_distrib_select( 1, dist_presstens_xx_fun, 
-      dist_presstens_flag, fzhlr, "presstens_xx", "presstens_xx" );
-    make_write_distrib_select( 1, dist_presstens_yy_fun,
-      dist_presstens_flag, fzhlr, "presstens_yy", "presstens_yy" );
-#ifndef TWOD
-    make_write_distrib_select( 1, dist_presstens_zz_fun,
-      dist_presstens_flag, fzhlr, "presstens_zz", "presstens_zz" );
-    make_write_distrib_select( 1, dist_presstens_yz_fun,
-      dist_presstens_flag, fzhlr, "presstens_yz", "presstens_yz" );
-    make_write_distrib_select( 1, dist_presstens_zx_fun,
-      dist_presstens_flag, fzhlr, "presstens_zx", "presstens_zx" );
-#endif
-    make_write_distrib_select( 1, dist_presstens_xy_fun,
-      dist_presstens_flag, fzhlr, "presstens_xy", "presstens_xy" );
-#else
-    make_write_distrib_select( DIM*(DIM+1)/2, dist_presstens_fun,
-      dist_presstens_flag, fzhlr, "presstens", contents);
+    dist_add_quant(DQ_PRESSTENS, DIM*(DIM+1)/2, dist_presstens_flag, 
+                   "presstens", contents);
 #endif /* BG */
   }
 #endif /* STRESS_TENS */
-
 #ifdef SHOCK
-  if (dist_vxavg_flag) {
-    make_write_distrib_select( 1, dist_vxavg_fun,
-      dist_vxavg_flag, fzhlr, "vxavg", "vxavg");
-  }
-  if (dist_Ekin_long_flag) {
-    make_write_distrib_select( 1, dist_Ekin_long_fun,
-      dist_Ekin_long_flag, fzhlr, "Ekin_long", "Ekin_long");
-  }
-  if (dist_Ekin_trans_flag) {
-    make_write_distrib_select( 1, dist_Ekin_trans_fun,
-      dist_Ekin_trans_flag, fzhlr, "Ekin_trans", "Ekin_trans");
-  }
-  if (dist_Ekin_comp_flag) {
-    make_write_distrib_select( 1, dist_Ekin_comp_fun,
-      dist_Ekin_comp_flag, fzhlr, "Ekin_comp", "Ekin_comp");
-  }
-  if (dist_shock_shear_flag) {
-    make_write_distrib_select( 1, dist_shock_shear_fun,
-      dist_shock_shear_flag, fzhlr, "shock_shear", "shock_shear");
-  }
-  if (dist_shear_aniso_flag) {
-    make_write_distrib_select( 1, dist_shear_aniso_fun,
-      dist_shear_aniso_flag, fzhlr, "shear_aniso", "shear_aniso");
-  }
+  if (dist_vxavg_flag)
+    dist_add_quant(DQ_VXAVG, 1, dist_vxavg_flag, "vxavg", "vxavg");
+  if (dist_Ekin_long_flag)
+    dist_add_quant(DQ_EKIN_LONG, 1, dist_Ekin_long_flag, 
+                   "Ekin_long", "Ekin_long");
+  if (dist_Ekin_trans_flag)
+    dist_add_quant(DQ_EKIN_TRANS, 1, dist_Ekin_trans_flag, 
+                   "Ekin_trans", "Ekin_trans");
+  if (dist_Ekin_comp_flag)
+    dist_add_quant(DQ_EKIN_COMP, 1, dist_Ekin_comp_flag, 
+                   "Ekin_comp", "Ekin_comp");
+#ifdef STRESS_TENS
+  if (dist_shock_shear_flag)
+    dist_add_quant(DQ_SHOCK_SHEAR, 1, dist_shock_shear_flag, 
+                   "shock_shear", "shock_shear");
+  if (dist_shear_aniso_flag)
+    dist_add_quant(DQ_SHEAR_ANISO, 1, dist_shear_aniso_flag, 
+                   "shear_aniso", "shear_aniso");
   if (dist_pressoff_flag) {
-    make_write_distrib_select( 1, dist_pressxy_fun,
-      dist_pressoff_flag, fzhlr, "pressxy", "pressxy");
-    make_write_distrib_select( 1, dist_pressyz_fun,
-      dist_pressoff_flag, fzhlr, "pressyz", "pressyz");
-    make_write_distrib_select( 1, dist_presszx_fun,
-      dist_pressoff_flag, fzhlr, "presszx", "presszx");
+    dist_add_quant(DQ_PT_XY, 1, dist_pressoff_flag, "pressxy", "pressxy");
+    dist_add_quant(DQ_PT_YZ, 1, dist_pressoff_flag, "pressyz", "pressyz");
+    dist_add_quant(DQ_PT_ZX, 1, dist_pressoff_flag, "presszx", "presszx");
   }
+#endif
 #endif /* SHOCK */
+  /* density is written from the bin counts, and must come last */
+  if (dist_dens_flag)
+    dist_add_quant(DQ_DENS, 1, dist_dens_flag, "dens", "dens");
+  dist_make_groups();
 
-  /* write density distribution */
-  if ((myid==0) && (dist_dens_flag)) {
-    write_distrib_density(dist_dens_flag, fzhlr);
-  }
+#if defined(BGL) && (defined(TIMING) || defined(DEBUG))
+  if (myid==0) 
+    printf("%d MB free before distribution allocation\n", get_free_mem());
+#endif
+#if defined(BG) && defined(NBLIST)
+  /* the neighbor list would be rebuilt within an averaging window */
+  if (0==dist_av_int) deallocate_nblist();
+#endif
+#if defined(BGL) && defined(NBLIST) && (defined(TIMING) || defined(DEBUG))
+  if (myid==0) 
+    printf("%d MB free after nblist deallocation\n", get_free_mem());
+#endif
 
-  /* free distribution arrays */
+  /* allocate distribution array */
 #ifdef MPI2
-  MPI_Free_mem(dat_1);
-  MPI_Free_mem(num_1);
-  MPI_Free_mem(dat_2);
-#elif defined(MPI)
-  free(dat_1);
-  free(num_1);
-  free(dat_2);
+  MPI_Alloc_mem( dist_len * sizeof(float), MPI_INFO_NULL, &dist_dat );
 #else
-  free(dat_1);
-  free(num_1);
+  dist_dat = (float *) malloc( dist_len * sizeof(float) );
 #endif
+  if (NULL==dist_dat) error("Cannot allocate distribution data.");
 
 #if defined(BGL) && (defined(TIMING) || defined(DEBUG))
   if (myid==0) 
-    printf("%d MB free after distribution deallocation\n", get_free_mem());
+    printf("%d MB free after distribution allocation\n", get_free_mem());
 #endif
 
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (i=0; i<dist_len; i++) dist_dat[i] = 0.0;
+  dist_nsamp = 0;
 }
 
 /******************************************************************************
 *
-*  selection function for kinetic energy
+*  add a sample to the distributions; with dist_av_int > 0, called every
+*  dist_av_int steps, so that the maps written are averages over the
+*  samples since the last write
 *
 ******************************************************************************/
 
-void dist_Ekin_fun(float *dat, cell *p, int i)
+void update_distrib(void)
 {
-  *dat += SPRODN(IMPULS,p,i,IMPULS,p,i) / (2 * MASSE(p,i));
+  if (NULL==dist_dat) init_distrib();
+  make_distrib(0);
+  dist_nsamp++;
 }
 
 /******************************************************************************
 *
-*  selection function for potential energy
+*  write distributions
 *
 ******************************************************************************/
 
-void dist_Epot_fun(float *dat, cell *p, int i)
+void write_distrib(int steps)
 {
-#ifdef DISLOC
-  if (Epot_diff==1)
-    *dat += POTENG(p,i) - EPOT_REF(p,i);
-  else
-#endif
-    *dat += POTENG(p,i);
-}
-
-#ifdef STRESS_TENS
+  int  fzhlr, g, q, i;
 
-/******************************************************************************
-*
-*  selection function for scalar pressure
-*
-******************************************************************************/
+  /* without averaging, the distributions are a snapshot */
+  if (0==dist_av_int) update_distrib();
+  if (NULL==dist_dat) return;
 
-void dist_press_fun(float *dat, cell *p, int i)
-{
-#ifdef TWOD
-  *dat += (PRESSTENS(p,i,xx) + PRESSTENS(p,i,yy)) / 2.0;
-#else
-  *dat += (PRESSTENS(p,i,xx) + PRESSTENS(p,i,yy) + PRESSTENS(p,i,zz)) / 3.0;
-#endif
-}
+  fzhlr = steps / dist_int;
 
-/******************************************************************************
-*
-*  selection functions for pressure tensor
-*
-******************************************************************************/
+  for (g=0; g<dist_ngrp; g++) {
 
-void dist_presstens_fun(float *dat, cell *p, int i)
-{
-  int k=0;
-  dat[k++] += PRESSTENS(p,i,xx);
-  dat[k++] += PRESSTENS(p,i,yy);
-#ifndef TWOD
-  dat[k++] += PRESSTENS(p,i,zz);
-  dat[k++] += PRESSTENS(p,i,yz);
-  dat[k++] += PRESSTENS(p,i,zx);
+    /* the bin counts are kept from the first pass */
+    if (g > 0) {
+#ifdef _OPENMP
+#pragma omp parallel for
 #endif
-  dat[k++] += PRESSTENS(p,i,xy);
-}
-
-void dist_presstens_xx_fun(float *dat, cell *p, int i)
-{
-  *dat += PRESSTENS(p,i,xx);
-}
+      for (i=dist_size; i<dist_len; i++) dist_dat[i] = 0.0;
+      make_distrib(g);
+    }
 
-void dist_presstens_yy_fun(float *dat, cell *p, int i)
-{
-  *dat += PRESSTENS(p,i,yy);
-}
+    /* add up the contributions of all CPUs */
+    reduce_distrib(g);
 
-#ifndef TWOD
+    /* each file is written by the CPU that collected it */
+    for (q=dist_grp[g]; q<dist_grp[g+1]; q++)
+      if ((DQ_DENS != dist_q[q].id) && (myid == q % num_cpus))
+        write_distrib_file(q, fzhlr);
+  }
 
-void dist_presstens_zz_fun(float *dat, cell *p, int i)
-{
-  *dat += PRESSTENS(p,i,zz);
-}
+  /* the density overwrites the bin counts */
+  for (q=0; q<dist_nq; q++)
+    if ((DQ_DENS == dist_q[q].id) && (myid == q % num_cpus))
+      write_distrib_file(q, fzhlr);
 
-void dist_presstens_yz_fun(float *dat, cell *p, int i)
-{
-  *dat += PRESSTENS(p,i,yz);
-}
-
-void dist_presstens_zx_fun(float *dat, cell *p, int i)
-{
-  *dat += PRESSTENS(p,i,zx);
-}
+  /* free distribution array */
+#ifdef MPI2
+  MPI_Free_mem(dist_dat);
+#else
+  free(dist_dat);
+#endif
+  dist_dat   = NULL;
+  dist_nsamp = 0;
 
+#if defined(BGL) && (defined(TIMING) || defined(DEBUG))
+  if (myid==0) 
+    printf("%d MB free after distribution deallocation\n", get_free_mem());
 #endif
 
-void dist_presstens_xy_fun(float *dat, cell *p, int i)
-{
-  *dat += PRESSTENS(p,i,xy);
 }
 
-#endif /* STRESS_TENS */
-
-#ifdef SHOCK
-
 /******************************************************************************
 *
-*  selection function for various shock quantities
+*  register a distribution file
 *
 ******************************************************************************/
 
-#ifdef STRESS_TENS
-/* shear stress */
-void dist_shock_shear_fun(float *dat, cell *p, int i)
-{
-  *dat += (PRESSTENS(p,i,xx)-(PRESSTENS(p,i,yy)+PRESSTENS(p,i,zz))/2.0)/2.0;
-}
-void dist_shear_aniso_fun(float *dat, cell *p, int i)
-{
-  *dat += PRESSTENS(p,i,yy)-PRESSTENS(p,i,zz);
-}
-void dist_pressxy_fun(float *dat, cell *p, int i)
-{
-  *dat += PRESSTENS(p,i,xy);
-}
-void dist_pressyz_fun(float *dat, cell *p, int i)
-{
-  *dat += PRESSTENS(p,i,yz);
-}
-void dist_presszx_fun(float *dat, cell *p, int i)
-{
-  *dat += PRESSTENS(p,i,zx);
-}
-#endif
-
-/* transversal kinetic energy */
-void dist_Ekin_trans_fun(float *dat, cell *p, int i)
+void dist_add_quant(int id, int n, int mode, char *suffix, char *cont)
 {
-  *dat += (SQR(IMPULS(p,i,Y)) + SQR(IMPULS(p,i,Z))) / (4 * MASSE(p,i));
+  dist_quant *q;
+
+  if (dist_nq == DIST_MAX_QUANT) error("Too many distributions requested.");
+  q = dist_q + dist_nq++;
+  q->id     = id;
+  q->n      = n;
+  q->mode   = mode;
+  q->suffix = suffix;
+  q->cont   = cont;
+  q->off    = 0;
 }
 
-/* difference kinetic energy */
-void dist_Ekin_comp_fun(float *dat, cell *p, int i)
-{
-  *dat += (SQR(IMPULS(p,i,Y)) - SQR(IMPULS(p,i,Z))) / (2 * MASSE(p,i));
-}
-
-/* longitudinal kinetic energy */
-void dist_Ekin_long_fun(float *dat, cell *p, int i)
-{
-  *dat += SQR(IMPULS(p,i,X) - PXAVG(p,i)) / (2*MASSE(p,i));
-}
+/******************************************************************************
+*
+*  add a contribution to a bin; shared bins are updated atomically
+*
+******************************************************************************/
 
-/* average sample velocity */
-void dist_vxavg_fun(float *dat, cell *p, int i)
+static void dist_add(float *dat, real val, int shared)
 {
-  *dat += IMPULS(p,i,X) / MASSE(p,i);
+#ifdef _OPENMP
+  if (shared) {
+#pragma omp atomic
+    *dat += val;
+    return;
+  }
+#endif
+  *dat += val;
 }
 
-#endif /* SHOCK */
-
 /******************************************************************************
 *
-*  make density distribution
+*  bin the quantities of pass g over the atoms, and add them to dist_dat;
+*  the bin counts are taken in the first pass only
+*
+*  With OpenMP, each thread bins into its own copy of the distribution
+*  if the copies together do not exceed dist_chunk_size; larger maps 
+*  are binned into the shared array with atomic updates.
 *
 ******************************************************************************/
 
-void make_distrib_density(void)
+void make_distrib(int g)
 {
-  cell *p;
-  real scalex, scaley, scalez;
-  int  num, numx, numy, numz;
-  int  i, j, k, m, chunk_size;
+  real  scalex, scaley, scalez;
+  float *priv = NULL;
+  int   nthreads = 1, shared = 0, i, t;
 
   /* the bins are orthogonal boxes in space */
   scalex = dist_dim.x / (dist_ur.x - dist_ll.x);
@@ -382,12 +364,35 @@ void make_distrib_density(void)
   scalez = dist_dim.z / (dist_ur.z - dist_ll.z);
 #endif
 
-  /* clear distribution */
-  for (i=0; i<dist_size; i++) num_2[i] = 0.0;
+#ifdef _OPENMP
+  nthreads = omp_get_max_threads();
+  if (nthreads > 1) {
+    if ((long) nthreads * dist_len <= dist_chunk_size)
+      priv = (float *) malloc( (long) nthreads * dist_len * sizeof(float) );
+    if (NULL==priv) shared = 1;
+  }
+#endif
+  if (NULL==priv) { priv = dist_dat; nthreads = 1; }
+
+  /* clear thread copies */
+  if (priv != dist_dat) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (i=0; i<nthreads*dist_len; i++) priv[i] = 0.0;
+  }
 
   /* loop over all atoms */
-  for (k=0; k<NCELLS; ++k) {
-    p = CELLPTR(k);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (t=0; t<NCELLS; ++t) {
+    float *dat = priv;
+    int   num, numx, numy, numz, i, q;
+    cell  *p = CELLPTR(t);
+#ifdef _OPENMP
+    if (nthreads > 1) dat += omp_get_thread_num() * dist_len;
+#endif
     for (i=0; i<p->n; ++i) {
       /* which bin? */
       numx = scalex * (ORT(p,i,X) - dist_ll.x);
@@ -400,216 +405,235 @@ void make_distrib_density(void)
       if ((numz < 0) || (numz >= dist_dim.z)) continue;
       num = num * dist_dim.z + numz;
 #endif
-      num_2[num] += 1.0;
+      if (0==g) dist_add(dat + num, 1.0, shared);
+      for (q=dist_grp[g]; q<dist_grp[g+1]; q++) {
+        float *d = dat + dist_q[q].off + dist_q[q].n * num;
+        switch (dist_q[q].id) {
+          case DQ_EKIN:
+            dist_add(d, SPRODN(IMPULS,p,i,IMPULS,p,i) / (2 * MASSE(p,i)), 
+                     shared);
+            break;
+          case DQ_EPOT:
+#ifdef DISLOC
+            if (Epot_diff==1)
+              dist_add(d, POTENG(p,i) - EPOT_REF(p,i), shared);
+            else
+#endif
+              dist_add(d, POTENG(p,i), shared);
+            break;
+#ifdef STRESS_TENS
+          case DQ_PRESS:
+#ifdef TWOD
+            dist_add(d, (PRESSTENS(p,i,xx) + PRESSTENS(p,i,yy)) / 2.0, 
+                     shared);
+#else
+            dist_add(d, (PRESSTENS(p,i,xx) + PRESSTENS(p,i,yy) 
+                         + PRESSTENS(p,i,zz)) / 3.0, shared);
+#endif
+            break;
+          case DQ_PRESSTENS:
+            dist_add(d++, PRESSTENS(p,i,xx), shared);
+            dist_add(d++, PRESSTENS(p,i,yy), shared);
+#ifndef TWOD
+            dist_add(d++, PRESSTENS(p,i,zz), shared);
+            dist_add(d++, PRESSTENS(p,i,yz), shared);
+            dist_add(d++, PRESSTENS(p,i,zx), shared);
+#endif
+            dist_add(d++, PRESSTENS(p,i,xy), shared);
+            break;
+          case DQ_PT_XX: dist_add(d, PRESSTENS(p,i,xx), shared); break;
+          case DQ_PT_YY: dist_add(d, PRESSTENS(p,i,yy), shared); break;
+#ifndef TWOD
+          case DQ_PT_ZZ: dist_add(d, PRESSTENS(p,i,zz), shared); break;
+          case DQ_PT_YZ: dist_add(d, PRESSTENS(p,i,yz), shared); break;
+          case DQ_PT_ZX: dist_add(d, PRESSTENS(p,i,zx), shared); break;
+#endif
+          case DQ_PT_XY: dist_add(d, PRESSTENS(p,i,xy), shared); break;
+#endif /* STRESS_TENS */
+#ifdef SHOCK
+          case DQ_VXAVG:
+            /* average sample velocity */
+            dist_add(d, IMPULS(p,i,X) / MASSE(p,i), shared);
+            break;
+          case DQ_EKIN_LONG:
+            /* longitudinal kinetic energy */
+            dist_add(d, SQR(IMPULS(p,i,X) - PXAVG(p,i)) / (2*MASSE(p,i)), 
+                     shared);
+            break;
+          case DQ_EKIN_TRANS:
+            /* transversal kinetic energy */
+            dist_add(d, (SQR(IMPULS(p,i,Y)) + SQR(IMPULS(p,i,Z))) 
+                        / (4 * MASSE(p,i)), shared);
+            break;
+          case DQ_EKIN_COMP:
+            /* difference kinetic energy */
+            dist_add(d, (SQR(IMPULS(p,i,Y)) - SQR(IMPULS(p,i,Z))) 
+                        / (2 * MASSE(p,i)), shared);
+            break;
+#ifdef STRESS_TENS
+          case DQ_SHOCK_SHEAR:
+            /* shear stress */
+            dist_add(d, (PRESSTENS(p,i,xx) - (PRESSTENS(p,i,yy) 
+                         + PRESSTENS(p,i,zz)) / 2.0) / 2.0, shared);
+            break;
+          case DQ_SHEAR_ANISO:
+            dist_add(d, PRESSTENS(p,i,yy) - PRESSTENS(p,i,zz), shared);
+            break;
+#endif
+#endif /* SHOCK */
+        }
+      }
     }
   }
 
-  /* add up results form different CPUs */
+  /* add up the thread copies */
+  if (priv != dist_dat) {
+#ifdef _OPENMP
+#pragma omp parallel for private(t)
+#endif
+    for (i=0; i<dist_len; i++) {
+      float sum = 0.0;
+      for (t=0; t<nthreads; t++) sum += priv[t * dist_len + i];
+      dist_dat[i] += sum;
+    }
+    free(priv);
+  }
+}
+
+/******************************************************************************
+*
+*  add up the distributions of pass g from different CPUs; the bin
+*  counts (of the first pass) go to all CPUs, each quantity to the CPU
+*  that writes it
+*
+******************************************************************************/
+
+void reduce_distrib(int g)
+{
 #ifdef MPI
-#ifdef BG
-  /* doing it in several chunks saves memory */
-  for (m = 0; m < dist_size; m += dist_chunk_size) { 
-    chunk_size = MIN( dist_size - m, dist_chunk_size );
-    MPI_Reduce(num_2+m, num_1+m, chunk_size, MPI_FLOAT, MPI_SUM, 0, cpugrid);
+  int m, q, len, root, chunk_size;
+
+  /* doing it in several chunks saves buffer memory */
+  if (0==g)
+    for (m = 0; m < dist_size; m += dist_chunk_size) {
+      chunk_size = MIN( dist_size - m, dist_chunk_size );
+      MPI_Allreduce( MPI_IN_PLACE, dist_dat + m, chunk_size, 
+                     MPI_FLOAT, MPI_SUM, cpugrid);
+    }
+  for (q=dist_grp[g]; q<dist_grp[g+1]; q++) {
+    if (DQ_DENS==dist_q[q].id) continue;
+    root = q % num_cpus;
+    len  = dist_q[q].n * dist_size;
+    for (m = 0; m < len; m += dist_chunk_size) {
+      chunk_size = MIN( len - m, dist_chunk_size );
+      if (myid == root)
+        MPI_Reduce( MPI_IN_PLACE, dist_dat + dist_q[q].off + m, chunk_size,
+                    MPI_FLOAT, MPI_SUM, root, cpugrid);
+      else
+        MPI_Reduce( dist_dat + dist_q[q].off + m, NULL, chunk_size,
+                    MPI_FLOAT, MPI_SUM, root, cpugrid);
+    }
   }
-#else
-  MPI_Reduce( num_2, num_1, dist_size, MPI_FLOAT, MPI_SUM, 0, cpugrid);
-#endif
 #endif
-
 }
 
 /******************************************************************************
 *
-*  write density distribution
+*  normalize and write a distribution file
+*
+*  The density is computed in place from the bin counts, so it must be
+*  the last file written.
 *
 ******************************************************************************/
 
-void write_distrib_density(int mode, int fzhlr)
+void write_distrib_file(int m, int fzhlr)
 {
+  dist_quant *q = dist_q + m;
   FILE  *outfile;
-  char  fname[255];
-  float fac, max=0.0, min=1e10;
-  int   i, j, count, r, s, t;
+  char  fname[255], *fmt;
+  float max[6], min[6], *dat = dist_dat + q->off, *num = dist_dat, fac;
+  int   n = q->n, i, k, count, r, s, t;
   real  vol;
 
   /* open distribution file, write header */
-  sprintf(fname, "%s.%u.%s", outfilename, fzhlr, "dens");
+  sprintf(fname, "%s.%u.%s", outfilename, fzhlr, q->suffix);
   outfile = fopen(fname, "w");
   if (NULL == outfile) error("Cannot open distribution file.");
-  write_distrib_header(outfile, mode, 1, "dens");
+  write_distrib_header(outfile, q->mode, n, q->cont);
 
-  /* compute density, minima and maxima */
-  vol = (dist_ur.x - dist_ll.x) * (dist_ur.y - dist_ll.y);
+  /* normalize distribution, compute minima and maxima */
+  if (DQ_DENS==q->id) {
+    vol = (dist_ur.x - dist_ll.x) * (dist_ur.y - dist_ll.y);
 #ifndef TWOD
-  vol *= (dist_ur.z - dist_ll.z);
+    vol *= (dist_ur.z - dist_ll.z);
 #endif
-  fac = dist_size / vol;
-  for (i=0; i<dist_size; i++) { 
-    dat_1[i] = num_1[i] * fac;
-    max = MAX( max, dat_1[i] );
-    min = MIN( min, dat_1[i] );
+    fac = dist_size / (vol * dist_nsamp);
+    min[0] = 1e10;
+    max[0] = 0.0;
+    for (i=0; i<dist_size; i++) { 
+      dat[i] *= fac;
+      max[0] = MAX( max[0], dat[i] );
+      min[0] = MIN( min[0], dat[i] );
+    }
+  }
+  else {
+    for (k=0; k<n; k++) {
+      min[k] =  1e+10;
+      max[k] = -1e+10;
+    }
+    for (i=0; i<dist_size; i++) {
+      if (num[i] > 0.0) {
+        for (k=0; k<n; k++) {
+          dat[n*i+k] /= num[i];
+          min[k] = MIN( min[k], dat[n*i+k] );
+          max[k] = MAX( max[k], dat[n*i+k] );
+        }
+      }
+    }
   }
 
   /* write distribution */
-  if (mode==DIST_FORMAT_BINARY) {
-    count = fwrite(dat_1, sizeof(float), dist_size, outfile); 
-    if (count != dist_size) warning("distribution write incomplete!");
+  if (q->mode==DIST_FORMAT_BINARY) {
+    count = fwrite(dat, sizeof(float), n*dist_size, outfile); 
+    if (count != n*dist_size) warning("distribution write incomplete!");
   } 
-  else if ((mode==DIST_FORMAT_ASCII) || (mode==DIST_FORMAT_ASCII_COORD)) {
+  else if ((q->mode==DIST_FORMAT_ASCII) || 
+           (q->mode==DIST_FORMAT_ASCII_COORD)) {
+    /* plain density files have no leading blank */
+    fmt = ((DQ_DENS==q->id) && (q->mode==DIST_FORMAT_ASCII)) ? "%e" : " %e";
     i=0;
     for (r=0; r<dist_dim.x; r++)
       for (s=0; s<dist_dim.y; s++)
 #ifndef TWOD
         for (t=0; t<dist_dim.z; t++)
 #endif
-	{
-	  if (mode==DIST_FORMAT_ASCII_COORD) {
+        {
+          if (q->mode==DIST_FORMAT_ASCII_COORD) {
 #ifdef TWOD
-            fprintf(outfile, "%d %d ", r, s);
+            fprintf(outfile, "%d %d", r, s);
 #else
-            fprintf(outfile, "%d %d %d ", r, s, t);
+            fprintf(outfile, "%d %d %d", r, s, t);
 #endif
           }
-          fprintf(outfile,"%e\n", dat_1[i++]);
+          for (k=0; k<n; k++) fprintf(outfile, fmt, dat[i++]);
+          fprintf(outfile, "\n");
         }
   }
   else error("unknown distribution output format");
   fclose(outfile);
 
   /* write minmax */
-  sprintf(fname, "%s.minmax.%s", outfilename, "dens");
+  sprintf(fname, "%s.minmax.%s", outfilename, q->suffix);
   outfile = fopen(fname, "a");
   if (NULL == outfile) error("Cannot open minmax file.");
-  fprintf(outfile, "%d %e %e\n", fzhlr, min, max);
-  fclose(outfile);
-
-}
-
-/******************************************************************************
-*
-*  make and write distribution of selected variables
-*
-******************************************************************************/
-
-void make_write_distrib_select(int n, void (*fun)(float*, cell*, int),
-                               int mode, int fzhlr, char *suffix, char *cont)
-{
-  cell  *p;
-  real  scalex, scaley, scalez;
-  int   num, numx, numy, numz;
-  int   i, j, k, count, r, s, t, m, chunk_size;
-  float max[6], min[6];
-  FILE  *outfile=NULL;
-  char  fname[255];
-
-  /* the bins are orthogonal boxes in space */
-  scalex = dist_dim.x / (dist_ur.x - dist_ll.x);
-  scaley = dist_dim.y / (dist_ur.y - dist_ll.y);
-#ifndef TWOD
-  scalez = dist_dim.z / (dist_ur.z - dist_ll.z);
-#endif
-
-  /* clear distribution */
-  for (i=0; i<n*dist_size; i++) dat_1[i] = 0.0;
-
-  /* loop over all atoms */
-  for (k=0; k<NCELLS; ++k) {
-    p = CELLPTR(k);
-    for (i=0; i<p->n; ++i) {
-      /* which bin? */
-      numx = scalex * (ORT(p,i,X) - dist_ll.x);
-      if ((numx < 0) || (numx >= dist_dim.x)) continue;
-      numy = scaley * (ORT(p,i,Y) - dist_ll.y);
-      if ((numy < 0) || (numy >= dist_dim.y)) continue;
-      num = numx * dist_dim.y + numy;
-#ifndef TWOD
-      numz = scalez * (ORT(p,i,Z) - dist_ll.z);
-      if ((numz < 0) || (numz >= dist_dim.z)) continue;
-      num = num * dist_dim.z + numz;
-#endif
-      (*fun)(dat_1 + n * num, p, i);
-    }
-  }
-
-  /* open distribution file, write header */
-  if (myid==0) {
-    sprintf(fname, "%s.%u.%s", outfilename, fzhlr, suffix);
-    outfile = fopen(fname, "w");
-    if (NULL == outfile) error("Cannot open distribution file.");
-    write_distrib_header(outfile, mode, n, cont);
-    for (k=0; k<n; k++) {
-      min[k] =  1e+10;
-      max[k] = -1e+10;
-    }
-  }
-
-  /* collect and write data in handy chunks */
-  r = s = t = 0;
-  for (m = 0; m < dist_size; m += dist_chunk_size) { 
-
-    chunk_size = MIN( dist_size - m, dist_chunk_size );
-
-    /* add up results form different CPUs */
-#ifdef MPI
-    MPI_Reduce(dat_1+n*m, dat_2, n*chunk_size, MPI_FLOAT, MPI_SUM, 0, cpugrid);
-#endif
-
-    if (myid==0) {
-
-      /* normalize distribution, compute minima and maxima */
-      for (i=0; i<chunk_size; i++) {
-        if (num_1[m+i] > 0.0) {
-          for (k=0; k<n; k++) {
-            dat_2[n*i+k] /= num_1[m+i];
-            min[k] = MIN( min[k], dat_2[n*i+k] );
-            max[k] = MAX( max[k], dat_2[n*i+k] );
-          }
-        }
-      }
-
-      /* write distribution */
-      if (mode==DIST_FORMAT_BINARY) {
-        count = fwrite(dat_2, sizeof(float), n*chunk_size, outfile); 
-        if (count != n*chunk_size) warning("distribution write incomplete!");
-      } 
-      else if ((mode==DIST_FORMAT_ASCII) || (mode==DIST_FORMAT_ASCII_COORD)) {
-	for (i=0; i<chunk_size; i++) {
-          if (mode==DIST_FORMAT_ASCII_COORD) {
-#ifdef TWOD
-            fprintf(outfile, "%d %d", r, s++);
-            if (s==dist_dim.y) { s=0; r++; }
-#else
-            fprintf(outfile, "%d %d %d", r, s, t++);
-            if (t==dist_dim.z) { t=0; s++; }
-            if (s==dist_dim.y) { s=0; r++; }
-#endif
-          }
-#ifdef BG
-          fprintf(outfile," %e\n", dat_2[i]);
-#else
-          for (k=0; k<n; k++) fprintf(outfile," %e", dat_2[n*i+k]);
-          fprintf(outfile, "\n");
-#endif
-        }
-      }
-      else error("unknown distribution output format");
-    }
-  }
-
-  /* close distribution file */
-  if (myid==0) fclose(outfile);
-
-  /* write minmax */
-  if (myid==0) {
-    sprintf(fname, "%s.minmax.%s", outfilename, suffix);
-    outfile = fopen(fname, "a");
-    if (NULL == outfile) error("Cannot open minmax file.");
+  if (DQ_DENS==q->id) 
+    fprintf( outfile, "%d %e %e\n", fzhlr, min[0], max[0] );
+  else {
     fprintf( outfile, "%d ", fzhlr );
-    for (i=0; i<n; i++) fprintf(outfile, " %e %e", min[i], max[i]);
+    for (k=0; k<n; k++) fprintf(outfile, " %e %e", min[k], max[k]);
     fprintf(outfile, "\n");
-    fclose(outfile);
   }
+  fclose(outfile);
 
 }
 
@@ -869,29 +893,35 @@ void write_atdist()
 
 #ifdef DIFFPAT
 
+static int diffpat_snap = 0;      /* snapshots collected in current batch */
+#ifdef MPI
+static int *diffpat_owner = NULL; /* CPU holding an x-slab of diffdist */
+static int *diffpat_nx_all, *diffpat_x0_all;
+#endif
+
 /******************************************************************************
 *
 *  initialize atoms distribution array
 *
+*  diffdist holds diffpat_batch snapshots of the density, interleaved,
+*  so that they can be transformed together. Under MPI, diffdist and 
+*  diffpat are distributed in slabs of diffpat_nx planes along x, 
+*  starting at plane diffpat_x0, and a parallel FFT is used.
+*
 ******************************************************************************/
   
 void init_diffpat()
 {
-  int size, i;
-
-#ifdef OMP
-  fftwf_init_threads();
-  fftwf_plan_with_nthreads(omp_get_max_threads());
-#endif
-
-#ifdef TIMING
-  imd_init_timer( &time_fft,      0, NULL, NULL );
-  imd_init_timer( &time_fft_plan, 0, NULL, NULL );
+  int size, i, flags;
+  int dimz2 =     (diffpat_dim.z / 2 + 1);
+#ifdef MPI
+  ptrdiff_t n[3], nc[3], alloc, local_nx, local_x0;
+  int r, x;
+#else
+  int dimz  = 2 * (diffpat_dim.z / 2 + 1);
+  int n[3], inembed[3], onembed[3];
 #endif
 
-  /* compute array size */
-  diffpat_size  = diffpat_dim.x * diffpat_dim.y * 2 * (diffpat_dim.z / 2 + 1);
-
   /* diffpat_ll and diffpat_ur must be set */
   if (0.0==diffpat_ur.x) {
     error("diffpat_ll and diffpat_ur must be set");
@@ -907,47 +937,144 @@ void init_diffpat()
   diffpat_scale.y = diffpat_dim.y / (diffpat_ur.y - diffpat_ll.y);
   diffpat_scale.z = diffpat_dim.z / (diffpat_ur.z - diffpat_ll.z);
 
-  /* allocate arrays */
+  /* allocate arrays and make fftw plan, once */
   if (NULL==diffdist) {
+
+#ifdef OMP
+    fftwf_init_threads();
+#endif
+#ifdef MPI
+    fftwf_mpi_init();
+#endif
+#ifdef OMP
+    fftwf_plan_with_nthreads(omp_get_max_threads());
+#endif
+
+#ifdef TIMING
+    imd_init_timer( &time_fft,      0, NULL, NULL );
+    imd_init_timer( &time_fft_plan, 0, NULL, NULL );
+#endif
+
+#ifdef MPI
+    /* get our slab of the distributed arrays */
+    n [0] = nc[0] = diffpat_dim.x;
+    n [1] = nc[1] = diffpat_dim.y;
+    n [2] = diffpat_dim.z;
+    nc[2] = dimz2;
+    alloc = fftwf_mpi_local_size_many(3, nc, diffpat_batch, 
+      FFTW_MPI_DEFAULT_BLOCK, cpugrid, &local_nx, &local_x0);
+    diffpat_nx   = local_nx;
+    diffpat_x0   = local_x0;
+    diffpat_size = 2 * alloc;
+
+    /* which CPU holds which slab */
+    diffpat_nx_all = (int *) malloc( num_cpus * sizeof(int) );
+    diffpat_x0_all = (int *) malloc( num_cpus * sizeof(int) );
+    diffpat_owner  = (int *) malloc( diffpat_dim.x * sizeof(int) );
+    if ((NULL==diffpat_nx_all) || (NULL==diffpat_x0_all) || 
+        (NULL==diffpat_owner))
+      error("Cannot allocate diffraction pattern slab table.");
+    MPI_Allgather( &diffpat_nx, 1, MPI_INT, diffpat_nx_all, 1, MPI_INT, 
+                   cpugrid);
+    MPI_Allgather( &diffpat_x0, 1, MPI_INT, diffpat_x0_all, 1, MPI_INT, 
+                   cpugrid);
+    for (r=0; r<num_cpus; r++)
+      for (x=diffpat_x0_all[r]; x<diffpat_x0_all[r]+diffpat_nx_all[r]; x++)
+        diffpat_owner[x] = r;
+#else
+    diffpat_nx   = diffpat_dim.x;
+    diffpat_x0   = 0;
+    diffpat_size = diffpat_dim.x * diffpat_dim.y * dimz * diffpat_batch;
+#endif
+
     diffdist = (float *) fftwf_malloc( diffpat_size * sizeof(float) );
-    diffpat  = (float *) malloc( (diffpat_size / 2) * sizeof(float) );
+    diffpat  = (float *) malloc( 
+      MAX(1, diffpat_nx * diffpat_dim.y * dimz2) * sizeof(float) );
     if ((NULL==diffdist) || (NULL==diffpat))
       error("Cannot allocate diffraction pattern array.");
-  }
 
-  /* make fftw plan */
+    /* make fftw plan */
 #ifdef TIMING
-  imd_start_timer(&time_fft_plan);
+    imd_start_timer(&time_fft_plan);
 #endif
-  if ((diffpat_end - diffpat_start) % diffpat_int > 50)
-    diffpat_plan = fftwf_plan_dft_r2c_3d(
-      diffpat_dim.x, diffpat_dim.y, diffpat_dim.z,
-      diffdist, (fftwf_complex *) diffdist, FFTW_MEASURE);
-  else
-    diffpat_plan = fftwf_plan_dft_r2c_3d(
-      diffpat_dim.x, diffpat_dim.y, diffpat_dim.z,
-      diffdist, (fftwf_complex *) diffdist, FFTW_ESTIMATE);
+    if ((diffpat_end - diffpat_start) % diffpat_int > 50)
+      flags = FFTW_MEASURE;
+    else
+      flags = FFTW_ESTIMATE;
+#ifdef MPI
+    diffpat_plan = fftwf_mpi_plan_many_dft_r2c(3, n, diffpat_batch, 
+      FFTW_MPI_DEFAULT_BLOCK, FFTW_MPI_DEFAULT_BLOCK,
+      diffdist, (fftwf_complex *) diffdist, cpugrid, flags);
+#else
+    n[0] = inembed[0] = onembed[0] = diffpat_dim.x;
+    n[1] = inembed[1] = onembed[1] = diffpat_dim.y;
+    n[2] = diffpat_dim.z;
+    inembed[2] = dimz;
+    onembed[2] = dimz2;
+    diffpat_plan = fftwf_plan_many_dft_r2c(3, n, diffpat_batch, 
+      diffdist, inembed, diffpat_batch, 1,
+      (fftwf_complex *) diffdist, onembed, diffpat_batch, 1, flags);
+#endif
+    if (NULL==diffpat_plan) error("Cannot make diffraction pattern FFT plan");
 #ifdef TIMING
-  imd_stop_timer(&time_fft_plan);
-  printf("Time for FFT plan: %f\n", time_fft_plan.total);
+    imd_stop_timer(&time_fft_plan);
+    if (0==myid) printf("Time for FFT plan: %f\n", time_fft_plan.total);
 #endif
+  }
 
   /* initialize arrays */
+  size = diffpat_nx * diffpat_dim.y * dimz2;
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-  for (i=0; i<diffpat_size;   i++) diffdist[i]=0.0;
+  for (i=0; i<diffpat_size; i++) diffdist[i]=0.0;
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-  for (i=0; i<diffpat_size/2; i++) diffpat [i]=0.0;
+  for (i=0; i<size; i++) diffpat [i]=0.0;
+  diffpat_snap = 0;
 
 }
 
+/******************************************************************************
+*
+*  transform the collected snapshots and add them to the diffraction pattern
+*
+******************************************************************************/
+
+void transform_diffpat()
+{
+  int   i, s, size = diffpat_nx * diffpat_dim.y * (diffpat_dim.z / 2 + 1);
+  fftwf_complex *dist_out = (fftwf_complex *) diffdist;
+
+#ifdef TIMING
+  imd_start_timer(&time_fft);
+#endif
+  fftwf_execute(diffpat_plan);
+#ifdef TIMING
+  imd_stop_timer(&time_fft);
+#endif
+#ifdef _OPENMP
+#pragma omp parallel for private(s)
+#endif
+  for (i=0; i<size; i++)
+    for (s=0; s<diffpat_batch; s++)
+      diffpat[i] += (float)(SQR(dist_out[i*diffpat_batch+s][0]) + 
+                            SQR(dist_out[i*diffpat_batch+s][1]));
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (i=0; i<diffpat_size; i++) diffdist[i]=0.0;
+  diffpat_snap = 0;
+}
+
 /******************************************************************************
 *
 *  update atoms distribution array
 *
+*  Under MPI, the contributions of our atoms are sent to the CPUs
+*  holding the slabs they fall into.
+*
 ******************************************************************************/
   
 void update_diffpat(int steps)
@@ -955,8 +1082,34 @@ void update_diffpat(int steps)
   int   num, numx, numy, numz, k, i;
   real  x, y, z;
   int   dimz  = 2 * (diffpat_dim.z / 2 + 1);
-  int   dimz2 =     (diffpat_dim.z / 2 + 1);
-  fftwf_complex *dist_out = (fftwf_complex *) diffdist;
+#ifdef MPI
+  static int   *idx = NULL, *dest, *sidx, *ridx;
+  static float *wgt, *swgt, *rwgt;
+  static int   *scnt, *sdsp, *rcnt, *rdsp, nmax = 0, rmax = 0;
+  int   m, r, nat = 0, nloc = 0, nrecv;
+
+  if (NULL==scnt) {
+    scnt = (int *) malloc( 4 * num_cpus * sizeof(int) );
+    if (NULL==scnt) error("Cannot allocate diffraction pattern buffers.");
+    sdsp = scnt + num_cpus;
+    rcnt = sdsp + num_cpus;
+    rdsp = rcnt + num_cpus;
+  }
+  for (k=0; k<NCELLS; ++k) nloc += CELLPTR(k)->n;
+  if (nloc > nmax) {
+    nmax = nloc;
+    free(idx);
+    free(wgt);
+    idx = (int   *) malloc( 3 * nmax * sizeof(int)   );
+    wgt = (float *) malloc( 2 * nmax * sizeof(float) );
+    if ((NULL==idx) || (NULL==wgt)) 
+      error("Cannot allocate diffraction pattern buffers.");
+    dest = idx  + nmax;
+    sidx = dest + nmax;
+    swgt = wgt  + nmax;
+  }
+  for (r=0; r<num_cpus; r++) scnt[r] = 0;
+#endif
 
   /* loop over all atoms */
   for (k=0; k<NCELLS; ++k) {
@@ -980,29 +1133,60 @@ void update_diffpat(int steps)
       numz = diffpat_scale.z * (z - diffpat_ll.z);
       if (numz < 0)              numz = 0;
       if (numz >= diffpat_dim.z) numz = diffpat_dim.z-1;
+#ifdef MPI
+      r   = diffpat_owner[numx];
+      num = ((numx - diffpat_x0_all[r]) * diffpat_dim.y + numy) * dimz + numz;
+      idx [nat] = num * diffpat_batch + diffpat_snap;
+      wgt [nat] = diffpat_weight[ SORTE(p,i) ];
+      dest[nat] = r;
+      scnt[r]++;
+      nat++;
+#else
       num = (numx * diffpat_dim.y + numy) * dimz + numz;
-      diffdist[num] += diffpat_weight[ SORTE(p,i) ];
+      diffdist[num * diffpat_batch + diffpat_snap] += 
+        diffpat_weight[ SORTE(p,i) ];
+#endif
     }
   }
 
-  /* increment diffraction pattern */
-  if (0==steps%diffpat_int) {
-#ifdef TIMING
-    imd_start_timer(&time_fft);
-#endif
-    fftwf_execute(diffpat_plan);
-#ifdef TIMING
-    imd_stop_timer(&time_fft);
-#endif
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-    for (i=0; i<diffpat_size/2; i++)
-      diffpat[i] += (float)(SQR(dist_out[i][0])+SQR(dist_out[i][1]));
-#ifdef _OPENMP
-#pragma omp parallel for
+#ifdef MPI
+  /* sort contributions by destination CPU */
+  sdsp[0] = 0;
+  for (r=1; r<num_cpus; r++) sdsp[r] = sdsp[r-1] + scnt[r-1];
+  for (m=0; m<nat; m++) {
+    r = dest[m];
+    sidx[sdsp[r]] = idx[m];
+    swgt[sdsp[r]] = wgt[m];
+    sdsp[r]++;
+  }
+  for (r=0; r<num_cpus; r++) sdsp[r] -= scnt[r];
+
+  /* send them */
+  MPI_Alltoall( scnt, 1, MPI_INT, rcnt, 1, MPI_INT, cpugrid );
+  rdsp[0] = 0;
+  for (r=1; r<num_cpus; r++) rdsp[r] = rdsp[r-1] + rcnt[r-1];
+  nrecv = rdsp[num_cpus-1] + rcnt[num_cpus-1];
+  if (nrecv > rmax) {
+    rmax = nrecv;
+    free(ridx);
+    free(rwgt);
+    ridx = (int   *) malloc( rmax * sizeof(int)   );
+    rwgt = (float *) malloc( rmax * sizeof(float) );
+    if ((NULL==ridx) || (NULL==rwgt)) 
+      error("Cannot allocate diffraction pattern buffers.");
+  }
+  MPI_Alltoallv( sidx, scnt, sdsp, MPI_INT, 
+                 ridx, rcnt, rdsp, MPI_INT,   cpugrid );
+  MPI_Alltoallv( swgt, scnt, sdsp, MPI_FLOAT, 
+                 rwgt, rcnt, rdsp, MPI_FLOAT, cpugrid );
+
+  /* add them to our slab */
+  for (m=0; m<nrecv; m++) diffdist[ ridx[m] ] += rwgt[m];
 #endif
-    for (i=0; i<diffpat_size; i++) diffdist[i]=0.0;
+
+  /* close snapshot; transform when the batch is complete */
+  if (0==steps%diffpat_int) {
+    if (++diffpat_snap == diffpat_batch) transform_diffpat();
   }
 
 }
@@ -1011,16 +1195,33 @@ void update_diffpat(int steps)
 *
 *  write diffraction pattern
 *
+*  Snapshots still in flight are transformed first. Under MPI, the 
+*  slabs are collected one by one on CPU 0.
+*
 ******************************************************************************/
 
 void write_diffpat()
 {
-  int  num, numx, numy, numz, len;
+  int  i, len;
   int  dimz2 = diffpat_dim.z / 2 + 1;
   real pi, ddx, ddy, ddz;
   char c;
   str255 fname;
   FILE *out;
+#ifdef MPI
+  MPI_Status status;
+  float *buf;
+  int   r;
+#endif
+
+  /* transform complete snapshots of an unfinished batch */
+  if (diffpat_snap > 0) {
+    for (i=0; i<diffpat_size; i++) 
+      if (i % diffpat_batch >= diffpat_snap) diffdist[i] = 0.0;
+    transform_diffpat();
+  }
+
+  len = diffpat_nx * diffpat_dim.y * dimz2;
 
   if (myid == 0) {
 
@@ -1042,9 +1243,22 @@ void write_diffpat()
     fprintf(out, "#E\n");
 
     /* write data */
-    len = diffpat_size / 2;
     if (len!=fwrite(diffpat, sizeof(float), len, out))
       error("Cannot write distribution");
+#ifdef MPI
+    for (r=1; r<num_cpus; r++) 
+      len = MAX( len, diffpat_nx_all[r] * diffpat_dim.y * dimz2 );
+    buf = (float *) malloc( MAX(1, len) * sizeof(float) );
+    if (NULL==buf) error("Cannot allocate diffraction pattern buffer.");
+    for (r=1; r<num_cpus; r++) {
+      len = diffpat_nx_all[r] * diffpat_dim.y * dimz2;
+      if (0==len) continue;
+      MPI_Recv( buf, len, MPI_FLOAT, r, DIFFPAT_TAG, cpugrid, &status );
+      if (len!=fwrite(buf, sizeof(float), len, out))
+        error("Cannot write distribution");
+    }
+    free(buf);
+#endif
     fclose(out);
 
 #ifdef TIMING
@@ -1052,6 +1266,11 @@ void write_diffpat()
 #endif
 
   }
+#ifdef MPI
+  else if (len > 0) {
+    MPI_Send( diffpat, len, MPI_FLOAT, 0, DIFFPAT_TAG, cpugrid );
+  }
+#endif
 }
 
 #endif /* DIFFPAT */
@@ -27,7 +27,7 @@ void create_atom(int type, real mass, real temp)
   cell *p;
   ivektor cellc, neigh_cellc;
   vektor pos, dist;
-  real ran1, ran2;
+  real ran[4];
   int pbc_x, pbc_y;
   real min_dist2, dist2;
   int i, l, m, n, cpu;
@@ -40,20 +40,12 @@ void create_atom(int type, real mass, real temp)
     else if (j==10000) error("EPITAX: 10000 search loops");
     ++j; 
 
-    /* trial position of new particle (on master processor) */
+    /* trial position of new particle, the same on all CPUs */
     /* x,y coordinates at random, z coordinate shifted continuously */
-    if (0 == myid) {
-      ran1 = drand48();
-      ran2 = drand48();
-      pos.x = ran1 * box_x.x + ran2 * box_y.x;
-      pos.y = ran1 * box_x.y + ran2 * box_y.y;
-      pos.z = epitax_height;
-    }
-
-   /* broadcast position */ 
-#ifdef MPI
-    MPI_Bcast( &pos, DIM, REAL, 0, cpugrid);
-#endif
+    imd_random4(epitax_number + 1, steps, RNG_EPITAX, j, ran);
+    pos.x = ran[0] * box_x.x + ran[1] * box_y.x;
+    pos.y = ran[0] * box_x.y + ran[1] * box_y.y;
+    pos.z = epitax_height;
 
     dist2  = box_z.z * box_z.z;
     dist.x = box_z.z;
@@ -339,6 +331,7 @@ void create_atom(int type, real mass, real temp)
   cell *p;
   ivektor cellc, neigh_cellc;
   vektor pos, dist;
+  real ran[4];
   int pbc_x;
   real min_dist2, dist2;
   int i, l, m, cpu; 
@@ -351,17 +344,11 @@ void create_atom(int type, real mass, real temp)
     else if (j==10000) error("EPITAX: 10000 search loops");
     ++j; 
 
-    /* trial position of new particle (on master processor) */
+    /* trial position of new particle, the same on all CPUs */
     /* x coordinate at random, y coordinate shifted continuously */
-    if (0 == myid) {
-    pos.x = drand48() * box_x.x;
+    imd_random4(epitax_number + 1, steps, RNG_EPITAX, j, ran);
+    pos.x = ran[0] * box_x.x;
     pos.y = epitax_height;
-    }
-
-   /* broadcast position */ 
-#ifdef MPI
-    MPI_Bcast( &pos, DIM, REAL, 0, cpugrid);
-#endif
 
     dist2  = box_y.y * box_y.y;
     dist.x = box_y.y;
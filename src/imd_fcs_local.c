@@ -0,0 +1,323 @@
+/******************************************************************************
+*
+* IMD -- The ITAP Molecular Dynamics Program
+*
+* Copyright 1996-2013 Institute for Theoretical and Applied Physics,
+* University of Stuttgart, D-70550 Stuttgart
+*
+******************************************************************************/
+
+/******************************************************************************
+*
+* imd_fcs_local.c -- built-in direct summation backend behind the
+*                    ScaFaCoS calling interface
+*
+* All positions and charges are gathered on every CPU, and the field
+* and potential at the local particles are summed over all particles
+* and a number of periodic images. This is O(N^2) and meant for testing
+* and benchmarking the FCS interface, not for production runs.
+*
+******************************************************************************/
+
+/******************************************************************************
+* $Revision$
+* $Date$
+******************************************************************************/
+
+#include "imd.h"
+#include "imd_fcs_local.h"
+
+struct fcs_local_result_t {
+  int  code;
+  char origin[64];
+  char message[255];
+};
+
+struct fcs_local_handle_t {
+  MPI_Comm  comm;
+  int       ncpus;
+  fcs_float box[3][3];
+  fcs_int   pbc[3];
+  fcs_int   images[3];
+  fcs_int   ntotal;
+  fcs_int   want_virial;
+  fcs_float virial[9];
+  int       *cnt, *off;      /* particles per CPU and their offsets */
+  fcs_float *all_pos;        /* gathered positions */
+  fcs_float *all_chg;        /* gathered charges */
+  int       nall_max;
+};
+
+/******************************************************************************
+*
+*  fcs_local_result -- create an error result
+*
+******************************************************************************/
+
+static FCSResult fcs_local_result(char *origin, char *message)
+{
+  FCSResult res = (FCSResult) malloc(sizeof(struct fcs_local_result_t));
+  if (NULL==res) error("Cannot allocate FCS result");
+  res->code = 1;
+  strncpy(res->origin,  origin,  63);  res->origin[63]   = '\0';
+  strncpy(res->message, message, 254); res->message[254] = '\0';
+  return res;
+}
+
+/******************************************************************************
+*
+*  fcsResult_printResult
+*
+******************************************************************************/
+
+void fcsResult_printResult(FCSResult res)
+{
+  if (NULL==res) return;
+  fprintf(stderr, "FCS error in %s: %s\n", res->origin, res->message);
+}
+
+/******************************************************************************
+*
+*  fcs_init
+*
+******************************************************************************/
+
+FCSResult fcs_init(FCS *handle, const char *method, MPI_Comm comm)
+{
+  FCS h;
+
+  if (strcasecmp(method,"direct")!=0)
+    return fcs_local_result("fcs_init",
+                            "only method direct is built in");
+
+  h = (FCS) malloc(sizeof(struct fcs_local_handle_t));
+  if (NULL==h) return fcs_local_result("fcs_init","cannot allocate handle");
+  memset(h, 0, sizeof(struct fcs_local_handle_t));
+  h->comm = comm;
+  MPI_Comm_size(comm, &h->ncpus);
+  h->images[0] = h->images[1] = h->images[2] = 1;
+  h->cnt = (int *) malloc(h->ncpus * sizeof(int));
+  h->off = (int *) malloc(h->ncpus * sizeof(int));
+  if ((NULL==h->cnt) || (NULL==h->off))
+    return fcs_local_result("fcs_init","cannot allocate handle");
+  *handle = h;
+  return NULL;
+}
+
+/******************************************************************************
+*
+*  parameter setters
+*
+******************************************************************************/
+
+FCSResult fcs_set_common(FCS h, fcs_int near_field_flag,
+                         const fcs_float *box_a, const fcs_float *box_b,
+                         const fcs_float *box_c, const fcs_float *offset,
+                         const fcs_int *periodicity, fcs_int total_particles)
+{
+  int i;
+  if (0==near_field_flag)
+    return fcs_local_result("fcs_set_common",
+                            "near field delegation not supported by direct");
+  for (i=0; i<3; i++) {
+    h->box[0][i] = box_a[i];
+    h->box[1][i] = box_b[i];
+    h->box[2][i] = box_c[i];
+    h->pbc[i]    = periodicity[i];
+  }
+  h->ntotal = total_particles;
+  return NULL;
+}
+
+FCSResult fcs_set_box_a(FCS h, const fcs_float *box_a)
+{
+  h->box[0][0] = box_a[0]; h->box[0][1] = box_a[1]; h->box[0][2] = box_a[2];
+  return NULL;
+}
+
+FCSResult fcs_set_box_b(FCS h, const fcs_float *box_b)
+{
+  h->box[1][0] = box_b[0]; h->box[1][1] = box_b[1]; h->box[1][2] = box_b[2];
+  return NULL;
+}
+
+FCSResult fcs_set_box_c(FCS h, const fcs_float *box_c)
+{
+  h->box[2][0] = box_c[0]; h->box[2][1] = box_c[1]; h->box[2][2] = box_c[2];
+  return NULL;
+}
+
+/* direct summation is exact; the tolerance is accepted and ignored */
+FCSResult fcs_set_tolerance(FCS h, fcs_int type, fcs_float tolerance)
+{
+  return NULL;
+}
+
+FCSResult fcs_require_virial(FCS h, fcs_int flag)
+{
+  h->want_virial = flag;
+  return NULL;
+}
+
+FCSResult fcs_direct_set_periodic_images(FCS h, fcs_int *images)
+{
+  h->images[0] = images[0];
+  h->images[1] = images[1];
+  h->images[2] = images[2];
+  return NULL;
+}
+
+FCSResult fcs_tune(FCS h, fcs_int nloc, fcs_int nloc_max,
+                   fcs_float *pos, fcs_float *chg)
+{
+  return NULL;
+}
+
+/******************************************************************************
+*
+*  fcs_run -- gather all particles and sum up field and potential
+*
+******************************************************************************/
+
+FCSResult fcs_run(FCS h, fcs_int nloc, fcs_int nloc_max,
+                  fcs_float *pos, fcs_float *chg,
+                  fcs_float *field, fcs_float *pot)
+{
+  int    i, nall, nimg[3];
+  double vir[6], vir_sum[6];
+  double vxx=0.0, vyy=0.0, vzz=0.0, vyz=0.0, vzx=0.0, vxy=0.0;
+
+  /* gather positions and charges of all particles */
+  MPI_Allgather(&nloc, 1, MPI_INT, h->cnt, 1, MPI_INT, h->comm);
+  nall = 0;
+  for (i=0; i<h->ncpus; i++) {
+    h->off[i] = nall;
+    nall     += h->cnt[i];
+  }
+  if (h->nall_max < nall) {
+    h->nall_max = nall;
+    free(h->all_pos);
+    free(h->all_chg);
+    h->all_pos = (fcs_float *) malloc(3 * nall * sizeof(fcs_float));
+    h->all_chg = (fcs_float *) malloc(    nall * sizeof(fcs_float));
+    if ((NULL==h->all_pos) || (NULL==h->all_chg))
+      return fcs_local_result("fcs_run","cannot allocate particle buffers");
+  }
+  MPI_Allgatherv(chg, nloc, FCS_MPI_FLOAT,
+                 h->all_chg, h->cnt, h->off, FCS_MPI_FLOAT, h->comm);
+  for (i=0; i<h->ncpus; i++) {
+    h->cnt[i] *= 3;
+    h->off[i] *= 3;
+  }
+  MPI_Allgatherv(pos, 3*nloc, FCS_MPI_FLOAT,
+                 h->all_pos, h->cnt, h->off, FCS_MPI_FLOAT, h->comm);
+
+  /* image shells only in periodic directions */
+  for (i=0; i<3; i++) nimg[i] = h->pbc[i] ? h->images[i] : 0;
+
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:vxx,vyy,vzz,vyz,vzx,vxy)
+#endif
+  for (i=0; i<nloc; i++) {
+    int       j, n0, n1, n2;
+    fcs_float fx=0.0, fy=0.0, fz=0.0, phi=0.0;
+    fcs_float wxx=0.0, wyy=0.0, wzz=0.0, wyz=0.0, wzx=0.0, wxy=0.0;
+    for (n0=-nimg[0]; n0<=nimg[0]; n0++)
+    for (n1=-nimg[1]; n1<=nimg[1]; n1++)
+    for (n2=-nimg[2]; n2<=nimg[2]; n2++) {
+      fcs_float sx = n0*h->box[0][0] + n1*h->box[1][0] + n2*h->box[2][0];
+      fcs_float sy = n0*h->box[0][1] + n1*h->box[1][1] + n2*h->box[2][1];
+      fcs_float sz = n0*h->box[0][2] + n1*h->box[1][2] + n2*h->box[2][2];
+      for (j=0; j<nall; j++) {
+        fcs_float dx, dy, dz, r2, ir, qr3;
+        dx = pos[3*i  ] - h->all_pos[3*j  ] - sx;
+        dy = pos[3*i+1] - h->all_pos[3*j+1] - sy;
+        dz = pos[3*i+2] - h->all_pos[3*j+2] - sz;
+        r2 = dx*dx + dy*dy + dz*dz;
+        if (r2 == 0.0) continue;  /* the particle itself */
+        ir   = 1.0 / sqrt(r2);
+        qr3  = h->all_chg[j] * ir * ir * ir;
+        phi += h->all_chg[j] * ir;
+        fx  += dx * qr3;
+        fy  += dy * qr3;
+        fz  += dz * qr3;
+        wxx += dx * dx * qr3;
+        wyy += dy * dy * qr3;
+        wzz += dz * dz * qr3;
+        wyz += dy * dz * qr3;
+        wzx += dz * dx * qr3;
+        wxy += dx * dy * qr3;
+      }
+    }
+    field[3*i  ] = fx;
+    field[3*i+1] = fy;
+    field[3*i+2] = fz;
+    pot  [i]     = phi;
+    /* each pair is visited from both ends */
+    vxx += 0.5 * chg[i] * wxx;
+    vyy += 0.5 * chg[i] * wyy;
+    vzz += 0.5 * chg[i] * wzz;
+    vyz += 0.5 * chg[i] * wyz;
+    vzx += 0.5 * chg[i] * wzx;
+    vxy += 0.5 * chg[i] * wxy;
+  }
+
+  /* the virial is a global quantity */
+  if (h->want_virial) {
+    vir[0] = vxx; vir[1] = vyy; vir[2] = vzz;
+    vir[3] = vyz; vir[4] = vzx; vir[5] = vxy;
+    MPI_Allreduce(vir, vir_sum, 6, MPI_DOUBLE, MPI_SUM, h->comm);
+    h->virial[0] = vir_sum[0];
+    h->virial[4] = vir_sum[1];
+    h->virial[8] = vir_sum[2];
+    h->virial[5] = h->virial[7] = vir_sum[3];
+    h->virial[2] = h->virial[6] = vir_sum[4];
+    h->virial[1] = h->virial[3] = vir_sum[5];
+  }
+
+  return NULL;
+}
+
+/******************************************************************************
+*
+*  fcs_get_virial
+*
+******************************************************************************/
+
+FCSResult fcs_get_virial(FCS h, fcs_float *virial)
+{
+  int i;
+  if (!h->want_virial)
+    return fcs_local_result("fcs_get_virial","virial was not requested");
+  for (i=0; i<9; i++) virial[i] = h->virial[i];
+  return NULL;
+}
+
+/******************************************************************************
+*
+*  fcs_compute_near -- only needed for near-field delegation
+*
+******************************************************************************/
+
+FCSResult fcs_compute_near(FCS h, fcs_float r, fcs_float *pot, fcs_float *grad)
+{
+  return fcs_local_result("fcs_compute_near",
+                          "near field delegation not supported by direct");
+}
+
+/******************************************************************************
+*
+*  fcs_destroy
+*
+******************************************************************************/
+
+FCSResult fcs_destroy(FCS h)
+{
+  if (NULL==h) return NULL;
+  free(h->cnt);
+  free(h->off);
+  free(h->all_pos);
+  free(h->all_chg);
+  free(h);
+  return NULL;
+}
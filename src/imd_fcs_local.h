@@ -0,0 +1,65 @@
+/******************************************************************************
+*
+* IMD -- The ITAP Molecular Dynamics Program
+*
+* Copyright 1996-2013 Institute for Theoretical and Applied Physics,
+* University of Stuttgart, D-70550 Stuttgart
+*
+******************************************************************************/
+
+/******************************************************************************
+*
+* imd_fcs_local.h -- built-in stand-in for the subset of the ScaFaCoS
+*                    interface used by imd_forces_fcs.c
+*
+* Only the direct summation method is provided. It allows to test and
+* time the FCS plumbing without linking against the ScaFaCoS library.
+*
+******************************************************************************/
+
+/******************************************************************************
+* $Revision$
+* $Date$
+******************************************************************************/
+
+#ifndef IMD_FCS_LOCAL_H
+#define IMD_FCS_LOCAL_H
+
+typedef double fcs_float;
+typedef int    fcs_int;
+
+#define FCS_MPI_FLOAT MPI_DOUBLE
+
+/* methods available in the built-in backend */
+#define FCS_ENABLE_DIRECT 1
+
+#define FCS_TOLERANCE_TYPE_ENERGY 0
+#define FCS_TOLERANCE_TYPE_FIELD  2
+
+/* opaque handle and result types, as in ScaFaCoS */
+typedef struct fcs_local_handle_t *FCS;
+typedef struct fcs_local_result_t *FCSResult;
+
+FCSResult fcs_init(FCS *handle, const char *method, MPI_Comm comm);
+FCSResult fcs_set_common(FCS handle, fcs_int near_field_flag,
+                         const fcs_float *box_a, const fcs_float *box_b,
+                         const fcs_float *box_c, const fcs_float *offset,
+                         const fcs_int *periodicity, fcs_int total_particles);
+FCSResult fcs_set_box_a(FCS handle, const fcs_float *box_a);
+FCSResult fcs_set_box_b(FCS handle, const fcs_float *box_b);
+FCSResult fcs_set_box_c(FCS handle, const fcs_float *box_c);
+FCSResult fcs_set_tolerance(FCS handle, fcs_int type, fcs_float tolerance);
+FCSResult fcs_require_virial(FCS handle, fcs_int flag);
+FCSResult fcs_direct_set_periodic_images(FCS handle, fcs_int *images);
+FCSResult fcs_tune(FCS handle, fcs_int nloc, fcs_int nloc_max,
+                   fcs_float *pos, fcs_float *chg);
+FCSResult fcs_run(FCS handle, fcs_int nloc, fcs_int nloc_max,
+                  fcs_float *pos, fcs_float *chg,
+                  fcs_float *field, fcs_float *pot);
+FCSResult fcs_get_virial(FCS handle, fcs_float *virial);
+FCSResult fcs_compute_near(FCS handle, fcs_float r,
+                           fcs_float *pot, fcs_float *grad);
+FCSResult fcs_destroy(FCS handle);
+void      fcsResult_printResult(FCSResult result);
+
+#endif /* IMD_FCS_LOCAL_H */
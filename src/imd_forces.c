@@ -104,6 +104,8 @@ void do_forces(cell *p, cell *q, vektor pbc, real *Epot, real *Virial,
       if (r2 <= pair_pot.end[col]) {
 #ifdef LINPOT
         PAIR_INT_LIN(pot_zwi, pot_grad, pair_pot_lin, col, inc, r2, is_short)
+#elif defined(ANAPOT)
+        PAIR_INT_ANA(pot_zwi, pot_grad, col, r2)
 #else
         PAIR_INT(pot_zwi, pot_grad, pair_pot, col, inc, r2, is_short)
 #endif
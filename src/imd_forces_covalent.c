@@ -1674,7 +1674,7 @@ void do_neightab2(cell *p, cell *q, vektor pbc)
       radius2 = SPROD(d,d);
 
       /* make neighbor tables*/
-      if (radius2 <= ada_nbr_r2cut) {
+      if (radius2 <= nnbr_r2cut) {
         neightab *neigh;
         real  *tmp_ptr;
 
@@ -21,6 +21,12 @@
 
 #include "imd.h"
 
+#ifdef RESPA
+/* Fourier contributions from the last long-range step */
+static real ew_respa_epot = 0.0;
+static real ew_respa_vir  = 0.0;
+#endif
+
 void clear_forces(void)
 
 {
@@ -89,7 +95,21 @@ void do_forces_ewald(int steps)
   }
 
   /* Fourier space part */
+#ifdef RESPA
+  /* between long-range steps, only energy and virial are carried along */
+  if ((ew_kcut > 0) && (respa_outer)) {
+    real epot0 = tot_pot_energy, vir0 = virial;
+    do_forces_ewald_fourier();
+    ew_respa_epot = tot_pot_energy - epot0;
+    ew_respa_vir  = virial - vir0;
+  }
+  else if (ew_kcut > 0) {
+    tot_pot_energy += ew_respa_epot;
+    virial         += ew_respa_vir;
+  }
+#else
   if (ew_kcut > 0) do_forces_ewald_fourier();
+#endif
 
   if ((steps==0) && (ew_test) && (ew_kcut>0)) {
     imd_stop_timer( &ewald_time );
@@ -129,6 +149,8 @@ void do_forces_ewald(int steps)
 *
 *  computes the fourier part of the Ewald sum
 *
+*  With RESPA, the forces are applied as an impulse for respa_n steps.
+*
 ******************************************************************************/
 
 void do_forces_ewald_fourier(void)
@@ -139,6 +161,11 @@ void do_forces_ewald_fourier(void)
   int    px, py, pz, mx, my, mz;
   real   tmp, tmp_virial=0.0, sum_cos, sum_sin;
   real   kforce, kpot;
+#ifdef RESPA
+  real   ffac = respa_n;
+#else
+  real   ffac = 1.0;
+#endif
 
   /* Compute exp(ikr) recursively */
   px = (ew_nx+1) * natoms;  mx = (ew_nx-1) * natoms;
@@ -273,9 +300,9 @@ void do_forces_ewald_fourier(void)
         kforce = charge[typ] * ew_expk[k] 
                  * (sinkr[cnt] * sum_cos - coskr[cnt] * sum_sin);
 #endif
-        KRAFT(p,i,X) += ew_kvek[k].x * kforce;
-        KRAFT(p,i,Y) += ew_kvek[k].y * kforce;
-        KRAFT(p,i,Z) += ew_kvek[k].z * kforce;
+        KRAFT(p,i,X) += ew_kvek[k].x * kforce * ffac;
+        KRAFT(p,i,Y) += ew_kvek[k].y * kforce * ffac;
+        KRAFT(p,i,Z) += ew_kvek[k].z * kforce * ffac;
         tmp_virial   += kforce * SPRODX(ORT,p,i,ew_kvek[k]);
 
         cnt++;
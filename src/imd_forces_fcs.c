@@ -19,11 +19,26 @@
 ******************************************************************************/
 
 #include "imd.h"
+#ifdef FCS_LOCAL
+#include "imd_fcs_local.h"
+#else
 #include <fcs.h>
+#endif
 
 fcs_float *pos=NULL, *chg=NULL, *field=NULL, *pot=NULL; 
 int       nloc, nloc_max=0;
+/* with neighbor lists, positions are only folded back at list updates */
+#ifdef NBLIST
+int       fcs_need_wrap=1;
+#else
+int       fcs_need_wrap=0;
+#endif
 FCS       handle=NULL;
+#ifdef RESPA
+/* energy and virial from the last long-range step */
+fcs_float respa_vir[9];
+real      respa_epot=0.0;
+#endif
  
 #define ASSERT_FCS(err) \
   do { \
@@ -63,43 +78,37 @@ void clear_forces(void) {
 
 /******************************************************************************
 *
-* do_boundaries_fcs
+* wrap_fcs -- apply periodic boundaries to a single position
 *
 ******************************************************************************/
 
 #define SPRODFCS(a,b) (((a)[0] * (b).x) + ((a)[1] * (b).y) + ((a)[2] * (b).z))
 
-void do_boundaries_fcs(int nloc, fcs_float *pos)
+INLINE static void wrap_fcs(fcs_float *x)
 {
-  int l, i;
+  real i;
 
   /* PBC in x direction */
-  if (1==pbc_dirs.x)
-    for (l=0; l<3*nloc; l+=3) {
-      i = -FLOOR( SPRODFCS(pos+l,tbox_x) );
-      pos[l  ] += i * box_x.x;
-      pos[l+1] += i * box_x.y;
-      pos[l+2] += i * box_x.z;
-    }
-
+  if (1==pbc_dirs.x) {
+    i = -FLOOR( SPRODFCS(x,tbox_x) );
+    x[0] += i * box_x.x;
+    x[1] += i * box_x.y;
+    x[2] += i * box_x.z;
+  }
   /* PBC in y direction */
-  if (1==pbc_dirs.y)
-    for (l=0; l<3*nloc; l+=3) {
-      i = -FLOOR( SPRODFCS(pos+l,tbox_y) );
-      pos[l  ] += i * box_y.x;
-      pos[l+1] += i * box_y.y;
-      pos[l+2] += i * box_y.z;
-    }
-
+  if (1==pbc_dirs.y) {
+    i = -FLOOR( SPRODFCS(x,tbox_y) );
+    x[0] += i * box_y.x;
+    x[1] += i * box_y.y;
+    x[2] += i * box_y.z;
+  }
   /* PBC in z direction */
-  if (1==pbc_dirs.z)
-    for (l=0; l<3*nloc; l+=3) {
-      i = -FLOOR( SPRODFCS(pos+l,tbox_z) );
-      pos[l  ] += i * box_z.x;
-      pos[l+1] += i * box_z.y;
-      pos[l+2] += i * box_z.z;
-    }
-
+  if (1==pbc_dirs.z) {
+    i = -FLOOR( SPRODFCS(x,tbox_z) );
+    x[0] += i * box_z.x;
+    x[1] += i * box_z.y;
+    x[2] += i * box_z.z;
+  }
 }
 
 /******************************************************************************
@@ -112,15 +121,15 @@ void pack_fcs(void) {
 
   int k, n, m, i;
 
-  /* (re-)allocate data structures if necessary */ 
+  /* (re-)allocate persistent buffers if necessary */ 
   nloc = 0;
   for (k=0; k<NCELLS; ++k) nloc += CELLPTR(k)->n;
   if (nloc_max < nloc) {
     nloc_max = (int) (1.1 * nloc);
-    free(pos);   pos   = (fcs_float*) malloc(DIM * nloc_max*sizeof(fcs_float));
-    free(chg);   chg   = (fcs_float*) malloc(      nloc_max*sizeof(fcs_float));
-    free(field); field = (fcs_float*) malloc(DIM * nloc_max*sizeof(fcs_float));
-    free(pot);   pot   = (fcs_float*) malloc(      nloc_max*sizeof(fcs_float));
+    pos   = (fcs_float*) realloc(pos,   DIM * nloc_max*sizeof(fcs_float));
+    chg   = (fcs_float*) realloc(chg,         nloc_max*sizeof(fcs_float));
+    field = (fcs_float*) realloc(field, DIM * nloc_max*sizeof(fcs_float));
+    pot   = (fcs_float*) realloc(pot,         nloc_max*sizeof(fcs_float));
     if ((NULL==pos) || (NULL==chg) || (NULL==field) || (NULL==pot)) 
       error("Could not allocate fcs data");
   }
@@ -131,53 +140,34 @@ void pack_fcs(void) {
 #endif
     clear_forces();
 
-  /* collect data from cell array */
+  /* collect data from cell array; positions kept by fix_cells
+     are already inside the box */
   n=0; m=0;
   for (k=0; k<NCELLS; ++k) {
     cell *p = CELLPTR(k);
     for (i=0; i<p->n; ++i) { 
-      pos[n++] = ORT(p,i,X); 
-      pos[n++] = ORT(p,i,Y); 
-      pos[n++] = ORT(p,i,Z); 
+      pos[n  ] = ORT(p,i,X); 
+      pos[n+1] = ORT(p,i,Y); 
+      pos[n+2] = ORT(p,i,Z); 
+      if (fcs_need_wrap) wrap_fcs(pos+n);
+      n += 3;
       chg[m++] = CHARGE(p,i);
     }
   }
-
-  /* apply periodic boundaries */
-  do_boundaries_fcs(nloc, pos);
 }
 
 /******************************************************************************
 *
-* unpack_fcs
+* add_virial_fcs -- add the FCS virial tensor
 *
 ******************************************************************************/
 
-void unpack_fcs(void) {
-
-  fcs_float vir[9] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
-  FCSResult result;
-  real pot1, pot2, e, c, sum=0.0, fac=0.5;
-  int n, m, k, i;
+void add_virial_fcs(fcs_float *vir) {
 
-  /* extract output and distribute it to cell array */
-  n=0; m=0; pot1=0.0;
-  for (k=0; k<NCELLS; ++k) {
-    cell *p = CELLPTR(k);
-    for (i=0; i<p->n; ++i) { 
-      c = CHARGE(p,i) * coul_eng;
-      KRAFT(p,i,X) += field[n++] * c; 
-      KRAFT(p,i,Y) += field[n++] * c; 
-      KRAFT(p,i,Z) += field[n++] * c;
-      e = pot[m++] * c * fac;
-      POTENG(p,i)  += e;
-      pot1         += e;
-    }
-  }
+#ifdef STRESS_TENS
+  int k, i;
+#endif
 
-  /* unpack virial */
-  result = fcs_get_virial(handle, vir);
-  ASSERT_FCS(result);
 #ifdef P_AXIAL
   vir_xx += vir[0];
   vir_yy += vir[4];
@@ -208,13 +198,59 @@ void unpack_fcs(void) {
     }
   }
 #endif
+}
+
+/******************************************************************************
+*
+* unpack_fcs
+*
+* With RESPA, the forces are applied as an impulse for respa_n steps.
+*
+******************************************************************************/
+
+void unpack_fcs(void) {
+
+  fcs_float vir[9] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+  FCSResult result;
+  real pot1, pot2, e, c, sum=0.0, fac=0.5;
+  int n, m, k, i;
+#ifdef RESPA
+  real ffac = respa_n;
+#else
+  real ffac = 1.0;
+#endif
+
+  /* extract output and distribute it to cell array */
+  n=0; m=0; pot1=0.0;
+  for (k=0; k<NCELLS; ++k) {
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; ++i) { 
+      c = CHARGE(p,i) * coul_eng;
+      KRAFT(p,i,X) += field[n++] * c * ffac; 
+      KRAFT(p,i,Y) += field[n++] * c * ffac; 
+      KRAFT(p,i,Z) += field[n++] * c * ffac;
+      e = pot[m++] * c * fac;
+      POTENG(p,i)  += e;
+      pot1         += e;
+    }
+  }
+
+  /* unpack virial */
+  result = fcs_get_virial(handle, vir);
+  ASSERT_FCS(result);
+  add_virial_fcs(vir);
 
   /* sum up potential energy */
 #ifdef MPI
   MPI_Allreduce( &pot1, &pot2, 1, MPI_DOUBLE, MPI_SUM, cpugrid);
-  tot_pot_energy += pot2;
 #else
-  tot_pot_energy += pot1;
+  pot2 = pot1;
+#endif
+  tot_pot_energy += pot2;
+
+#ifdef RESPA
+  for (i=0; i<9; i++) respa_vir[i] = vir[i];
+  respa_epot = pot2;
 #endif
 }
 
@@ -291,7 +327,12 @@ void init_fcs(void) {
   switch (fcs_method) {
 #ifdef FCS_ENABLE_DIRECT
     case FCS_METH_DIRECT:
-      /* nothing to do */
+      if (fcs_direct_images.x || fcs_direct_images.y || fcs_direct_images.z) {
+        fcs_int images[3] = { fcs_direct_images.x, fcs_direct_images.y, 
+                              fcs_direct_images.z };
+        res = fcs_direct_set_periodic_images(handle, images);
+        ASSERT_FCS(res);
+      }
       break;
 #endif
 #ifdef FCS_ENABLE_PEPC
@@ -409,6 +450,10 @@ break;
       error("FCS method unknown or not implemented"); 
       break;
   }
+  /* fix_cells keeps positions inside the box only from now on */
+#ifndef NBLIST
+  do_boundaries();
+#endif
   pack_fcs();
   res = fcs_tune(handle, nloc, nloc_max, pos, chg);
   ASSERT_FCS(res);
@@ -457,6 +502,9 @@ break;
   }
 
   /* add near-field potential, after fcs_tune */
+#ifdef ANAPOT
+  if (0==srf) error("ANAPOT cannot be used with FCS near-field delegation");
+#endif
   if (0==srf) fcs_update_pottab();
 }
 
@@ -502,12 +550,39 @@ void calc_forces_fcs(int steps) {
     result = fcs_set_box_c(handle, BoxZ);
     ASSERT_FCS(result);
   }
+#endif
+#ifdef RESPA
+  /* between long-range steps, only energy and virial are carried along */
+  if (!respa_outer) {
+    /* without short-range forces, nobody else clears them */
+#ifdef PAIR
+    if (!have_potfile && !have_pre_pot)
+#endif
+      clear_forces();
+    tot_pot_energy += respa_epot;
+    add_virial_fcs(respa_vir);
+    return;
+  }
+#endif
+#ifdef TIMING
+  imd_start_timer(&time_fcs_pack);
 #endif
   pack_fcs();
+#ifdef TIMING
+  imd_stop_timer(&time_fcs_pack);
+  imd_start_timer(&time_fcs_run);
+#endif
   /* dump_config_fcs( pos, chg, nloc, steps, myid ); */
   result = fcs_run(handle, nloc, nloc_max, pos, chg, field, pot);
   ASSERT_FCS(result);
+#ifdef TIMING
+  imd_stop_timer(&time_fcs_run);
+  imd_start_timer(&time_fcs_pack);
+#endif
   unpack_fcs();
+#ifdef TIMING
+  imd_stop_timer(&time_fcs_pack);
+#endif
 }
 
 
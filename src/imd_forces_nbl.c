@@ -308,6 +308,9 @@ void calc_forces(int steps)
   nfc++;
 
   /* clear per atom accumulation variables, also in buffer cells */
+#ifdef _OPENMP
+#pragma omp parallel for private(i)
+#endif
   for (k=0; k<nallcells; k++) {
     cell *p = cell_array + k;
 #ifdef ia64
@@ -475,6 +478,8 @@ void calc_forces(int steps)
 #if defined(PAIR)
 #ifdef LINPOT
           PAIR_INT_LIN(pot, grad, pair_pot_lin, col, inc, r2, is_short);
+#elif defined(ANAPOT)
+          PAIR_INT_ANA(pot, grad, col, r2);
 #else
 	  PAIR_INT(pot, grad, pair_pot, col, inc, r2, is_short);
 #endif
@@ -1853,6 +1858,9 @@ void calc_sm_pot()
   send_cells(copy_sm_charge,pack_sm_charge,unpack_sm_charge);
 
   /* clear per atom accumulation variables, also in buffer cells */
+#ifdef _OPENMP
+#pragma omp parallel for private(i)
+#endif
   for (k=0; k<nallcells; k++) {
     cell *p = cell_array + k;
     for (i=0; i<p->n; i++) {
@@ -1951,6 +1959,9 @@ void calc_sm_chi()
   if (0==have_valid_nbl) make_nblist();
 
   /* clear per atom accumulation variables, also in buffer cells */
+#ifdef _OPENMP
+#pragma omp parallel for private(i)
+#endif
   for (k=0; k<nallcells; k++) {
     cell *p = cell_array + k;
     for (i=0; i<p->n; i++) {
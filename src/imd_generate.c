@@ -77,7 +77,6 @@ void generate_atoms(str255 mode)
 #endif
 
   /* We always have to initialize the velocities on generated structures */
-  srand48(seed); /* initialize random number generator */
   do_maxwell=1;
 
 #ifdef TWOD
@@ -40,7 +40,15 @@ void setup_mpi_topology( void )
 	   cpu_dim.x,cpu_dim.y,cpu_dim.z);
   }
   
+#ifdef NEB
+  /* each NEB image has its own process array */
+  MPI_Cart_create(neb_img_comm, 3, (int *) &cpu_dim, period, 1, &cpugrid);
+#elif defined(PRD)
+  /* each PRD replica has its own process array */
+  MPI_Cart_create(prd_comm, 3, (int *) &cpu_dim, period, 1, &cpugrid);
+#else
   MPI_Cart_create(MPI_COMM_WORLD, 3, (int *) &cpu_dim, period, 1, &cpugrid);
+#endif
   MPI_Comm_rank(cpugrid, &myid);
   MPI_Comm_size(cpugrid, &num_cpus);
   MPI_Cart_coords(cpugrid, myid, 3, (int *) &my_coord);
@@ -866,6 +866,202 @@ void move_atoms_mik(void)
 #endif
 
 
+#ifdef FIRE2
+
+/*****************************************************************************
+*
+*  reset FIRE 2.0, e.g. after a deformation step
+*
+*****************************************************************************/
+
+void reset_fire2(void)
+{
+  int i, k;
+
+  if (fire2_starttimestep == 0.0) fire2_starttimestep = timestep;
+  timestep    = fire2_starttimestep;
+  fire2_alpha = fire2_alpha0;
+  fire2_npos  = 0;
+  fire2_nneg  = 0;
+  fire2_iter  = 0;
+  fnorm       = 9.99e99;
+
+  for (k=0; k<NCELLS; ++k) {
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; ++i) {
+      IMPULS(p,i,X) = 0.0;
+      IMPULS(p,i,Y) = 0.0;
+#ifndef TWOD
+      IMPULS(p,i,Z) = 0.0;
+#endif
+    }
+  }
+}
+
+/*****************************************************************************
+*
+*  FIRE 2.0 relaxation with semi-implicit Euler integration
+*  (Guenole et al., Comp. Mat. Sci. 175 (2020) 109584)
+*
+*****************************************************************************/
+
+void move_atoms_fire2(void)
+{
+  int  k, stop = 0;
+  real P = 0.0, vv = 0.0, vf = 0.0, ff = 0.0, tmp_f_max2 = 0.0;
+  real vnorm, fscale;
+#ifdef MPI
+  real tmpvec1[5], tmpvec2[5];
+#endif
+
+  fnorm = 0.0;
+
+  /* restrict forces, and get P = F*v and the norms needed for mixing */
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:P,vv,vf,ff,fnorm) reduction(max:tmp_f_max2)
+#endif
+  for (k=0; k<NCELLS; ++k) {
+    int  i, sort;
+    real m2;
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; ++i) {
+      sort = VSORTE(p,i);
+#ifdef FBC
+      KRAFT(p,i,X) += (fbc_forces + sort)->x;
+      KRAFT(p,i,Y) += (fbc_forces + sort)->y;
+#ifndef TWOD
+      KRAFT(p,i,Z) += (fbc_forces + sort)->z;
+#endif
+#endif
+      KRAFT(p,i,X) *= (restrictions + sort)->x;
+      KRAFT(p,i,Y) *= (restrictions + sort)->y;
+#ifndef TWOD
+      KRAFT(p,i,Z) *= (restrictions + sort)->z;
+#endif
+      m2     = MASSE(p,i) * MASSE(p,i);
+      P     += SPRODN(IMPULS,p,i,KRAFT,p,i) / MASSE(p,i);
+      vv    += SPRODN(IMPULS,p,i,IMPULS,p,i) / m2;
+      vf    += SPRODN(IMPULS,p,i,KRAFT,p,i) / m2;
+      ff    += SPRODN(KRAFT,p,i,KRAFT,p,i) / m2;
+      fnorm += SPRODN(KRAFT,p,i,KRAFT,p,i);
+      tmp_f_max2 = MAX(SQR(KRAFT(p,i,X)),tmp_f_max2);
+      tmp_f_max2 = MAX(SQR(KRAFT(p,i,Y)),tmp_f_max2);
+#ifndef TWOD
+      tmp_f_max2 = MAX(SQR(KRAFT(p,i,Z)),tmp_f_max2);
+#endif
+    }
+  }
+#ifdef MPI
+  tmpvec1[0] = P;
+  tmpvec1[1] = vv;
+  tmpvec1[2] = vf;
+  tmpvec1[3] = ff;
+  tmpvec1[4] = fnorm;
+  MPI_Allreduce( tmpvec1, tmpvec2, 5, REAL, MPI_SUM, cpugrid);
+  P     = tmpvec2[0];
+  vv    = tmpvec2[1];
+  vf    = tmpvec2[2];
+  ff    = tmpvec2[3];
+  fnorm = tmpvec2[4];
+  MPI_Allreduce( &tmp_f_max2, &f_max2, 1, REAL, MPI_MAX, cpugrid);
+#else
+  f_max2 = tmp_f_max2;
+#endif
+  f_max = SQRT(f_max2);
+  PxF   = P;
+
+  /* adapt timestep and mixing; uphill steps are partially undone */
+  if (P > 0.0) {
+    fire2_npos++;
+    fire2_nneg = 0;
+    if (fire2_npos > fire2_ndelay) {
+      timestep     = MIN(timestep * fire2_finc, fire2_dtmax);
+      fire2_alpha *= fire2_falpha;
+    }
+  }
+  else {
+    fire2_npos = 0;
+    fire2_nneg++;
+    if (fire2_nneg > fire2_nnegmax) stop = 1;
+    if (!(fire2_initdelay && (fire2_iter < fire2_ndelay))) {
+      if (timestep * fire2_fdec >= fire2_dtmin) timestep *= fire2_fdec;
+      fire2_alpha = fire2_alpha0;
+    }
+    vv = vf = 0.0;
+  }
+  fire2_iter++;
+
+  /* |v| after the velocity update, and the scale of the mixed in force */
+  vnorm  = SQRT( vv + 2.0 * timestep * vf + timestep * timestep * ff );
+  fscale = (ff > 0.0) ? fire2_alpha * vnorm / SQRT(ff) : 0.0;
+
+  tot_kin_energy = 0.0;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:tot_kin_energy)
+#endif
+  for (k=0; k<NCELLS; ++k) {
+    int  i;
+    real tmp;
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; ++i) {
+      tmp = timestep / MASSE(p,i);
+      if (P <= 0.0) {
+        ORT(p,i,X)   -= 0.5 * tmp * IMPULS(p,i,X);
+        ORT(p,i,Y)   -= 0.5 * tmp * IMPULS(p,i,Y);
+#ifndef TWOD
+        ORT(p,i,Z)   -= 0.5 * tmp * IMPULS(p,i,Z);
+#endif
+        IMPULS(p,i,X) = 0.0;
+        IMPULS(p,i,Y) = 0.0;
+#ifndef TWOD
+        IMPULS(p,i,Z) = 0.0;
+#endif
+      }
+      /* v += dt F / m, then v = (1-alpha) v + alpha |v| F / |F| */
+      IMPULS(p,i,X) = (1.0 - fire2_alpha) * (IMPULS(p,i,X) + timestep * KRAFT(p,i,X))
+                      + fscale * KRAFT(p,i,X);
+      IMPULS(p,i,Y) = (1.0 - fire2_alpha) * (IMPULS(p,i,Y) + timestep * KRAFT(p,i,Y))
+                      + fscale * KRAFT(p,i,Y);
+#ifndef TWOD
+      IMPULS(p,i,Z) = (1.0 - fire2_alpha) * (IMPULS(p,i,Z) + timestep * KRAFT(p,i,Z))
+                      + fscale * KRAFT(p,i,Z);
+#endif
+      ORT(p,i,X) += tmp * IMPULS(p,i,X);
+      ORT(p,i,Y) += tmp * IMPULS(p,i,Y);
+#ifndef TWOD
+      ORT(p,i,Z) += tmp * IMPULS(p,i,Z);
+#endif
+      tot_kin_energy += SPRODN(IMPULS,p,i,IMPULS,p,i) / (2.0 * MASSE(p,i));
+#ifdef STRESS_TENS
+      if (do_press_calc) {
+        PRESSTENS(p,i,xx) += IMPULS(p,i,X) * IMPULS(p,i,X) / MASSE(p,i);
+        PRESSTENS(p,i,yy) += IMPULS(p,i,Y) * IMPULS(p,i,Y) / MASSE(p,i);
+#ifndef TWOD
+        PRESSTENS(p,i,zz) += IMPULS(p,i,Z) * IMPULS(p,i,Z) / MASSE(p,i);
+        PRESSTENS(p,i,yz) += IMPULS(p,i,Y) * IMPULS(p,i,Z) / MASSE(p,i);
+        PRESSTENS(p,i,zx) += IMPULS(p,i,Z) * IMPULS(p,i,X) / MASSE(p,i);
+#endif
+        PRESSTENS(p,i,xy) += IMPULS(p,i,X) * IMPULS(p,i,Y) / MASSE(p,i);
+      }
+#endif
+    }
+  }
+#ifdef MPI
+  tmpvec1[0] = tot_kin_energy;
+  MPI_Allreduce( tmpvec1, tmpvec2, 1, REAL, MPI_SUM, cpugrid);
+  tot_kin_energy = tmpvec2[0];
+#endif
+
+  if (stop) {
+    if (0==myid)
+      printf("FIRE 2.0: more than %d uphill steps, giving up\n", fire2_nnegmax);
+    steps_max = steps;
+  }
+}
+
+#endif /* FIRE2 */
+
+
 /*****************************************************************************
 *
 * NVT Integrator with Nose Hoover Thermostat 
@@ -1143,6 +1339,151 @@ void move_atoms_nvt(void)
 #endif
 
 
+/*****************************************************************************
+*
+* Langevin thermostat (leapfrog form of Bruenger, Brooks and Karplus)
+*
+* Each atom is coupled to the heat bath individually. The noise comes
+* from the counter-based random numbers, and depends only on atom
+* number and step, so that no global state is needed.
+*
+*****************************************************************************/
+
+#ifdef LANGEVIN
+
+void move_atoms_langevin(void)
+{
+  int k;
+  real tmpvec1[3], tmpvec2[3];
+  real E_kin_1 = 0.0, E_kin_2 = 0.0;
+  real reibung, eins_d_reib, noise;
+  real tmp_f_max2 = 0.0;
+
+  fnorm   = 0.0;
+  omega_E = 0.0;
+
+  reibung     =        1.0 - langevin_gamma * timestep / 2.0;
+  eins_d_reib = 1.0 / (1.0 + langevin_gamma * timestep / 2.0);
+  /* times sqrt(mass) gives the width of the random momentum */
+  noise       = sqrt( 2.0 * langevin_gamma * temperature * timestep );
+
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:E_kin_1,E_kin_2,fnorm,omega_E) reduction(max:tmp_f_max2)
+#endif
+  for (k=0; k<NCELLS; ++k) {  /* loop over cells */
+
+    int    i, sort;
+    cell   *p;
+    real   tmp, g[4];
+    vektor *rest;
+
+    p = CELLPTR(k);
+
+    for (i=0; i<p->n; ++i) {  /* loop over atoms */
+
+      sort = VSORTE(p,i);
+      rest = restrictions + sort;
+
+      /* twice the old kinetic energy */
+      E_kin_1 += SPRODN(IMPULS,p,i,IMPULS,p,i) / MASSE(p,i);
+
+#ifdef FBC
+      /* give virtual particles their extra force */
+      KRAFT(p,i,X) += (fbc_forces + sort)->x;
+      KRAFT(p,i,Y) += (fbc_forces + sort)->y;
+#ifndef TWOD
+      KRAFT(p,i,Z) += (fbc_forces + sort)->z;
+#endif
+#endif
+
+      KRAFT(p,i,X) *= rest->x;
+      KRAFT(p,i,Y) *= rest->y;
+#ifndef TWOD
+      KRAFT(p,i,Z) *= rest->z;
+#endif
+#ifdef FNORM
+      fnorm += SPRODN(KRAFT,p,i,KRAFT,p,i);
+      /* determine the biggest force component */
+      tmp_f_max2 = MAX(SQR(KRAFT(p,i,X)),tmp_f_max2);
+      tmp_f_max2 = MAX(SQR(KRAFT(p,i,Y)),tmp_f_max2);
+#ifndef TWOD
+      tmp_f_max2 = MAX(SQR(KRAFT(p,i,Z)),tmp_f_max2);
+#endif
+#endif
+#ifdef EINSTEIN
+      omega_E += SPRODN(KRAFT,p,i,KRAFT,p,i) / MASSE(p,i);
+#endif
+
+      /* friction, random and systematic force in one update */
+      imd_gauss4(NUMMER(p,i), steps, RNG_LANGEVIN, 0, g);
+      tmp = noise * SQRT( MASSE(p,i) );
+      IMPULS(p,i,X) = (IMPULS(p,i,X) * reibung + timestep * KRAFT(p,i,X)
+                       + tmp * g[0]) * eins_d_reib * rest->x;
+      IMPULS(p,i,Y) = (IMPULS(p,i,Y) * reibung + timestep * KRAFT(p,i,Y)
+                       + tmp * g[1]) * eins_d_reib * rest->y;
+#ifndef TWOD
+      IMPULS(p,i,Z) = (IMPULS(p,i,Z) * reibung + timestep * KRAFT(p,i,Z)
+                       + tmp * g[2]) * eins_d_reib * rest->z;
+#endif
+
+      /* twice the new kinetic energy */
+      E_kin_2 += SPRODN(IMPULS,p,i,IMPULS,p,i) / MASSE(p,i);
+
+      /* new positions */
+      tmp = timestep / MASSE(p,i);
+      ORT(p,i,X) += tmp * IMPULS(p,i,X);
+      ORT(p,i,Y) += tmp * IMPULS(p,i,Y);
+#ifndef TWOD
+      ORT(p,i,Z) += tmp * IMPULS(p,i,Z);
+#endif
+
+#ifdef STRESS_TENS
+      if (do_press_calc) {
+        PRESSTENS(p,i,xx) += IMPULS(p,i,X) * IMPULS(p,i,X) / MASSE(p,i);
+        PRESSTENS(p,i,yy) += IMPULS(p,i,Y) * IMPULS(p,i,Y) / MASSE(p,i);
+#ifndef TWOD
+        PRESSTENS(p,i,zz) += IMPULS(p,i,Z) * IMPULS(p,i,Z) / MASSE(p,i);
+        PRESSTENS(p,i,yz) += IMPULS(p,i,Y) * IMPULS(p,i,Z) / MASSE(p,i);
+        PRESSTENS(p,i,zx) += IMPULS(p,i,Z) * IMPULS(p,i,X) / MASSE(p,i);
+#endif
+        PRESSTENS(p,i,xy) += IMPULS(p,i,X) * IMPULS(p,i,Y) / MASSE(p,i);
+      }
+#endif
+    }
+  }
+
+  tot_kin_energy = ( E_kin_1 + E_kin_2 ) / 4.0;
+
+#ifdef MPI
+  /* add up results from different CPUs */
+  tmpvec1[0] = tot_kin_energy;
+  tmpvec1[1] = fnorm;
+  tmpvec1[2] = omega_E;
+
+  MPI_Allreduce( tmpvec1, tmpvec2, 3, REAL, MPI_SUM, cpugrid);
+
+  tot_kin_energy = tmpvec2[0];
+  fnorm          = tmpvec2[1];
+  omega_E        = tmpvec2[2];
+#ifdef FNORM
+  MPI_Allreduce( &tmp_f_max2, &f_max2, 1, REAL, MPI_MAX, cpugrid);
+#endif
+#elif defined(FNORM)
+  f_max2 = tmp_f_max2;
+#endif
+}
+
+#else
+
+void move_atoms_langevin(void) 
+{
+  if (myid==0)
+  error("the chosen ensemble LANGEVIN is not supported by this binary");
+}
+
+#endif
+
+
 /*****************************************************************************
 *
 * NVT Integrator with Nose Hoover Thermostat and some shearing (?)
@@ -2191,30 +2532,42 @@ void move_atoms_frac(void)
 void move_atoms_ftg(void)
 
 {
-  int j, k;
+  int j, k, t, nthreads = 1;
    real tmp_f_max2=0.0;
   static real *E_kin_1     = NULL; static real *E_kin_2     = NULL;
   static real *ftgtmpvec1  = NULL; static real *ftgtmpvec2  = NULL;
   static int  *iftgtmpvec1 = NULL; static int  *iftgtmpvec2 = NULL;
+  /* per thread: degrees of freedom, last local gamma of each slice */
+  static int  *ninslice_t  = NULL;
+  static real *gamma_t     = NULL; static int  *igamma_t    = NULL;
 
-  real tmp,tmp1,tmp2;
+#ifdef MPI
+  real tmp1,tmp2;
+#endif
   real ttt;
-  real reibung, reibung_y, eins_d_reib, eins_d_reib_y;
-  real epsilontmp, eins_d_epsilontmp;
-  int slice;
-  real gamma_tmp;
+
+#ifdef _OPENMP
+  nthreads = omp_get_max_threads();
+#endif
 
   /* alloc vector versions of E_kin and  ftgtmpvect*/
   if (NULL==E_kin_1) {
-    E_kin_1=(real*) malloc(nslices*sizeof(real));
+    E_kin_1=(real*) malloc(nthreads*nslices*sizeof(real));
     if (NULL==E_kin_1) 
       error("Cannot allocate memory for E_kin_1 vector\n");
   }
   if (NULL==E_kin_2) {
-    E_kin_2=(real*) malloc(nslices*sizeof(real));
+    E_kin_2=(real*) malloc(nthreads*nslices*sizeof(real));
     if (NULL==E_kin_2) 
       error("Cannot allocate memory for E_kin_2 vector\n");
   }
+  if (NULL==ninslice_t) {
+    ninslice_t=(int*) malloc(nthreads*nslices*sizeof(int));
+    gamma_t   =(real*)malloc(nthreads*nslices*sizeof(real));
+    igamma_t  =(int*) malloc(nthreads*nslices*sizeof(int));
+    if ((NULL==ninslice_t) || (NULL==gamma_t) || (NULL==igamma_t))
+      error("Cannot allocate memory for FTG thread buffers\n");
+  }
   if (NULL==ftgtmpvec1) {
     ftgtmpvec1=(real*) malloc(nslices*sizeof(real));
     if (NULL==ftgtmpvec1) 
@@ -2236,10 +2589,11 @@ void move_atoms_ftg(void)
       error("Cannot allocate memory for iftgtmpvec2 vector\n");
   }
 
-  for (j=0; j<nslices; j++) {
+  for (j=0; j<nthreads*nslices; j++) {
     *(E_kin_1   +j) = 0.0;
     *(E_kin_2   +j) = 0.0;
-    *(ninslice  +j) = 0;
+    *(ninslice_t+j) = 0;
+    *(igamma_t  +j) = 0;
   }
 
   fnorm = 0.0;
@@ -2247,13 +2601,23 @@ void move_atoms_ftg(void)
   if(expansionmode==1)
       dotepsilon = dotepsilon0 / (1.0 + dotepsilon0 * steps * timestep);
       
-  /* loop over all cells */
+  /* loop over all cells; static schedule keeps the cells of each
+     thread in order, so the local gammas are merged as in serial */
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) reduction(+:fnorm) reduction(max:tmp_f_max2)
+#endif
   for (k=0; k<NCELLS; ++k) {
 
-    int i, j, sort;
+    int i, j, sort, slice, off = 0;
     cell *p;
+    real tmp, nfree, temp_at, gamma_tmp, gam;
+    real reibung, reibung_y, eins_d_reib, eins_d_reib_y;
+    real epsilontmp, eins_d_epsilontmp;
 
     p = CELLPTR(k);
+#ifdef _OPENMP
+    off = nslices * omp_get_thread_num();
+#endif
 
 #ifdef CLONE
     for (i=0; i<p->n; i+=nclones)
@@ -2281,27 +2645,28 @@ void move_atoms_ftg(void)
       slice = (int) (nslices *tmp);
       if (slice<0)        slice = 0;
       if (slice>=nslices) slice = nslices-1;;      
+      gam = *(gamma_ftg+slice);
      
       /* if half axis in y-direction is given: local viscous damping !!! */
       if(stadium.y != 0.0){ 
 
 	/* calc desired temperature */
-	temperature = Tleft + (Tright-Tleft) * (nslices*tmp - nslices_Left)
+	temp_at = Tleft + (Tright-Tleft) * (nslices*tmp - nslices_Left)
 	  /(nslices - nslices_Left - nslices_Right);
-	if (temperature < Tleft ) temperature = Tleft;
-	if (temperature > Tright) temperature = Tright;
+	if (temp_at < Tleft ) temp_at = Tleft;
+	if (temp_at > Tright) temp_at = Tright;
 	
 	/* calc kinetic "temperature" for actual atom */
 	tmp  = SPRODN(IMPULS,p,i,IMPULS,p,i) / MASSE(p,i);
 #ifdef TWOD
-	tmp2 = ( (restrictions + sort)->x + 
-		 (restrictions + sort)->y   );
+	nfree = ( (restrictions + sort)->x + 
+		  (restrictions + sort)->y   );
 #else
-	tmp2 = ( (restrictions + sort)->x + 
-		 (restrictions + sort)->y +  
-		 (restrictions + sort)->z  );
+	nfree = ( (restrictions + sort)->x + 
+		  (restrictions + sort)->y +  
+		  (restrictions + sort)->z  );
 #endif
-	if(tmp2!=0) tmp /= (real)tmp2;
+	if(nfree!=0) tmp /= nfree;
 	
 	/* calc damping factor form position */
 	gamma_tmp = (FABS(ORT(p,i,Y)-center.y) - stadium.y)/
@@ -2313,24 +2678,26 @@ void move_atoms_ftg(void)
 	gamma_tmp = .5 * (1 + sin(-M_PI/2.0 + M_PI*gamma_tmp));
 	
 	/* to share the code with the non local version we overwrite 
-	 the gamma values every timestep */
-	*(gamma_ftg+slice)  = (gamma_min + gamma_bar * gamma_tmp) 
-	  * (tmp-temperature) 
-	  / sqrt(SQR(tmp) + SQR(temperature/delta_ftg));     
+	 the gamma values every timestep (after the loop) */
+	gam = (gamma_min + gamma_bar * gamma_tmp) 
+	  * (tmp-temp_at) 
+	  / sqrt(SQR(tmp) + SQR(temp_at/delta_ftg));     
+	*(gamma_t  + off + slice) = gam;
+	*(igamma_t + off + slice) = 1;
       } 
 
       /* add up degrees of freedom  considering restriction vector  */
 #ifdef TWOD
-      *(ninslice + slice) += ( (restrictions + sort)->x + 
-			       (restrictions + sort)->y   );
+      *(ninslice_t + off + slice) += ( (restrictions + sort)->x + 
+			               (restrictions + sort)->y   );
 #else
-      *(ninslice + slice) += ( (restrictions + sort)->x + 
-			       (restrictions + sort)->y +  
-			       (restrictions + sort)->z  );
+      *(ninslice_t + off + slice) += ( (restrictions + sort)->x + 
+			               (restrictions + sort)->y +  
+			               (restrictions + sort)->z  );
 #endif
       
       /* twice the old kinetic energy */
-      *(E_kin_1 + slice) += SPRODN(IMPULS,p,i,IMPULS,p,i) / MASSE(p,i);
+      *(E_kin_1 + off + slice) += SPRODN(IMPULS,p,i,IMPULS,p,i) / MASSE(p,i);
 
 #ifdef FBC
         /* give virtual particles their extra force */
@@ -2357,12 +2724,10 @@ void move_atoms_ftg(void)
 #endif
 #endif
 
-	reibung       =        1.0 -  *(gamma_ftg + slice) * timestep / 2.0;
-	eins_d_reib   = 1.0 / (1.0 +  *(gamma_ftg + slice) * timestep / 2.0);
-	reibung_y     =        1.0 - (*(gamma_ftg + slice) + dotepsilon) * 
-	                        timestep / 2.0;
-	eins_d_reib_y = 1.0 / (1.0 + (*(gamma_ftg + slice) + dotepsilon) * 
-			        timestep / 2.0);
+	reibung       =        1.0 -  gam * timestep / 2.0;
+	eins_d_reib   = 1.0 / (1.0 +  gam * timestep / 2.0);
+	reibung_y     =        1.0 - (gam + dotepsilon) * timestep / 2.0;
+	eins_d_reib_y = 1.0 / (1.0 + (gam + dotepsilon) * timestep / 2.0);
 	
         /* new momenta */
 	IMPULS(p,i,X) = (IMPULS(p,i,X)  * reibung   + timestep * KRAFT(p,i,X))
@@ -2375,7 +2740,7 @@ void move_atoms_ftg(void)
 #endif                  
 
 	/* twice the new kinetic energy */ 
-	*(E_kin_2 + slice) +=  SPRODN(IMPULS,p,i,IMPULS,p,i) / MASSE(p,i);
+	*(E_kin_2 + off + slice) +=  SPRODN(IMPULS,p,i,IMPULS,p,i) / MASSE(p,i);
 	
 	/* new positions */
         tmp = timestep / MASSE(p,i);
@@ -2405,6 +2770,20 @@ void move_atoms_ftg(void)
     }
   }
 
+  /* merge the thread buffers; the last local gamma wins, as in serial */
+  for (j=0; j<nslices; j++) {
+    *(ninslice + j) = 0;
+    for (t=0; t<nthreads; t++) {
+      if (t > 0) {
+        *(E_kin_1 + j) += *(E_kin_1 + t*nslices + j);
+        *(E_kin_2 + j) += *(E_kin_2 + t*nslices + j);
+      }
+      *(ninslice + j) += *(ninslice_t + t*nslices + j);
+      if (*(igamma_t + t*nslices + j))
+        *(gamma_ftg + j) = *(gamma_t + t*nslices + j);
+    }
+  }
+
   tot_kin_energy = 0.0; 
   for (j=0; j<nslices; j++){
     tot_kin_energy += ( *(E_kin_1 + j) + *(E_kin_2 + j)) / 4.0;
@@ -2492,20 +2871,23 @@ void move_atoms_finnis(void)
 {
   int j, k;
 
-  real E_kin_1, E_kin_2;
-  real tmp, tmp1, tmp2;
-  real ttt;
-  real temperature_at;
-  real zeta_finnis;
+  real E_kin_1 = 0.0, E_kin_2 = 0.0;
+#ifdef MPI
+  real tmp1, tmp2;
+#endif
   real tmp_f_max2=0.0;
   fnorm = 0.0;
 
   /* loop over all cells */
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:E_kin_1,E_kin_2,fnorm) reduction(max:tmp_f_max2)
+#endif
   for (k=0; k<NCELLS; ++k) {
 
     int i, j, sort;
     vektor *rest;
     cell *p;
+    real tmp, nfree, temperature_at, zeta_finnis;
 
     p = CELLPTR(k);
 
@@ -2534,13 +2916,13 @@ void move_atoms_finnis(void)
       /* calc kinetic "temperature" for actual atom */
       tmp  = SPRODN(IMPULS,p,i,IMPULS,p,i) / MASSE(p,i);
 #ifdef TWOD
-      tmp2 = rest->x + rest->y;
+      nfree = rest->x + rest->y;
 #else
-      tmp2 = rest->x + rest->y + rest->z;
+      nfree = rest->x + rest->y + rest->z;
 #endif
-      if (tmp2 != 0) tmp /= tmp2;
+      if (nfree != 0) tmp /= nfree;
       /* to account for restricted mobilities and to avoid singularities */
-      temperature_at = (tmp2 !=0) ? (tmp2/3.0 * temperature) : (1e-10); 
+      temperature_at = (nfree !=0) ? (nfree/3.0 * temperature) : (1e-10); 
 
       /* to share the code with the non local version we overwrite 
 	 the zeta values every timestep */
@@ -2618,6 +3000,14 @@ void move_atoms_finnis(void)
   tmp1 = tot_kin_energy;
   MPI_Allreduce( &tmp1, &tmp2, 1, REAL, MPI_SUM, cpugrid);
   tot_kin_energy = tmp2;
+#ifdef FNORM
+  tmp1 = fnorm;
+  MPI_Allreduce( &tmp1, &tmp2, 1, REAL, MPI_SUM, cpugrid);
+  fnorm = tmp2;
+  MPI_Allreduce( &tmp_f_max2, &f_max2, 1, REAL, MPI_MAX, cpugrid);
+#endif
+#elif defined(FNORM)
+  f_max2 = tmp_f_max2;
 #endif
 
 }
@@ -2646,22 +3036,24 @@ void move_atoms_stm(void)
   int k;
   real tmp_f_max2=0.0;
   /* we handle 2 ensembles ensindex = 0 -> NVT ;ensindex = 1 -> NVE */
-  int ensindex = 0;
   real kin_energie_1[2] = {0.0,0.0}, kin_energie_2[2] = {0.0,0.0};
+  /* scalar copies of the above, as OpenMP reduces only scalars */
+  real E_kin_1_nvt = 0.0, E_kin_1_nve = 0.0;
+  real E_kin_2_nvt = 0.0, E_kin_2_nve = 0.0;
+  int  n_stad = 0;
   real tmpvec1[5], tmpvec2[5], ttt;
-  n_stadium = 0;
 
   /* loop over all atoms */
 #ifdef _OPENMP
-#pragma omp parallel for reduction(+:kin_energie_1[0],kin_energie_1[1],kin_energie_2[0],kin_energie_2[2],n_stadium)
+#pragma omp parallel for reduction(+:E_kin_1_nvt,E_kin_1_nve,E_kin_2_nvt,E_kin_2_nve,n_stad)
 #endif
   for (k=0; k<NCELLS; ++k) {
 
     int i;
     cell *p;
     real reibung, eins_d_reib;
-    real tmp;
-    vektor d;
+    real tmp, ekin;
+    int ensindex = 0;
     int sort=0;
 
     p = CELLPTR(k);
@@ -2675,7 +3067,7 @@ void move_atoms_stm(void)
           /* We are inside the ellipse: */
           reibung = 1.0;
           eins_d_reib = 1.0;
-	  n_stadium += DIM;
+	  n_stad += DIM;
 	  ensindex = 1;
         } else {
           reibung     =      1 - eta * timestep / 2.0;
@@ -2684,7 +3076,8 @@ void move_atoms_stm(void)
         }
 
         /* twice the old kinetic energy */
-        kin_energie_1[ensindex] += SPRODN(IMPULS,p,i,IMPULS,p,i) / MASSE(p,i);
+        ekin = SPRODN(IMPULS,p,i,IMPULS,p,i) / MASSE(p,i);
+        if (ensindex) E_kin_1_nve += ekin; else E_kin_1_nvt += ekin;
 
         /* new momenta */
 	sort = VSORTE(p,i);
@@ -2694,7 +3087,8 @@ void move_atoms_stm(void)
                           * eins_d_reib * (restrictions + sort)->y;
 
         /* twice the new kinetic energy */ 
-        kin_energie_2[ensindex] += SPRODN(IMPULS,p,i,IMPULS,p,i) / MASSE(p,i);
+        ekin = SPRODN(IMPULS,p,i,IMPULS,p,i) / MASSE(p,i);
+        if (ensindex) E_kin_2_nve += ekin; else E_kin_2_nvt += ekin;
 
         /* new positions */
         tmp = timestep * MASSE(p,i);
@@ -2702,6 +3096,9 @@ void move_atoms_stm(void)
         ORT(p,i,Y) += tmp * IMPULS(p,i,Y);
     }
   }
+  kin_energie_1[0] = E_kin_1_nvt;  kin_energie_1[1] = E_kin_1_nve;
+  kin_energie_2[0] = E_kin_2_nvt;  kin_energie_2[1] = E_kin_2_nve;
+  n_stadium        = n_stad;
   
   tot_kin_energy  = (kin_energie_1[0] + kin_energie_2[0]) / 4.0;
   E_kin_stadium   = (kin_energie_1[1] + kin_energie_2[1]) / 4.0;
@@ -2747,22 +3144,23 @@ void move_atoms_stm(void)
 void move_atoms_nvx(void)
 
 {
-  int  k, num, nhalf;  
-  real Ekin_1, Ekin_2, Ekin_right, Ekin_left, delta_E, Evec1[3], Evec2[3];
-  real scale, xx, rescale_left, rescale_right;
-
-  Evec1[0] = 0.0;
-  Evec1[1] = 0.0;
-  Evec1[2] = 0.0;
+  int  k, nhalf;  
+  real Ekin_right, Ekin_left, delta_E, Evec1[3], Evec2[3];
+  real scale, rescale_left, rescale_right;
+  real Ekin = 0.0, Ekin_l = 0.0, Ekin_r = 0.0;
 
   nhalf   = hc_nlayers / 2;
   scale   = hc_nlayers / box_x.x;
   delta_E = hc_heatcurr * 2 * box_y.y * box_z.z * timestep;
 
   /* loop over all atoms */
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:Ekin,Ekin_l,Ekin_r)
+#endif
   for (k=0; k<NCELLS; ++k) {
 
-    int i;
+    int  i, num;
+    real Ekin_1, Ekin_2, xx;
     cell *p = CELLPTR(k);
 
     for (i=0; i<p->n; ++i) {
@@ -2786,17 +3184,20 @@ void move_atoms_nvx(void)
 #ifndef TWOD
       ORT(p,i,Z) += timestep * IMPULS(p,i,Z) / MASSE(p,i);
 #endif
-      Evec1[0] += (Ekin_1 + Ekin_2) / 4.0;
+      Ekin += (Ekin_1 + Ekin_2) / 4.0;
 
       /* kinetic energy of layers 0 and nhalf */
       xx = ORT(p,i,X);
       if (xx<0.0) xx += box_x.x;
       num = (int) (scale * xx);
       if      (num >= hc_nlayers) num -= hc_nlayers;
-      if      (num == 0    ) Evec1[1] += Ekin_2;
-      else if (num == nhalf) Evec1[2] += Ekin_2;
+      if      (num == 0    ) Ekin_l += Ekin_2;
+      else if (num == nhalf) Ekin_r += Ekin_2;
     }
   }
+  Evec1[0] = Ekin;
+  Evec1[1] = Ekin_l;
+  Evec1[2] = Ekin_r;
 
 #ifdef MPI
   /* Add up results from all cpus */
@@ -2815,9 +3216,13 @@ void move_atoms_nvx(void)
   rescale_right = SQRT( 1.0 + delta_E / Ekin_right );
 
   /* rescale the momenta */
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
   for (k=0; k<NCELLS; ++k) {
 
-    int i;
+    int  i, num;
+    real xx;
     cell *p = CELLPTR(k);
 
     for (i=0; i<p->n; ++i) {
@@ -2871,6 +3276,9 @@ void move_atoms_cg(real alpha)
   real tmpvec1[1], tmpvec2[1];
   /* loop over all cells */
   xnorm=0;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:xnorm) reduction(max:tmp_x_max2)
+#endif
   for (k=0; k<NCELLS; ++k) {
 
     int  i, j, sort;
@@ -2950,6 +3358,9 @@ void move_atoms_sd(real alpha)
   real tmpvec1[1], tmpvec2[1];
   /* loop over all cells */
   xnorm=0;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:xnorm) reduction(max:tmp_x_max2)
+#endif
   for (k=0; k<NCELLS; ++k) {
 
     int  i, j, sort;
@@ -603,7 +603,7 @@ void write_atoms_ada(FILE *out) {
 					 first entry = 0 -> no more data,
 					 first entry = 1 -> Line-sense vector + Burgers vector*/
 					nyeTensorInfo *info = NYE(p,i);
-					if (info != NULL){
+					if (info->valid){
 						data[n++].i	= 1;
 						data[n++].f = (float) info->ls[0];
 						data[n++].f = (float) info->ls[1];
@@ -624,7 +624,7 @@ void write_atoms_ada(FILE *out) {
 							ORT(p,i,Z), ADATYPE(p,i));
 #ifdef NYETENSOR
 					nyeTensorInfo *info = NYE(p,i);
-					if (info != NULL) {
+					if (info->valid) {
 						len += sprintf(outbuf + len,
 							" 1 %12f %12f %12f %12f %12f %12f",
 							info->ls[0], info->ls[1], info->ls[2],
@@ -646,6 +646,82 @@ void write_atoms_ada(FILE *out) {
 
 #endif /* ADA*/
 
+#ifdef PTM
+
+/******************************************************************************
+*
+*  writes header for ptm-file
+*
+******************************************************************************/
+
+void write_header_ptm(FILE *out)
+{
+  char c;
+
+  /* format line */
+  if (binary_output)
+    c = is_big_endian ? 'b' : 'l';
+  else
+    c = 'A';
+  fprintf(out, "#F %c 1 1 0 3 0 %d\n", c, PTM_NDAT + 1);
+
+  /* contents line */
+  fprintf(out, "#C number type x y z ptm_type rmsd qw qx qy qz "
+               "eps_xx eps_yy eps_zz eps_yz eps_zx eps_xy\n");
+
+  /* box lines */
+  fprintf(out, "#X \t%.16e %.16e %.16e\n", box_x.x, box_x.y, box_x.z);
+  fprintf(out, "#Y \t%.16e %.16e %.16e\n", box_y.x, box_y.y, box_y.z);
+  fprintf(out, "#Z \t%.16e %.16e %.16e\n", box_z.x, box_z.y, box_z.z);
+
+  /* endheader line */
+  fprintf(out, "#E\n");
+}
+
+/******************************************************************************
+*
+*  writes data for ptm-file
+*
+******************************************************************************/
+
+void write_atoms_ptm(FILE *out)
+{
+  int i, j, k, n, len = 0;
+  i_or_f *data;
+
+  for (k=0; k<NCELLS; k++) {
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; i++) {
+      if (binary_output) {
+        n = 0;
+        data = (i_or_f *) (outbuf + len);
+        data[n++].i = (int)   NUMMER(p,i);
+        data[n++].i = (int)   VSORTE(p,i);
+        data[n++].f = (float) ORT(p,i,X);
+        data[n++].f = (float) ORT(p,i,Y);
+        data[n++].f = (float) ORT(p,i,Z);
+        data[n++].i = (int)   PTM_TYPE(p,i);
+        for (j=0; j<PTM_NDAT; j++)
+          data[n++].f = (float) PTM_DAT(p,i,j);
+        len += n * sizeof(i_or_f);
+      }
+      else {
+        len += sprintf(outbuf+len, "%d %d %12f %12f %12f %d",
+          NUMMER(p,i), VSORTE(p,i), ORT(p,i,X), ORT(p,i,Y), ORT(p,i,Z),
+          PTM_TYPE(p,i));
+        for (j=0; j<PTM_NDAT; j++)
+          len += sprintf(outbuf+len, " %e", PTM_DAT(p,i,j));
+        len += sprintf(outbuf+len, "\n");
+      }
+      /* flush or send outbuf if it is full */
+      if (len > outbuf_size - 512) flush_outbuf(out,&len,OUTBUF_TAG);
+    }
+  }
+  flush_outbuf(out,&len,OUTBUF_TAG+1);
+}
+
+#endif /* PTM */
+
 #ifdef EFILTER
 
 /******************************************************************************
@@ -2790,7 +2866,7 @@ void write_fext_header()
 
   
 #ifdef RELAX
-    if ( ((ensemble==ENS_MIK) || (ensemble==ENS_GLOK) || (ensemble==ENS_CG)) &&
+    if ( IS_RELAX_ENS(ensemble) &&
          (ep_max_int > 0) ) {
       fprintf(out, "#C steps");
     } else
@@ -2883,7 +2959,7 @@ void write_fext(int steps)
         error_str("Cannot open indenter file %s", fname);
     }
 #ifdef RELAX
-    if ( ((ensemble==ENS_MIK) || (ensemble==ENS_GLOK) || (ensemble==ENS_CG)) &&
+    if ( IS_RELAX_ENS(ensemble) &&
          (ep_max_int > 0) ) {
       fprintf(ind_file, "%e ", (double) (steps));
     } else
@@ -3629,100 +3705,288 @@ void write_nmoldyn(int step)
 *
 *  dynamical structure factor
 *
+*  The density Fourier components rho(k,t) along each k-point series are
+*  computed with recursive phase factors, vectorized over the atoms of a
+*  cell. They are written as raw stream (.dsf) and, if dsf_nt > 0,
+*  transformed in situ: each window of dsf_nt samples is Fourier
+*  transformed in time (Hann window), and |rho(k,w)|^2 is averaged over
+*  the windows into S(k,w) (.skw).
+*
 ******************************************************************************/
 
-void write_dsf()
+static int          dsf_nktot = 0;     /* total number of k-points */
+static int          *dsf_koff;         /* first k-point of each series */
+static vektor       *dsf_k0v, *dsf_kdirv;
+static double       *dsf_acc = NULL;   /* rho(k), per thread */
+static double       **dsf_scr;         /* scratch per thread */
+static int          *dsf_scrlen;
+static int          dsf_nwin = 0;      /* number of completed windows */
+static fftw_complex *dsf_win, *dsf_fft;
+static double       *dsf_skw;
+static fftw_plan    dsf_plan;
+
+/******************************************************************************
+*
+*  initialize k-points, buffers and time FFT
+*
+******************************************************************************/
+
+static void init_dsf(void)
 {
-  int    i, j, k, n;
+  int    i, nthreads = 1;
   double wtot = 0.0, twopi = 2*M_PI;
-  static int    *koff = NULL, count = 0, nk;
-  static double *data = NULL, *data2 = NULL;
-  static vektor *k0   = NULL, *kdir  = NULL;
 
-  /* allocate data arrays, and initialize data */
-  if (NULL==data) {
-    koff = (int    *) malloc( dsf_nk * sizeof(int)    );
-    kdir = (vektor *) malloc( dsf_nk * sizeof(vektor) );
-    k0   = (vektor *) malloc( dsf_nk * sizeof(vektor) );
-    if ((NULL==koff) || (NULL==kdir) || (NULL==k0))
-      error("cannot allocate dsf arrays");
-    nk = 0;
-    for (i=0; i<dsf_nk; i++) {
-      koff[i] = nk;
-      nk += dsf_kmax[i] + 1;
+#ifdef _OPENMP
+  nthreads = omp_get_max_threads();
+#endif
+  dsf_koff   = (int    *) malloc( dsf_nk * sizeof(int)    );
+  dsf_kdirv  = (vektor *) malloc( dsf_nk * sizeof(vektor) );
+  dsf_k0v    = (vektor *) malloc( dsf_nk * sizeof(vektor) );
+  dsf_scr    = (double **) calloc( nthreads, sizeof(double *) );
+  dsf_scrlen = (int    *) calloc( nthreads, sizeof(int)    );
+  if ((NULL==dsf_koff) || (NULL==dsf_kdirv) || (NULL==dsf_k0v) ||
+      (NULL==dsf_scr)  || (NULL==dsf_scrlen))
+    error("cannot allocate dsf arrays");
+  dsf_nktot = 0;
+  for (i=0; i<dsf_nk; i++) {
+    dsf_koff[i] = dsf_nktot;
+    dsf_nktot += dsf_kmax[i] + 1;
 #ifdef TWOD
-      k0  [i].x = (dsf_k0  [2*i]*tbox_x.x + dsf_k0  [2*i+1]*tbox_y.x)*twopi;
-      k0  [i].y = (dsf_k0  [2*i]*tbox_x.y + dsf_k0  [2*i+1]*tbox_y.y)*twopi;
-      kdir[i].x = (dsf_kdir[2*i]*tbox_x.x + dsf_kdir[2*i+1]*tbox_y.x)*twopi;
-      kdir[i].y = (dsf_kdir[2*i]*tbox_x.y + dsf_kdir[2*i+1]*tbox_y.y)*twopi;
-#else
-      k0  [i].x = (dsf_k0  [3*i  ] * tbox_x.x + dsf_k0  [3*i+1] * tbox_y.x +
-                   dsf_k0  [3*i+2] * tbox_z.x) * twopi;
-      k0  [i].y = (dsf_k0  [3*i  ] * tbox_x.y + dsf_k0  [3*i+1] * tbox_y.y +
-                   dsf_k0  [3*i+2] * tbox_z.y) * twopi;
-      k0  [i].z = (dsf_k0  [3*i  ] * tbox_x.z + dsf_k0  [3*i+1] * tbox_y.z +
-                   dsf_k0  [3*i+2] * tbox_z.z) * twopi;
-      kdir[i].x = (dsf_kdir[3*i  ] * tbox_x.x + dsf_kdir[3*i+1] * tbox_y.x +
-                   dsf_kdir[3*i+2] * tbox_z.x) * twopi;
-      kdir[i].y = (dsf_kdir[3*i  ] * tbox_x.y + dsf_kdir[3*i+1] * tbox_y.y +
-                   dsf_kdir[3*i+2] * tbox_z.y) * twopi;
-      kdir[i].z = (dsf_kdir[3*i  ] * tbox_x.z + dsf_kdir[3*i+1] * tbox_y.z +
-                   dsf_kdir[3*i+2] * tbox_z.z) * twopi;
+    dsf_k0v  [i].x = (dsf_k0  [2*i]*tbox_x.x + dsf_k0  [2*i+1]*tbox_y.x)*twopi;
+    dsf_k0v  [i].y = (dsf_k0  [2*i]*tbox_x.y + dsf_k0  [2*i+1]*tbox_y.y)*twopi;
+    dsf_kdirv[i].x = (dsf_kdir[2*i]*tbox_x.x + dsf_kdir[2*i+1]*tbox_y.x)*twopi;
+    dsf_kdirv[i].y = (dsf_kdir[2*i]*tbox_x.y + dsf_kdir[2*i+1]*tbox_y.y)*twopi;
+#else
+    dsf_k0v  [i].x = (dsf_k0  [3*i  ] * tbox_x.x + dsf_k0  [3*i+1] * tbox_y.x +
+                      dsf_k0  [3*i+2] * tbox_z.x) * twopi;
+    dsf_k0v  [i].y = (dsf_k0  [3*i  ] * tbox_x.y + dsf_k0  [3*i+1] * tbox_y.y +
+                      dsf_k0  [3*i+2] * tbox_z.y) * twopi;
+    dsf_k0v  [i].z = (dsf_k0  [3*i  ] * tbox_x.z + dsf_k0  [3*i+1] * tbox_y.z +
+                      dsf_k0  [3*i+2] * tbox_z.z) * twopi;
+    dsf_kdirv[i].x = (dsf_kdir[3*i  ] * tbox_x.x + dsf_kdir[3*i+1] * tbox_y.x +
+                      dsf_kdir[3*i+2] * tbox_z.x) * twopi;
+    dsf_kdirv[i].y = (dsf_kdir[3*i  ] * tbox_x.y + dsf_kdir[3*i+1] * tbox_y.y +
+                      dsf_kdir[3*i+2] * tbox_z.y) * twopi;
+    dsf_kdirv[i].z = (dsf_kdir[3*i  ] * tbox_x.z + dsf_kdir[3*i+1] * tbox_y.z +
+                      dsf_kdir[3*i+2] * tbox_z.z) * twopi;
+#endif
+  }
+  dsf_acc = (double *) calloc( 2 * dsf_nktot * nthreads, sizeof(double) );
+  if (NULL==dsf_acc) error("cannot allocate dsf array");
+
+  /* normalize weights */
+  for (i=0; i<ntypes; i++) wtot += num_sort[i] * dsf_weight[i];
+  for (i=0; i<ntypes; i++) dsf_weight[i] /= wtot;
+
+  /* time windows are transformed on CPU 0, all k-points in one batch */
+  if ((0==myid) && (dsf_nt > 0)) {
+    dsf_win = (fftw_complex *) fftw_malloc( dsf_nktot * dsf_nt *
+                                            sizeof(fftw_complex) );
+    dsf_fft = (fftw_complex *) fftw_malloc( dsf_nktot * dsf_nt *
+                                            sizeof(fftw_complex) );
+    dsf_skw = (double *) calloc( dsf_nktot * dsf_nt, sizeof(double) );
+    if ((NULL==dsf_win) || (NULL==dsf_fft) || (NULL==dsf_skw))
+      error("cannot allocate dsf window");
+    dsf_plan = fftw_plan_many_dft(1, &dsf_nt, dsf_nktot,
+                                  dsf_win, NULL, 1, dsf_nt,
+                                  dsf_fft, NULL, 1, dsf_nt,
+                                  FFTW_FORWARD, FFTW_ESTIMATE);
+  }
+}
+
+/******************************************************************************
+*
+*  compute rho(k) of the local atoms; the sum over the atoms of a cell is
+*  the innermost loop, so that it can be vectorized
+*
+******************************************************************************/
+
+static void make_dsf(double *data)
+{
+  int k, t, nthreads = 1;
+
+#ifdef _OPENMP
+  nthreads = omp_get_max_threads();
 #endif
+  for (k=0; k<2*dsf_nktot*nthreads; k++) dsf_acc[k] = 0.0;
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (k=0; k<NCELLS; k++) {
+    cell   *p = CELLPTR(k);
+    int    i, j, n, tid = 0;
+    double *acc = dsf_acc;
+    double *co, *si, *co1, *si1;
+#ifdef _OPENMP
+    tid  = omp_get_thread_num();
+    acc += 2 * dsf_nktot * tid;
+#endif
+    if (dsf_scrlen[tid] < p->n) {
+      dsf_scrlen[tid] = p->n;
+      dsf_scr[tid] = (double *) realloc( dsf_scr[tid], 4*p->n*sizeof(double) );
+      if (NULL==dsf_scr[tid]) error("cannot allocate dsf scratch");
     }
-    data  = (double *) malloc( 2 * nk * sizeof(real) );
+    co  = dsf_scr[tid];
+    si  = co + p->n;
+    co1 = si + p->n;
+    si1 = co1 + p->n;
+    for (n=0; n<dsf_nk; n++) {
+      double *d = acc + 2 * dsf_koff[n];
+      for (i=0; i<p->n; i++) {
+        double x = SPRODX(ORT,p,i,dsf_k0v  [n]);
+        double y = SPRODX(ORT,p,i,dsf_kdirv[n]);
+        double w = dsf_weight[SORTE(p,i)];
+        co [i] = cos(x) * w;  co1[i] = cos(y);
+        si [i] = sin(x) * w;  si1[i] = sin(y);
+      }
+      for (j=0; j<=dsf_kmax[n]; j++) {
+        double re = 0.0, im = 0.0;
+#ifdef _OPENMP
+#pragma omp simd reduction(+:re,im)
+#endif
+        for (i=0; i<p->n; i++) {
+          double tt = co[i] * co1[i] - si[i] * si1[i];
+          re += co[i];
+          im += si[i];
+          si[i] = co[i] * si1[i] + si[i] * co1[i];
+          co[i] = tt;
+        }
+        d[2*j  ] += re;
+        d[2*j+1] += im;
+      }
+    }
+  }
+
+  /* add up the sums of the threads */
+  for (k=0; k<2*dsf_nktot; k++) {
+    data[k] = dsf_acc[k];
+    for (t=1; t<nthreads; t++) data[k] += dsf_acc[2*dsf_nktot*t+k];
+  }
+}
+
+/******************************************************************************
+*
+*  add a sample of rho(k) to the time window, transform complete windows
+*
+******************************************************************************/
+
+static void update_skw(double *data)
+{
+  static int nt = 0;
+  int    k, t;
+  double w2 = 0.0, fac;
+
+  for (k=0; k<dsf_nktot; k++) {
+    dsf_win[k*dsf_nt+nt][0] = data[2*k  ];
+    dsf_win[k*dsf_nt+nt][1] = data[2*k+1];
+  }
+  if (++nt < dsf_nt) return;
+  nt = 0;
+
+  /* Hann window */
+  for (t=0; t<dsf_nt; t++) {
+    double w = 0.5 * (1.0 - cos(2 * M_PI * t / dsf_nt));
+    w2 += w * w;
+    for (k=0; k<dsf_nktot; k++) {
+      dsf_win[k*dsf_nt+t][0] *= w;
+      dsf_win[k*dsf_nt+t][1] *= w;
+    }
+  }
+  fftw_execute(dsf_plan);
+
+  /* normalized such that the integral over w / 2pi gives S(k) */
+  fac = natoms * dsf_int * timestep / w2;
+  for (k=0; k<dsf_nktot*dsf_nt; k++)
+    dsf_skw[k] += fac * (SQR(dsf_fft[k][0]) + SQR(dsf_fft[k][1]));
+  dsf_nwin++;
+}
+
+/******************************************************************************
+*
+*  write S(k,w), averaged over the completed windows
+*
+******************************************************************************/
+
+static void write_skw(void)
+{
+  FILE   *out;
+  str255 fname;
+  int    n, j, m, l, *k;
+  double dw = 2 * M_PI / (dsf_nt * dsf_int * timestep);
+
+  sprintf(fname,"%s.%s",outfilename,"skw");
+  out = fopen(fname, "w");
+  if (NULL == out) error_str("Cannot open output file %s",fname);
+  fprintf(out, "# S(k,w) from %d windows of %d samples\n", dsf_nwin, dsf_nt);
+  for (n=0; n<dsf_nk; n++)
+    for (j=0; j<=dsf_kmax[n]; j++) {
+      double *s = dsf_skw + (dsf_koff[n] + j) * dsf_nt;
+      k = dsf_k0 + DIM * n;
+#ifdef TWOD
+      fprintf(out, "#K %d %d\n",
+              k[0] + j * dsf_kdir[DIM*n], k[1] + j * dsf_kdir[DIM*n+1]);
+#else
+      fprintf(out, "#K %d %d %d\n",
+              k[0] + j * dsf_kdir[DIM*n  ], k[1] + j * dsf_kdir[DIM*n+1],
+              k[2] + j * dsf_kdir[DIM*n+2]);
+#endif
+      /* frequencies in ascending order */
+      for (l=0; l<dsf_nt; l++) {
+        m = (l + (dsf_nt+1) / 2) % dsf_nt;
+        fprintf(out, "%e %e\n", (m < (dsf_nt+1) / 2 ? m : m - dsf_nt) * dw,
+                s[m] / dsf_nwin);
+      }
+      fprintf(out, "\n\n");
+    }
+  fclose(out);
+}
+
+/******************************************************************************
+*
+*  take a sample of the dynamical structure factor
+*
+******************************************************************************/
+
+void write_dsf()
+{
+  int    n;
+  double twopi = 2*M_PI;
+  static int    count = 0;
+  static double *data = NULL, *data2 = NULL;
+
+  /* allocate data arrays */
+  if (NULL==data) {
+    if (0==dsf_nktot) init_dsf();
+    data  = (double *) malloc( 2 * dsf_nktot * sizeof(double) );
     if (NULL==data) error("cannot allocate dsf array");
 #ifdef MPI
-    data2 = (double *) malloc( 2 * nk * sizeof(real) );
+    data2 = (double *) malloc( 2 * dsf_nktot * sizeof(double) );
     if (NULL==data2) error("cannot allocate dsf array");
 #else
     data2 = data;
 #endif
-    /* normalize weights */
-    for (i=0; i<ntypes; i++) wtot += num_sort[i] * dsf_weight[i];
-    for (i=0; i<ntypes; i++) dsf_weight[i] /= wtot;
   }
 
-  /* clear data array */
-  for (j=0; j<2*nk; j++) data[j] = 0.0;
-
   /* compute data */
-  for (k=0; k<NCELLS; k++) {
-    cell *p = CELLPTR(k); 
-    for (i=0; i<p->n; i++) {
-      for (n=0; n<dsf_nk; n++) {
-        double x, y, w, co, si, co_1, si_1, tt;
-        int    m = 2 * koff[n];
-        x = SPRODX(ORT,p,i,k0  [n]);
-        y = SPRODX(ORT,p,i,kdir[n]);
-        w = dsf_weight[SORTE(p,i)];
-        co = cos(x) * w;  co_1 = cos(y);
-        si = sin(x) * w;  si_1 = sin(y);
-        for (j=0; j<=dsf_kmax[n]; j++) {
-          data[m+2*j  ] += co;
-          data[m+2*j+1] += si;
-          tt = co * co_1 - si * si_1;
-          si = co * si_1 + si * co_1;
-          co = tt;
-        }
-/*
-        for (j=0; j<=dsf_kmax[n]; j++) {
-          real tmp = x + j * y;
-          data[2*(koff[n]+j)  ] += cos(tmp)*w;
-          data[2*(koff[n]+j)+1] += sin(tmp)*w;
-        }
-*/
-      }
-    }
-  }  
+  make_dsf(data);
 
 #ifdef MPI
   /* collect data from different CPUs */
-  MPI_Reduce( data, data2, 2*nk, MPI_DOUBLE, MPI_SUM, 0, cpugrid);
+  MPI_Reduce( data, data2, 2*dsf_nktot, MPI_DOUBLE, MPI_SUM, 0, cpugrid);
 #endif
 
+  if (0!=myid) return;
+
+  /* correlate in time */
+  if (dsf_nt > 0) {
+    int nwin = dsf_nwin;
+    update_skw(data2);
+    if (dsf_nwin > nwin) write_skw();
+  }
+
   /* write data to a file */
-  if (0==myid) {
+  if (dsf_raw) {
 
     FILE   *out;
     str255 fname;  
@@ -3767,7 +4031,7 @@ void write_dsf()
     }
 
     /* write data and close file */
-    fwrite( data2, sizeof(double), 2*nk, out);
+    fwrite( data2, sizeof(double), 2*dsf_nktot, out);
     fclose(out);
     count++;
   }
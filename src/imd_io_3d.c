@@ -83,8 +83,6 @@ void read_atoms(str255 infilename)
     printf("********************************* \n");fflush(stdout);
     printf("    ************************* \n");fflush(stdout);
 #endif
-  /* initialize random number generator */
-  srand48(seed);
   is_big_endian = endian();
 
   /* allocate num_sort and num_vsort on all CPUs */
@@ -800,7 +798,7 @@ void write_atoms_config(FILE *out)
 #endif
 #ifdef NYETENSOR
 		nyeTensorInfo *info = NYE(p,i);
-		if (info != NULL){
+		if (info->valid){
 			data[n++].r = info->ls[0];
 			data[n++].r = info->ls[1];
 			data[n++].r = info->ls[2];
@@ -895,7 +893,7 @@ void write_atoms_config(FILE *out)
 #endif
 #ifdef NYETENSOR
         nyeTensorInfo *info = NYE(p,i);
-       	if (info != NULL) {
+       	if (info->valid) {
        		len += sprintf(outbuf+len, RESOL3, info->ls[0], info->ls[1], info->ls[2] );
        		len += sprintf(outbuf+len, RESOL3, info->bv[0], info->bv[1], info->bv[2] );
        	} else {
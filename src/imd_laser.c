@@ -124,53 +124,34 @@ double get_surface()
   
   double deltax = 2.5;
   int ndcells = (int)(box_x.x/deltax);
-  int *xdens_1, *xdens_2 = NULL;
+  int *xdens_1, *xdens_2;
   
   int l,k;
-  int rightside = ndcells;
+  int rightside = ndcells-1;
   int leftside = 0;
 
-#ifdef MPI2
-  MPI_Alloc_mem( ndcells * sizeof(int), MPI_INFO_NULL, &xdens_1 );
-  MPI_Alloc_mem( ndcells * sizeof(int), MPI_INFO_NULL, &xdens_2 );
-#elif defined(MPI)
-  xdens_1 = (int *) malloc( ndcells * sizeof(int) );
-  xdens_2 = (int *) malloc( ndcells * sizeof(int) );
-#else
-  xdens_1 = (int *) malloc( ndcells * sizeof(int) );
-  xdens_2 = (int *) malloc( ndcells * sizeof(int) );
-#endif
-
-  for (l=0; l<(ndcells); l++) {
-    xdens_1[l] = 0;
-    xdens_2[l] = 0;
-   }
+  xdens_1 = (int *) calloc( ndcells, sizeof(int) );
+  xdens_2 = (int *) calloc( ndcells, sizeof(int) );
+  if ((NULL==xdens_1) || (NULL==xdens_2))
+    error("Cannot allocate laser density histogram");
 
-  /* sum over the density-cells */
+  /* sum over the density-cells, in one pass over the atoms */
  
-  for (l=0; l<(ndcells); l++) {
-    
-    /* check if an atoms x-coordiante is in the l-th dcell */
-    
-    for (k=0; k<NCELLS; k++) {
-      cell *p;
-      p = CELLPTR(k);
-      int i;
-      
-      /* if so, add 1 atom to the xdens of the l-th dcell */
-      
-      for (i=0; i < p->n; i++) {
-	if( (ORT(p,i,X) > (double)l * deltax ) && (ORT(p,i,X) < (double)(l+1) * deltax ) )
-	  xdens_2[l] += 1;
-	
-      }
+  for (k=0; k<NCELLS; k++) {
+    cell *p;
+    p = CELLPTR(k);
+    int i;
+    for (i=0; i < p->n; i++) {
+      l = (int) FLOOR( ORT(p,i,X) / deltax );
+      if ((l >= 0) && (l < ndcells)) xdens_2[l] += 1;
     }
-  } 
+  }
 
-  /* add the resultes for the different CPUs */
+  /* add the resultes for the different CPUs; all CPUs get the
+     histogram, and find the same surface */
   
 #ifdef MPI
-  MPI_Reduce( xdens_2, xdens_1, ndcells, MPI_INT, MPI_SUM, 0, cpugrid);
+  MPI_Allreduce( xdens_2, xdens_1, ndcells, MPI_INT, MPI_SUM, cpugrid);
 #else
   for(l=0; l<ndcells;l++)
   {
@@ -178,90 +159,67 @@ double get_surface()
   }
 #endif
  
-  if(myid==0){
-  
-    /* find the right side of the sample, which is the most outer dcell with density != 0 */
+  /* find the right side of the sample, which is the most outer dcell with density != 0 */
     
-    for (l=ndcells-1;l>0;l--)
+  for (l=ndcells-1;l>0;l--)
+  {
+    if( (xdens_1[l] == 0) && (xdens_1[l-1]  != 0) )
     {
-      if( (xdens_1[l] == 0) && (xdens_1[l-1]  != 0) )
-      {
-	rightside = l-1;
-	break;
-      }
-      
+      rightside = l-1;
+      break;
     }
+      
+  }
 
 
 #ifdef DEBUG
+  if (0==myid)
     for (l=0; l<ndcells; l++)
       printf("num(%i): %i, intervall: %f - %f \n", l, xdens_1[l], l* deltax, (l+1)* deltax); 
 #endif
 
-    /* find the actual surface (not clusters or vapour)
-       by starting from the very right side and look for two adjacent dcells with density 0 */
+  /* find the actual surface (not clusters or vapour)
+     by starting from the very right side and look for two adjacent dcells with density 0 */
     
-    for (l=rightside; l>0; l--){
-      if((xdens_1[l]==0)&&(xdens_1[l-1]==0))
-	break;
-    }
+  for (l=rightside; l>0; l--){
+    if((xdens_1[l]==0)&&(xdens_1[l-1]==0))
+      break;
+  }
     
-    leftside = l+1;
+  leftside = l+1;
     
-    /* check if there are only a few atoms inside the actual top 2 guessed 
-       'surface dcells'; if so adjusts the surface slightly; do also for
-       the rightside */
+  /* check if there are only a few atoms inside the actual top 2 guessed 
+     'surface dcells'; if so adjusts the surface slightly; do also for
+     the rightside */
     
-    if ((xdens_1[leftside]<500))
-    {
-      if ((xdens_1[leftside+1]<500))
-	leftside = l+3;
-      else
-	leftside = l+2;
-    }
+  if ((xdens_1[leftside]<500))
+  {
+    if ((xdens_1[leftside+1]<500))
+      leftside = l+3;
+    else
+      leftside = l+2;
+  }
     
     
-    if ((xdens_1[rightside]<500))
-    {
-      if((xdens_1[rightside-1]<500))
-	rightside-=2;
-      else
-	rightside-=1;
-    }
-       
+  if ((xdens_1[rightside]<500))
+  {
+    if((xdens_1[rightside-1]<500))
+      rightside-=2;
+    else
+      rightside-=1;
   }
+       
+  laser_atom_vol=calc_laser_atom_vol(deltax, leftside, rightside, xdens_1);
 
   /* free arrays*/
-#ifdef MPI2
-  MPI_Free_mem(xdens_1);
-  MPI_Free_mem(xdens_2);
-#elif defined(MPI)
   free(xdens_1);
   free(xdens_2);
-#else
-  free(xdens_1);
-  free(xdens_2);
-#endif
-  
-  laser_atom_vol=calc_laser_atom_vol(deltax, leftside, rightside, xdens_1);
    
-  
-  /* send the new value for laser_atom_vol to the other CPUs */
-#ifdef MPI
-  MPI_Bcast( &laser_atom_vol,     1, MPI_DOUBLE,  0, MPI_COMM_WORLD);
-#endif
-
 #ifdef PDECAY
   double samplesize = (rightside - leftside)*deltax;
     
   ramp_start = (1.0 - ramp_fraction) * samplesize + (double)(leftside+0.5)*deltax;
   ramp_end = (double)(rightside) * deltax;
-
-#ifdef MPI
-  MPI_Bcast( &ramp_start,   1, REAL,  0, MPI_COMM_WORLD);
-  MPI_Bcast( &ramp_end,     1, REAL,  0, MPI_COMM_WORLD);
-#endif
-
 #endif
 
 
@@ -271,6 +229,49 @@ double get_surface()
 }
 
 
+/* exp(-laser_mu*depth), tabulated in steps of LASER_TAB_H/laser_mu up
+   to a depth of LASER_TAB_MAX/laser_mu, and linearly interpolated; the
+   relative error is about (LASER_TAB_H)^2/8 */
+
+#define LASER_TAB_H    0.002
+#define LASER_TAB_MAX  40.0
+
+static real *laser_exp_tab = NULL;
+static int   laser_exp_n   = 0;
+
+static void laser_make_table(void)
+{
+  int l;
+
+  if (laser_mu <= 0.0) return;
+  laser_exp_n   = (int) (LASER_TAB_MAX / LASER_TAB_H) + 2;
+  laser_exp_tab = (real *) malloc( laser_exp_n * sizeof(real) );
+  if (NULL==laser_exp_tab) error("Cannot allocate laser absorption table");
+  for (l=0; l<laser_exp_n; l++) laser_exp_tab[l] = exp( -l * LASER_TAB_H );
+}
+
+static real laser_exp_depth(real depth)
+{
+  real x;
+  int  l;
+
+  if (NULL==laser_exp_tab) return exp( -laser_mu * depth );
+  x = laser_mu * depth / LASER_TAB_H;
+  l = (int) x;
+  if (l >= laser_exp_n - 1) return 0.0;
+  x -= l;
+  return laser_exp_tab[l] + x * (laser_exp_tab[l+1] - laser_exp_tab[l]);
+}
+
+/* find the surface again, if it may have moved */
+
+static void laser_update_surface(void)
+{
+  if ((laser_surface_int > 0) && (steps > 0) &&
+      (0 == steps % laser_surface_int))
+    laser_offset = get_surface();
+}
+
 
 void init_laser()
 {
@@ -302,10 +303,7 @@ void init_laser()
   /* get the surface coordinate and write it into laser_offset */
   
   laser_offset = get_surface();
- 
-#ifdef MPI
-  MPI_Bcast( &laser_offset,     1, REAL,  0, MPI_COMM_WORLD);
-#endif
+  laser_make_table();
 
 #ifdef LASERYZ
     /* if beam-coordinates are given in realtive values*/
@@ -375,15 +373,16 @@ void laser_rescale_dummy()
   /* do nothing */
 }
 
-/* Routine to generate random 3D unit vector */
-void rand_uvec_3d(real* x, real* y, real *z)
+/* Routine to generate random 3D unit vector for atom num */
+void rand_uvec_3d(int num, real* x, real* y, real *z)
 {
 
-  real cosph, sinph, theta, costh, sinth;
+  real cosph, sinph, theta, costh, sinth, u[4];
 
-  cosph = 1.0 - 2.0 * drand48();
+  imd_random4(num, steps, RNG_LASER, 0, u);
+  cosph = 1.0 - 2.0 * u[0];
   sinph = sqrt( 1.0 - cosph * cosph );
-  theta = 2.0 * M_PI * drand48();
+  theta = 2.0 * M_PI * u[1];
   costh = cos(theta);
   sinth = sin(theta);
 
@@ -393,12 +392,13 @@ void rand_uvec_3d(real* x, real* y, real *z)
 }
 
 
-/* Routine to generate random 2D unit vector */
-void rand_uvec_2d(real* x, real* y)
+/* Routine to generate random 2D unit vector for atom num */
+void rand_uvec_2d(int num, real* x, real* y)
 {
-  real phi;
+  real phi, u[4];
 
-  phi   = drand48() * 2 * M_PI;
+  imd_random4(num, steps, RNG_LASER, 0, u);
+  phi   = u[0] * 2 * M_PI;
   *x = cos(phi);
   *y = sin(phi);
 }
@@ -430,6 +430,8 @@ void laser_rescale_1()
   int k;
   real cosph, sinph, theta, costh, sinth;
 
+  laser_update_surface();
+
   gauss_time_squared = timestep * steps - laser_t_0;
   gauss_time_squared *= gauss_time_squared;
   exp_gauss_time_etc = exp(-gauss_time_squared/laser_sigma_t_squared/2.0)
@@ -442,6 +444,10 @@ void laser_rescale_1()
   }
 
 
+  /* the random directions depend only on atom number and step */
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
   for (k=0; k<NCELLS; k++) {
     cell *p;
     p = CELLPTR(k);
@@ -531,22 +537,22 @@ void laser_rescale_1()
    
       
      
-      de = exp( -laser_mu*depth ) * exp_gauss_time_etc * laser_intensity_profile(x,y,z);     
+      de = laser_exp_depth(depth) * exp_gauss_time_etc * laser_intensity_profile(x,y,z);     
   
     
 
 #else
-      de = exp(-laser_mu*depth) * exp_gauss_time_etc;
+      de = laser_exp_depth(depth) * exp_gauss_time_etc;
        
 #endif         
 
        if ( p_0_square == 0.0 ) { /* we need a direction for the momentum. */
 #ifndef TWOD
         /* find random 3d unit vector */
-        rand_uvec_3d(&tmpx, &tmpy, &tmpz);
+        rand_uvec_3d(NUMMER(p,i), &tmpx, &tmpy, &tmpz);
 #else
         /* find random 2d unit vector */
-        rand_uvec_2d(&tmpx, &tmpy);      
+        rand_uvec_2d(NUMMER(p,i), &tmpx, &tmpy);      
 #endif
         scale_p = sqrt( de * 2.0 * MASSE(p,i) );
         IMPULS(p,i,X) = tmpx * scale_p;
@@ -579,6 +585,8 @@ void laser_rescale_2()
   real exp_gauss_time_etc, gauss_time_squared, gauss_time_squared1;
   int k;
 
+  laser_update_surface();
+
   gauss_time_squared = timestep * steps - laser_t_0;
   gauss_time_squared *= gauss_time_squared;
   exp_gauss_time_etc = exp(-gauss_time_squared/laser_sigma_t_squared/2.0)
@@ -590,6 +598,9 @@ void laser_rescale_2()
                        * laser_p_peak1 * timestep * laser_atom_vol;
   }
 
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
   for (k=0; k<NCELLS; k++) {
     cell *p;
     p = CELLPTR(k);
@@ -617,10 +628,10 @@ void laser_rescale_2()
       double x = ORT(p,i,X);
       double y = ORT(p,i,Y);
       double z = ORT(p,i,Z);
-      de = exp( -laser_mu*depth ) * exp_gauss_time_etc * laser_intensity_profile(x,y,z);   
+      de = laser_exp_depth(depth) * exp_gauss_time_etc * laser_intensity_profile(x,y,z);   
 
 #else
-      de = exp(-laser_mu*depth) * exp_gauss_time_etc;
+      de = laser_exp_depth(depth) * exp_gauss_time_etc;
     
 #endif
       dp = sqrt( p_0_square + 2*de*MASSE(p,i) ) - p_0;
@@ -628,9 +639,9 @@ void laser_rescale_2()
 
       /* Momentum increment is to point in a random direction... */
 #ifndef TWOD
-      rand_uvec_3d(&tmpx, &tmpy, &tmpz);
+      rand_uvec_3d(NUMMER(p,i), &tmpx, &tmpy, &tmpz);
 #else
-      rand_uvec_2d(&tmpx, &tmpy);
+      rand_uvec_2d(NUMMER(p,i), &tmpx, &tmpy);
 #endif
       IMPULS(p,i,X) += tmpx * dp;
       IMPULS(p,i,Y) += tmpy * dp;
@@ -685,6 +696,8 @@ void laser_rescale_ttm()
   int i,j,k;
   real exp_gauss_time_etc, gauss_time_squared, gauss_time_squared1, depth;
   
+  laser_update_surface();
+
   gauss_time_squared = timestep * steps - laser_t_0;
   gauss_time_squared *= gauss_time_squared;
   exp_gauss_time_etc = exp(-gauss_time_squared/laser_sigma_t_squared/2.0)
@@ -706,7 +719,7 @@ void laser_rescale_ttm()
       {
 	depth = ttm_calc_depth(i,j,k); 
         l2[i][j][k].source = l1[i][j][k].source
-	                   = exp(-laser_mu*depth) * exp_gauss_time_etc; 
+	                   = laser_exp_depth(depth) * exp_gauss_time_etc; 
       }
     }
   }
@@ -0,0 +1,289 @@
+/******************************************************************************
+*
+* IMD -- The ITAP Molecular Dynamics Program
+*
+* Copyright 1996-2013 Institute for Theoretical and Applied Physics,
+* University of Stuttgart, D-70550 Stuttgart
+*
+******************************************************************************/
+
+/******************************************************************************
+*
+* imd_lbfgs.c -- limited memory BFGS minimizer
+*
+* Each atom carries its share of the history in LBFGS_HIST, so that the
+* history migrates with the atoms between cells and CPUs. Per atom, the
+* block contains the forces of the previous step, a work vector, and
+* lbfgs_m pairs of steps s and force changes y. Every step needs one
+* force evaluation; instead of a line search, the step is limited to a
+* maximal atomic displacement of lbfgs_maxstep.
+*
+******************************************************************************/
+
+/******************************************************************************
+* $Revision$
+* $Date$
+******************************************************************************/
+
+#include "imd.h"
+
+/* offsets into the per atom history block */
+#define LB_F       0                     /* forces of previous step */
+#define LB_Q       (DIM)                 /* work vector, new step */
+#define LB_S(j)    (DIM * (2 + 2*(j)))   /* j-th step */
+#define LB_Y(j)    (DIM * (3 + 2*(j)))   /* j-th change of gradient */
+
+static real *lbfgs_rho = NULL;           /* 1 / (y*s) of each pair */
+static real *lbfgs_a   = NULL;           /* coefficients of the two loops */
+
+/*****************************************************************************
+*
+*  global scalar product of two history vectors
+*
+*****************************************************************************/
+
+static real lbfgs_dot(int a, int b)
+{
+  int  k;
+  real sum = 0.0;
+#ifdef MPI
+  real tmp;
+#endif
+
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:sum)
+#endif
+  for (k=0; k<NCELLS; ++k) {
+    int  i, d;
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; ++i)
+      for (d=0; d<DIM; ++d)
+        sum += LBFGS_HIST(p,i,a+d) * LBFGS_HIST(p,i,b+d);
+  }
+#ifdef MPI
+  MPI_Allreduce( &sum, &tmp, 1, REAL, MPI_SUM, cpugrid);
+  sum = tmp;
+#endif
+  return sum;
+}
+
+/*****************************************************************************
+*
+*  history vectors a = c * a + e * b
+*
+*****************************************************************************/
+
+static void lbfgs_axpy(int a, real c, real e, int b)
+{
+  int k;
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (k=0; k<NCELLS; ++k) {
+    int  i, d;
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; ++i)
+      for (d=0; d<DIM; ++d)
+        LBFGS_HIST(p,i,a+d) = c * LBFGS_HIST(p,i,a+d) + e * LBFGS_HIST(p,i,b+d);
+  }
+}
+
+/*****************************************************************************
+*
+*  reset L-BFGS, e.g. after a deformation step
+*
+*****************************************************************************/
+
+void reset_lbfgs(void)
+{
+  int i, k;
+
+  if (NULL == lbfgs_rho) {
+    lbfgs_rho = (real *) malloc( lbfgs_m * sizeof(real) );
+    lbfgs_a   = (real *) malloc( lbfgs_m * sizeof(real) );
+    if ((NULL == lbfgs_rho) || (NULL == lbfgs_a))
+      error("Cannot allocate L-BFGS history");
+  }
+  lbfgs_pos       = 0;
+  lbfgs_count     = 0;
+  lbfgs_have_prev = 0;
+  fnorm           = 9.99e99;
+
+  /* there is no dynamics, only steps */
+  for (k=0; k<NCELLS; ++k) {
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; ++i) {
+      IMPULS(p,i,X) = 0.0;
+      IMPULS(p,i,Y) = 0.0;
+#ifndef TWOD
+      IMPULS(p,i,Z) = 0.0;
+#endif
+    }
+  }
+}
+
+/*****************************************************************************
+*
+*  one L-BFGS step, with the forces at the current positions
+*
+*****************************************************************************/
+
+void move_atoms_lbfgs(void)
+{
+  int  k, l, j;
+  real tmp_f_max2 = 0.0, tmp_d_max2 = 0.0, d_max2, scale, dF;
+  real epot = tot_pot_energy, wext = 0.0;
+#ifdef MPI
+  real tmp;
+#endif
+
+  fnorm = 0.0;
+
+  /* add external forces, restrict forces, store them, and complete
+     the last (s,y) pair */
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:fnorm,wext) reduction(max:tmp_f_max2)
+#endif
+  for (k=0; k<NCELLS; ++k) {
+    int  i, d, sort;
+    real f[3];
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; ++i) {
+      sort = VSORTE(p,i);
+#ifdef FBC
+      KRAFT(p,i,X) += (fbc_forces + sort)->x;
+      KRAFT(p,i,Y) += (fbc_forces + sort)->y;
+#ifndef TWOD
+      KRAFT(p,i,Z) += (fbc_forces + sort)->z;
+#endif
+      /* work done by the external forces during the last step */
+      if (lbfgs_have_prev) {
+        real *s = &LBFGS_HIST(p,i,LB_S(lbfgs_pos));
+        wext += (fbc_forces + sort)->x * s[0]
+              + (fbc_forces + sort)->y * s[1]
+#ifndef TWOD
+              + (fbc_forces + sort)->z * s[2]
+#endif
+              ;
+      }
+#endif
+      KRAFT(p,i,X) *= (restrictions + sort)->x;
+      KRAFT(p,i,Y) *= (restrictions + sort)->y;
+      f[0] = KRAFT(p,i,X);
+      f[1] = KRAFT(p,i,Y);
+#ifndef TWOD
+      KRAFT(p,i,Z) *= (restrictions + sort)->z;
+      f[2] = KRAFT(p,i,Z);
+#endif
+      for (d=0; d<DIM; ++d) {
+        if (lbfgs_have_prev)
+          LBFGS_HIST(p,i,LB_Y(lbfgs_pos)+d) = LBFGS_HIST(p,i,LB_F+d) - f[d];
+        LBFGS_HIST(p,i,LB_F+d) = f[d];
+        LBFGS_HIST(p,i,LB_Q+d) = f[d];
+        tmp_f_max2 = MAX(SQR(f[d]),tmp_f_max2);
+      }
+      fnorm += SPRODN(KRAFT,p,i,KRAFT,p,i);
+    }
+  }
+#ifdef MPI
+  MPI_Allreduce( &fnorm,      &tmp,    1, REAL, MPI_SUM, cpugrid);
+  fnorm = tmp;
+  MPI_Allreduce( &tmp_f_max2, &f_max2, 1, REAL, MPI_MAX, cpugrid);
+#else
+  f_max2 = tmp_f_max2;
+#endif
+  f_max = SQRT(f_max2);
+#if defined(FBC) && defined(MPI)
+  MPI_Allreduce( &wext, &tmp, 1, REAL, MPI_SUM, cpugrid);
+  wext = tmp;
+#endif
+
+  /* accept the new pair only if it carries positive curvature;
+     forget the history if the last step went uphill, including the
+     potential energy of the external forces */
+  if (lbfgs_have_prev) {
+    if (epot - wext > lbfgs_epot_old) {
+      lbfgs_count = 0;
+    }
+    else {
+      real ys = lbfgs_dot( LB_Y(lbfgs_pos), LB_S(lbfgs_pos) );
+      real yy = lbfgs_dot( LB_Y(lbfgs_pos), LB_Y(lbfgs_pos) );
+      if ((ys > 0.0) && (yy > 0.0)) {
+        lbfgs_rho[lbfgs_pos] = 1.0 / ys;
+        lbfgs_gamma = ys / yy;
+        lbfgs_pos   = (lbfgs_pos + 1) % lbfgs_m;
+        if (lbfgs_count < lbfgs_m) lbfgs_count++;
+      }
+    }
+  }
+
+  /* two-loop recursion: q = H * F is the new search direction */
+  for (l=0; l<lbfgs_count; l++) {
+    j = (lbfgs_pos - 1 - l + lbfgs_m) % lbfgs_m;
+    lbfgs_a[j] = lbfgs_rho[j] * lbfgs_dot( LB_S(j), LB_Q );
+    lbfgs_axpy( LB_Q, 1.0, -lbfgs_a[j], LB_Y(j) );
+  }
+  lbfgs_axpy( LB_Q, (lbfgs_count > 0) ? lbfgs_gamma : 1.0 / lbfgs_alpha,
+              0.0, LB_Q );
+  for (l=lbfgs_count-1; l>=0; l--) {
+    real b;
+    j = (lbfgs_pos - 1 - l + lbfgs_m) % lbfgs_m;
+    b = lbfgs_rho[j] * lbfgs_dot( LB_Y(j), LB_Q );
+    lbfgs_axpy( LB_Q, 1.0, lbfgs_a[j] - b, LB_S(j) );
+  }
+
+  /* fall back to steepest descent if this is not a descent direction */
+  dF = lbfgs_dot( LB_Q, LB_F );
+  if ((lbfgs_count > 0) && (dF <= 0.0)) {
+    lbfgs_count = 0;
+    lbfgs_axpy( LB_Q, 0.0, 1.0 / lbfgs_alpha, LB_F );
+    dF = fnorm / lbfgs_alpha;
+  }
+
+  /* limit the largest atomic displacement */
+#ifdef _OPENMP
+#pragma omp parallel for reduction(max:tmp_d_max2)
+#endif
+  for (k=0; k<NCELLS; ++k) {
+    int  i, d;
+    real d2;
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; ++i) {
+      d2 = 0.0;
+      for (d=0; d<DIM; ++d) d2 += SQR( LBFGS_HIST(p,i,LB_Q+d) );
+      tmp_d_max2 = MAX(d2,tmp_d_max2);
+    }
+  }
+#ifdef MPI
+  MPI_Allreduce( &tmp_d_max2, &d_max2, 1, REAL, MPI_MAX, cpugrid);
+#else
+  d_max2 = tmp_d_max2;
+#endif
+  scale = 1.0;
+  if (d_max2 > SQR(lbfgs_maxstep)) scale = lbfgs_maxstep / SQRT(d_max2);
+
+  /* make the step, and keep it as s of the next pair */
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (k=0; k<NCELLS; ++k) {
+    int  i, d;
+    real *s;
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; ++i) {
+      s = &LBFGS_HIST(p,i,LB_S(lbfgs_pos));
+      for (d=0; d<DIM; ++d) s[d] = scale * LBFGS_HIST(p,i,LB_Q+d);
+      ORT(p,i,X) += s[0];
+      ORT(p,i,Y) += s[1];
+#ifndef TWOD
+      ORT(p,i,Z) += s[2];
+#endif
+    }
+  }
+
+  lbfgs_have_prev = 1;
+  lbfgs_epot_old  = epot;
+  PxF             = scale * dF;
+  tot_kin_energy  = 0.0;
+}
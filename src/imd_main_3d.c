@@ -139,6 +139,12 @@ int nyeDone;
 #ifdef CG
   if (ensemble == ENS_CG) reset_cg();
 #endif
+#ifdef LBFGS
+  if (ensemble == ENS_LBFGS) reset_lbfgs();
+#endif
+#ifdef FIRE2
+  if (ensemble == ENS_FIRE2) reset_fire2();
+#endif
 
 #ifdef DEFORM
   deform_int = 0; 
@@ -187,6 +193,7 @@ int nyeDone;
 		     ((force_int  > 0) && (0 == steps % force_int )) ||
 #endif /* FORCE */
                      ((dist_int  > 0) && (0 == steps % dist_int )) ||
+                     ((dist_av_int > 0) && (0 == steps % dist_av_int)) ||
 #ifdef HC
                      ((hc_int > 0) && (steps >= hc_av_start) && 
                       ((steps < hc_start) || ((steps-hc_start)%hc_int==0))) ||
@@ -211,7 +218,7 @@ int nyeDone;
 #ifdef EXTPOT
     /* update extpot position if necessary */
 #ifdef RELAX
-    if ( ((ensemble==ENS_MIK) || (ensemble==ENS_GLOK) || (ensemble==ENS_CG)) &&
+    if ( IS_RELAX_ENS(ensemble) &&
          (ep_max_int > 0) ) {
         if ((is_relaxed) || (ep_int > ep_max_int)) {
             write_ssdef(steps);    /* write info for quasistat simulations */
@@ -226,6 +233,12 @@ int nyeDone;
             {
                 reset_glok();
             }
+#endif
+#ifdef LBFGS
+            if (ensemble==ENS_LBFGS) reset_lbfgs();
+#endif
+#ifdef FIRE2
+            if (ensemble==ENS_FIRE2) reset_fire2();
 #endif
         }
         ep_int++;
@@ -250,7 +263,7 @@ int nyeDone;
 #endif
 
 #if defined(HOMDEF) && defined(RELAX)
-    if ( (ensemble==ENS_MIK) || (ensemble==ENS_GLOK) || (ensemble==ENS_CG) )
+    if (IS_RELAX_ENS(ensemble))
     {
         if(lindef_int >0)
         {
@@ -283,6 +296,12 @@ int nyeDone;
                {
                    reset_glok();
                }
+#endif
+#ifdef LBFGS
+               if (ensemble==ENS_LBFGS) reset_lbfgs();
+#endif
+#ifdef FIRE2
+               if (ensemble==ENS_FIRE2) reset_fire2();
 #endif
            }
             deform_int++;
@@ -318,6 +337,12 @@ int nyeDone;
               reset_glok();
           }
 #endif
+#ifdef LBFGS
+          if (ensemble==ENS_LBFGS) reset_lbfgs();
+#endif
+#ifdef FIRE2
+          if (ensemble==ENS_FIRE2) reset_fire2();
+#endif
 #else
       if (deform_int == max_deform_int)
       {
@@ -386,6 +411,10 @@ int nyeDone;
 #endif
 #endif
 
+#ifdef RESPA
+    /* long-range forces only every respa_n steps, as an impulse */
+    respa_outer = (0 == steps % respa_n);
+#endif
 #ifdef TIMING
     imd_start_timer(&time_forces);
 #endif
@@ -459,7 +488,6 @@ int nyeDone;
 #endif 
       do_cna();
       if (0==myid && cna_write_statistics) {
-	/* works not correctly in parallel version */
 	sort_pair_types();
 	write_statistics();
       }
@@ -484,6 +512,26 @@ int nyeDone;
     }
 #endif
 
+#ifdef PTM
+    /* before the atoms move, while the buffer cells are up to date */
+    if ((ptm_int > 0) && (0 == steps % ptm_int)) {
+      do_ptm();
+      write_config_select(steps/ptm_int, "ptm", write_atoms_ptm, write_header_ptm);
+    }
+#endif
+
+#ifdef RDF
+    if ((rdf_int > 0) && (0 == steps % rdf_int)) {
+      do_rdf();
+      if (0 == steps % rdf_write_int) write_rdf(steps/rdf_write_int);
+    }
+#endif
+
+#ifdef NNBR_TABLE
+    /* the atoms move before ADA and NYETENSOR use the table */
+    nnbr_done = 0;
+#endif
+
 #if defined(CORRELATE) || defined(MSQD)
     if ((steps >= correl_start) && ((steps < correl_end) || (correl_end==0))) {
       int istep = steps - correl_start;
@@ -494,6 +542,11 @@ int nyeDone;
     }
 #endif
 
+#ifdef MTAU
+    if ((mtau_int > 0) && (steps >= mtau_start) &&
+        (0 == (steps - mtau_start) % mtau_int)) update_mtau();
+#endif
+
 #ifdef GLOK
     /* "global convergence": set momenta to 0 if P*F < 0 (global vectors) */
     if (ensemble == ENS_GLOK) {
@@ -530,6 +583,18 @@ int nyeDone;
 #endif
 
 #ifdef SM
+#ifdef RESPA
+    /* charges are only needed for the next long-range step;
+       charge_update_steps then counts long-range steps */
+    if ((!sm_fixed_charges) && (charge_update_steps > 0) && 
+        ((steps+1) % (charge_update_steps * respa_n) == 0)) {
+#ifdef NBLIST
+      charge_update_sm();
+#else
+      do_charge_update();
+#endif
+    }
+#else
 #ifdef NBLIST
     if ((!sm_fixed_charges) && ((charge_update_steps > 0) && steps % charge_update_steps == 0)){
       charge_update_sm();
@@ -539,6 +604,7 @@ int nyeDone;
       do_charge_update();
        }
 #endif
+#endif /* RESPA */
 #endif
 
 #ifdef HC
@@ -546,10 +612,17 @@ int nyeDone;
         ((steps < hc_start) || ((steps - hc_start) % hc_int == 0)))
       do_heat_cond(steps);  
 #endif
+#ifdef NVX
+    if ((ensemble == ENS_NVX) && (hc_int > 0) && (steps > hc_start)) 
+      do_heat_cond(steps);
+#endif
 
 #ifdef TIMING
     imd_start_timer(&time_integrate);
 #endif
+#ifdef SHAKE
+    shake_prepare();
+#endif
 #if !defined(CBE) || !defined(SPU_INT)
 #ifdef NEB
     if(myrank != 0 && myrank != neb_nrep-1)
@@ -561,6 +634,10 @@ int nyeDone;
     }
 #endif
     
+#endif
+#ifdef SHAKE
+    /* constrain bond lengths */
+    shake();
 #endif
 #ifdef TIMING
     imd_stop_timer(&time_integrate);
@@ -690,11 +767,12 @@ int nyeDone;
     if ((checkpt_int > 0) && (0 == steps % checkpt_int)) 
        write_config( steps/checkpt_int, steps);
     if ((eng_int  > 0) && (0 == steps % eng_int )) write_eng_file(steps);
+    if ((dist_av_int > 0) && (0 == steps % dist_av_int)) update_distrib();
     if ((dist_int > 0) && (0 == steps % dist_int)) write_distrib(steps);
     if ((pic_int  > 0) && (0 == steps % pic_int )) write_pictures(steps);
 #ifdef EXTPOT
 #ifdef RELAX
-    if ( ((ensemble==ENS_MIK) || (ensemble==ENS_GLOK) || (ensemble==ENS_CG)) &&
+    if ( IS_RELAX_ENS(ensemble) &&
          (ep_max_int <= 0) )
 #endif
     if ((eng_int > 0) && (0 == steps % eng_int )) write_fext(steps);
@@ -761,7 +839,7 @@ int nyeDone;
 #endif
 
 #ifdef NEB
-    if ((0==myrank) && (neb_eng_int > 0) && (0 == steps % neb_eng_int ))
+    if ((0==myrank) && (0==myid) && (neb_eng_int > 0) && (0 == steps % neb_eng_int ))
       write_neb_eng_file(steps);
 #endif
 
@@ -771,6 +849,10 @@ int nyeDone;
     fix_cells();  
 #endif
 
+#ifdef PRD
+    prd_step();
+#endif
+
 #ifdef NYETENSOR
     if (nyeDone == 1)
     	removeNyeTensorData();
@@ -787,6 +869,12 @@ int nyeDone;
         (correl_end==0) && (steps==steps_max))   
       write_config_select(0, "sqd", write_atoms_sqd, write_header_sqd);
 #endif
+#ifdef MTAU
+    if ((mtau_int > 0) && (steps > mtau_start) &&
+        (((mtau_write_int > 0) && (0 == steps % mtau_write_int)) ||
+         ((mtau_write_int == 0) && (steps == steps_max))))
+      write_mtau(steps);
+#endif
 
     /* write checkpoint, if empty write file is found */
     if ((watch_int > 0) && (0==steps%watch_int)) check_write();
@@ -799,7 +887,7 @@ int nyeDone;
       /* finish, if max deformation steps in quasistatic simulation are done */
 #ifdef RELAX
 #if defined (DEFORM) || defined (HOMDEF) || defined (EXTPOT) || defined (FBC)
-    if ( (ensemble==ENS_MIK) || (ensemble==ENS_GLOK) || (ensemble==ENS_CG) ) {
+    if (IS_RELAX_ENS(ensemble)) {
         if ( (max_sscount>0) && (sscount>max_sscount) ) {
                  finished = 1 ;
                  steps_max = steps;
@@ -824,7 +912,7 @@ int nyeDone;
   imdrestart=0;
   if (0==myid) {
     write_itr_file(-1, steps_max,"");
-    if (0==myrank) printf( "End of simulation %d\n", simulation );
+    if ((0==myrank) && (0==myid)) printf( "End of simulation %d\n", simulation );
   }  
   return finished;
     }
@@ -862,6 +950,7 @@ void constrain_move(void)
           if (SQRT(xnorm) >neb_maxmove)
           {
               normp=sqrt(pnorm);
+              if (0==myid)
               printf("step %d myrank:%d xnorm = %lf maxmove = %lf  normp =%lf x_max =%lf \n",steps,myrank,SQRT(xnorm),neb_maxmove,normp,SQRT(x_max2));
 	 
               for (k=0; k<NCELLS; ++k) {
@@ -894,8 +983,19 @@ void constrain_move(void)
 #endif
                   }
               }
-              printf("myrank:%d newxnorm = %lf new xmax %lf\n",myrank,SQRT(newxnorm),SQRT(tmp_x_max2));
-              fflush(stdout);
+#ifdef MPI
+              {
+                real tmp;
+                MPI_Allreduce( &newxnorm,   &tmp, 1, REAL, MPI_SUM, cpugrid);
+                newxnorm = tmp;
+                MPI_Allreduce( &tmp_x_max2, &tmp, 1, REAL, MPI_MAX, cpugrid);
+                tmp_x_max2 = tmp;
+              }
+#endif
+              if (0==myid) {
+                printf("myrank:%d newxnorm = %lf new xmax %lf\n",myrank,SQRT(newxnorm),SQRT(tmp_x_max2));
+                fflush(stdout);
+              }
               xnorm=newxnorm;
               x_max2 = tmp_x_max2;
               
@@ -1119,7 +1219,7 @@ void init_fbc(void)
 #else
   /* dynamic loading, increment linearly at each timestep */
   if (0 == myid) printf("FBC: vtype  fbc_df.x fbc_df.y fbc_df.z\n");
-  if ((ensemble!=ENS_MIK) && (ensemble!=ENS_GLOK) && (ensemble!=ENS_CG)) {
+  if (!IS_RELAX_ENS(ensemble)) {
     for (l=0;l<vtypes;l++){
       (fbc_df+l)->x = ((fbc_endforces+l)->x-(fbc_beginforces+l)->x)/steps_diff;
       (fbc_df+l)->y = ((fbc_endforces+l)->y-(fbc_beginforces+l)->y)/steps_diff;
@@ -1151,7 +1251,7 @@ void update_fbc()
 #endif
 #ifdef RELAX
   /* set fbc increment if necessary */
-  if ((ensemble==ENS_MIK) || (ensemble==ENS_GLOK) || (ensemble==ENS_CG)) {
+  if (IS_RELAX_ENS(ensemble)) {
     if ((is_relaxed) || (fbc_int > max_fbc_int)) {
         write_ssdef(steps);
         write_ssconfig(steps); /* write config, even when not fully relaxed */
@@ -1183,6 +1283,12 @@ void update_fbc()
     {
         reset_glok();
     }
+#endif
+#ifdef LBFGS
+    if (ensemble==ENS_LBFGS) reset_lbfgs();
+#endif
+#ifdef FIRE2
+    if (ensemble==ENS_FIRE2) reset_fire2();
 #endif
   }
 }
@@ -1227,7 +1333,7 @@ void init_bfbc(void)
   }
 #else
   /* dynamic loading, increment linearly at each timestep */
-  if ((ensemble!=ENS_MIK) && (ensemble!=ENS_GLOK) && (ensemble!=ENS_CG)) {
+  if (!IS_RELAX_ENS(ensemble)) {
     for (l=0;l<vtypes;l++){
       (fbc_bdf+l)->x = ((fbc_endbforces+l)->x-(fbc_beginbforces+l)->x)/steps_diff;
       (fbc_bdf+l)->y = ((fbc_endbforces+l)->y-(fbc_beginbforces+l)->y)/steps_diff;
@@ -1258,7 +1364,7 @@ void update_bfbc()
 #endif
 #ifdef RELAX
   /* set fbc increment if necessary */
-  if ((ensemble==ENS_MIK) || (ensemble==ENS_GLOK) || (ensemble==ENS_CG)) {
+  if (IS_RELAX_ENS(ensemble)) {
     if ((is_relaxed) || (bfbc_int > max_fbc_int)) {
         write_ssdef(steps);
         write_ssconfig(steps); /* write config, even when not fully relaxed */
@@ -1290,6 +1396,12 @@ void update_bfbc()
     {
         reset_glok();
     }
+#endif
+#ifdef LBFGS
+    if (ensemble==ENS_LBFGS) reset_lbfgs();
+#endif
+#ifdef FIRE2
+    if (ensemble==ENS_FIRE2) reset_fire2();
 #endif
   }
 }
@@ -1689,12 +1801,12 @@ void check_relaxed(void)
     int write_ss=1;
     is_relaxed = 0;
 
-    if ((ensemble==ENS_MIK) || (ensemble==ENS_GLOK) || (ensemble==ENS_CG)) {
+    if (IS_RELAX_ENS(ensemble)) {
         
         int stop = 0;
         real fnorm2, ekin, epot, delta_epot;
 #ifdef NEB
-        MPI_Allreduce( &fnorm, &neb_fnorm, 1, REAL, MPI_SUM, MPI_COMM_WORLD);
+        MPI_Allreduce( &fnorm, &neb_fnorm, 1, REAL, MPI_SUM, neb_rep_comm);
         neb_fnorm = SQRT( neb_fnorm / (nactive * (neb_nrep-2)) );
         if (neb_fnorm < fnorm_threshold) is_relaxed = 1;
         else is_relaxed = 0;
@@ -1739,7 +1851,7 @@ void check_relaxed(void)
                 write_ssconfig(steps);
             
 #ifdef NEB
-            if (0==myrank) write_neb_eng_file(steps);
+            if ((0==myrank) && (0==myid)) write_neb_eng_file(steps);
 #else
             if (0==myid) {
                 printf("nfc = %d epot = %22.16f\n", nfc, epot );
@@ -1947,6 +2059,13 @@ void do_boundaries(void)
       REF_POS(p,l,Z) += i * box_x.z;
 #endif
 #endif
+#ifdef SM
+      SM_POS(p,l,X)  += i * box_x.x;
+      SM_POS(p,l,Y)  += i * box_x.y;
+#ifndef TWOD
+      SM_POS(p,l,Z)  += i * box_x.z;
+#endif
+#endif
 #ifdef AVPOS
       SHEET(p,l,X)   -= i * box_x.x;
       SHEET(p,l,Y)   -= i * box_x.y;
@@ -1972,6 +2091,13 @@ void do_boundaries(void)
       REF_POS(p,l,Z) += i * box_y.z;
 #endif
 #endif
+#ifdef SM
+      SM_POS(p,l,X)  += i * box_y.x;
+      SM_POS(p,l,Y)  += i * box_y.y;
+#ifndef TWOD
+      SM_POS(p,l,Z)  += i * box_y.z;
+#endif
+#endif
 #ifdef AVPOS
       SHEET(p,l,X)   -= i * box_y.x;
       SHEET(p,l,Y)   -= i * box_y.y;
@@ -1994,6 +2120,11 @@ void do_boundaries(void)
       REF_POS(p,l,Y) += i * box_z.y;
       REF_POS(p,l,Z) += i * box_z.z;
 #endif
+#ifdef SM
+      SM_POS(p,l,X)  += i * box_z.x;
+      SM_POS(p,l,Y)  += i * box_z.y;
+      SM_POS(p,l,Z)  += i * box_z.z;
+#endif
 #ifdef AVPOS
       SHEET(p,l,X)   -= i * box_z.x;
       SHEET(p,l,Y)   -= i * box_z.y;
@@ -9,7 +9,8 @@
 
 /******************************************************************************
 *
-* imd_maxwell.c -- initialize velocity with a maxwell distribution
+* imd_maxwell.c -- initialize velocity with a maxwell distribution,
+*                  and counter-based random numbers
 *
 ******************************************************************************/
 
@@ -20,8 +21,6 @@
 
 #include "imd.h"
 
-real imd_gaussian(const real);
-
 /*
 *
 * Converted directly from an example in the book of Allen and Tildesley
@@ -46,42 +45,36 @@ void maxwell(real temp)
 { 
    int         k;
    vektor      tot_impuls;
-   int         nactive_x, nactive_y, nactive_z;
-   static long dummy = 0;
-   int slice;
-#ifdef DAMP
-   real tmp1,tmp2,tmp3,f,maxax,maxax2;
-#endif
-#ifdef LASER
-   real depth;
-#endif
+   real        tot_x = 0.0, tot_y = 0.0, tot_z = 0.0;
+   int         nactive_x = 0, nactive_y = 0, nactive_z = 0;
+   static int  ncall = 0;
 
-#ifdef UNIAX
-   real xisq;
-   real xi0;
-   real xi1;
-   real xi2;
-   real dot;
-   real norm;
-   real osq;
-#endif
-   real   TEMP;
-   real   scale, xx, tmp;
-   int    num, nhalf, typ;
-
-   TEMP = temp;
-   tot_impuls.x = 0.0;   nactive_x = 0;
-   tot_impuls.y = 0.0;   nactive_y = 0;
-#ifndef TWOD
-   tot_impuls.z = 0.0;   nactive_z = 0;
-#endif
+   /* the random numbers depend on atom number, step and call only,
+      not on the distribution of the atoms to CPUs and threads */
+   ncall++;
 
    /* set temperature */
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:tot_x,tot_y,tot_z,nactive_x,nactive_y,nactive_z)
+#endif
    for (k=0; k<NCELLS; ++k) {
 
       int i;
       cell *p;
       vektor *rest;
+      real   TEMP = temp, tmp, g[4];
+#ifdef LASER
+      real   depth;
+#endif
+#ifdef DAMP
+      real   tmp1, tmp2, tmp3, f, maxax, maxax2;
+#endif
+#ifdef FTG
+      int    slice;
+#endif
+#ifdef UNIAX
+      real   u[4], xi0, dot, norm, osq;
+#endif
 
       p = CELLPTR(k);
 
@@ -146,10 +139,11 @@ void maxwell(real temp)
 	 tmp  = sqrt(TEMP * MASSE(p,i));
          rest = restrictions + VSORTE(p,i);
 #ifndef RIGID
-         IMPULS(p,i,X) = imd_gaussian(tmp) * rest->x;
-         IMPULS(p,i,Y) = imd_gaussian(tmp) * rest->y;
+         imd_gauss4(NUMMER(p,i), steps, RNG_MAXWELL, ncall, g);
+         IMPULS(p,i,X) = tmp * g[0] * rest->x;
+         IMPULS(p,i,Y) = tmp * g[1] * rest->y;
 #ifndef TWOD
-         IMPULS(p,i,Z) = imd_gaussian(tmp) * rest->z;
+         IMPULS(p,i,Z) = tmp * g[2] * rest->z;
 #endif
 #else
 	 /* superatoms get velocity zero */
@@ -166,10 +160,10 @@ void maxwell(real temp)
 #ifndef TWOD
          nactive_z += (int) rest->z;
 #endif
-         tot_impuls.x += IMPULS(p,i,X);
-         tot_impuls.y += IMPULS(p,i,Y);
+         tot_x += IMPULS(p,i,X);
+         tot_y += IMPULS(p,i,Y);
 #ifndef TWOD
-         tot_impuls.z += IMPULS(p,i,Z);
+         tot_z += IMPULS(p,i,Z);
 #endif
 
 #ifdef UNIAX
@@ -178,17 +172,12 @@ void maxwell(real temp)
 
          /* choose a random vector in space */
 
-         do {
-           xi1 = 2.0 * drand48() - 1.0 ;
-           xi2 = 2.0 * drand48() - 1.0 ;
-           xisq = xi1 * xi1 + xi2 * xi2 ;
-         } while ( xisq >= 1.0 );
+         imd_random4(NUMMER(p,i), steps, RNG_UNIAX, ncall, u);
+         xi0 = 2.0 * sqrt( u[0] * (1.0 - u[0]) ) ;
 
-         xi0 = sqrt( 1.0 - xisq ) ;
-
-         DREH_IMPULS(p,i,X) = 2.0 * xi1 * xi0 ;
-         DREH_IMPULS(p,i,Y) = 2.0 * xi2 * xi0 ;
-         DREH_IMPULS(p,i,Z) = 1.0 - 2.0 * xisq ;
+         DREH_IMPULS(p,i,X) = xi0 * cos( 2.0 * M_PI * u[1] ) ;
+         DREH_IMPULS(p,i,Y) = xi0 * sin( 2.0 * M_PI * u[1] ) ;
+         DREH_IMPULS(p,i,Z) = 1.0 - 2.0 * u[0] ;
 
         /* constrain the vector to be perpendicular to the molecule */
 
@@ -209,7 +198,7 @@ void maxwell(real temp)
 
         /* choose the magnitude of the angular momentum */
 
-        osq = - 2.0 * uniax_inert * TEMP * log( drand48() ) ;
+        osq = - 2.0 * uniax_inert * TEMP * log( u[2] ) ;
         norm = sqrt( osq );
 
         DREH_IMPULS(p,i,X) *= norm ;
@@ -236,6 +225,11 @@ void maxwell(real temp)
 #endif
       }
    }
+   tot_impuls.x = tot_x;
+   tot_impuls.y = tot_y;
+#ifndef TWOD
+   tot_impuls.z = tot_z;
+#endif
 
 #ifdef CLONE
 
@@ -272,6 +266,27 @@ void maxwell(real temp)
 
 #endif /* CLONE */
 
+#ifdef MPI
+   /* total momentum of the whole sample */
+   {
+     vektor tmpvec;
+     int    nact[3], tmp[3];
+     MPI_Allreduce( &tot_impuls, &tmpvec, DIM, REAL, MPI_SUM, cpugrid);
+     tot_impuls = tmpvec;
+     nact[0] = nactive_x;
+     nact[1] = nactive_y;
+#ifndef TWOD
+     nact[2] = nactive_z;
+#endif
+     MPI_Allreduce( nact, tmp, DIM, MPI_INT, MPI_SUM, cpugrid);
+     nactive_x = tmp[0];
+     nactive_y = tmp[1];
+#ifndef TWOD
+     nactive_z = tmp[2];
+#endif
+   }
+#endif
+
    tot_impuls.x = nactive_x == 0 ? 0.0 : tot_impuls.x / nactive_x;
    tot_impuls.y = nactive_y == 0 ? 0.0 : tot_impuls.y / nactive_y;
 #ifndef TWOD
@@ -279,6 +294,9 @@ void maxwell(real temp)
 #endif
 
    /* correct center of mass momentum */
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
    for (k=0; k<NCELLS; ++k) {
       int i;
       cell *p;
@@ -296,28 +314,60 @@ void maxwell(real temp)
 
 } 
 
-/* The following is adapted from the GNU Scientific Library, Version 1.1.
-   See http://www.gnu.org/software/gsl/ 
-*/
-
-/* Polar (Box-Mueller) method; See Knuth v2, 3rd ed, p122 */
+/******************************************************************************
+*
+*  Counter-based random numbers (Philox4x32-10, Salmon et al., SC 2011).
+*
+*  The result is a function of the key (seed and replica) and of the
+*  counter (atom number, step, stream, and a further integer), so that
+*  it does not depend on the order in which the atoms are treated, nor
+*  on the number of CPUs or threads.
+*
+******************************************************************************/
 
-real imd_gaussian(const real sigma)
+static void philox4x32(unsigned int c[4], unsigned int k0, unsigned int k1)
 {
-  double x, y, r2;
+  unsigned long long p0, p1;
+  int r;
+
+  for (r=0; r<10; r++) {
+    p0 = 0xD2511F53ULL * c[0];
+    p1 = 0xCD9E8D57ULL * c[2];
+    c[0] = ((unsigned int) (p1 >> 32)) ^ c[1] ^ k0;
+    c[1] =  (unsigned int)  p1;
+    c[2] = ((unsigned int) (p0 >> 32)) ^ c[3] ^ k1;
+    c[3] =  (unsigned int)  p0;
+    k0 += 0x9E3779B9U;
+    k1 += 0xBB67AE85U;
+  }
+}
 
-  do
-    {
-      /* choose x,y in uniform square (-1,-1) to (+1,+1) */
+/* four random numbers, uniform in (0,1) */
 
-      x = -1 + 2 * drand48();
-      y = -1 + 2 * drand48();
+void imd_random4(int num, int step, int stream, int n, real *u)
+{
+  unsigned int c[4];
+  int i;
+
+  c[0] = (unsigned int) num;
+  c[1] = (unsigned int) step;
+  c[2] = (unsigned int) stream;
+  c[3] = (unsigned int) n;
+  philox4x32(c, (unsigned int) seed, (unsigned int) myrank);
+  for (i=0; i<4; i++) u[i] = (c[i] + 0.5) * (1.0 / 4294967296.0);
+}
 
-      /* see if it is in the unit circle */
-      r2 = x * x + y * y;
-    }
-  while (r2 > 1.0 || r2 == 0);
+/* four normally distributed random numbers (Box-Muller) */
 
-  /* Box-Muller transform */
-  return (real) (sigma * y * sqrt (-2.0 * log (r2) / r2));
+void imd_gauss4(int num, int step, int stream, int n, real *g)
+{
+  real u[4], r;
+
+  imd_random4(num, step, stream, n, u);
+  r    = sqrt( -2.0 * log( u[0] ) );
+  g[0] = r * cos( 2.0 * M_PI * u[1] );
+  g[1] = r * sin( 2.0 * M_PI * u[1] );
+  r    = sqrt( -2.0 * log( u[2] ) );
+  g[2] = r * cos( 2.0 * M_PI * u[3] );
+  g[3] = r * sin( 2.0 * M_PI * u[3] );
 }
@@ -228,7 +228,11 @@ void init_io(void)
   { 
     msgbuf b = {NULL, 0, 0};
     minicell c;
-    alloc_msgbuf( &b, 256 );
+    int len = 256;
+#ifdef MTAU
+    len += mtau_len;
+#endif
+    alloc_msgbuf( &b, len );
     c.n_max = 0;
     ALLOC_MINICELL( &c, 1 );
     c.n = 1;
@@ -345,6 +349,10 @@ int irecv_buf(msgbuf *b, int from, MPI_Request *req)
 
 void copy_atom_cell_buf(msgbuf *to, int to_cpu, cell *p, int ind )
 {
+#if defined(LBFGS) || defined(PRD) || defined(MTAU)
+  int k;
+#endif
+
   /* Check the parameters */
   if ((0 > ind) || (ind >= p->n)) {
     printf("%d: i %d n %d\n", myid, ind, p->n);
@@ -389,6 +397,13 @@ void copy_atom_cell_buf(msgbuf *to, int to_cpu, cell *p, int ind )
 #ifdef VARCHG
   to->data[ to->n++ ] = CHARGE(p,ind);
 #endif
+#ifdef SM
+  to->data[ to->n++ ] = SM_POS(p,ind,X);
+  to->data[ to->n++ ] = SM_POS(p,ind,Y);
+#ifndef TWOD
+  to->data[ to->n++ ] = SM_POS(p,ind,Z);
+#endif
+#endif
 #ifdef DIPOLE 
   /* dp_E_stat, dp_E_ind and dp_p_stat are not sent */
 /*   to->data[ to->n++ ] = DP_P_STAT(p,ind,X); */
@@ -417,6 +432,18 @@ void copy_atom_cell_buf(msgbuf *to, int to_cpu, cell *p, int ind )
   to->data[ to->n++ ] = OLD_ORT(p,ind,Z); 
 #endif
 #endif /* CG */
+#ifdef LBFGS
+  for (k=0; k<lbfgs_len; k++)
+    to->data[ to->n++ ] = LBFGS_HIST(p,ind,k);
+#endif
+#ifdef PRD
+  for (k=0; k<PRD_NSAVE; k++)
+    to->data[ to->n++ ] = PRD_SAVE(p,ind,k);
+#endif
+#ifdef MTAU
+  for (k=0; k<mtau_len; k++)
+    to->data[ to->n++ ] = MTAU_BUF(p,ind,k);
+#endif
 #ifdef DAMP
   to->data[ to->n++ ] = DAMPF(p,ind);
 #endif
@@ -562,6 +589,9 @@ void copy_atom_buf_cell(minicell *p, msgbuf *b, int start)
 {
   int  ind, j = start + 1;  /* the first entry is the CPU number */
   cell *to;
+#if defined(LBFGS) || defined(PRD) || defined(MTAU)
+  int  k;
+#endif
 
 #ifdef VEC
   if (p->n >= p->n_max) alloc_minicell(p,p->n_max+incrsz);
@@ -607,6 +637,13 @@ void copy_atom_buf_cell(minicell *p, msgbuf *b, int start)
 #ifdef VARCHG
   CHARGE(to,ind)     = b->data[j++];
 #endif
+#ifdef SM
+  SM_POS(to,ind,X)   = b->data[j++];
+  SM_POS(to,ind,Y)   = b->data[j++];
+#ifndef TWOD
+  SM_POS(to,ind,Z)   = b->data[j++];
+#endif
+#endif
 #ifdef DIPOLE
   /* don't send p_stat, E_stat, E_ind */
   DP_P_IND(to,ind,X) = b->data[j++];
@@ -632,6 +669,18 @@ void copy_atom_buf_cell(minicell *p, msgbuf *b, int start)
   OLD_ORT(to,ind,Z) = b->data[j++];
 #endif
 #endif /* CG */
+#ifdef LBFGS
+  for (k=0; k<lbfgs_len; k++)
+    LBFGS_HIST(to,ind,k) = b->data[j++];
+#endif
+#ifdef PRD
+  for (k=0; k<PRD_NSAVE; k++)
+    PRD_SAVE(to,ind,k) = b->data[j++];
+#endif
+#ifdef MTAU
+  for (k=0; k<mtau_len; k++)
+    MTAU_BUF(to,ind,k) = b->data[j++];
+#endif
 #ifdef DAMP
   DAMPF(to,ind) = b->data[j++];
 #endif
@@ -790,6 +839,9 @@ void setup_buffers(void)
 #ifdef VARCHG
     binc1++;         /* charge */   
 #endif
+#if defined(DIPOLE) || defined(SHAKE)
+    binc1++;         /* nummer */
+#endif
 
     /* for communication from buffer cells */
     binc2 = DIM;     /* force */
@@ -0,0 +1,367 @@
+
+/******************************************************************************
+*
+* IMD -- The ITAP Molecular Dynamics Program
+*
+* Copyright 1996-2013 Institute for Theoretical and Applied Physics,
+* University of Stuttgart, D-70550 Stuttgart
+*
+******************************************************************************/
+
+/******************************************************************************
+*
+* imd_mtau.c -- multiple time origin correlations with a multi-tau scheme
+*
+* Mean square displacement, velocity autocorrelation, and (with HC) heat
+* current autocorrelation are accumulated in situ over all time origins.
+* Level l of the correlator holds the last mtau_p values of a series,
+* sampled every mtau_m^l samples; values at level l > 0 are block averages
+* of mtau_m values of level l-1 (velocities, heat current), or the
+* unwrapped displacement at that time (mean square displacement). Lags
+* j * mtau_m^l with j < mtau_p are correlated at each level, so memory
+* grows only with the logarithm of the longest lag.
+*
+* Each atom carries its histories in MTAU_BUF, so that they migrate with
+* the atom between cells and CPUs. The correlation sums are reduced only
+* when they are written.
+*
+******************************************************************************/
+
+/******************************************************************************
+* $Revision$
+* $Date$
+******************************************************************************/
+
+#include "imd.h"
+
+#define MTAU_MAXLEV 32
+
+/* offsets into the per atom block */
+#define MT_ORT      0                                  /* last position */
+#define MT_U        (DIM)                              /* unwrapped disp. */
+#define MT_R        (2*DIM)                            /* disp. history */
+#define MT_V        (mt_voff)                          /* velocity history */
+#define MT_A        (mt_voff + DIM*mtau_levels*mtau_p) /* block sums */
+
+static int    mt_voff;          /* offset of velocity part of atom block */
+static int    mt_len;           /* length of one table of sums */
+static long   mt_nsample = 0;   /* number of samples taken */
+static double *mt_sum  = NULL;  /* sums: msqd and vacf, per thread */
+static double *mt_red  = NULL;  /* sums reduced for output */
+static double *mt_norm = NULL;  /* number of origins of each lag */
+#ifdef HC
+static long   hc_nsample = 0;   /* number of heat current samples */
+static real   *hc_hist, *hc_acc;
+static double *hc_sum, *hc_norm;
+#endif
+
+/******************************************************************************
+*
+*  allocate correlation sums
+*
+******************************************************************************/
+
+void init_mtau(void)
+{
+  int nthreads = 1, n = mtau_levels * mtau_p;
+
+#ifdef _OPENMP
+  nthreads = omp_get_max_threads();
+#endif
+  mt_voff = mtau_msqd ? DIM * (2 + n) : 0;
+  mt_len  = ntypes * n * DIM;
+  mt_sum  = (double *) calloc( 2 * mt_len * nthreads, sizeof(double) );
+  mt_red  = (double *) calloc( 2 * mt_len,            sizeof(double) );
+  mt_norm = (double *) calloc( n,                     sizeof(double) );
+  if ((NULL==mt_sum) || (NULL==mt_red) || (NULL==mt_norm))
+    error("Cannot allocate multi-tau correlation sums");
+#ifdef HC
+  hc_hist = (real   *) calloc( n * DIM,           sizeof(real)   );
+  hc_acc  = (real   *) calloc( mtau_levels * DIM, sizeof(real)   );
+  hc_sum  = (double *) calloc( n * DIM,           sizeof(double) );
+  hc_norm = (double *) calloc( n,                 sizeof(double) );
+  if ((NULL==hc_hist) || (NULL==hc_acc) || (NULL==hc_sum) || (NULL==hc_norm))
+    error("Cannot allocate multi-tau heat current correlation");
+#endif
+}
+
+/******************************************************************************
+*
+*  levels receiving sample k, and the number of values they already hold
+*
+******************************************************************************/
+
+static int mtau_schedule(long k, long *c)
+{
+  int  l;
+  long w = 1;
+
+  for (l=0; l<mtau_levels; l++) {
+    if ((k+1) % w) break;
+    c[l] = (k+1) / w - 1;
+    w *= mtau_m;
+  }
+  return l;
+}
+
+/******************************************************************************
+*
+*  first and last lag correlated at level l
+*
+******************************************************************************/
+
+static int mtau_jmin(int l, int sq)
+{
+  return (l > 0) ? mtau_p / mtau_m : (sq ? 1 : 0);
+}
+
+static int mtau_jmax(long c)
+{
+  return (c < mtau_p - 1) ? (int) c : mtau_p - 1;
+}
+
+/******************************************************************************
+*
+*  push a sample x into the multi-tau history of one series
+*
+*  hist holds mtau_p values per level, acc the block sums passed on to the
+*  next level (NULL if the series is decimated instead), sum the
+*  correlations, either mean square differences (sq) or products
+*
+******************************************************************************/
+
+static void mtau_push(real *x, int nl, long *c, real *hist, real *acc,
+                      double *sum, int sq)
+{
+  int  l, j, d, jmax;
+  real v[3], *y;
+
+  for (d=0; d<DIM; d++) v[d] = x[d];
+  for (l=0; l<nl; l++) {
+
+    /* the value at level l > 0 is the block average of level l-1 */
+    if ((l > 0) && (NULL != acc))
+      for (d=0; d<DIM; d++) {
+        v[d] = acc[(l-1)*DIM+d] / mtau_m;
+        acc[(l-1)*DIM+d] = 0.0;
+      }
+    if (NULL != acc)
+      for (d=0; d<DIM; d++) acc[l*DIM+d] += v[d];
+
+    /* store and correlate */
+    y = hist + (l * mtau_p + c[l] % mtau_p) * DIM;
+    for (d=0; d<DIM; d++) y[d] = v[d];
+    jmax = mtau_jmax(c[l]);
+    for (j=mtau_jmin(l,sq); j<=jmax; j++) {
+      y = hist + (l * mtau_p + (c[l] - j) % mtau_p) * DIM;
+      if (sq) for (d=0; d<DIM; d++)
+        sum[(l*mtau_p+j)*DIM+d] += SQR(v[d] - y[d]);
+      else    for (d=0; d<DIM; d++)
+        sum[(l*mtau_p+j)*DIM+d] += v[d] * y[d];
+    }
+  }
+}
+
+/******************************************************************************
+*
+*  count the origins of the lags of a sample
+*
+******************************************************************************/
+
+static void mtau_count(int nl, long *c, double *norm)
+{
+  int l, j, jmax;
+
+  for (l=0; l<nl; l++) {
+    jmax = mtau_jmax(c[l]);
+    for (j=mtau_jmin(l,0); j<=jmax; j++) norm[l*mtau_p+j] += 1.0;
+  }
+}
+
+/******************************************************************************
+*
+*  take a sample of displacements and velocities of all atoms
+*
+******************************************************************************/
+
+void update_mtau(void)
+{
+  long c[MTAU_MAXLEV];
+  int  nl, nthreads = 1, k, t;
+
+  nl = mtau_schedule(mt_nsample, c);
+
+#ifdef _OPENMP
+  nthreads = omp_get_max_threads();
+#pragma omp parallel for
+#endif
+  for (k=0; k<NCELLS; ++k) {
+    int    i, d;
+    cell   *p = CELLPTR(k);
+    double *sum = mt_sum;
+    real   x[3];
+    vektor dr;
+#ifdef _OPENMP
+    sum += 2 * mt_len * omp_get_thread_num();
+#endif
+    for (i=0; i<p->n; ++i) {
+      int s = SORTE(p,i) * mtau_levels * mtau_p * DIM;
+
+      /* unwrapped displacement since the first sample */
+      if (mtau_msqd) {
+        if (0==mt_nsample) {
+          MTAU_BUF(p,i,MT_ORT+0) = ORT(p,i,X);
+          MTAU_BUF(p,i,MT_ORT+1) = ORT(p,i,Y);
+#ifndef TWOD
+          MTAU_BUF(p,i,MT_ORT+2) = ORT(p,i,Z);
+#endif
+          for (d=0; d<DIM; d++) MTAU_BUF(p,i,MT_U+d) = 0.0;
+        }
+        dr.x = ORT(p,i,X) - MTAU_BUF(p,i,MT_ORT+0);
+        dr.y = ORT(p,i,Y) - MTAU_BUF(p,i,MT_ORT+1);
+#ifndef TWOD
+        dr.z = ORT(p,i,Z) - MTAU_BUF(p,i,MT_ORT+2);
+#endif
+        reduce_displacement(&dr);
+        x[0] = MTAU_BUF(p,i,MT_U+0) += dr.x;
+        x[1] = MTAU_BUF(p,i,MT_U+1) += dr.y;
+        MTAU_BUF(p,i,MT_ORT+0) = ORT(p,i,X);
+        MTAU_BUF(p,i,MT_ORT+1) = ORT(p,i,Y);
+#ifndef TWOD
+        x[2] = MTAU_BUF(p,i,MT_U+2) += dr.z;
+        MTAU_BUF(p,i,MT_ORT+2) = ORT(p,i,Z);
+#endif
+        mtau_push(x, nl, c, &MTAU_BUF(p,i,MT_R), NULL, sum + s, 1);
+      }
+
+      /* velocity */
+      if (mtau_vacf) {
+        if (0==mt_nsample)
+          for (d=0; d<DIM*mtau_levels; d++) MTAU_BUF(p,i,MT_A+d) = 0.0;
+        x[0] = IMPULS(p,i,X) / MASSE(p,i);
+        x[1] = IMPULS(p,i,Y) / MASSE(p,i);
+#ifndef TWOD
+        x[2] = IMPULS(p,i,Z) / MASSE(p,i);
+#endif
+        mtau_push(x, nl, c, &MTAU_BUF(p,i,MT_V), &MTAU_BUF(p,i,MT_A),
+                  sum + mt_len + s, 0);
+      }
+    }
+  }
+
+  /* add up the sums of the threads */
+  for (t=1; t<nthreads; t++)
+    for (k=0; k<2*mt_len; k++) {
+      mt_sum[k] += mt_sum[2*mt_len*t+k];
+      mt_sum[2*mt_len*t+k] = 0.0;
+    }
+
+  mtau_count(nl, c, mt_norm);
+  mt_nsample++;
+}
+
+#ifdef HC
+
+/******************************************************************************
+*
+*  take a sample of the heat current (on CPU 0)
+*
+******************************************************************************/
+
+void update_mtau_hc(vektor h)
+{
+  long c[MTAU_MAXLEV];
+  real x[3];
+  int  nl;
+
+  x[0] = h.x;
+  x[1] = h.y;
+#ifndef TWOD
+  x[2] = h.z;
+#endif
+  nl = mtau_schedule(hc_nsample, c);
+  mtau_push(x, nl, c, hc_hist, hc_acc, hc_sum, 0);
+  mtau_count(nl, c, hc_norm);
+  hc_nsample++;
+}
+
+#endif /* HC */
+
+/******************************************************************************
+*
+*  write one correlation table; sums are normalized by the number of
+*  origins and, if num is given, by the number of atoms of each type
+*
+******************************************************************************/
+
+static void write_mtau_table(char *suffix, char *name, double *sum,
+                             double *norm, int n, long *num, real dt, int sq)
+{
+  str255 fname;
+  FILE   *out;
+  int    l, j, t, d;
+  real   w = 1.0;
+  double f;
+
+  sprintf(fname, "%s.%s", outfilename, suffix);
+  out = fopen(fname, "w");
+  if (NULL == out) error_str("Cannot open %s file.", suffix);
+
+  fprintf(out, "# time");
+  for (t=0; t<n; t++) {
+    if (num) fprintf(out, " %s%d_x %s%d_y", name, t, name, t);
+    else     fprintf(out, " %s_x %s_y",     name,    name   );
+#ifndef TWOD
+    if (num) fprintf(out, " %s%d_z", name, t);
+    else     fprintf(out, " %s_z",   name   );
+#endif
+  }
+  fprintf(out, "\n");
+
+  for (l=0; l<mtau_levels; l++) {
+    for (j=mtau_jmin(l,sq); j<mtau_p; j++) {
+      if (0.0 == norm[l*mtau_p+j]) continue;
+      fprintf(out, "%10.4e", (double)(j * w * dt));
+      for (t=0; t<n; t++) {
+        f = norm[l*mtau_p+j];
+        if (num) f *= num[t];
+        for (d=0; d<DIM; d++)
+          fprintf(out, " %10.4e", (f > 0.0) ?
+            sum[((t*mtau_levels+l)*mtau_p+j)*DIM+d] / f : 0.0);
+      }
+      fprintf(out, "\n");
+    }
+    w *= mtau_m;
+  }
+  fclose(out);
+}
+
+/******************************************************************************
+*
+*  write correlations
+*
+******************************************************************************/
+
+void write_mtau(int steps)
+{
+  /* a single reduction of all sums */
+#ifdef MPI
+  MPI_Reduce( mt_sum, mt_red, 2*mt_len, MPI_DOUBLE, MPI_SUM, 0, cpugrid);
+#else
+  memcpy( mt_red, mt_sum, 2 * mt_len * sizeof(double) );
+#endif
+
+  if (0!=myid) return;
+
+  if (mtau_msqd)
+    write_mtau_table("mtmsqd", "type", mt_red, mt_norm, ntypes, num_sort,
+                     mtau_int * timestep, 1);
+  if (mtau_vacf)
+    write_mtau_table("vacf", "type", mt_red + mt_len, mt_norm, ntypes,
+                     num_sort, mtau_int * timestep, 0);
+#ifdef HC
+  if ((mtau_hc) && (hc_nsample > 0))
+    write_mtau_table("hcacf", "hc", hc_sum, hc_norm, 1, NULL,
+                     hc_int * timestep, 0);
+#endif
+}
@@ -12,6 +12,13 @@
 *
 * imd_neb -- functions for the NEB method
 *
+* Each image runs on its own group of CPUs. Without MPI, this is a single
+* CPU per image. With MPI, the CPUs of an image form a communicator with
+* the usual domain decomposition, and every CPU of an image is in charge
+* of a contiguous block of atom numbers for the NEB forces. Tangents and
+* spring forces are computed blockwise; the blocks are exchanged with the
+* CPUs holding the same block in the neighboring images.
+*
 ******************************************************************************/
 
 /******************************************************************************
@@ -27,9 +34,60 @@
 #define nebSPRODN(x,y) ( (x)[0]*(y)[0] + (x)[1]*(y)[1] + (x)[2]*(y)[2] )
 #endif
 
-/* auxiliary arrays */
+/* auxiliary arrays, for the block of atoms of this CPU */
 real *pos=NULL, *pos_l=NULL, *pos_r=NULL, *f=NULL, *tau=NULL, *dRleft=NULL, *dRright=NULL;
 
+/* tangent and spring force of the local atoms, in cell order */
+real *neb_tf=NULL;
+int  neb_tf_len=0;
+
+#ifdef MPI
+/* buffers for redistributing atoms between spatial and block owners */
+real *neb_sbuf=NULL, *neb_rbuf=NULL;
+int  neb_sbuf_len=0, neb_rbuf_len=0, neb_nrecv=0;
+int  *neb_nsnd, *neb_nrcv, *neb_off;            /* atoms per CPU */
+int  *neb_scnt, *neb_sdsp, *neb_rcnt, *neb_rdsp; /* reals per CPU */
+#endif
+
+/******************************************************************************
+*
+*  sum over all CPUs of the image
+*
+******************************************************************************/
+
+static real neb_sum(real x)
+{
+#ifdef MPI
+  real tmp;
+  MPI_Allreduce( &x, &tmp, 1, REAL, MPI_SUM, cpugrid);
+  return tmp;
+#else
+  return x;
+#endif
+}
+
+#ifdef MPI
+
+/******************************************************************************
+*
+*  exchange len reals per atom between the CPUs of the image
+*
+******************************************************************************/
+
+static void neb_alltoallv(real *sbuf, int *nsnd, real *rbuf, int *nrcv, int len)
+{
+  int i, ns = 0, nr = 0;
+
+  for (i=0; i<num_cpus; i++) {
+    neb_scnt[i] = len * nsnd[i];  neb_sdsp[i] = ns;  ns += neb_scnt[i];
+    neb_rcnt[i] = len * nrcv[i];  neb_rdsp[i] = nr;  nr += neb_rcnt[i];
+  }
+  MPI_Alltoallv( sbuf, neb_scnt, neb_sdsp, REAL,
+                 rbuf, neb_rcnt, neb_rdsp, REAL, cpugrid );
+}
+
+#endif
+
 /******************************************************************************
 *
 *  initialize MPI (NEB version)
@@ -41,11 +99,46 @@ void init_mpi(void)
   /* Initialize MPI */
   MPI_Comm_size(MPI_COMM_WORLD,&num_cpus);
   MPI_Comm_rank(MPI_COMM_WORLD,&myrank);
+#ifdef MPI
+  /* until the images are split off, parameters are read by CPU 0 only */
+  myid = myrank;
+#endif
   if (0 == myrank) { 
     printf("NEB: Starting up MPI with %d processes.\n", num_cpus);
   }
 }
 
+#ifdef MPI
+
+/******************************************************************************
+*
+*  split the CPUs into neb_nrep groups, one for each image
+*
+*  Afterwards, myrank is the number of the image, and myid and num_cpus
+*  refer to the CPUs of the image.
+*
+******************************************************************************/
+
+void neb_split_images(void)
+{
+  static int done = 0;
+  int nworld, wrank;
+
+  if (done) return;
+  done = 1;
+
+  MPI_Comm_size(MPI_COMM_WORLD, &nworld);
+  MPI_Comm_rank(MPI_COMM_WORLD, &wrank);
+  myrank = wrank / (nworld / neb_nrep);
+  MPI_Comm_split(MPI_COMM_WORLD, myrank, wrank, &neb_img_comm);
+  MPI_Comm_rank(neb_img_comm, &myid);
+  MPI_Comm_size(neb_img_comm, &num_cpus);
+  if ((0==myrank) && (0==myid))
+    printf("NEB: %d images with %d processes each.\n", neb_nrep, num_cpus);
+}
+
+#endif
+
 /******************************************************************************
 *
 *  shutdown MPI (NEB version)
@@ -72,15 +165,43 @@ void shutdown_mpi(void)
 
 void alloc_pos(void) 
 {
-  pos   = (real *) malloc( DIM * natoms * sizeof(real ) );
-  pos_l = (real *) malloc( DIM * natoms * sizeof(real ) );
-  pos_r = (real *) malloc( DIM * natoms * sizeof(real ) );
-  f     = (real *) malloc( DIM * natoms * sizeof(real ) );
-  tau   = (real *) malloc( DIM * natoms * sizeof(real ) );
-  dRleft= (real *) malloc( DIM * natoms * sizeof(real ) );
-  dRright= (real *) malloc( DIM * natoms * sizeof(real ) );
+  int nb;
+
+  /* block of atom numbers of this CPU */
+#ifdef MPI
+  nb = (natoms + num_cpus - 1) / num_cpus;
+  neb_nfirst = myid * nb;
+  neb_nblk   = MAX( 0, MIN( nb, natoms - neb_nfirst ) );
+#else
+  neb_nfirst = 0;
+  neb_nblk   = natoms;
+#endif
+  nb = MAX( 1, neb_nblk );
+
+  pos   = (real *) malloc( DIM * nb * sizeof(real ) );
+  pos_l = (real *) malloc( DIM * nb * sizeof(real ) );
+  pos_r = (real *) malloc( DIM * nb * sizeof(real ) );
+  f     = (real *) malloc( DIM * nb * sizeof(real ) );
+  tau   = (real *) malloc( DIM * nb * sizeof(real ) );
+  dRleft= (real *) malloc( DIM * nb * sizeof(real ) );
+  dRright= (real *) malloc( DIM * nb * sizeof(real ) );
   if ((NULL==pos) || (NULL==pos_l) || (NULL==pos_r) || (NULL==f)|| (NULL==tau)|| (NULL==dRleft) || (NULL==dRright))
     error("cannot allocate NEB position arrays");
+
+  /* the CPUs holding the same block in all images */
+#ifdef MPI
+  MPI_Comm_split(MPI_COMM_WORLD, myid, myrank, &neb_rep_comm);
+  neb_nsnd = (int *) malloc( 7 * num_cpus * sizeof(int) );
+  if (NULL==neb_nsnd) error("cannot allocate NEB communication arrays");
+  neb_nrcv = neb_nsnd + 1 * num_cpus;
+  neb_off  = neb_nsnd + 2 * num_cpus;
+  neb_scnt = neb_nsnd + 3 * num_cpus;
+  neb_sdsp = neb_nsnd + 4 * num_cpus;
+  neb_rcnt = neb_nsnd + 5 * num_cpus;
+  neb_rdsp = neb_nsnd + 6 * num_cpus;
+#else
+  neb_rep_comm = MPI_COMM_WORLD;
+#endif
 }
 
 /******************************************************************************
@@ -111,7 +232,7 @@ void read_atoms_neb(str255 infilename)
     sprintf(outfilename, "%s.%02d", neb_outfilename, 0);
     write_eng_file_header();
     write_eng_file(0);
-    fclose(eng_file);
+    if (NULL != eng_file) fclose(eng_file);
     eng_file = NULL;
   }
 
@@ -127,7 +248,7 @@ void read_atoms_neb(str255 infilename)
     sprintf(outfilename, "%s.%02d", neb_outfilename, neb_nrep-1);
     write_eng_file_header();
     write_eng_file(0);
-    fclose(eng_file);
+    if (NULL != eng_file) fclose(eng_file);
     eng_file = NULL;
   }
 
@@ -135,7 +256,10 @@ void read_atoms_neb(str255 infilename)
   {
       /* read positions of my configuration */
       sprintf(fname, "%s.%02d", infilename, myrank);
-      printf("rank: %d reading  %s.%02d\n",myrank, infilename, myrank);fflush(stdout);
+      if (0==myid) {
+        printf("rank: %d reading  %s.%02d\n",myrank, infilename, myrank);
+        fflush(stdout);
+      }
       read_atoms(fname);
       if (NULL==pos) alloc_pos();
       sprintf(outfilename, "%s.%02d", neb_outfilename, myrank);
@@ -153,6 +277,63 @@ void neb_sendrecv_pos(void)
   int i, k, n, cpu_l, cpu_r;
   MPI_Status status;
 
+#ifdef MPI
+  int nb = (natoms + num_cpus - 1) / num_cpus, nloc = 0;
+
+  /* count the local atoms for each block owner */
+  for (i=0; i<num_cpus; i++) neb_nsnd[i] = 0;
+  for (k=0; k<NCELLS; k++) {
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; i++) {
+      if ((NUMMER(p,i) < 0) || (NUMMER(p,i) >= natoms))
+        error("NEB requires atom numbers in the range 0..natoms-1");
+      neb_nsnd[ NUMMER(p,i) / nb ]++;
+    }
+    nloc += p->n;
+  }
+  MPI_Alltoall( neb_nsnd, 1, MPI_INT, neb_nrcv, 1, MPI_INT, cpugrid );
+  neb_nrecv = 0;
+  for (i=0; i<num_cpus; i++) neb_nrecv += neb_nrcv[i];
+
+  /* buffers are large enough for the way back, too */
+  if (neb_sbuf_len < 2 * DIM * nloc) {
+    neb_sbuf_len = 2 * DIM * nloc;
+    neb_sbuf = (real *) realloc( neb_sbuf, neb_sbuf_len * sizeof(real) );
+    if (NULL==neb_sbuf) error("cannot allocate NEB send buffer");
+  }
+  if (neb_rbuf_len < 2 * DIM * neb_nrecv) {
+    neb_rbuf_len = 2 * DIM * neb_nrecv;
+    neb_rbuf = (real *) realloc( neb_rbuf, neb_rbuf_len * sizeof(real) );
+    if (NULL==neb_rbuf) error("cannot allocate NEB receive buffer");
+  }
+
+  /* pack number and position, sorted by block owner */
+  n = 0;
+  for (i=0; i<num_cpus; i++) {
+    neb_off[i] = n;
+    n += neb_nsnd[i];
+  }
+  for (k=0; k<NCELLS; k++) {
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; i++) {
+      real *b = neb_sbuf + 4 * neb_off[ NUMMER(p,i) / nb ]++;
+      b[0] = (real) NUMMER(p,i);
+      b[1] = ORT(p,i,X);
+      b[2] = ORT(p,i,Y);
+      b[3] = ORT(p,i,Z);
+    }
+  }
+  neb_alltoallv( neb_sbuf, neb_nsnd, neb_rbuf, neb_nrcv, 4 );
+
+  /* fill pos array with my block */
+  for (i=0; i<neb_nrecv; i++) {
+    real *b = neb_rbuf + 4 * i;
+    n = (int) b[0] - neb_nfirst;
+    pos X(n) = b[1];
+    pos Y(n) = b[2];
+    pos Z(n) = b[3];
+  }
+#else
   /* fill pos array */
   for (k=0; k<NCELLS; k++) {
     cell *p = CELLPTR(k);
@@ -163,20 +344,80 @@ void neb_sendrecv_pos(void)
       pos Z(n) = ORT(p,i,Z);
     }
   }
+#endif
 
   /* ranks of left/right cpus */
   cpu_l = (0            == myrank) ? MPI_PROC_NULL : myrank - 1;
   cpu_r = (neb_nrep - 1 == myrank) ? MPI_PROC_NULL : myrank + 1;
 
   /* send positions to right, receive from left */
-  MPI_Sendrecv(pos,   DIM*natoms, REAL, cpu_r, BUFFER_TAG,
-	       pos_l, DIM*natoms, REAL, cpu_l, BUFFER_TAG,
-	       MPI_COMM_WORLD, &status );
+  MPI_Sendrecv(pos,   DIM*neb_nblk, REAL, cpu_r, BUFFER_TAG,
+	       pos_l, DIM*neb_nblk, REAL, cpu_l, BUFFER_TAG,
+	       neb_rep_comm, &status );
 
   /* send positions to left, receive from right */
-  MPI_Sendrecv(pos,   DIM*natoms, REAL, cpu_l, BUFFER_TAG,
-	       pos_r, DIM*natoms, REAL, cpu_r, BUFFER_TAG,
-	       MPI_COMM_WORLD, &status );
+  MPI_Sendrecv(pos,   DIM*neb_nblk, REAL, cpu_l, BUFFER_TAG,
+	       pos_r, DIM*neb_nblk, REAL, cpu_r, BUFFER_TAG,
+	       neb_rep_comm, &status );
+}
+
+/******************************************************************************
+*
+*  get tangent and spring force of the local atoms from the block owners
+*
+******************************************************************************/
+
+void neb_recv_tangent(void)
+{
+  int i, k, n, nloc = 0;
+#ifdef MPI
+  int nb = (natoms + num_cpus - 1) / num_cpus;
+#endif
+
+  for (k=0; k<NCELLS; k++) nloc += CELLPTR(k)->n;
+  if (neb_tf_len < 2 * DIM * nloc) {
+    neb_tf_len = 2 * DIM * nloc;
+    neb_tf = (real *) realloc( neb_tf, neb_tf_len * sizeof(real) );
+    if (NULL==neb_tf) error("cannot allocate NEB tangent buffer");
+  }
+
+#ifdef MPI
+  /* send back in the order the positions came in; going backwards,
+     the number of an atom is read before its slot is overwritten */
+  for (i=neb_nrecv-1; i>=0; i--) {
+    real *b = neb_rbuf + 2 * DIM * i;
+    n = (int) neb_rbuf[4 * i] - neb_nfirst;
+    b[0] = tau X(n);  b[1] = tau Y(n);  b[2] = tau Z(n);
+    b[3] = f   X(n);  b[4] = f   Y(n);  b[5] = f   Z(n);
+  }
+  neb_alltoallv( neb_rbuf, neb_nrcv, neb_sbuf, neb_nsnd, 2 * DIM );
+
+  /* unpack in cell order */
+  n = 0;
+  for (i=0; i<num_cpus; i++) {
+    neb_off[i] = n;
+    n += neb_nsnd[i];
+  }
+  nloc = 0;
+  for (k=0; k<NCELLS; k++) {
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; i++) {
+      real *b = neb_sbuf + 2 * DIM * neb_off[ NUMMER(p,i) / nb ]++;
+      memcpy( neb_tf + 2 * DIM * nloc++, b, 2 * DIM * sizeof(real) );
+    }
+  }
+#else
+  nloc = 0;
+  for (k=0; k<NCELLS; k++) {
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; i++) {
+      real *b = neb_tf + 2 * DIM * nloc++;
+      n = NUMMER(p,i);
+      b[0] = tau X(n);  b[1] = tau Y(n);  b[2] = tau Z(n);
+      b[3] = f   X(n);  b[4] = f   Y(n);  b[5] = f   Z(n);
+    }
+  }
+#endif
 }
 
 /******************************************************************************
@@ -207,7 +448,7 @@ void calc_forces_neb(void)
 
   /* get info about the energies of the different images */
   neb_image_energies[ myimage]=tot_pot_energy;
-  MPI_Allreduce(neb_image_energies , neb_epot_im, NEB_MAXNREP, REAL, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(neb_image_energies , neb_epot_im, NEB_MAXNREP, REAL, MPI_SUM, neb_rep_comm);
   Emax=-999999999999999;
   Emin=999999999999999;
   for(i=0;i<neb_nrep;i++)
@@ -238,7 +479,7 @@ void calc_forces_neb(void)
       else
 	{
 	  neb_climbing_image = maximage;
-	  if(myrank==0)
+	  if((myrank==0) && (myid==0))
 	    {
 	      printf("Starting climbing image, image set to %d (= max_Epot = %lf)\n",maximage, Emax);
 	    }
@@ -273,7 +514,7 @@ void calc_forces_neb(void)
 	tmp_neb_ks[myimage] = neb_k;
       }
   }
-  MPI_Allreduce(tmp_neb_ks , neb_ks, NEB_MAXNREP, REAL, MPI_SUM, MPI_COMM_WORLD); 
+  MPI_Allreduce(tmp_neb_ks , neb_ks, NEB_MAXNREP, REAL, MPI_SUM, neb_rep_comm); 
 
   /* exchange positions with neighbor replicas */
   neb_sendrecv_pos();
@@ -287,7 +528,7 @@ void calc_forces_neb(void)
       kl = 0.5 * (neb_ks[myimage]+neb_ks[myimage-1]);
 
       /* preparation: calculate distance to left and right immage */
-       for (i=0; i<DIM*natoms; i+=DIM) {
+       for (i=0; i<DIM*neb_nblk; i+=DIM) {
 	 vektor dr,dl;	
 	 real x;
 	 dl.x = pos  [i  ] - pos_l[i  ];
@@ -343,7 +584,7 @@ void calc_forces_neb(void)
       if ( ( V_next > V_actual ) && ( V_actual > V_previous ) )
 	{
 
-	  for (i=0; i<DIM*natoms; i+=DIM) {
+	  for (i=0; i<DIM*neb_nblk; i+=DIM) {
 	    tau[i  ] = dRright[i  ];
 	    tau[i+1] = dRright[i+1];
 	    tau[i+2] = dRright[i+2];
@@ -352,8 +593,9 @@ void calc_forces_neb(void)
 	    d2  += dRright[i+2]*dRright[i+2];
 	  }
 	  
+	  d2 = neb_sum(d2);
 	  tmp=1.0/sqrt(d2);
-	  for (i=0; i<DIM*natoms; i+=DIM) {
+	  for (i=0; i<DIM*neb_nblk; i+=DIM) {
 	    tau[i  ] *= tmp;
 	    tau[i+1] *= tmp;
 	    tau[i+2] *= tmp;
@@ -374,7 +616,7 @@ void calc_forces_neb(void)
 	}
       else if ( ( V_next < V_actual ) && ( V_actual < V_previous ) ) 
 	{
-	  for (i=0; i<DIM*natoms; i+=DIM) {
+	  for (i=0; i<DIM*neb_nblk; i+=DIM) {
 	    tau[i  ] = dRleft[i  ];
 	    tau[i+1] = dRleft[i+1];
 	    tau[i+2] = dRleft[i+2];
@@ -383,8 +625,9 @@ void calc_forces_neb(void)
 	    d2  += dRleft[i+2]*dRleft[i+2];
 	  }
 	  
+	  d2 = neb_sum(d2);
 	  tmp=1.0/sqrt(d2);
-	  for (i=0; i<DIM*natoms; i+=DIM) {
+	  for (i=0; i<DIM*neb_nblk; i+=DIM) {
 	    tau[i  ] *= tmp;
 	    tau[i+1] *= tmp;
 	    tau[i+2] *= tmp;
@@ -413,7 +656,7 @@ void calc_forces_neb(void)
 	  deltaVmax    = MAX( abs_next, abs_previous );
 	  deltaVmin    = MIN( abs_next, abs_previous );
 
-	  for (i=0; i<DIM*natoms; i+=DIM) {
+	  for (i=0; i<DIM*neb_nblk; i+=DIM) {
 	    dr2  += dRright[i  ]*dRright[i  ];
 	    dr2  += dRright[i+1]*dRright[i+1];
 	    dr2  += dRright[i+2]*dRright[i+2];
@@ -421,10 +664,12 @@ void calc_forces_neb(void)
 	    dl2  += dRleft[i+1]*dRleft[i+1];
 	    dl2  += dRleft[i+2]*dRleft[i+2];
 	  }
+	  dl2 = neb_sum(dl2);
+	  dr2 = neb_sum(dr2);
 	  tmpl=1.0/sqrt(dl2);
 	  tmpr=1.0/sqrt(dr2);
 
-	  for (i=0; i<DIM*natoms; i+=DIM) {
+	  for (i=0; i<DIM*neb_nblk; i+=DIM) {
 	    vektor dl, dr;
 	    dr.x =  dRright[i  ]*tmpr;
 	    dr.y =  dRright[i+1]*tmpr;
@@ -456,8 +701,9 @@ void calc_forces_neb(void)
 	    d2  += tau[i+1]*tau[i+1];
 	    d2  += tau[i+2]*tau[i+2];
 	  }
+	  d2 = neb_sum(d2);
 	  tmp=1.0/sqrt(d2);
-	  for (i=0; i<DIM*natoms; i+=DIM) {	 
+	  for (i=0; i<DIM*neb_nblk; i+=DIM) {	 
 	    tau[i  ] *= tmp;
 	    tau[i+1] *= tmp;
 	    tau[i+2] *= tmp;
@@ -479,8 +725,10 @@ void calc_forces_neb(void)
 	  }
 	}
 
+      felastfact = neb_sum(felastfact);
+
       /* finally construct the spring force */
-      for (i=0; i<DIM*natoms; i+=DIM) {
+      for (i=0; i<DIM*neb_nblk; i+=DIM) {
 	if (var_k==1)
 	  {
 	    f[i  ] = - tau[i  ] *felastfact;
@@ -500,36 +748,43 @@ void calc_forces_neb(void)
   /* calculate the neb-force */
  if(myrank != 0 && myrank != neb_nrep-1)
   {
+      int nloc;
+
+      /* tangent and spring force of my atoms */
+      neb_recv_tangent();
 
     // first scalar product of -force and tangent vector 
       tmp = 0.0;
+      nloc = 0;
       for (k=0; k<NCELLS; k++) {
 	cell *p = CELLPTR(k);
 	for (i=0; i<p->n; i++) { 
-	  int n = NUMMER(p,i);
-	  tmp -= tau X(n) * KRAFT(p,i,X);
-	  tmp -= tau Y(n) * KRAFT(p,i,Y);
-	  tmp -= tau Z(n) * KRAFT(p,i,Z);
+	  real *t = neb_tf + 2 * DIM * nloc++;
+	  tmp -= t[0] * KRAFT(p,i,X);
+	  tmp -= t[1] * KRAFT(p,i,Y);
+	  tmp -= t[2] * KRAFT(p,i,Z);
 	}
       }
+      tmp = neb_sum(tmp);
      
       // add tmp times the tangent vector
       // and the spring force
+      nloc = 0;
       for (k=0; k<NCELLS; k++) {
 	cell *p = CELLPTR(k);
 	for (i=0; i<p->n; i++) { 
-	  int n = NUMMER(p,i);
+	  real *t = neb_tf + 2 * DIM * nloc++;
 	  if(myimage == neb_climbing_image && (steps >= neb_cineb_start))
 	    {
-	      KRAFT(p,i,X) += 2.0*tmp * tau X(n);
-	      KRAFT(p,i,Y) += 2.0*tmp * tau Y(n);
-	      KRAFT(p,i,Z) += 2.0*tmp * tau Z(n);
+	      KRAFT(p,i,X) += 2.0*tmp * t[0];
+	      KRAFT(p,i,Y) += 2.0*tmp * t[1];
+	      KRAFT(p,i,Z) += 2.0*tmp * t[2];
 	    }
 	  else
 	    {
-	      KRAFT(p,i,X) += tmp * tau X(n) + f X(n);
-	      KRAFT(p,i,Y) += tmp * tau Y(n) + f Y(n);
-	      KRAFT(p,i,Z) += tmp * tau Z(n) + f Z(n);
+	      KRAFT(p,i,X) += tmp * t[0] + t[3];
+	      KRAFT(p,i,Y) += tmp * t[1] + t[4];
+	      KRAFT(p,i,Z) += tmp * t[2] + t[5];
 	    }
 
 	  
@@ -38,35 +38,35 @@ int icoFaces[20][3] = {
 	{6,1,10}, {9,0,11}, {9,11,2}, {9,2,5}, {7,2,11}
 };
 
-nyeTensorInfo* alloc_nyeTensorInfo(void) {
-	nyeTensorInfo *info = (nyeTensorInfo*) malloc(sizeof(nyeTensorInfo));
+#define NYE_MAXLIST 256	/* max. atoms within two hops of a defect */
 
-	info->lcm[0][0] = 1.;  info->lcm[1][0] = 0.; info->lcm[2][0] = 0.;
-	info->lcm[0][1] = 0.;  info->lcm[1][1] = 1.; info->lcm[2][1] = 0.;
-	info->lcm[0][2] = 0.;  info->lcm[1][2] = 0.; info->lcm[2][2] = 1.;
+/*
+ * Reset a record to the identity lattice correspondence
+ */
+static void init_nyeTensorInfo(nyeTensorInfo *info) {
+	int i, j;
 
-	info->bv[0] = 0.; info->bv[1] = 0.; info->bv[2] = 0.;
-	info->ls[0] = 0.; info->ls[1] = 0.; info->ls[2] = 0.;
-	return info;
+	for (i = 0; i < 3; i++) {
+		for (j = 0; j < 3; j++) {
+			info->lcm[i][j] = (i == j) ? 1. : 0.;
+			info->nyeTensor[i][j] = 0.;
+		}
+		info->bv[i] = 0.;
+		info->ls[i] = 0.;
+	}
+	info->valid = 1;
 }
 
 /*
- * Free all memory allocated for nyeTensorInfo including the buffer cells
+ * Invalidate the records of all cells including the buffer cells
  */
 void removeNyeTensorData(){
-	int i,j,k,l;
-	for (i = 0; i < cell_dim.x; ++i){
-		for (j = 0; j < cell_dim.y; ++j){
-			for (k = 0; k < cell_dim.z; ++k){
-				cell *p = PTR_3D_V(cell_array, i, j, k, cell_dim);
-				for (l = 0; l < p->n; l++) {
-					if (p->nyeTens[l] != NULL) {
-						free(p->nyeTens[l]);
-						p->nyeTens[l] = NULL;
-					}
-				}
-			}
-		}
+	int i, k;
+
+	for (k = 0; k < nallcells; k++) {
+		cell *p = cell_array + k;
+		for (i = 0; i < p->n; i++)
+			NYE(p,i)->valid = 0;
 	}
 }
 
@@ -82,6 +82,7 @@ void init_NyeTensor(){
 			ada_nbr_r2cut = SQR(0.862*ada_latticeConst);
 		}
 	}
+	nnbr_r2cut = MAX(nnbr_r2cut, ada_nbr_r2cut);
 
 	if (ada_crystal_structure == ADA_FCC_CONFIG || ada_crystal_structure == ADA_ACKLAND_CONFIG){
 		integrationRadius = 0.707107 * ada_latticeConst; /*Nearest neighbor distance*/
@@ -235,48 +236,19 @@ int matrixInverse(real m[3][3]){
  * match the local configuration of nearest neighbor bonds to a reference structure
  */
 void calculateLcm(cell *p, int n) {
-	int i, j, ii, invertible, best;
+	int i, j, invertible, best;
 	real l, bestAngle, angle;
-	int nneigh = NEIGH(p, n)->n;
-	real neigh[nneigh][3];
+	neightab *nb = NEIGH(p, n);
 	nyeTensorInfo *nti;
 	real *nei;
 
-	for (i = 0; i < nneigh; i++) {
-		cell *q = NEIGH(p, n)->cl[i];
-		ii = NEIGH(p, n)->num[i];
-
-		neigh[i][0] = ORT(q,ii,X) - ORT(p,n,X);
-		neigh[i][1] = ORT(q,ii,Y) - ORT(p,n,Y);
-		neigh[i][2] = ORT(q,ii,Z) - ORT(p,n,Z);
-
-		if (pbc_dirs.x) {
-			if (neigh[i][0] < -box_x.x * 0.5)
-				neigh[i][0] += box_x.x;
-			else if (neigh[i][0] > box_x.x * 0.5)
-				neigh[i][0] -= box_x.x;
-		}
-		if (pbc_dirs.y) {
-			if (neigh[i][1] < -box_y.y * 0.5)
-				neigh[i][1] += box_y.y;
-			else if (neigh[i][1] > box_y.y * 0.5)
-				neigh[i][1] -= box_y.y;
-		}
-		if (pbc_dirs.z) {
-			if (neigh[i][2] < -box_z.z * 0.5)
-				neigh[i][2] += box_z.z;
-			else if (neigh[i][2] > box_z.z * 0.5)
-				neigh[i][2] -= box_z.z;
-		}
-	}
-
 	real a[3][3] = {{0.,0.,0.},{0.,0.,0.},{0.,0.,0.}};
 	real b[3][3] = {{0.,0.,0.},{0.,0.,0.},{0.,0.,0.}};
 
-	for (i = 0; i < nneigh; i++) {
+	for (i = 0; i < nb->n; i++) {
 		bestAngle = -1.;
 		best = 0;
-		nei = neigh[i];
+		nei = nb->dist + 3*i;
 		l = SQRT(SPRODA3D(nei,nei));
 		for (j = 0; j < neighPerfLength; j++) {
 			angle = SPRODA3D(nei, neighPerf[j]) / (l*neighPerfDistance[j]);
@@ -326,96 +298,52 @@ void calculateLcm(cell *p, int n) {
 	}
 }
 
+/*
+ * Gradient of the lattice correspondence matrix by least squares over the
+ * neighbor bonds. The normal matrix sum(d d^T) is the same for all nine
+ * components, so it is built and inverted once, and the right hand sides
+ * of all components are accumulated together in one pass.
+ */
 void calculateNye(cell *p, int n){
-	int i, j, ii, k;
-	int nneigh = NEIGH(p, n)->n;
-	real neigh[nneigh][3];
-	real neighT[nneigh][3][3];
-	real grd[3][3][3];
-	nyeTensorInfo *nti, *ntiNeigh;
-	real e0, de;
-
-	nti = NYE(p,n);
-
-	for (i = 0; i < nneigh; i++) {
-		cell *q = NEIGH(p, n)->cl[i];
-		ii = NEIGH(p, n)->num[i];
-
-		neigh[i][0] = ORT(q,ii,X) - ORT(p,n,X);
-		neigh[i][1] = ORT(q,ii,Y) - ORT(p,n,Y);
-		neigh[i][2] = ORT(q,ii,Z) - ORT(p,n,Z);
-
-		if (pbc_dirs.x) {
-			if (neigh[i][0] < -box_x.x * 0.5)
-				neigh[i][0] += box_x.x;
-			else if (neigh[i][0] > box_x.x * 0.5)
-				neigh[i][0] -= box_x.x;
-		}
-		if (pbc_dirs.y) {
-			if (neigh[i][1] < -box_y.y * 0.5)
-				neigh[i][1] += box_y.y;
-			else if (neigh[i][1] > box_y.y * 0.5)
-				neigh[i][1] -= box_y.y;
-		}
-		if (pbc_dirs.z) {
-			if (neigh[i][2] < -box_z.z * 0.5)
-				neigh[i][2] += box_z.z;
-			else if (neigh[i][2] > box_z.z * 0.5)
-				neigh[i][2] -= box_z.z;
+	int i, j, k;
+	neightab *nb = NEIGH(p, n);
+	nyeTensorInfo *nti = NYE(p,n);
+	real *e0 = &nti->lcm[0][0];
+	real a[3][3] = {{0.,0.,0.},{0.,0.,0.},{0.,0.,0.}};
+	real c[9][3], grd[3][3][3];
+
+	for (j = 0; j < 9; j++)
+		c[j][0] = c[j][1] = c[j][2] = 0.;
+
+	for (k = 0; k < nb->n; k++) {
+		real *d = nb->dist + 3*k;
+		real *e = &NYE((cell *) nb->cl[k], nb->num[k])->lcm[0][0];
+
+		a[0][0] += d[0] * d[0]; a[0][1] += d[0] * d[1]; a[0][2] += d[0] * d[2];
+		a[1][0] += d[1] * d[0]; a[1][1] += d[1] * d[1]; a[1][2] += d[1] * d[2];
+		a[2][0] += d[2] * d[0]; a[2][1] += d[2] * d[1]; a[2][2] += d[2] * d[2];
+
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+		for (j = 0; j < 9; j++) {
+			real de = e[j] - e0[j];
+			c[j][0] += d[0] * de;
+			c[j][1] += d[1] * de;
+			c[j][2] += d[2] * de;
 		}
 	}
 
-	for (i = 0; i < nneigh; i++) {
-		neighT[i][0][0] = neigh[i][0] * neigh[i][0];
-		neighT[i][0][1] = neigh[i][0] * neigh[i][1];
-		neighT[i][0][2] = neigh[i][0] * neigh[i][2];
-
-		neighT[i][1][0] = neigh[i][1] * neigh[i][0];
-		neighT[i][1][1] = neigh[i][1] * neigh[i][1];
-		neighT[i][1][2] = neigh[i][1] * neigh[i][2];
-
-		neighT[i][2][0] = neigh[i][2] * neigh[i][0];
-		neighT[i][2][1] = neigh[i][2] * neigh[i][1];
-		neighT[i][2][2] = neigh[i][2] * neigh[i][2];
-	}
-
+	matrixInverse(a);
 	for (i = 0; i < 3; i++) {
 		for (j = 0; j < 3; j++) {
-			e0 = nti->lcm[i][j];
-			real a[3][3] = {{0.,0.,0.},{0.,0.,0.},{0.,0.,0.}};
-			real c[3] = {0.,0.,0.};
-			for (k = 0; k < nneigh; k++) {
-				a[0][0] += neighT[k][0][0];
-				a[0][1] += neighT[k][0][1];
-				a[0][2] += neighT[k][0][2];
-
-				a[1][0] += neighT[k][1][0];
-				a[1][1] += neighT[k][1][1];
-				a[1][2] += neighT[k][1][2];
-
-				a[2][0] += neighT[k][2][0];
-				a[2][1] += neighT[k][2][1];
-				a[2][2] += neighT[k][2][2];
-
-				cell *q = NEIGH(p, n)->cl[k];
-				ii = NEIGH(p, n)->num[k];
-				ntiNeigh = NYE(q,ii);
-
-				de = ntiNeigh->lcm[i][j] - e0;
-
-				c[0] += neigh[k][0] * de;
-				c[1] += neigh[k][1] * de;
-				c[2] += neigh[k][2] * de;
-			}
-
-			matrixInverse(a);
-			grd[i][j][0] = c[0] * a[0][0] + c[1] * a[0][1] + c[2] * a[0][2];
-			grd[i][j][1] = c[0] * a[1][0] + c[1] * a[1][1] + c[2] * a[1][2];
-			grd[i][j][2] = c[0] * a[2][0] + c[1] * a[2][1] + c[2] * a[2][2];
+			real *cc = c[3*i+j];
+			grd[i][j][0] = cc[0] * a[0][0] + cc[1] * a[0][1] + cc[2] * a[0][2];
+			grd[i][j][1] = cc[0] * a[1][0] + cc[1] * a[1][1] + cc[2] * a[1][2];
+			grd[i][j][2] = cc[0] * a[2][0] + cc[1] * a[2][1] + cc[2] * a[2][2];
 		}
 	}
 
-
 	for (i = 0; i < 3; i++) {
 		nti->nyeTensor[0][i] = -grd[2][i][1] + grd[1][i][2];
 		nti->nyeTensor[1][i] = -grd[0][i][2] + grd[2][i][0];
@@ -423,273 +351,161 @@ void calculateNye(cell *p, int n){
 	}
 }
 
+/*
+ * Collect the central atom, its nearest neighbors and their nearest neighbors,
+ * with positions relative to the central atom (from the neighbor tables) and
+ * a copy of their Nye tensors, in contiguous arrays
+ */
+static int nye_gather(cell *p, int i, real rel[][3], real nt[][9]) {
+	neightab *nb = NEIGH(p, i);
+	cell *cl[NYE_MAXLIST];
+	int num[NYE_MAXLIST];
+	int j, l, m, n = 0, ok;
+
+	cl[n] = p; num[n] = i;
+	rel[n][0] = 0.; rel[n][1] = 0.; rel[n][2] = 0.;
+	n++;
+
+	for (j = 0; j < nb->n && n < NYE_MAXLIST; j++) {
+		cl[n] = (cell *) nb->cl[j]; num[n] = nb->num[j];
+		rel[n][0] = nb->dist[3*j]; rel[n][1] = nb->dist[3*j+1]; rel[n][2] = nb->dist[3*j+2];
+		n++;
+	}
 
-int interpolateLineSense(real x, real y, real z, real distSqr,
-		cell **neiCells, int *neiIndices, int n, real interpolated[3][3]) {
-
-	real distances[n];	/*Distances from atom to interpolation point*/
-	real sum = 0.;
-	int i;
-	real d_x, d_y, d_z, dis, d;
-
-	interpolated[0][0] = 0.; interpolated[0][1] = 0.; interpolated[0][2] = 0.;
-	interpolated[1][0] = 0.; interpolated[1][1] = 0.; interpolated[1][2] = 0.;
-	interpolated[2][0] = 0.; interpolated[2][1] = 0.; interpolated[2][2] = 0.;
-
-	for (i=0; i<n;i++) {
-		d_x = x - ORT(neiCells[i],neiIndices[i],X);
-		d_y = y - ORT(neiCells[i],neiIndices[i],Y);
-		d_z = z - ORT(neiCells[i],neiIndices[i],Z);
-
-		if (pbc_dirs.x) {
-			if (d_x < -box_x.x * 0.5)
-			d_x += box_x.x;
-			else if (d_x > box_x.x * 0.5)
-			d_x -= box_x.x;
-		}
-		if (pbc_dirs.y) {
-			if (d_y < -box_y.y * 0.5)
-			d_y += box_y.y;
-			else if (d_y > box_y.y * 0.5)
-			d_y -= box_y.y;
-		}
-		if (pbc_dirs.z) {
-			if (d_z < -box_z.z * 0.5)
-			d_z += box_z.z;
-			else if (d_z > box_z.z * 0.5)
-			d_z -= box_z.z;
-		}
-
-		dis = d_x*d_x + d_y*d_y + d_z*d_z;
-		//Store the distance if it is below the threshold, otherwise save 0.
-		if ( dis < distSqr) {
-			distances[i] = 1./dis;
-			sum += distances[i];
-		} else {
-			distances[i] = 0.;
+	for (j = 0; j < nb->n; j++) {
+		neightab *nb2 = NEIGH((cell *) nb->cl[j], nb->num[j]);
+		real *d1 = nb->dist + 3*j;
+		for (l = 0; l < nb2->n; l++) {
+			cell *r = (cell *) nb2->cl[l];
+			int iii = nb2->num[l];
+			/*Test if this atom is already inserted in the list*/
+			ok = 1;
+			for (m = 0; m < n; m++) {
+				if (cl[m] == r && num[m] == iii) {
+					ok = 0;
+					break;
+				}
+			}
+			if (!ok) continue;
+			if (n == NYE_MAXLIST)
+				error("NYETENSOR: too many atoms around a defect");
+			cl[n] = r; num[n] = iii;
+			rel[n][0] = d1[0] + nb2->dist[3*l];
+			rel[n][1] = d1[1] + nb2->dist[3*l+1];
+			rel[n][2] = d1[2] + nb2->dist[3*l+2];
+			n++;
 		}
 	}
 
-	if (sum>0) {
-		for (i=0; i<n; i++) {
-			nyeTensorInfo *nyeInfo = NYE(neiCells[i],neiIndices[i]);
-			interpolated[0][0] += (nyeInfo->nyeTensor[0][0]) * distances[i];
-			interpolated[0][1] += (nyeInfo->nyeTensor[1][0]) * distances[i];
-			interpolated[0][2] += (nyeInfo->nyeTensor[2][0]) * distances[i];
-
-			interpolated[1][0] += (nyeInfo->nyeTensor[0][1]) * distances[i];
-			interpolated[1][1] += (nyeInfo->nyeTensor[1][1]) * distances[i];
-			interpolated[1][2] += (nyeInfo->nyeTensor[2][1]) * distances[i];
-
-			interpolated[2][0] += (nyeInfo->nyeTensor[0][2]) * distances[i];
-			interpolated[2][1] += (nyeInfo->nyeTensor[1][2]) * distances[i];
-			interpolated[2][2] += (nyeInfo->nyeTensor[2][2]) * distances[i];
-		}
-		d = 1./sum;
-		interpolated[0][0] *= d; interpolated[1][0] *= d; interpolated[2][0] *= d;
-		interpolated[0][1] *= d; interpolated[1][1] *= d; interpolated[2][1] *= d;
-		interpolated[0][2] *= d; interpolated[1][2] *= d; interpolated[2][2] *= d;
-	} else return 0;
-	return 1;
+	for (m = 0; m < n; m++) {
+		real *t = &NYE(cl[m], num[m])->nyeTensor[0][0];
+		for (j = 0; j < 9; j++) nt[m][j] = t[j];
+	}
+	return n;
 }
 
-void interpolateBurgersVector(real x, real y, real z, real distSqr,
-		cell **neiCells, int *neiIndices, int n, real norm[3], real nyeInter[3]) {
-
-	real distances[n];	/*Distances from atom to interpolation point*/
-	real sum = 0.;
-	int i;
-	real d_x, d_y, d_z, dis, d;
-
-	nyeInter[0] = 0.; nyeInter[1] = 0.; nyeInter[2] = 0.;
-
-	for (i=0; i<n;i++) {
-		d_x = x - ORT(neiCells[i],neiIndices[i],X);
-		d_y = y - ORT(neiCells[i],neiIndices[i],Y);
-		d_z = z - ORT(neiCells[i],neiIndices[i],Z);
-
-		if (pbc_dirs.x) {
-			if (d_x < -box_x.x * 0.5)
-			d_x += box_x.x;
-			else if (d_x > box_x.x * 0.5)
-			d_x -= box_x.x;
-		}
-		if (pbc_dirs.y) {
-			if (d_y < -box_y.y * 0.5)
-			d_y += box_y.y;
-			else if (d_y > box_y.y * 0.5)
-			d_y -= box_y.y;
-		}
-		if (pbc_dirs.z) {
-			if (d_z < -box_z.z * 0.5)
-			d_z += box_z.z;
-			else if (d_z > box_z.z * 0.5)
-			d_z -= box_z.z;
+/*
+ * Inverse square distance interpolation of the Nye tensor field at the
+ * icosahedron vertices, with cutoff r2ls for the line sense and r2bv for the
+ * Burgers vector. Returns 0 if a vertex has no atom for the line sense.
+ */
+static int nye_interpolate(int n, real rel[][3], real nt[][9],
+		real r2ls, real r2bv, real ls[12][9], real bv[12][9]) {
+	real wls[NYE_MAXLIST], wbv[NYE_MAXLIST];
+	int v, j, m;
+
+	for (v = 0; v < 12; v++) {
+		real sls = 0., sbv = 0.;
+#ifdef _OPENMP
+#pragma omp simd reduction(+:sls,sbv)
+#endif
+		for (m = 0; m < n; m++) {
+			real dx = icoVertices[v][0] - rel[m][0];
+			real dy = icoVertices[v][1] - rel[m][1];
+			real dz = icoVertices[v][2] - rel[m][2];
+			real dis = dx*dx + dy*dy + dz*dz;
+			wls[m] = (dis < r2ls) ? 1./dis : 0.;
+			wbv[m] = (dis < r2bv) ? 1./dis : 0.;
+			sls += wls[m];
+			sbv += wbv[m];
 		}
-
-		dis = d_x*d_x + d_y*d_y + d_z*d_z;
-		//Store the distance if it is below the threshold, otherwise save 0.
-		if ( dis < distSqr) {
-			distances[i] = 1./dis;
-			sum += distances[i];
-		} else {
-			distances[i] = 0.;
+		if (sls <= 0.) return 0;
+
+		for (j = 0; j < 9; j++) {
+			real als = 0., abv = 0.;
+#ifdef _OPENMP
+#pragma omp simd reduction(+:als,abv)
+#endif
+			for (m = 0; m < n; m++) {
+				als += nt[m][j] * wls[m];
+				abv += nt[m][j] * wbv[m];
+			}
+			ls[v][j] = als / sls;
+			bv[v][j] = (sbv > 0.) ? abv / sbv : 0.;
 		}
 	}
+	return 1;
+}
 
-	if (sum>0) {
-		for (i=0; i<n; i++) {
-			nyeTensorInfo *nyeInfo = NYE(neiCells[i],neiIndices[i]);
-			nyeInter[0] += (norm[0]*nyeInfo->nyeTensor[0][0]
-			            + norm[1]*nyeInfo->nyeTensor[1][0] + norm[2]*nyeInfo->nyeTensor[2][0]) * distances[i];
-			nyeInter[1] += (norm[0]*nyeInfo->nyeTensor[0][1]
-			            + norm[1]*nyeInfo->nyeTensor[1][1] + norm[2]*nyeInfo->nyeTensor[2][1]) * distances[i];
-			nyeInter[2] += (norm[0]*nyeInfo->nyeTensor[0][2]
-			            + norm[1]*nyeInfo->nyeTensor[1][2] + norm[2]*nyeInfo->nyeTensor[2][2]) * distances[i];
-		}
-		d = 1./sum;
-		nyeInter[0] *= d;
-		nyeInter[1] *= d;
-		nyeInter[2] *= d;
+/*
+ * Volume between icosahedron face k and the face displaced along the vertex
+ * normals by f1, f2, f3
+ */
+static real nye_prism(int k, real f1, real f2, real f3) {
+	int v1 = icoFaces[k][0];
+	int v2 = icoFaces[k][1];
+	int v3 = icoFaces[k][2];
+	real i1[3], i2[3], i3[3];
+	int j;
+
+	for (j = 0; j < 3; j++) {
+		i1[j] = icoVertices[v1][j] + icoNormals[v1][j] * f1;
+		i2[j] = icoVertices[v2][j] + icoNormals[v2][j] * f2;
+		i3[j] = icoVertices[v3][j] + icoNormals[v3][j] * f3;
 	}
+	return integral(icoVertices[v1], icoVertices[v2], icoVertices[v3], i1, i2, i3);
 }
 
-int calculateLineSense(real nnDist, cell *central, int centralInd, cell **neiCells, int *neiIndices, int n, real ls[3], int dir[3]) {
-	real sqr = nnDist*nnDist;
+/*
+ * Line sense and Burgers vector of a defect atom. The Nye tensor field is
+ * interpolated once; the line sense is tried with the assumed Burgers vectors
+ * along x, y and z, until it is not too small.
+ */
+static void nye_defect(cell *p, int i) {
+	real rel[NYE_MAXLIST][3], nt[NYE_MAXLIST][9];
+	real lsi[12][9], bvi[12][9], f[12], l = 0.;
+	nyeTensorInfo *info = NYE(p,i);
+	int n, d, c, a, k, v;
 
-	real lineSenseInter[12][3][3];
-	real x = ORT(central, centralInd, X);
-	real y = ORT(central, centralInd, Y);
-	real z = ORT(central, centralInd, Z);
-	ls[0] = 0.; ls[1] = 0.; ls[2] = 0.;
-	int ok = 0;
-	int i;
-
-	for (i = 0; i<12; i++) {
-		ok = interpolateLineSense(x+icoVertices[i][0], y+icoVertices[i][1], z+icoVertices[i][2], sqr-0.001, neiCells, neiIndices, n, lineSenseInter[i]);
-		if (!ok) return 0;
-	}
+	n = nye_gather(p, i, rel, nt);
+	if (!nye_interpolate(n, rel, nt, SQR(integrationRadius) - 0.001,
+			SQR(integrationRadius), lsi, bvi))
+		return;
 
 	/*Integrate the Nye tensor field on the surface of a icosahedron, as an approximation of a sphere, to estimate the line direction*/
-	for (i = 0; i<20; i++){
-		int v1 = icoFaces[i][0];
-		int v2 = icoFaces[i][1];
-		int v3 = icoFaces[i][2];
-
-		real i1[3];
-		real i2[3];
-		real i3[3];
-
-		real m = dir[0]*lineSenseInter[v1][0][0]+dir[1]*lineSenseInter[v1][1][0]+dir[2]*lineSenseInter[v1][2][0];
-		i1[0] = icoVertices[v1][0]+icoNormals[v1][0]*m;
-		i1[1] = icoVertices[v1][1]+icoNormals[v1][1]*m;
-		i1[2] = icoVertices[v1][2]+icoNormals[v1][2]*m;
-
-		i2[0] = icoVertices[v2][0]+icoNormals[v2][0]*m;
-		i2[1] = icoVertices[v2][1]+icoNormals[v2][1]*m;
-		i2[2] = icoVertices[v2][2]+icoNormals[v2][2]*m;
-
-		i3[0] = icoVertices[v3][0]+icoNormals[v3][0]*m;
-		i3[1] = icoVertices[v3][1]+icoNormals[v3][1]*m;
-		i3[2] = icoVertices[v3][2]+icoNormals[v3][2]*m;
-
-		ls[0] += integral(icoVertices[v1], icoVertices[v2], icoVertices[v3],i1, i2, i3);
-
-
-		m = dir[0]*lineSenseInter[v1][0][1]+dir[1]*lineSenseInter[v1][1][1]+dir[2]*lineSenseInter[v1][2][1];
-		i1[0] = icoVertices[v1][0]+icoNormals[v1][0]*m;
-		i1[1] = icoVertices[v1][1]+icoNormals[v1][1]*m;
-		i1[2] = icoVertices[v1][2]+icoNormals[v1][2]*m;
-
-		i2[0] = icoVertices[v2][0]+icoNormals[v2][0]*m;
-		i2[1] = icoVertices[v2][1]+icoNormals[v2][1]*m;
-		i2[2] = icoVertices[v2][2]+icoNormals[v2][2]*m;
-
-		i3[0] = icoVertices[v3][0]+icoNormals[v3][0]*m;
-		i3[1] = icoVertices[v3][1]+icoNormals[v3][1]*m;
-		i3[2] = icoVertices[v3][2]+icoNormals[v3][2]*m;
-
-		ls[1] += integral(icoVertices[v1], icoVertices[v2], icoVertices[v3],i1, i2, i3);
-
-
-		m = dir[0]*lineSenseInter[v1][0][2]+dir[1]*lineSenseInter[v1][1][2]+dir[2]*lineSenseInter[v1][2][2];
-		i1[0] = icoVertices[v1][0]+icoNormals[v1][0]*m;
-		i1[1] = icoVertices[v1][1]+icoNormals[v1][1]*m;
-		i1[2] = icoVertices[v1][2]+icoNormals[v1][2]*m;
-
-		i2[0] = icoVertices[v2][0]+icoNormals[v2][0]*m;
-		i2[1] = icoVertices[v2][1]+icoNormals[v2][1]*m;
-		i2[2] = icoVertices[v2][2]+icoNormals[v2][2]*m;
-
-		i3[0] = icoVertices[v3][0]+icoNormals[v3][0]*m;
-		i3[1] = icoVertices[v3][1]+icoNormals[v3][1]*m;
-		i3[2] = icoVertices[v3][2]+icoNormals[v3][2]*m;
-
-		ls[2] += integral(icoVertices[v1], icoVertices[v2], icoVertices[v3],i1, i2, i3);
+	for (d = 0; d < 3; d++) {
+		for (c = 0; c < 3; c++) {
+			info->ls[c] = 0.;
+			for (k = 0; k < 20; k++) {
+				real m = lsi[icoFaces[k][0]][3*c+d];
+				info->ls[c] += nye_prism(k, m, m, m);
+			}
+		}
+		l = SQRT(SPRODA3D(info->ls, info->ls));
+		if (l >= 0.316) break;
 	}
+	if (l <= 0.) return;
+	info->ls[0] /= l; info->ls[1] /= l; info->ls[2] /= l;
 
-	return 1;
-}
-
-void calculateBurgersVector(real nnDist, cell *central, int centralInd, cell **neiCells, int *neiIndices, int n, real lsNorm[3], real bv[3]) {
-	real sqr = nnDist*nnDist;
-
-	real bvInter[12][3];
-	real x = ORT(central, centralInd, X);
-	real y = ORT(central, centralInd, Y);
-	real z = ORT(central, centralInd, Z);
-	int i;
-
-	bv[0] = 0.; bv[1] = 0.; bv[2] = 0.;
-
-	for (i = 0; i<12; i++) {
-		interpolateBurgersVector(x+icoVertices[i][0], y+icoVertices[i][1], z+icoVertices[i][2], sqr, neiCells, neiIndices, n, lsNorm, bvInter[i]);
-	}
 	/*Integrate the Nye tensor field on the surface of a icosahedron, as an approximation of a sphere, to get the Burgers vector*/
-	for (i = 0; i<20; i++) {
-		int v1 = icoFaces[i][0];
-		int v2 = icoFaces[i][1];
-		int v3 = icoFaces[i][2];
-
-		real i1[3] = {icoVertices[v1][0]+icoNormals[v1][0]*bvInter[v1][0],
-					  icoVertices[v1][1]+icoNormals[v1][1]*bvInter[v1][0],
-					  icoVertices[v1][2]+icoNormals[v1][2]*bvInter[v1][0]};
-		real i2[3] = {icoVertices[v2][0]+icoNormals[v2][0]*bvInter[v2][0],
-					  icoVertices[v2][1]+icoNormals[v2][1]*bvInter[v2][0],
-					  icoVertices[v2][2]+icoNormals[v2][2]*bvInter[v2][0]};
-		real i3[3] = {icoVertices[v3][0]+icoNormals[v3][0]*bvInter[v3][0],
-					  icoVertices[v3][1]+icoNormals[v3][1]*bvInter[v3][0],
-					  icoVertices[v3][2]+icoNormals[v3][2]*bvInter[v3][0]};
-
-		bv[0] += integral(icoVertices[v1], icoVertices[v2], icoVertices[v3], i1, i2, i3);
-
-		i1[0] = icoVertices[v1][0]+icoNormals[v1][0]*bvInter[v1][1];
-		i1[1] = icoVertices[v1][1]+icoNormals[v1][1]*bvInter[v1][1];
-		i1[2] = icoVertices[v1][2]+icoNormals[v1][2]*bvInter[v1][1];
-
-		i2[0] = icoVertices[v2][0]+icoNormals[v2][0]*bvInter[v2][1];
-		i2[1] = icoVertices[v2][1]+icoNormals[v2][1]*bvInter[v2][1];
-		i2[2] = icoVertices[v2][2]+icoNormals[v2][2]*bvInter[v2][1];
-
-		i3[0] = icoVertices[v3][0]+icoNormals[v3][0]*bvInter[v3][1];
-		i3[1] = icoVertices[v3][1]+icoNormals[v3][1]*bvInter[v3][1];
-		i3[2] = icoVertices[v3][2]+icoNormals[v3][2]*bvInter[v3][1];
-
-		bv[1] += integral(icoVertices[v1], icoVertices[v2], icoVertices[v3], i1, i2, i3);
-
-		i1[0] = icoVertices[v1][0]+icoNormals[v1][0]*bvInter[v1][2];
-		i1[1] = icoVertices[v1][1]+icoNormals[v1][1]*bvInter[v1][2];
-		i1[2] = icoVertices[v1][2]+icoNormals[v1][2]*bvInter[v1][2];
-
-		i2[0] = icoVertices[v2][0]+icoNormals[v2][0]*bvInter[v2][2];
-		i2[1] = icoVertices[v2][1]+icoNormals[v2][1]*bvInter[v2][2];
-		i2[2] = icoVertices[v2][2]+icoNormals[v2][2]*bvInter[v2][2];
-
-		i3[0] = icoVertices[v3][0]+icoNormals[v3][0]*bvInter[v3][2];
-		i3[1] = icoVertices[v3][1]+icoNormals[v3][1]*bvInter[v3][2];
-		i3[2] = icoVertices[v3][2]+icoNormals[v3][2]*bvInter[v3][2];
-
-		bv[2] += integral(icoVertices[v1], icoVertices[v2], icoVertices[v3], i1, i2, i3);
+	for (c = 0; c < 3; c++) {
+		for (v = 0; v < 12; v++) {
+			f[v] = 0.;
+			for (a = 0; a < 3; a++) f[v] += info->ls[a] * bvi[v][3*a+c];
+		}
+		info->bv[c] = 0.;
+		for (k = 0; k < 20; k++)
+			info->bv[c] += nye_prism(k, f[icoFaces[k][0]], f[icoFaces[k][1]], f[icoFaces[k][2]]);
 	}
 }
 
@@ -703,7 +519,7 @@ void pack_nyeTensorInfo(msgbuf *b, int k, int l, int m) {
 	from = PTR_3D_V(cell_array, k, l, m, cell_dim);
 
 	for (i = 0; i < from->n; ++i) {
-		if (NYE(from, i) == NULL){
+		if (!NYE(from, i)->valid){
 			b->data[j++] = 0;
 		} else {
 			nyeTensorInfo *info = NYE(from, i);
@@ -741,21 +557,16 @@ void pack_nyeTensorInfo(msgbuf *b, int k, int l, int m) {
 ******************************************************************************/
 
 void unpack_nyeTensorInfo(msgbuf *b, int k, int l, int m) {
-	int i, isNull, j = b->n;
+	int i, valid, j = b->n;
 	minicell *to;
 
 	to = PTR_3D_V(cell_array, k, l, m, cell_dim);
 
 	for (i = 0; i < to->n; ++i) {
-		isNull = b->data[j++];
-		if (isNull){
-			/*
-			 * Buffer cells are only allocated on demand
-			 */
-			if (NYE(to,i) == NULL){
-				NYE(to,i) = alloc_nyeTensorInfo();
-			}
-			nyeTensorInfo *info = NYE(to, i);
+		nyeTensorInfo *info = NYE(to, i);
+		valid = b->data[j++];
+		info->valid = valid;
+		if (valid){
 
 			info->lcm[0][0] = b->data[j++];
 			info->lcm[0][1] = b->data[j++];
@@ -786,70 +597,51 @@ void unpack_nyeTensorInfo(msgbuf *b, int k, int l, int m) {
 }
 
 void copy_nyeTensorInfo(int k, int l, int m, int r, int s, int t) {
-	int i;
+	int i, j;
 	minicell *from, *to;
 
 	from = PTR_3D_V(cell_array, k, l, m, cell_dim);
 	to = PTR_3D_V(cell_array, r, s, t, cell_dim);
 
 	for (i = 0; i < to->n; ++i) {
-		if (from->nyeTens[i] != NULL) {
-			if (to->nyeTens[i] == NULL) {
-				to->nyeTens[i] = alloc_nyeTensorInfo();
+		nyeTensorInfo *fi = NYE(from, i), *ti = NYE(to, i);
+		ti->valid = fi->valid;
+		if (fi->valid) {
+			for (j = 0; j < 3; j++) {
+				ti->lcm[j][0] = fi->lcm[j][0];
+				ti->lcm[j][1] = fi->lcm[j][1];
+				ti->lcm[j][2] = fi->lcm[j][2];
+				ti->nyeTensor[j][0] = fi->nyeTensor[j][0];
+				ti->nyeTensor[j][1] = fi->nyeTensor[j][1];
+				ti->nyeTensor[j][2] = fi->nyeTensor[j][2];
 			}
-
-			to->nyeTens[i]->lcm[0][0] = from->nyeTens[i]->lcm[0][0];
-			to->nyeTens[i]->lcm[0][1] = from->nyeTens[i]->lcm[0][1];
-			to->nyeTens[i]->lcm[0][2] = from->nyeTens[i]->lcm[0][2];
-			to->nyeTens[i]->lcm[1][0] = from->nyeTens[i]->lcm[1][0];
-			to->nyeTens[i]->lcm[1][1] = from->nyeTens[i]->lcm[1][1];
-			to->nyeTens[i]->lcm[1][2] = from->nyeTens[i]->lcm[1][2];
-			to->nyeTens[i]->lcm[2][0] = from->nyeTens[i]->lcm[2][0];
-			to->nyeTens[i]->lcm[2][1] = from->nyeTens[i]->lcm[2][1];
-			to->nyeTens[i]->lcm[2][2] = from->nyeTens[i]->lcm[2][2];
-
-			to->nyeTens[i]->nyeTensor[0][0] = from->nyeTens[i]->nyeTensor[0][0];
-			to->nyeTens[i]->nyeTensor[0][1] = from->nyeTens[i]->nyeTensor[0][1];
-			to->nyeTens[i]->nyeTensor[0][2] = from->nyeTens[i]->nyeTensor[0][2];
-			to->nyeTens[i]->nyeTensor[1][0] = from->nyeTens[i]->nyeTensor[1][0];
-			to->nyeTens[i]->nyeTensor[1][1] = from->nyeTens[i]->nyeTensor[1][1];
-			to->nyeTens[i]->nyeTensor[1][2] = from->nyeTens[i]->nyeTensor[1][2];
-			to->nyeTens[i]->nyeTensor[2][0] = from->nyeTens[i]->nyeTensor[2][0];
-			to->nyeTens[i]->nyeTensor[2][1] = from->nyeTens[i]->nyeTensor[2][1];
-			to->nyeTens[i]->nyeTensor[2][2] = from->nyeTens[i]->nyeTensor[2][2];
 		}
 	}
 }
 
 void calculateNyeTensorData(){
-	int k,i,j,ii,l,iii,m;
-
-	cell *neiCells[100];
-	int neighIndices[100];
-	int numNeighs;
-	int ok, nneigh1, nneigh2;
-	int dir1[3];
-	int dir2[3];
-	int dir3[3];
-
-	/* Three orthogonal assumed burgers vectors */
-	dir1[0] = 1; dir1[1] = 0; dir1[2] = 0;
-	dir2[0] = 0; dir2[1] = 1; dir2[2] = 0;
-	dir3[0] = 0; dir3[1] = 0; dir3[2] = 1;
+	int k;
 
 	/* Compute neighbor table (if already computed, nothing is done)*/
 	do_neightab_complete();
 
+	/* Invalidate the records of the previous step, including buffer cells */
+	removeNyeTensorData();
+
 	/*
-	 * Allocate memory and calculate lattice correspondence matrices (LCM)
+	 * Calculate lattice correspondence matrices (LCM)
 	 */
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
 	for (k = 0; k < ncells; k++) {
 		cell *p = CELLPTR(k);
+		int i;
 
 		for (i = 0; i < p->n; i++) {
 			if (HOPSTODEFECT(p,i) <= 3)
 			{
-				p->nyeTens[i] = alloc_nyeTensorInfo();
+				init_nyeTensorInfo(NYE(p,i));
 				calculateLcm(p,i);
 			}
 		}
@@ -861,8 +653,13 @@ void calculateNyeTensorData(){
 	/**
 	 * Calculate the nye tensor
 	 */
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
 	for (k = 0; k < ncells; k++) {
 		cell *p = CELLPTR(k);
+		int i;
+
 		for (i = 0; i < p->n; i++) {
 			if (HOPSTODEFECT(p, i) <= 2)
 			{
@@ -874,95 +671,28 @@ void calculateNyeTensorData(){
 	/*Exchange nye tensor between cells*/
 	send_fromCellsToBuffer(copy_nyeTensorInfo,pack_nyeTensorInfo,unpack_nyeTensorInfo);
 
-	/*Calculate lineSense and burgers vectors for defects*/
+	/*Calculate lineSense and burgers vectors for defects, and
+	  remove records with an insignificant burgers vector*/
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
 	for (k = 0; k < ncells; k++) {
 		cell *p = CELLPTR(k);
+		int i;
+
 		for (i = 0; i < p->n; i++) {
+			nyeTensorInfo *info = NYE(p,i);
 			if ( ADATYPE(p, i) != ada_default_type &&
 					((ada_crystal_structure == ADA_FCC_CONFIG && ADATYPE(p,i)>=3 && ADATYPE(p,i)<=5) ||
 					 (ada_crystal_structure == ADA_BCC_CONFIG && ADATYPE(p,i)!=6)) )
-				{
-				nyeTensorInfo *info = NYE(p,i);
-				/*Copy the central atom, its nearest neighbors and their nearest neighbors into a list*/
-				numNeighs = 0;
-				/*Add the central atom*/
-				neiCells[numNeighs] = p;
-				neighIndices[numNeighs] = i;
-				numNeighs++;
-
-				/*Add its nearest neighbors*/
-				nneigh1 = NEIGH(p, i)->n;
-				for (j = 0; j < nneigh1; j++) {
-					cell *q = NEIGH(p, i)->cl[j];
-					ii = NEIGH(p, i)->num[j];
-					neiCells[numNeighs] = q;
-					neighIndices[numNeighs] = ii;
-					numNeighs++;
-				}
-
-				/*Add its second nearest neighbors*/
-				nneigh1 = NEIGH(p, i)->n;
-				for (j = 0; j < nneigh1; j++) {
-					cell *q = NEIGH(p, i)->cl[j];
-					ii = NEIGH(p, i)->num[j];
-					nneigh2 = NEIGH(q, ii)->n;
-					for (l = 0; l < nneigh2; l++) {
-						cell *r = NEIGH(q, ii)->cl[l];
-						iii = NEIGH(q, ii)->num[l];
-						/*Test if this atom is already inserted in the list*/
-						ok = 1;
-						for (m=0; m<numNeighs;m++){
-							if (neiCells[m] == r && neighIndices[m] == iii){
-								ok = 0;
-								break;
-							}
-						}
-						/*If not insert it too*/
-						if (ok){
-							neiCells[numNeighs] = r;
-							neighIndices[numNeighs] = iii;
-							numNeighs++;
-						}
-					}
-				}
-
-				ok = calculateLineSense(integrationRadius,p,i,neiCells,neighIndices, numNeighs, info->ls, dir1);
-				if (ok){
-					real l = SQRT(info->ls[0]*info->ls[0] + info->ls[1]*info->ls[1] + info->ls[2]*info->ls[2]);
-					/*If the line sense vector is very small, test another assumed burgers vector*/
-					if (l<0.316) {
-						calculateLineSense(integrationRadius,p,i,neiCells,neighIndices, numNeighs, info->ls, dir2);
-						l = SQRT(info->ls[0]*info->ls[0] + info->ls[1]*info->ls[1] + info->ls[2]*info->ls[2]);
-						/*And finally the last of the three*/
-						if (l<0.316) {
-							calculateLineSense(integrationRadius,p,i,neiCells,neighIndices, numNeighs, info->ls, dir3);
-							l = SQRT(info->ls[0]*info->ls[0] + info->ls[1]*info->ls[1] + info->ls[2]*info->ls[2]);
-						}
-					}
-
-					if (l>0.){
-						info->ls[0] /= l; info->ls[1] /= l; info->ls[2] /= l;
-						/*Calculate burgers vector*/
-						calculateBurgersVector(integrationRadius,p,i,neiCells,neighIndices,numNeighs,info->ls,info->bv);
-					}
-				}
+			{
+				nye_defect(p, i);
 			}
-		}
-	}
-
-	/*Remove rbv with an insignificant burgers vector*/
-	for (k = 0; k < ncells; k++) {
-			cell *p = CELLPTR(k);
-
-			for (i = 0; i < p->n; i++) {
-				nyeTensorInfo *info = NYE(p,i);
-				if (info != NULL){
-					real l = info->bv[0]*info->bv[0] + info->bv[1]*info->bv[1] + info->bv[2]*info->bv[2];
-					if (l < 0.02*integrationRadius*integrationRadius){
-						free(p->nyeTens[i]);
-						p->nyeTens[i] = NULL;
-					}
-				}
+			if (info->valid){
+				real l = SPRODA3D(info->bv, info->bv);
+				if (l < 0.02*integrationRadius*integrationRadius)
+					info->valid = 0;
 			}
 		}
+	}
 }
@@ -343,7 +343,7 @@ int getparamfile(char *paramfname, int phase)
       getparam(token,&loop,PARAM_INT,1,1);
     }
     else if (strcasecmp(token,"seed")==0) {
-      /* seed for random number generator in maxwell */
+      /* seed for the random numbers (maxwell, laser, epitax) */
       int tmp;
       getparam("seed",&tmp,PARAM_INT,1,1);
       seed = (long) tmp;
@@ -433,11 +433,27 @@ int getparamfile(char *paramfname, int phase)
         ensemble = ENS_CG;
         move_atoms = move_atoms_cg;
       }
+#endif
+#ifdef LBFGS
+      else if (strcasecmp(tmpstr,"lbfgs")==0) {
+        ensemble = ENS_LBFGS;
+        move_atoms = move_atoms_lbfgs;
+      }
+#endif
+#ifdef FIRE2
+      else if (strcasecmp(tmpstr,"fire2")==0) {
+        ensemble = ENS_FIRE2;
+        move_atoms = move_atoms_fire2;
+      }
 #endif
       else if (strcasecmp(tmpstr,"ttm")==0) {
         ensemble = ENS_TTM;
 	move_atoms = move_atoms_ttm;
       }
+      else if (strcasecmp(tmpstr,"langevin")==0) {
+        ensemble = ENS_LANGEVIN;
+        move_atoms = move_atoms_langevin;
+      }
     else {
         error("unknown ensemble");
       }
@@ -466,6 +482,10 @@ int getparamfile(char *paramfname, int phase)
       /* number of steps between energy dist. writes */
       getparam(token,&dist_int,PARAM_INT,1,1);
     }
+    else if (strcasecmp(token,"dist_av_int")==0) {
+      /* number of steps between samples averaged in distributions */
+      getparam(token,&dist_av_int,PARAM_INT,1,1);
+    }
     else if (strcasecmp(token,"dist_dim")==0) {
       /* dimension of distributions */
       getparam(token,&dist_dim,PARAM_INT,DIM,DIM);
@@ -550,8 +570,15 @@ int getparamfile(char *paramfname, int phase)
       getparam(token,&neb_nrep,PARAM_INT,1,1);
       if (0==myrank)
 	{
+#ifdef MPI
+        int nworld;
+        MPI_Comm_size(MPI_COMM_WORLD, &nworld);
+        if ((neb_nrep < 1) || (nworld % neb_nrep != 0))
+          error("The number of MPI processes must be a multiple of neb_nrep");
+#else
         if (num_cpus != neb_nrep)
           error("We need exactly neb_nrep MPI processes");
+#endif
         if (neb_nrep>NEB_MAXNREP)
           error("Too many images for NEB");
 	}
@@ -627,6 +654,88 @@ int getparamfile(char *paramfname, int phase)
     }
 
 #endif
+#ifdef SHAKE
+    else if (strcasecmp(token,"shake_file")==0) {
+      /* file with bond length constraints */
+      getparam(token,shake_file,PARAM_STR,1,255);
+    }
+    else if (strcasecmp(token,"shake_tol")==0) {
+      /* relative tolerance of the squared bond lengths */
+      getparam(token,&shake_tol,PARAM_REAL,1,1);
+    }
+    else if (strcasecmp(token,"shake_maxit")==0) {
+      /* maximal number of SHAKE iterations */
+      getparam(token,&shake_maxit,PARAM_INT,1,1);
+    }
+#endif
+#ifdef PRD
+    else if (strcasecmp(token,"prd_nrep")==0) {
+      /* number of replicas for parallel replica dynamics */
+      getparam(token,&prd_nrep,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"prd_dephase")==0) {
+      /* number of dephasing steps */
+      getparam(token,&prd_dephase,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"prd_check_int")==0) {
+      /* number of steps between transition checks */
+      getparam(token,&prd_check_int,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"prd_corr")==0) {
+      /* number of correlation steps after a transition */
+      getparam(token,&prd_corr,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"prd_quench_steps")==0) {
+      /* maximal number of steps of a quench */
+      getparam(token,&prd_quench_steps,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"prd_quench_fmax")==0) {
+      /* largest force on an atom at which a quench is complete */
+      getparam(token,&prd_quench_fmax,PARAM_REAL,1,1);
+    }
+    else if (strcasecmp(token,"prd_dmax")==0) {
+      /* displacement of a quenched atom indicating a transition */
+      getparam(token,&prd_dmax,PARAM_REAL,1,1);
+    }
+#endif
+#ifdef MTAU
+    else if (strcasecmp(token,"mtau_int")==0) {
+      /* number of steps between multi-tau samples */
+      getparam(token,&mtau_int,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"mtau_start")==0) {
+      /* step of the first multi-tau sample */
+      getparam(token,&mtau_start,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"mtau_write_int")==0) {
+      /* number of steps between writes of the correlations */
+      getparam(token,&mtau_write_int,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"mtau_p")==0) {
+      /* number of values per level */
+      getparam(token,&mtau_p,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"mtau_m")==0) {
+      /* averaging factor between levels */
+      getparam(token,&mtau_m,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"mtau_levels")==0) {
+      /* number of levels */
+      getparam(token,&mtau_levels,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"mtau_msqd")==0) {
+      /* flag for mean square displacement */
+      getparam(token,&mtau_msqd,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"mtau_vacf")==0) {
+      /* flag for velocity autocorrelation */
+      getparam(token,&mtau_vacf,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"mtau_hc")==0) {
+      /* flag for heat current autocorrelation */
+      getparam(token,&mtau_hc,PARAM_INT,1,1);
+    }
+#endif
 #ifdef VEC
     else if (strcasecmp(token,"atoms_per_cpu")==0) {
       /* maximal number of atoms per CPU */
@@ -1291,6 +1400,12 @@ int getparamfile(char *paramfname, int phase)
       getparam("tau_berendsen",&tauber,PARAM_REAL,1,1);
     }
 #endif
+#ifdef LANGEVIN
+    else if (strcasecmp(token,"langevin_gamma")==0) {
+      /* friction coefficient of the Langevin thermostat */
+      getparam(token,&langevin_gamma,PARAM_REAL,1,1);
+    }
+#endif
 #if defined(NVT) || defined(NPT) || defined(STM)
     else if (strcasecmp(token,"eta")==0) {
       /* eta variable for NVT or NPT thermostat */
@@ -1757,6 +1872,58 @@ int getparamfile(char *paramfname, int phase)
       else error_str("unknown CG mode %s",tmpstr);
     }
 #endif /* CG */
+#ifdef LBFGS
+    else if (strcasecmp(token,"lbfgs_m")==0) {
+      /* number of step pairs kept in the L-BFGS history */
+      getparam(token,&lbfgs_m,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"lbfgs_maxstep")==0) {
+      /* max. displacement of an atom in one L-BFGS step */
+      getparam(token,&lbfgs_maxstep,PARAM_REAL,1,1);
+    }
+    else if (strcasecmp(token,"lbfgs_alpha")==0) {
+      /* initial Hessian guess, alpha * unit matrix */
+      getparam(token,&lbfgs_alpha,PARAM_REAL,1,1);
+    }
+#endif /* LBFGS */
+#ifdef FIRE2
+    else if (strcasecmp(token,"fire2_dtmax")==0) {
+      /* max. timestep of FIRE 2.0 */
+      getparam(token,&fire2_dtmax,PARAM_REAL,1,1);
+    }
+    else if (strcasecmp(token,"fire2_dtmin")==0) {
+      /* min. timestep of FIRE 2.0 */
+      getparam(token,&fire2_dtmin,PARAM_REAL,1,1);
+    }
+    else if (strcasecmp(token,"fire2_finc")==0) {
+      /* timestep increase factor */
+      getparam(token,&fire2_finc,PARAM_REAL,1,1);
+    }
+    else if (strcasecmp(token,"fire2_fdec")==0) {
+      /* timestep decrease factor */
+      getparam(token,&fire2_fdec,PARAM_REAL,1,1);
+    }
+    else if (strcasecmp(token,"fire2_alpha0")==0) {
+      /* initial mixing parameter */
+      getparam(token,&fire2_alpha0,PARAM_REAL,1,1);
+    }
+    else if (strcasecmp(token,"fire2_falpha")==0) {
+      /* decrease factor of mixing parameter */
+      getparam(token,&fire2_falpha,PARAM_REAL,1,1);
+    }
+    else if (strcasecmp(token,"fire2_ndelay")==0) {
+      /* number of downhill steps before timestep is increased */
+      getparam(token,&fire2_ndelay,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"fire2_nnegmax")==0) {
+      /* max. number of consecutive uphill steps */
+      getparam(token,&fire2_nnegmax,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"fire2_initdelay")==0) {
+      /* no timestep decrease during the first fire2_ndelay steps */
+      getparam(token,&fire2_initdelay,PARAM_INT,1,1);
+    }
+#endif /* FIRE2 */
 
 #ifdef ACG
       else if (strcasecmp(token,"acg_alpha")==0) {
@@ -1921,6 +2088,14 @@ int getparamfile(char *paramfname, int phase)
       dsf_kmax[    dsf_nk  ] = tmp[i++];
       dsf_nk++;
     }
+    else if (strcasecmp(token,"dsf_nt")==0) {
+      /* number of samples per time window of S(k,w) */
+      getparam(token,&dsf_nt,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"dsf_raw")==0) {
+      /* write rho(k,t) to .dsf file? */
+      getparam(token,&dsf_raw,PARAM_INT,1,1);
+    }
 #endif
 #if defined(HC) || defined(NVX)
     else if (strcasecmp(token, "hc_int")==0){
@@ -1931,18 +2106,22 @@ int getparamfile(char *paramfname, int phase)
       /* start step for heat current or profile measurement  */
       getparam(token, &hc_start, PARAM_INT, 1,1);
     }
+    else if (strcasecmp(token, "hc_nlayers")==0){
+      /* number of layers */
+      getparam(token, &hc_nlayers, PARAM_INT, 1,1);
+    }
 #endif
 #ifdef HC
     else if (strcasecmp(token, "hc_av_start")==0){
       /* start step for energy averaging  */
       getparam(token, &hc_av_start, PARAM_INT, 1,1);
     }
+    else if (strcasecmp(token, "hc_prof_int")==0){
+      /* number of steps between layer profile writes */
+      getparam(token, &hc_prof_int, PARAM_INT, 1,1);
+    }
 #endif
 #ifdef NVX
-    else if (strcasecmp(token, "hc_nlayers")==0){
-      /* number of layers */
-      getparam(token, &hc_nlayers, PARAM_INT, 1,1);
-    }
     else if (strcasecmp(token, "hc_count")==0){
       /* running index of temperature profile */
       getparam(token, &hc_count, PARAM_INT, 1,1);
@@ -1985,6 +2164,22 @@ int getparamfile(char *paramfname, int phase)
       /* How many FD time steps to one MD time step?  */
       getparam("fd_n_timesteps", &fd_n_timesteps, PARAM_INT, 1, 1);
     }
+    else if (strcasecmp(token, "fd_implicit")==0){
+      /* implicit FD time steps (theta scheme)? */
+      getparam("fd_implicit", &fd_implicit, PARAM_INT, 1, 1);
+    }
+    else if (strcasecmp(token, "fd_theta")==0){
+      /* implicitness: 0.5 Crank-Nicolson, 1 backward Euler */
+      getparam("fd_theta", &fd_theta, PARAM_REAL, 1, 1);
+    }
+    else if (strcasecmp(token, "fd_cg_tol")==0){
+      /* relative residual of the implicit FD solver */
+      getparam("fd_cg_tol", &fd_cg_tol, PARAM_REAL, 1, 1);
+    }
+    else if (strcasecmp(token, "fd_cg_max_itr")==0){
+      /* max. number of CG iterations per implicit FD step */
+      getparam("fd_cg_max_itr", &fd_cg_max_itr, PARAM_INT, 1, 1);
+    }
     else if (strcasecmp(token, "ttm_int")==0){
       /* How many time steps between ttm writeouts?  */
       getparam("ttm_int", &ttm_int, PARAM_INT, 1, 1);
@@ -2027,6 +2222,10 @@ else if (strcasecmp(token, "laser_offset")==0){
       /* offset of sample from origin */
       getparam("laser_offset", &laser_offset, PARAM_REAL, 1,1);
     }
+else if (strcasecmp(token, "laser_surface_int")==0){
+      /* steps between updates of the surface position */
+      getparam("laser_surface_int", &laser_surface_int, PARAM_INT, 1,1);
+    }
 
 else if (strcasecmp(token, "laser_dir")==0){
       /* direction of incidence of laser
@@ -2262,6 +2461,55 @@ else if (strcasecmp(token,"laser_rescale_mode")==0) {
       cna_write_statistics = 1;
     }
 #endif
+#ifdef PTM
+    else if (strcasecmp(token,"ptm_int")==0) {
+      /* interval of template matching */
+      getparam(token,&ptm_int,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"ptm_rcut")==0) {
+      /* neighbor cutoff radius, must include the second bcc shell */
+      getparam(token,&rtmp,PARAM_REAL,1,1);
+      ptm_r2cut = SQR(rtmp);
+      cellsz = MAX(cellsz,ptm_r2cut);
+    }
+    else if (strcasecmp(token,"ptm_rmsd_max")==0) {
+      /* max. RMSD of a matched structure */
+      getparam(token,&ptm_rmsd_max,PARAM_REAL,1,1);
+    }
+    else if (strcasecmp(token,"ptm_latticeConst")==0) {
+      /* reference lattice constant for the elastic strain */
+      getparam(token,&ptm_latticeConst,PARAM_REAL,1,1);
+    }
+#endif
+#ifdef RDF
+    else if (strcasecmp(token,"rdf_int")==0) {
+      /* interval of g(r) sampling */
+      getparam(token,&rdf_int,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"rdf_write_int")==0) {
+      /* interval of g(r) output, multiple of rdf_int */
+      getparam(token,&rdf_write_int,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"rdf_rcut")==0) {
+      /* cutoff radius of g(r) */
+      getparam(token,&rtmp,PARAM_REAL,1,1);
+      rdf_r2cut = SQR(rtmp);
+      cellsz = MAX(cellsz,rdf_r2cut);
+    }
+    else if (strcasecmp(token,"rdf_nbins")==0) {
+      /* number of g(r) bins */
+      getparam(token,&rdf_nbins,PARAM_INT,1,1);
+    }
+    else if (strcasecmp(token,"rdf_bond_rcut")==0) {
+      /* bond cutoff for angle distribution and coordination */
+      getparam(token,&rtmp,PARAM_REAL,1,1);
+      rdf_bond_r2cut = SQR(rtmp);
+    }
+    else if (strcasecmp(token,"rdf_angle_nbins")==0) {
+      /* number of bond angle bins */
+      getparam(token,&rdf_angle_nbins,PARAM_INT,1,1);
+    }
+#endif
 #ifdef ADA
    else if (strcasecmp(token, "ada_nbr_rcut") == 0) {
 		/* cutoff radius for angle distribution analysis neighbor,*/
@@ -2446,6 +2694,10 @@ else if (strcasecmp(token,"laser_rescale_mode")==0) {
       /* step when diffraction pattern recording is stopped */
       getparam(token,&diffpat_end,PARAM_INT,1,1);
     }
+    else if (strcasecmp(token,"diffpat_batch")==0) {
+      /* number of snapshots transformed together */
+      getparam(token,&diffpat_batch,PARAM_INT,1,1);
+    }
     else if (strcasecmp(token,"diffpat_ur")==0) {
       /* upper right corner of atoms distribution */
       getparam(token,&diffpat_ur,PARAM_REAL,DIM,DIM);
@@ -2755,6 +3007,23 @@ else if (strcasecmp(token,"laser_rescale_mode")==0) {
     else if (strcasecmp(token,"sm_fixed_charges")==0) {
       getparam(token, &sm_fixed_charges, PARAM_INT, 1, 1);
     }
+    /* tolerance and max. iterations of the charge solver */
+    else if (strcasecmp(token,"sm_tol")==0) {
+      getparam(token, &sm_tol, PARAM_REAL, 1, 1);
+    }
+    else if (strcasecmp(token,"sm_max_itr")==0) {
+      getparam(token, &sm_max_itr, PARAM_INT, 1, 1);
+    }
+    /* skip or truncate charge updates if atoms have hardly moved */
+    else if (strcasecmp(token,"sm_adapt")==0) {
+      getparam(token, &sm_adapt, PARAM_INT, 1, 1);
+    }
+    else if (strcasecmp(token,"sm_adapt_dmax")==0) {
+      getparam(token, &sm_adapt_dmax, PARAM_REAL, 1, 1);
+    }
+    else if (strcasecmp(token,"sm_adapt_itr")==0) {
+      getparam(token, &sm_adapt_itr, PARAM_INT, 1, 1);
+    }
     /* Initial value of the electronegativity */
     else if (strcasecmp(token,"sm_chi_0")==0) {
       if (ntypes==0) error("specify parameter ntypes before sm_chi_0");
@@ -3128,7 +3397,17 @@ else if (strcasecmp(token,"laser_rescale_mode")==0) {
     else if (strcasecmp(token,"fcs_p2nfft_epsI")==0) {
       getparam(token,&fcs_p2nfft_epsI,PARAM_REAL,1,1);
     }
+    /* fcs_direct_images: periodic image shells (0 0 0 = method default) */
+    else if (strcasecmp(token,"fcs_direct_images")==0) {
+      getparam(token,&fcs_direct_images,PARAM_INT,3,3);
+    }
 #endif /* USEFCS */
+#ifdef RESPA
+    /* long-range forces are evaluated every respa_n steps */
+    else if (strcasecmp(token,"respa_n")==0) {
+      getparam(token,&respa_n,PARAM_INT,1,1);
+    }
+#endif
 #if defined(EWALD) || defined(COULOMB)
     /* smoothing parameter */
     else if (strcasecmp(token,"ew_kappa")==0) {
@@ -3516,6 +3795,33 @@ void check_parameters_complete()
   }
 #endif
 
+#ifdef ANAPOT
+  if (have_potfile)
+    error("ANAPOT requires analytic pair potentials, not a potential file");
+  for (k=0; k<ntypepairs-ntypes; k++)
+    if (spring_const[k] > 0)
+      error("ANAPOT cannot be used with spring_const");
+#if defined(EWALD)
+  if ((ew_r2_cut > 0) && (ew_nmax < 0))
+    error("ANAPOT cannot be used with the tabulated Ewald real space part");
+#endif
+#if defined(DIPOLE) || defined(MORSE) || defined(BUCK)
+  error("ANAPOT cannot be used with DIPOLE, MORSE or BUCK");
+#endif
+#endif
+
+#if defined(SM) && !defined(NBLIST)
+  if (sm_adapt)
+    error("sm_adapt requires option nbl");
+#endif
+
+#ifdef RESPA
+  if (respa_n < 1)
+    error("respa_n must be at least 1");
+  if ((respa_n > 1) && IS_RELAX_ENS(ensemble))
+    error("RESPA cannot be used with relaxation ensembles");
+#endif
+
 #ifdef EXTPOT
   if(ep_a !=0)
     printf("Usage of ep_a is depreciated, use extpot_file instead\n");
@@ -3574,6 +3880,13 @@ void check_parameters_complete()
     if (hc_nlayers == 0) error ("hc_nlayers is zero.");
   }
 #endif
+#ifdef HC
+  if ((hc_int > 0) && (hc_nlayers > 0)) {
+    if (hc_prof_int == 0) error ("hc_prof_int is zero.");
+    if (hc_prof_int % hc_int != 0) 
+      error ("hc_prof_int must be a multiple of hc_int.");
+  }
+#endif
 #ifdef FTG
   if (nslices < 2){
     error ("nslices is missing or less than 2.");
@@ -3658,10 +3971,64 @@ void check_parameters_complete()
   else if (strcasecmp(fd_one_d_str,"")!=0) {
     warning("Ignoring unknown value of fe_one_d\n");
   }
+  if ((fd_implicit) && ((fd_theta < 0.5) || (fd_theta > 1.0)))
+    error("fd_theta must be between 0.5 and 1 for fd_implicit");
+  if ((fd_implicit) && (fd_cg_max_itr < 1))
+    error("fd_cg_max_itr must be positive");
   if ((fd_gamma==0.0 && fd_c==0.0)||(fd_gamma!=0.0 && fd_c!=0.0)) {
     error ("You must specify either fd_gamma or fd_c for TTM simulations.");
   }
 #endif /* TTM */
+#ifdef SHAKE
+#ifdef TWOD
+  error("SHAKE is not supported in two dimensions");
+#endif
+  if ('\0'==shake_file[0]) error("shake_file is missing");
+  if ((shake_tol <= 0.0) || (shake_maxit < 1))
+    error("shake_tol and shake_maxit must be positive");
+  if ((ensemble != ENS_NVE) && (ensemble != ENS_NVT) &&
+      (ensemble != ENS_LANGEVIN))
+    error("SHAKE is supported only for ensembles nve, nvt and langevin");
+#endif
+#ifdef PRD
+  if (prd_nrep < 1) error("prd_nrep must be positive");
+  if ((prd_check_int < 1) || (prd_dephase < 0) || (prd_corr < 0))
+    error("prd_check_int must be positive, prd_dephase and prd_corr not negative");
+  if (prd_dmax <= 0.0) error("prd_dmax must be positive");
+  if (IS_RELAX_ENS(ensemble))
+    error("parallel replica dynamics needs an MD ensemble");
+#ifdef MPI
+  {
+    int nworld;
+    MPI_Comm_size(MPI_COMM_WORLD, &nworld);
+    if (nworld % prd_nrep != 0)
+      error("The number of MPI processes must be a multiple of prd_nrep");
+    /* each replica gets its own share of the CPUs */
+    num_cpus = nworld / prd_nrep;
+  }
+#else
+  if (prd_nrep > 1) error("more than one PRD replica needs MPI");
+#endif
+#endif
+#ifdef MTAU
+  if (mtau_int < 0) error("mtau_int must not be negative");
+  if (mtau_m < 2) error("mtau_m must be at least 2");
+  if ((mtau_p < mtau_m) || (mtau_p % mtau_m))
+    error("mtau_p must be a multiple of mtau_m");
+  if ((mtau_levels < 1) || (mtau_levels > 32))
+    error("mtau_levels must be between 1 and 32");
+  mtau_len = 0;
+  if (mtau_int > 0) {
+    if (mtau_msqd) mtau_len += DIM * (2 + mtau_levels * mtau_p);
+    if (mtau_vacf) mtau_len += DIM * (mtau_levels * mtau_p + mtau_levels);
+  }
+#endif
+#if defined(NEB) && defined(MPI)
+  /* each image gets its own share of the CPUs */
+  if (0==neb_nrep) error("neb_nrep is missing or zero");
+  MPI_Comm_size(MPI_COMM_WORLD, &num_cpus);
+  num_cpus /= neb_nrep;
+#endif
 #ifdef MPI
   {
 #ifdef TWOD
@@ -3708,10 +4075,40 @@ void check_parameters_complete()
   if (0==atdist_end) atdist_end = steps_max;
 #endif
 
+  if ((dist_av_int > 0) && ((0==dist_int) || (dist_int % dist_av_int != 0)))
+    error("dist_int must be a multiple of dist_av_int");
+
+#ifdef DSF
+  if (dsf_nt < 0) error("dsf_nt must not be negative");
+  if ((dsf_int > 0) && (dsf_nk < 1)) error("dsf_int needs at least one dsf_k");
+#endif
+
 #ifdef CG
   if ((linmin_maxsteps==0) || (linmin_tol==0.0) )
     error("You have to set parameters for the linmin search");
 #endif
+#ifdef LBFGS
+  if (lbfgs_m < 1)
+    error("lbfgs_m must be positive");
+  if ((lbfgs_maxstep <= 0.0) || (lbfgs_alpha <= 0.0))
+    error("lbfgs_maxstep and lbfgs_alpha must be positive");
+  /* old forces, work vector, and lbfgs_m pairs of steps and force changes */
+  lbfgs_len = DIM * (2 + 2 * lbfgs_m);
+#endif
+#ifdef LANGEVIN
+  if (ensemble == ENS_LANGEVIN) {
+#if defined(UNIAX) || defined(RIGID)
+    error("The Langevin thermostat does not support UNIAX and RIGID");
+#endif
+    if (langevin_gamma <= 0.0) error("langevin_gamma must be positive");
+  }
+#endif
+#ifdef FIRE2
+  if (fire2_dtmax == 0.0) fire2_dtmax = 10.0 * timestep;
+  if (fire2_dtmin == 0.0) fire2_dtmin = 0.02 * timestep;
+  if ((fire2_finc <= 1.0) || (fire2_fdec >= 1.0) || (fire2_fdec <= 0.0))
+    error("FIRE 2.0 requires fire2_finc > 1 and 0 < fire2_fdec < 1");
+#endif
 #ifdef HOMDEF
   if (relax_rate > 0.0) {
 #ifdef STRESS_TENS
@@ -3726,6 +4123,9 @@ void check_parameters_complete()
 #if defined(DIFFPAT) && defined(TWOD)
   error("Option DIFFPAT is not supported in 2D");
 #endif
+#ifdef DIFFPAT
+  if (diffpat_batch < 1) error("diffpat_batch must be at least 1");
+#endif
 
 #ifdef KIM
   if (strcmp(kim_el_names[0],"\0")==0)
@@ -3742,6 +4142,35 @@ void check_parameters_complete()
   }
 #endif
 
+#if defined(PTM) && defined(TWOD)
+  error("Option PTM is not supported in 2D");
+#endif
+
+#ifdef PTM
+  if ((ptm_int > 0) && (ptm_r2cut == 0.0))
+    error("Neighbor cutoff \"ptm_rcut\" is missing or zero in the parameter file");
+  if (ptm_rmsd_max <= 0.0)
+    error("ptm_rmsd_max must be positive");
+#endif
+
+#if defined(RDF) && defined(TWOD)
+  error("Option RDF is not supported in 2D");
+#endif
+
+#ifdef RDF
+  if (rdf_int > 0) {
+    if (rdf_r2cut == 0.0)
+      error("Cutoff \"rdf_rcut\" is missing or zero in the parameter file");
+    if ((rdf_nbins < 1) || (rdf_angle_nbins < 1))
+      error("rdf_nbins and rdf_angle_nbins must be positive");
+    if (rdf_bond_r2cut > rdf_r2cut)
+      error("rdf_bond_rcut must not exceed rdf_rcut");
+    if (rdf_write_int == 0) rdf_write_int = rdf_int;
+    if (rdf_write_int % rdf_int != 0)
+      error("rdf_write_int must be a multiple of rdf_int");
+  }
+#endif
+
 #ifdef NYETENSOR
   if (ada_latticeConst == 0.){
   	  error("Lattice constant \"ada_latticeConst\" is missing or zero in the parameter file");
@@ -3910,6 +4339,12 @@ int read_parameters(char *paramfname, int phase)
 #ifdef MPI
   MPI_Bcast( &finished, 1, MPI_INT, 0, MPI_COMM_WORLD);
   broadcast_params();
+#ifdef NEB
+  neb_split_images();
+#endif
+#ifdef PRD
+  prd_split_replicas();
+#endif
 #endif
   return finished;
 }
@@ -3958,6 +4393,7 @@ void broadcast_params() {
 #endif
 
   MPI_Bcast( &dist_int,              1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &dist_av_int,           1, MPI_INT, 0, MPI_COMM_WORLD);
   MPI_Bcast( &dist_dim,            DIM, MPI_INT, 0, MPI_COMM_WORLD);
   MPI_Bcast( &dist_ll,             DIM, REAL,    0, MPI_COMM_WORLD);
   MPI_Bcast( &dist_ur,             DIM, REAL,    0, MPI_COMM_WORLD);
@@ -4326,17 +4762,20 @@ void broadcast_params() {
   MPI_Bcast( dsf_k0,   DIM*dsf_nk, MPI_INT, 0, MPI_COMM_WORLD);
   MPI_Bcast( dsf_kdir, DIM*dsf_nk, MPI_INT, 0, MPI_COMM_WORLD);
   MPI_Bcast( dsf_kmax,     dsf_nk, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &dsf_nt,        1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &dsf_raw,       1, MPI_INT, 0, MPI_COMM_WORLD);
 #endif
 
 #if defined(HC) || defined(NVX)
   MPI_Bcast( &hc_int,        1, MPI_INT,  0, MPI_COMM_WORLD);
   MPI_Bcast( &hc_start,      1, MPI_INT,  0, MPI_COMM_WORLD);
+  MPI_Bcast( &hc_nlayers,    1, MPI_INT,  0, MPI_COMM_WORLD);
 #endif
 #ifdef HC
   MPI_Bcast( &hc_av_start,   1, MPI_INT,  0, MPI_COMM_WORLD);
+  MPI_Bcast( &hc_prof_int,   1, MPI_INT,  0, MPI_COMM_WORLD);
 #endif
 #ifdef NVX
-  MPI_Bcast( &hc_nlayers,    1, MPI_INT,  0, MPI_COMM_WORLD);
   MPI_Bcast( &hc_count,      1, MPI_INT,  0, MPI_COMM_WORLD);
   MPI_Bcast( &hc_heatcurr,   1, REAL,     0, MPI_COMM_WORLD);
 #endif
@@ -4344,6 +4783,7 @@ void broadcast_params() {
   MPI_Bcast( &laser_rescale_mode,1,MPI_INT,0,MPI_COMM_WORLD);
   MPI_Bcast( &laser_dir,  DIM , MPI_INT,  0, MPI_COMM_WORLD);
   MPI_Bcast( &laser_mu,         1, REAL,  0, MPI_COMM_WORLD);
+  MPI_Bcast( &laser_surface_int,1, MPI_INT,0, MPI_COMM_WORLD);
   MPI_Bcast( &laser_delta_temp, 1, REAL,  0, MPI_COMM_WORLD);
   MPI_Bcast( &laser_sigma_e,    1, REAL,  0, MPI_COMM_WORLD);
   MPI_Bcast( &laser_sigma_t,    1, REAL,  0, MPI_COMM_WORLD);
@@ -4372,6 +4812,10 @@ void broadcast_params() {
   MPI_Bcast( &fd_gamma,	      1, REAL,	  0, MPI_COMM_WORLD);
   MPI_Bcast( &fd_k,           1, REAL,    0, MPI_COMM_WORLD);
   MPI_Bcast( &fd_n_timesteps, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &fd_implicit,    1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &fd_theta,       1, REAL,    0, MPI_COMM_WORLD);
+  MPI_Bcast( &fd_cg_tol,      1, REAL,    0, MPI_COMM_WORLD);
+  MPI_Bcast( &fd_cg_max_itr,  1, MPI_INT, 0, MPI_COMM_WORLD);
   MPI_Bcast( &ttm_int,        1, MPI_INT, 0, MPI_COMM_WORLD);
   MPI_Bcast( &init_t_el,      1, REAL,    0, MPI_COMM_WORLD);
   MPI_Bcast( &fix_t_el,	      1, MPI_INT, 0, MPI_COMM_WORLD);
@@ -4557,7 +5001,14 @@ void broadcast_params() {
 #endif
 
 #ifdef DIFFPAT
-  error("Option DIFFPAT is not supported under MPI");
+  MPI_Bcast( &diffpat_dim,    DIM, MPI_INT,   0, MPI_COMM_WORLD);
+  MPI_Bcast( &diffpat_int,      1, MPI_INT,   0, MPI_COMM_WORLD);
+  MPI_Bcast( &diffpat_start,    1, MPI_INT,   0, MPI_COMM_WORLD);
+  MPI_Bcast( &diffpat_end,      1, MPI_INT,   0, MPI_COMM_WORLD);
+  MPI_Bcast( &diffpat_batch,    1, MPI_INT,   0, MPI_COMM_WORLD);
+  MPI_Bcast( &diffpat_ur,     DIM, REAL,      0, MPI_COMM_WORLD);
+  MPI_Bcast( &diffpat_ll,     DIM, REAL,      0, MPI_COMM_WORLD);
+  MPI_Bcast( diffpat_weight,   10, MPI_FLOAT, 0, MPI_COMM_WORLD);
 #endif
 
 #ifdef ORDPAR
@@ -4587,6 +5038,63 @@ void broadcast_params() {
   MPI_Bcast( &cg_infolevel,    1, MPI_INT, 0, MPI_COMM_WORLD);
   MPI_Bcast( &cg_mode,         1, MPI_INT, 0, MPI_COMM_WORLD);
 #endif
+#ifdef NEB
+  MPI_Bcast( &neb_nrep,           1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &neb_eng_int,        1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &neb_cineb_start,    1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &neb_climbing_image, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &neb_vark_start,     1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &neb_k,              1, REAL,    0, MPI_COMM_WORLD);
+  MPI_Bcast( &neb_maxmove,        1, REAL,    0, MPI_COMM_WORLD);
+  MPI_Bcast( &neb_kmax,           1, REAL,    0, MPI_COMM_WORLD);
+  MPI_Bcast( &neb_kmin,           1, REAL,    0, MPI_COMM_WORLD);
+#endif
+#ifdef SHAKE
+  MPI_Bcast( shake_file,       255, MPI_CHAR, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &shake_tol,         1, REAL,     0, MPI_COMM_WORLD);
+  MPI_Bcast( &shake_maxit,       1, MPI_INT,  0, MPI_COMM_WORLD);
+#endif
+#ifdef PRD
+  MPI_Bcast( &prd_nrep,           1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &prd_dephase,        1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &prd_check_int,      1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &prd_corr,           1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &prd_quench_steps,   1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &prd_quench_fmax,    1, REAL,    0, MPI_COMM_WORLD);
+  MPI_Bcast( &prd_dmax,           1, REAL,    0, MPI_COMM_WORLD);
+#endif
+#ifdef MTAU
+  MPI_Bcast( &mtau_int,           1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &mtau_start,         1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &mtau_write_int,     1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &mtau_p,             1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &mtau_m,             1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &mtau_levels,        1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &mtau_msqd,          1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &mtau_vacf,          1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &mtau_hc,            1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &mtau_len,           1, MPI_INT, 0, MPI_COMM_WORLD);
+#endif
+#ifdef LANGEVIN
+  MPI_Bcast( &langevin_gamma,  1, REAL,    0, MPI_COMM_WORLD);
+#endif
+#ifdef LBFGS
+  MPI_Bcast( &lbfgs_m,         1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &lbfgs_len,       1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &lbfgs_maxstep,   1, REAL,    0, MPI_COMM_WORLD);
+  MPI_Bcast( &lbfgs_alpha,     1, REAL,    0, MPI_COMM_WORLD);
+#endif
+#ifdef FIRE2
+  MPI_Bcast( &fire2_dtmax,     1, REAL,    0, MPI_COMM_WORLD);
+  MPI_Bcast( &fire2_dtmin,     1, REAL,    0, MPI_COMM_WORLD);
+  MPI_Bcast( &fire2_finc,      1, REAL,    0, MPI_COMM_WORLD);
+  MPI_Bcast( &fire2_fdec,      1, REAL,    0, MPI_COMM_WORLD);
+  MPI_Bcast( &fire2_alpha0,    1, REAL,    0, MPI_COMM_WORLD);
+  MPI_Bcast( &fire2_falpha,    1, REAL,    0, MPI_COMM_WORLD);
+  MPI_Bcast( &fire2_ndelay,    1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &fire2_nnegmax,   1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &fire2_initdelay, 1, MPI_INT, 0, MPI_COMM_WORLD);
+#endif
 #ifdef ACG
   MPI_Bcast( &acg_init_alpha,      1, REAL,    0, MPI_COMM_WORLD);
   MPI_Bcast( &acg_decfac,     1, REAL,    0, MPI_COMM_WORLD);
@@ -4726,7 +5234,13 @@ void broadcast_params() {
   MPI_Bcast( &coul_eng,           1,      REAL,    0, MPI_COMM_WORLD);
 #endif
 #ifdef SM
+  MPI_Bcast( &charge_update_steps,     1, MPI_INT, 0, MPI_COMM_WORLD);
   MPI_Bcast( &sm_fixed_charges,        1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &sm_tol,                  1, REAL,    0, MPI_COMM_WORLD);
+  MPI_Bcast( &sm_max_itr,              1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &sm_adapt,                1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &sm_adapt_dmax,           1, REAL,    0, MPI_COMM_WORLD);
+  MPI_Bcast( &sm_adapt_itr,            1, MPI_INT, 0, MPI_COMM_WORLD);
   MPI_Bcast( sm_chi_0,            ntypes, REAL,    0, MPI_COMM_WORLD);
   MPI_Bcast( sm_J_0,              ntypes, REAL,    0, MPI_COMM_WORLD);
   MPI_Bcast( sm_Z,                ntypes, REAL,    0, MPI_COMM_WORLD);
@@ -4759,6 +5273,10 @@ void broadcast_params() {
   MPI_Bcast( &fcs_pp3mg_max_part, 1,   MPI_INT,    0, MPI_COMM_WORLD);
   MPI_Bcast( &fcs_p2nfft_intpol_order, 1, MPI_INT, 0, MPI_COMM_WORLD);
   MPI_Bcast( &fcs_p2nfft_epsI,    1,      REAL,    0, MPI_COMM_WORLD);
+  MPI_Bcast( &fcs_direct_images,  3,   MPI_INT,    0, MPI_COMM_WORLD);
+#endif
+#ifdef RESPA
+  MPI_Bcast( &respa_n,            1,   MPI_INT,    0, MPI_COMM_WORLD);
 #endif
 #if defined(EWALD) || defined(COULOMB)
   MPI_Bcast( &ew_kappa,           1,      REAL,    0, MPI_COMM_WORLD);
@@ -4881,6 +5399,13 @@ void broadcast_params() {
     case ENS_FTG:       move_atoms = move_atoms_ftg;       break;
     case ENS_FINNIS:    move_atoms = move_atoms_finnis;    break;
     case ENS_CG:                                           break;
+    case ENS_LANGEVIN:  move_atoms = move_atoms_langevin;  break;
+#ifdef LBFGS
+    case ENS_LBFGS:     move_atoms = move_atoms_lbfgs;     break;
+#endif
+#ifdef FIRE2
+    case ENS_FIRE2:     move_atoms = move_atoms_fire2;     break;
+#endif
     default: if (0==myid) error("unknown ensemble in broadcast"); break;
   }
 
@@ -5013,6 +5538,20 @@ void broadcast_params() {
   MPI_Bcast( &ada_default_type,  1, MPI_INT, 0, MPI_COMM_WORLD);
   MPI_Bcast( &ada_latticeConst,  1, REAL, 0, MPI_COMM_WORLD);
 #endif
+#ifdef PTM
+  MPI_Bcast( &ptm_int,          1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &ptm_r2cut,        1, REAL,    0, MPI_COMM_WORLD);
+  MPI_Bcast( &ptm_rmsd_max,     1, REAL,    0, MPI_COMM_WORLD);
+  MPI_Bcast( &ptm_latticeConst, 1, REAL,    0, MPI_COMM_WORLD);
+#endif
+#ifdef RDF
+  MPI_Bcast( &rdf_int,          1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &rdf_write_int,    1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &rdf_r2cut,        1, REAL,    0, MPI_COMM_WORLD);
+  MPI_Bcast( &rdf_nbins,        1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast( &rdf_bond_r2cut,   1, REAL,    0, MPI_COMM_WORLD);
+  MPI_Bcast( &rdf_angle_nbins,  1, MPI_INT, 0, MPI_COMM_WORLD);
+#endif
 #ifdef NYETENSOR
   MPI_Bcast( &nye_rotationAxis_x, 3, REAL, 0, MPI_COMM_WORLD);
   MPI_Bcast( &nye_rotationAxis_y, 3, REAL, 0, MPI_COMM_WORLD);
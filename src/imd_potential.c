@@ -951,6 +951,50 @@ void init_pre_pot(void) {
     }
 #endif
 
+#ifdef ANAPOT
+  /* parameters for direct evaluation in the force loops */
+  for (i=0; i<ntypes; i++)
+    for (j=0; j<ntypes; j++) {
+      ana_pot_t *ap = ana_pot + i*ntypes + j;
+      memset(ap, 0, sizeof(ana_pot_t));
+      if (r2_cut[i][j] <= 0.0) continue;
+      ap->r2_cut  = r2_cut[i][j];
+      ap->r2_tail = (1.0 - POT_TAIL) * r2_cut[i][j];
+      if (lj_epsilon[i][j] > 0.0) {
+        ap->lj_eps  = lj_epsilon[i][j];
+        ap->lj_sig2 = SQR(lj_sigma[i][j]);
+        ap->shift  += lj_shift[i][j];
+        ap->aaa    += lj_aaa[i][j];
+        if (ljg_eps[i][j] > 0.0) {
+          ap->ljg_eps  = ljg_eps[i][j];
+          ap->ljg_r0   = ljg_r0[i][j];
+          ap->ljg_isig = 1.0 / ljg_sig[i][j];
+          ana_have_ljg = 1;
+        }
+      }
+      if (morse_epsilon[i][j] > 0.0) {
+        ap->morse_eps   = morse_epsilon[i][j];
+        ap->morse_alpha = morse_alpha[i][j];
+        ap->morse_sig   = morse_sigma[i][j];
+        ap->shift      += morse_shift[i][j];
+        ap->aaa        += morse_aaa[i][j];
+        ana_have_morse  = 1;
+      }
+      if (buck_sigma[i][j] > 0.0) {
+        ap->buck_a    = buck_a[i][j];
+        ap->buck_c6   = buck_c[i][j] * pow(buck_sigma[i][j], 6.0);
+        ap->buck_isig = 1.0 / buck_sigma[i][j];
+        ap->shift    += buck_shift[i][j];
+        ap->aaa      += buck_aaa[i][j];
+        ana_have_buck  = 1;
+      }
+#ifdef LJ
+      if ((ap->ljg_eps > 0.0) || (ap->morse_eps > 0.0) || (ap->buck_isig > 0.0))
+        error("with LJ, ANAPOT supports only Lennard-Jones potentials");
+#endif
+    }
+#endif
+
 #if defined(CBE)
   mk_pt();
 #endif  /* CBE */
@@ -0,0 +1,542 @@
+/******************************************************************************
+*
+* IMD -- The ITAP Molecular Dynamics Program
+*
+* Copyright 1996-2013 Institute for Theoretical and Applied Physics,
+* University of Stuttgart, D-70550 Stuttgart
+*
+******************************************************************************/
+
+/******************************************************************************
+*
+* imd_prd.c -- parallel replica dynamics
+*
+* The CPUs are split into prd_nrep groups, each running one replica of
+* the system with the usual domain decomposition. After dephasing, all
+* replicas run MD and are quenched every prd_check_int steps. If an atom
+* of the quenched configuration is further than prd_dmax away from its
+* position in the reference minimum, a transition has occurred. The
+* replica with the lowest number among those with a transition goes on
+* for prd_corr correlation steps, and its state is then copied to all
+* other replicas. The simulated time of all replicas is summed up in
+* prd_time.
+*
+* Each atom carries its reference position and the saved MD state in
+* PRD_SAVE, so that these migrate with the atoms between cells and CPUs
+* during a quench.
+*
+******************************************************************************/
+
+/******************************************************************************
+* $Revision$
+* $Date$
+******************************************************************************/
+
+#include "imd.h"
+
+/* offsets into the per atom save block */
+#define PRD_REF   0              /* position in the reference minimum */
+#define PRD_X     (DIM)          /* saved position */
+#define PRD_P     (2*DIM)        /* saved momentum */
+
+/* phases of a PRD cycle */
+#define PRD_DEPHASE   0
+#define PRD_PARALLEL  1
+#define PRD_CORRELATE 2
+
+static int prd_phase  = PRD_DEPHASE;
+static int prd_count  = 0;
+static int prd_winner = 0;
+
+#ifdef MPI
+
+/******************************************************************************
+*
+*  split the CPUs into prd_nrep groups, one for each replica
+*
+*  Afterwards, myrank is the number of the replica, and myid and num_cpus
+*  refer to the CPUs of the replica. Each replica writes its own files.
+*
+******************************************************************************/
+
+void prd_split_replicas(void)
+{
+  static int done = 0;
+  int nworld, wrank;
+
+  if (done) return;
+  done = 1;
+
+  MPI_Comm_size(MPI_COMM_WORLD, &nworld);
+  MPI_Comm_rank(MPI_COMM_WORLD, &wrank);
+  myrank = wrank / (nworld / prd_nrep);
+  MPI_Comm_split(MPI_COMM_WORLD, myrank, wrank, &prd_comm);
+  MPI_Comm_rank(prd_comm, &myid);
+  MPI_Comm_size(prd_comm, &num_cpus);
+  MPI_Comm_split(MPI_COMM_WORLD, myid, myrank, &prd_rep_comm);
+
+  prd_outfilename = strdup(outfilename);
+  if (prd_nrep > 1) sprintf(outfilename, "%s.%02d", prd_outfilename, myrank);
+  if (0==wrank)
+    printf("PRD: %d replicas with %d processes each.\n", prd_nrep, num_cpus);
+}
+
+#endif
+
+/******************************************************************************
+*
+*  reductions over the replicas
+*
+******************************************************************************/
+
+static int prd_max_int(int x)
+{
+#ifdef MPI
+  int tmp;
+  MPI_Allreduce( &x, &tmp, 1, MPI_INT, MPI_MAX, prd_rep_comm);
+  return tmp;
+#else
+  return x;
+#endif
+}
+
+static int prd_min_int(int x)
+{
+#ifdef MPI
+  int tmp;
+  MPI_Allreduce( &x, &tmp, 1, MPI_INT, MPI_MIN, prd_rep_comm);
+  return tmp;
+#else
+  return x;
+#endif
+}
+
+/******************************************************************************
+*
+*  save and restore the MD state, set the reference minimum
+*
+******************************************************************************/
+
+static void prd_save(void)
+{
+  int k;
+
+  for (k=0; k<NCELLS; ++k) {
+    int  i;
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; ++i) {
+      PRD_SAVE(p,i,PRD_X  ) = ORT(p,i,X);
+      PRD_SAVE(p,i,PRD_X+1) = ORT(p,i,Y);
+      PRD_SAVE(p,i,PRD_P  ) = IMPULS(p,i,X);
+      PRD_SAVE(p,i,PRD_P+1) = IMPULS(p,i,Y);
+#ifndef TWOD
+      PRD_SAVE(p,i,PRD_X+2) = ORT(p,i,Z);
+      PRD_SAVE(p,i,PRD_P+2) = IMPULS(p,i,Z);
+#endif
+    }
+  }
+}
+
+static void prd_restore(void)
+{
+  int k;
+
+  for (k=0; k<NCELLS; ++k) {
+    int  i;
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; ++i) {
+      ORT   (p,i,X) = PRD_SAVE(p,i,PRD_X  );
+      ORT   (p,i,Y) = PRD_SAVE(p,i,PRD_X+1);
+      IMPULS(p,i,X) = PRD_SAVE(p,i,PRD_P  );
+      IMPULS(p,i,Y) = PRD_SAVE(p,i,PRD_P+1);
+#ifndef TWOD
+      ORT   (p,i,Z) = PRD_SAVE(p,i,PRD_X+2);
+      IMPULS(p,i,Z) = PRD_SAVE(p,i,PRD_P+2);
+#endif
+    }
+  }
+#ifdef NBLIST
+  check_nblist();
+#else
+  fix_cells();
+#endif
+}
+
+static void prd_set_reference(void)
+{
+  int k;
+
+  for (k=0; k<NCELLS; ++k) {
+    int  i;
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; ++i) {
+      PRD_SAVE(p,i,PRD_REF  ) = ORT(p,i,X);
+      PRD_SAVE(p,i,PRD_REF+1) = ORT(p,i,Y);
+#ifndef TWOD
+      PRD_SAVE(p,i,PRD_REF+2) = ORT(p,i,Z);
+#endif
+    }
+  }
+}
+
+/******************************************************************************
+*
+*  quench to the nearest minimum, with velocities projected as in glok
+*
+******************************************************************************/
+
+static void prd_quench(void)
+{
+  int  k, n;
+  real pf, f2max;
+#ifdef MPI
+  real tmp;
+#endif
+
+  for (k=0; k<NCELLS; ++k) {
+    int  i;
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; ++i) {
+      IMPULS(p,i,X) = 0.0;
+      IMPULS(p,i,Y) = 0.0;
+#ifndef TWOD
+      IMPULS(p,i,Z) = 0.0;
+#endif
+    }
+  }
+
+  for (n=0; n<prd_quench_steps; ++n) {
+
+#ifdef NBLIST
+    check_nblist();
+#else
+    fix_cells();
+#endif
+    calc_forces(steps);
+
+    pf    = 0.0;
+    f2max = 0.0;
+    for (k=0; k<NCELLS; ++k) {
+      int  i, sort;
+      cell *p = CELLPTR(k);
+      for (i=0; i<p->n; ++i) {
+        sort = VSORTE(p,i);
+        KRAFT(p,i,X) *= (restrictions + sort)->x;
+        KRAFT(p,i,Y) *= (restrictions + sort)->y;
+#ifndef TWOD
+        KRAFT(p,i,Z) *= (restrictions + sort)->z;
+#endif
+        pf   += SPRODN(IMPULS,p,i,KRAFT,p,i);
+        f2max = MAX( f2max, SPRODN(KRAFT,p,i,KRAFT,p,i) );
+      }
+    }
+#ifdef MPI
+    MPI_Allreduce( &pf,    &tmp, 1, REAL, MPI_SUM, cpugrid);
+    pf = tmp;
+    MPI_Allreduce( &f2max, &tmp, 1, REAL, MPI_MAX, cpugrid);
+    f2max = tmp;
+#endif
+    if (f2max < SQR(prd_quench_fmax)) break;
+
+    for (k=0; k<NCELLS; ++k) {
+      int  i;
+      real tmp;
+      cell *p = CELLPTR(k);
+      for (i=0; i<p->n; ++i) {
+        if (pf < 0.0) {
+          IMPULS(p,i,X) = 0.0;
+          IMPULS(p,i,Y) = 0.0;
+#ifndef TWOD
+          IMPULS(p,i,Z) = 0.0;
+#endif
+        }
+        IMPULS(p,i,X) += timestep * KRAFT(p,i,X);
+        IMPULS(p,i,Y) += timestep * KRAFT(p,i,Y);
+#ifndef TWOD
+        IMPULS(p,i,Z) += timestep * KRAFT(p,i,Z);
+#endif
+        tmp = timestep / MASSE(p,i);
+        ORT(p,i,X) += tmp * IMPULS(p,i,X);
+        ORT(p,i,Y) += tmp * IMPULS(p,i,Y);
+#ifndef TWOD
+        ORT(p,i,Z) += tmp * IMPULS(p,i,Z);
+#endif
+      }
+    }
+  }
+}
+
+/******************************************************************************
+*
+*  has the quenched configuration left the reference minimum?
+*
+******************************************************************************/
+
+static int prd_left_reference(void)
+{
+  int  k;
+  real d2max = 0.0;
+#ifdef MPI
+  real tmp;
+#endif
+
+  for (k=0; k<NCELLS; ++k) {
+    int    i;
+    real   x;
+    vektor d;
+    cell   *p = CELLPTR(k);
+    for (i=0; i<p->n; ++i) {
+      d.x = ORT(p,i,X) - PRD_SAVE(p,i,PRD_REF  );
+      d.y = ORT(p,i,Y) - PRD_SAVE(p,i,PRD_REF+1);
+#ifndef TWOD
+      d.z = ORT(p,i,Z) - PRD_SAVE(p,i,PRD_REF+2);
+#endif
+      /* apply periodic boundary conditions */
+      if (1==pbc_dirs.x) {
+        x = - round( SPROD(d,tbox_x) );
+        d.x += x * box_x.x;
+        d.y += x * box_x.y;
+#ifndef TWOD
+        d.z += x * box_x.z;
+#endif
+      }
+      if (1==pbc_dirs.y) {
+        x = - round( SPROD(d,tbox_y) );
+        d.x += x * box_y.x;
+        d.y += x * box_y.y;
+#ifndef TWOD
+        d.z += x * box_y.z;
+#endif
+      }
+#ifndef TWOD
+      if (1==pbc_dirs.z) {
+        x = - round( SPROD(d,tbox_z) );
+        d.x += x * box_z.x;
+        d.y += x * box_z.y;
+        d.z += x * box_z.z;
+      }
+#endif
+      d2max = MAX( d2max, SPROD(d,d) );
+    }
+  }
+#ifdef MPI
+  MPI_Allreduce( &d2max, &tmp, 1, REAL, MPI_MAX, cpugrid);
+  d2max = tmp;
+#endif
+  return (d2max > SQR(prd_dmax));
+}
+
+/******************************************************************************
+*
+*  quench a copy of the current state and compare with the reference
+*
+******************************************************************************/
+
+static int prd_check(void)
+{
+  int trans;
+
+  prd_save();
+  prd_quench();
+  trans = prd_left_reference();
+  prd_restore();
+  return trans;
+}
+
+/******************************************************************************
+*
+*  quench a copy of the current state and make it the new reference
+*
+******************************************************************************/
+
+static void prd_new_reference(void)
+{
+  prd_save();
+  prd_quench();
+  prd_set_reference();
+  prd_restore();
+}
+
+/******************************************************************************
+*
+*  start a new, decorrelated trajectory
+*
+******************************************************************************/
+
+static void prd_start_md(void)
+{
+  maxwell(temperature);
+#ifdef NVT
+  eta = 0.0;
+#endif
+}
+
+/******************************************************************************
+*
+*  copy the state of replica root to all other replicas
+*
+*  All replicas have the same domain decomposition, so every CPU
+*  exchanges its atoms with the CPUs of the same rank in the other
+*  replicas.
+*
+******************************************************************************/
+
+static void prd_bcast_state(int root)
+{
+#ifdef MPI
+  static msgbuf b = {NULL, 0, 0};
+  int k, n;
+
+  if (prd_nrep == 1) return;
+
+  if (myrank == root) {
+    n = 0;
+    for (k=0; k<NCELLS; ++k) n += CELLPTR(k)->n;
+    if (b.n_max < n * atom_size) alloc_msgbuf(&b, n * atom_size);
+    b.n = 0;
+    for (k=0; k<NCELLS; ++k) {
+      int  i;
+      cell *p = CELLPTR(k);
+      for (i=0; i<p->n; ++i) copy_atom_cell_buf(&b, myid, p, i);
+    }
+    n = b.n;
+  }
+  MPI_Bcast( &n, 1, MPI_INT, root, prd_rep_comm);
+  if (myrank != root) {
+    if (b.n_max < n) alloc_msgbuf(&b, n);
+    b.n = n;
+  }
+  MPI_Bcast( b.data, n, REAL, root, prd_rep_comm);
+
+  /* replace my atoms */
+  if (myrank != root) {
+    for (k=0; k<NCELLS; ++k) CELLPTR(k)->n = 0;
+    process_buffer(&b);
+#ifdef NBLIST
+    /* the atoms are all new, the lists are rebuilt with the forces */
+    have_valid_nbl = 0;
+#else
+    fix_cells();
+#endif
+  }
+#endif
+}
+
+/******************************************************************************
+*
+*  write a line to the .prd file
+*
+******************************************************************************/
+
+static void write_prd_file(void)
+{
+  if ((0!=myrank) || (0!=myid)) return;
+  fprintf(prd_file, "%d %d %e %d %e\n", prd_nevent, steps, prd_time,
+          prd_winner, tot_pot_energy / natoms);
+  fflush(prd_file);
+}
+
+/******************************************************************************
+*
+*  initialize parallel replica dynamics
+*
+******************************************************************************/
+
+void init_prd(void)
+{
+  str255 fname;
+
+  if (NULL==prd_outfilename) prd_outfilename = strdup(outfilename);
+
+  if ((0==myrank) && (0==myid)) {
+    sprintf(fname, "%s.prd", prd_outfilename);
+    prd_file = fopen(fname, "a");
+    if (NULL == prd_file) error_str("Cannot open PRD file %s", fname);
+    if (0==imdrestart)
+      fprintf(prd_file, "# event step time replica Epot_min\n");
+  }
+
+  /* find the initial reference minimum */
+  prd_new_reference();
+  if ((0==myrank) && (0==myid))
+    printf("PRD: initial minimum has Epot = %e per atom\n",
+           tot_pot_energy / natoms);
+  write_prd_file();
+
+  prd_phase = PRD_DEPHASE;
+  prd_count = 0;
+  prd_start_md();
+}
+
+/******************************************************************************
+*
+*  advance the PRD cycle by one MD step
+*
+*  All replicas step in lockstep, so the decisions below are taken at the
+*  same step everywhere. Replicas that lose a transition race keep on
+*  running during correlation, but their state is overwritten afterwards.
+*
+******************************************************************************/
+
+void prd_step(void)
+{
+  int trans;
+
+  prd_count++;
+
+  switch (prd_phase) {
+
+  case PRD_DEPHASE:
+    /* a replica that left the minimum restarts from the reference */
+    if (prd_count < prd_dephase) return;
+    trans = prd_check();
+    if (trans) {
+      int k;
+      for (k=0; k<NCELLS; ++k) {
+        int  i;
+        cell *p = CELLPTR(k);
+        for (i=0; i<p->n; ++i) {
+          ORT(p,i,X) = PRD_SAVE(p,i,PRD_REF  );
+          ORT(p,i,Y) = PRD_SAVE(p,i,PRD_REF+1);
+#ifndef TWOD
+          ORT(p,i,Z) = PRD_SAVE(p,i,PRD_REF+2);
+#endif
+        }
+      }
+#ifdef NBLIST
+      check_nblist();
+#else
+      fix_cells();
+#endif
+      prd_start_md();
+    }
+    prd_count = 0;
+    if (0 == prd_max_int(trans)) prd_phase = PRD_PARALLEL;
+    break;
+
+  case PRD_PARALLEL:
+    if (prd_count < prd_check_int) return;
+    prd_count = 0;
+    prd_time += prd_nrep * prd_check_int * timestep;
+    trans = prd_check();
+    prd_winner = prd_min_int( trans ? myrank : prd_nrep );
+    if (prd_winner < prd_nrep) {
+      prd_phase = PRD_CORRELATE;
+      if ((0==myrank) && (0==myid))
+        printf("PRD: transition in replica %d at step %d\n", prd_winner, steps);
+    }
+    break;
+
+  case PRD_CORRELATE:
+    if (prd_count < prd_corr) return;
+    prd_count = 0;
+    prd_time += prd_corr * timestep;
+    prd_bcast_state(prd_winner);
+    prd_new_reference();
+    prd_nevent++;
+    write_prd_file();
+    prd_phase = PRD_DEPHASE;
+    prd_start_md();
+    break;
+  }
+}
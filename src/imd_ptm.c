@@ -0,0 +1,580 @@
+/******************************************************************************
+*
+* IMD -- The ITAP Molecular Dynamics Program
+*
+* Copyright 1996-2013 Institute for Theoretical and Applied Physics,
+* University of Stuttgart, D-70550 Stuttgart
+*
+******************************************************************************/
+
+/******************************************************************************
+*
+* imd_ptm.c -- template matching of local structure, orientation and strain
+*
+* The nearest neighbors of each atom, taken from the complete neighbor
+* table, are matched against the ideal neighbor shells of fcc, hcp, bcc,
+* icosahedral and simple cubic structures. A correspondence between
+* neighbors and template vectors is seeded by mapping the nearest neighbor
+* onto a representative template vector and a second neighbor onto each
+* template vector with the same bond angle (from tables computed once),
+* and completed by nearest assignment. A least squares affine fit of the
+* template to the neighbors is split by polar decomposition into the local
+* lattice orientation and the elastic stretch. The template with the
+* smallest scale invariant RMSD is chosen, if it is below ptm_rmsd_max.
+*
+******************************************************************************/
+
+/******************************************************************************
+* $Revision$
+* $Date$
+******************************************************************************/
+
+#include "imd.h"
+
+#define PTM_MAXNB   14     /* largest template */
+#define PTM_NTEMPL  5      /* number of templates */
+#define PTM_COSTOL  0.2    /* tolerance of bond angle cosines */
+#define PTM_MAXSYM  60     /* largest rotation group (icosahedral) */
+
+typedef struct {
+  int    type;             /* PTM_FCC, ... */
+  int    n;                /* number of neighbors */
+  int    nrep;             /* number of classes of equivalent neighbors */
+  int    rep[2];           /* representative neighbor of each class */
+  real   dnn;              /* nearest neighbor distance / ptm_latticeConst */
+  real   t[PTM_MAXNB][3];  /* neighbor vectors, nearest neighbor dist. 1 */
+  real   tt2;              /* sum of squared lengths */
+  real   tinv[3][3];       /* inverse of sum of t t^T */
+  real   cosr[2][PTM_MAXNB]; /* bond angle cosines to the representatives */
+  int    nsym;             /* number of symmetry rotations */
+  real   sym[PTM_MAXSYM][3][3]; /* rotations mapping the template on itself */
+} ptm_templ;
+
+static ptm_templ ptm_tmpl[PTM_NTEMPL];
+
+/******************************************************************************
+*
+*  small 3x3 matrix helpers
+*
+******************************************************************************/
+
+static real det3(real a[3][3])
+{
+  return a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1])
+       - a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0])
+       + a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+}
+
+static void inv3(real a[3][3], real b[3][3])
+{
+  real d = 1.0 / det3(a);
+
+  b[0][0] = (a[1][1] * a[2][2] - a[1][2] * a[2][1]) * d;
+  b[0][1] = (a[0][2] * a[2][1] - a[0][1] * a[2][2]) * d;
+  b[0][2] = (a[0][1] * a[1][2] - a[0][2] * a[1][1]) * d;
+  b[1][0] = (a[1][2] * a[2][0] - a[1][0] * a[2][2]) * d;
+  b[1][1] = (a[0][0] * a[2][2] - a[0][2] * a[2][0]) * d;
+  b[1][2] = (a[0][2] * a[1][0] - a[0][0] * a[1][2]) * d;
+  b[2][0] = (a[1][0] * a[2][1] - a[1][1] * a[2][0]) * d;
+  b[2][1] = (a[0][1] * a[2][0] - a[0][0] * a[2][1]) * d;
+  b[2][2] = (a[0][0] * a[1][1] - a[0][1] * a[1][0]) * d;
+}
+
+/* eigenvalues w and eigenvectors (columns of v) of symmetric a (Jacobi) */
+static void eig3(real a[3][3], real w[3], real v[3][3])
+{
+  int  i, j, k, p, q, sweep;
+  real m[3][3], th, t, c, s, tmp;
+
+  for (i=0; i<3; i++)
+    for (j=0; j<3; j++) {
+      m[i][j] = a[i][j];
+      v[i][j] = (i==j) ? 1.0 : 0.0;
+    }
+  for (sweep=0; sweep<50; sweep++) {
+    if (ABS(m[0][1]) + ABS(m[0][2]) + ABS(m[1][2]) <
+        1e-15 * (ABS(m[0][0]) + ABS(m[1][1]) + ABS(m[2][2]))) break;
+    for (p=0; p<2; p++)
+      for (q=p+1; q<3; q++) {
+        if (0.0 == m[p][q]) continue;
+        th = (m[q][q] - m[p][p]) / (2 * m[p][q]);
+        t  = ((th >= 0) ? 1.0 : -1.0) / (ABS(th) + sqrt(th * th + 1));
+        c  = 1.0 / sqrt(t * t + 1);
+        s  = t * c;
+        for (k=0; k<3; k++) {
+          tmp = m[k][p];
+          m[k][p] = c * tmp - s * m[k][q];
+          m[k][q] = s * tmp + c * m[k][q];
+        }
+        for (k=0; k<3; k++) {
+          tmp = m[p][k];
+          m[p][k] = c * tmp - s * m[q][k];
+          m[q][k] = s * tmp + c * m[q][k];
+        }
+        for (k=0; k<3; k++) {
+          tmp = v[k][p];
+          v[k][p] = c * tmp - s * v[k][q];
+          v[k][q] = s * tmp + c * v[k][q];
+        }
+      }
+  }
+  for (i=0; i<3; i++) w[i] = m[i][i];
+}
+
+/* orthonormal frame o (rows) spanned by u0 and u1 */
+static void ptm_frame(real *u0, real *u1, real o[3][3])
+{
+  real nrm, d;
+  int  j;
+
+  nrm = 1.0 / sqrt(SQR(u0[0]) + SQR(u0[1]) + SQR(u0[2]));
+  for (j=0; j<3; j++) o[0][j] = u0[j] * nrm;
+  d = o[0][0] * u1[0] + o[0][1] * u1[1] + o[0][2] * u1[2];
+  for (j=0; j<3; j++) o[1][j] = u1[j] - d * o[0][j];
+  nrm = 1.0 / sqrt(SQR(o[1][0]) + SQR(o[1][1]) + SQR(o[1][2]));
+  for (j=0; j<3; j++) o[1][j] *= nrm;
+  o[2][0] = o[0][1] * o[1][2] - o[0][2] * o[1][1];
+  o[2][1] = o[0][2] * o[1][0] - o[0][0] * o[1][2];
+  o[2][2] = o[0][0] * o[1][1] - o[0][1] * o[1][0];
+}
+
+/* rotation Q taking the frame of (u0,u1) onto the frame of (v0,v1) */
+static void ptm_rot(real *u0, real *u1, real *v0, real *v1, real Q[3][3])
+{
+  real a[3][3], b[3][3];
+  int  j, l;
+
+  ptm_frame(u0, u1, a);
+  ptm_frame(v0, v1, b);
+  for (j=0; j<3; j++)
+    for (l=0; l<3; l++)
+      Q[j][l] = b[0][j] * a[0][l] + b[1][j] * a[1][l] + b[2][j] * a[2][l];
+}
+
+static real ptm_cos(real *a, real *b)
+{
+  return (a[0]*b[0] + a[1]*b[1] + a[2]*b[2]) /
+    sqrt((SQR(a[0]) + SQR(a[1]) + SQR(a[2])) *
+         (SQR(b[0]) + SQR(b[1]) + SQR(b[2])));
+}
+
+/******************************************************************************
+*
+*  set up one template; the neighbor vectors are normalized to nearest
+*  neighbor distance 1
+*
+******************************************************************************/
+
+static void ptm_set_template(ptm_templ *T, int type, int n, real v[][3],
+                             real dnn, int nrep, int rep0, int rep1)
+{
+  int  i, j, k, r, m, a, b;
+  real l = 0.0, s[3][3], c, l0, l1;
+
+  T->type = type;
+  T->n    = n;
+  T->dnn  = dnn;
+  T->nrep = nrep;
+  T->rep[0] = rep0;
+  T->rep[1] = rep1;
+
+  /* scale to nearest neighbor distance 1 */
+  for (i=0; i<n; i++) {
+    real r2 = SQR(v[i][0]) + SQR(v[i][1]) + SQR(v[i][2]);
+    if ((0==i) || (r2 < l)) l = r2;
+  }
+  l = 1.0 / sqrt(l);
+  T->tt2 = 0.0;
+  for (j=0; j<3; j++)
+    for (k=0; k<3; k++) s[j][k] = 0.0;
+  for (i=0; i<n; i++) {
+    for (j=0; j<3; j++) T->t[i][j] = v[i][j] * l;
+    for (j=0; j<3; j++) {
+      T->tt2 += SQR(T->t[i][j]);
+      for (k=0; k<3; k++) s[j][k] += T->t[i][j] * T->t[i][k];
+    }
+  }
+  inv3(s, T->tinv);
+
+  /* bond angles to the representatives */
+  for (r=0; r<nrep; r++)
+    for (i=0; i<n; i++)
+      T->cosr[r][i] = ptm_cos(T->t[T->rep[r]], T->t[i]);
+
+  /* symmetry rotations: map two neighbors onto all equivalent pairs,
+     keep the rotations which map the template onto itself */
+  for (m=1; ABS(ptm_cos(T->t[0], T->t[m])) > 0.95; m++);
+  c  = ptm_cos(T->t[0], T->t[m]);
+  l0 = SQR(T->t[0][0]) + SQR(T->t[0][1]) + SQR(T->t[0][2]);
+  l1 = SQR(T->t[m][0]) + SQR(T->t[m][1]) + SQR(T->t[m][2]);
+  T->nsym = 0;
+  for (a=0; a<n; a++)
+    for (b=0; b<n; b++) {
+      real Q[3][3];
+      int  ok = 1;
+      if ((a == b) || (ABS(ptm_cos(T->t[a], T->t[b]) - c) > 1e-6) ||
+          (ABS(SQR(T->t[a][0]) + SQR(T->t[a][1]) + SQR(T->t[a][2]) - l0) > 1e-6) ||
+          (ABS(SQR(T->t[b][0]) + SQR(T->t[b][1]) + SQR(T->t[b][2]) - l1) > 1e-6))
+        continue;
+      ptm_rot(T->t[0], T->t[m], T->t[a], T->t[b], Q);
+      for (i=0; (i<n) && ok; i++) {
+        real y[3];
+        for (j=0; j<3; j++)
+          y[j] = Q[j][0] * T->t[i][0] + Q[j][1] * T->t[i][1] +
+                 Q[j][2] * T->t[i][2];
+        for (k=0; k<n; k++)
+          if (SQR(y[0] - T->t[k][0]) + SQR(y[1] - T->t[k][1]) +
+              SQR(y[2] - T->t[k][2]) < 1e-10) break;
+        ok = (k < n);
+      }
+      if (!ok) continue;
+      if (T->nsym == PTM_MAXSYM) error("PTM: too many template symmetries");
+      for (j=0; j<3; j++)
+        for (k=0; k<3; k++) T->sym[T->nsym][j][k] = Q[j][k];
+      T->nsym++;
+    }
+}
+
+/******************************************************************************
+*
+*  initialize templates and the neighbor table cutoff
+*
+******************************************************************************/
+
+void init_ptm(void)
+{
+  real v[PTM_MAXNB][3], g = 0.5 * (1.0 + sqrt(5.0)), h = sqrt(2.0 / 3.0);
+  int  i, j, k, n;
+
+  /* fcc: (+-1,+-1,0) and permutations */
+  n = 0;
+  for (k=0; k<3; k++)
+    for (i=-1; i<=1; i+=2)
+      for (j=-1; j<=1; j+=2) {
+        v[n][k] = 0.0;  v[n][(k+1)%3] = i;  v[n][(k+2)%3] = j;  n++;
+      }
+  ptm_set_template(ptm_tmpl + 0, PTM_FCC, 12, v, sqrt(0.5), 1, 0, 0);
+
+  /* hcp: six neighbors in the basal plane, three above and below */
+  for (i=0; i<6; i++) {
+    v[i][0] = cos(i * M_PI / 3);  v[i][1] = sin(i * M_PI / 3);  v[i][2] = 0.0;
+  }
+  for (i=0; i<3; i++) {
+    real phi = M_PI / 6 + i * 2 * M_PI / 3;
+    v[6+i][0] = v[9+i][0] = cos(phi) / sqrt(3.0);
+    v[6+i][1] = v[9+i][1] = sin(phi) / sqrt(3.0);
+    v[6+i][2] =  h;
+    v[9+i][2] = -h;
+  }
+  ptm_set_template(ptm_tmpl + 1, PTM_HCP, 12, v, 1.0, 2, 0, 6);
+
+  /* bcc: eight nearest neighbors (+-1,+-1,+-1), six second (+-2,0,0) */
+  n = 0;
+  for (i=-1; i<=1; i+=2)
+    for (j=-1; j<=1; j+=2)
+      for (k=-1; k<=1; k+=2) {
+        v[n][0] = i;  v[n][1] = j;  v[n][2] = k;  n++;
+      }
+  for (k=0; k<3; k++)
+    for (i=-2; i<=2; i+=4) {
+      v[n][k] = i;  v[n][(k+1)%3] = 0.0;  v[n][(k+2)%3] = 0.0;  n++;
+    }
+  ptm_set_template(ptm_tmpl + 2, PTM_BCC, 14, v, 0.5 * sqrt(3.0), 1, 0, 0);
+
+  /* icosahedron: (0,+-1,+-g) and cyclic permutations */
+  n = 0;
+  for (k=0; k<3; k++)
+    for (i=-1; i<=1; i+=2)
+      for (j=-1; j<=1; j+=2) {
+        v[n][k] = 0.0;  v[n][(k+1)%3] = i;  v[n][(k+2)%3] = j * g;  n++;
+      }
+  ptm_set_template(ptm_tmpl + 3, PTM_ICO, 12, v, sqrt(0.5), 1, 0, 0);
+
+  /* simple cubic */
+  n = 0;
+  for (k=0; k<3; k++)
+    for (i=-1; i<=1; i+=2) {
+      v[n][k] = i;  v[n][(k+1)%3] = 0.0;  v[n][(k+2)%3] = 0.0;  n++;
+    }
+  ptm_set_template(ptm_tmpl + 4, PTM_SC, 6, v, 1.0, 1, 0, 0);
+
+  /* the neighbor table must reach the second bcc shell */
+  nnbr_r2cut = MAX(nnbr_r2cut, ptm_r2cut);
+#ifdef NYETENSOR
+  if (ptm_r2cut > ada_nbr_r2cut)
+    error("ptm_rcut must not exceed the ADA neighbor cutoff with nye");
+#endif
+#if defined(COVALENT) && !defined(CNA)
+  /* the force loop builds the neighbor table, up to the potential cutoff */
+  for (i=0; i<ntypes*ntypes; i++)
+    if (ptm_r2cut > neightab_r2cut[i])
+      error("ptm_rcut must not exceed the cutoff of the covalent potential");
+#endif
+
+  if (0==myid) {
+    printf("PTM: neighbor cut-off radius: %f\n", sqrt(ptm_r2cut));
+    printf("PTM: write interval: %d\n", ptm_int);
+  }
+}
+
+/******************************************************************************
+*
+*  fit template T to the neighbors x under the correspondence perm;
+*  returns the RMSD relative to the mean neighbor distance len, and the
+*  rotation R and the strain eps (both in the sample frame)
+*
+******************************************************************************/
+
+static real ptm_fit(ptm_templ *T, real x[][3], int *perm, real len,
+                    real R[3][3], real eps[3][3])
+{
+  real M[3][3], A[3][3], C[3][3], U[3][3], Ui[3][3], w[3], V[3][3];
+  real s = 0.0, d2 = 0.0, dref;
+  int  i, j, k, l;
+
+  /* affine fit x = A t */
+  for (j=0; j<3; j++)
+    for (k=0; k<3; k++) M[j][k] = 0.0;
+  for (i=0; i<T->n; i++)
+    for (j=0; j<3; j++)
+      for (k=0; k<3; k++) M[j][k] += x[i][j] * T->t[perm[i]][k];
+  for (j=0; j<3; j++)
+    for (k=0; k<3; k++)
+      A[j][k] = M[j][0] * T->tinv[0][k] + M[j][1] * T->tinv[1][k] +
+                M[j][2] * T->tinv[2][k];
+  if (det3(A) <= 0.0) return 1e10;
+
+  /* polar decomposition A = R U, U = sqrt(A^T A) */
+  for (j=0; j<3; j++)
+    for (k=0; k<3; k++)
+      C[j][k] = A[0][j] * A[0][k] + A[1][j] * A[1][k] + A[2][j] * A[2][k];
+  eig3(C, w, V);
+  for (l=0; l<3; l++) w[l] = sqrt(MAX(w[l], 0.0));
+  for (j=0; j<3; j++)
+    for (k=0; k<3; k++) {
+      U[j][k] = Ui[j][k] = 0.0;
+      for (l=0; l<3; l++) {
+        U [j][k] += V[j][l] * w[l] * V[k][l];
+        Ui[j][k] += V[j][l] / w[l] * V[k][l];
+      }
+    }
+  for (j=0; j<3; j++)
+    for (k=0; k<3; k++)
+      R[j][k] = A[j][0] * Ui[0][k] + A[j][1] * Ui[1][k] + A[j][2] * Ui[2][k];
+
+  /* best scale and deviation for a rotation only */
+  for (j=0; j<3; j++)
+    for (k=0; k<3; k++) s += R[j][k] * M[j][k];
+  s /= T->tt2;
+  for (i=0; i<T->n; i++)
+    for (j=0; j<3; j++) {
+      real *t = T->t[perm[i]];
+      d2 += SQR(x[i][j] - s * (R[j][0]*t[0] + R[j][1]*t[1] + R[j][2]*t[2]));
+    }
+
+  /* elastic strain V - 1 = R (U / dref - 1) R^T */
+  dref = (ptm_latticeConst > 0.0) ? T->dnn * ptm_latticeConst : s;
+  for (j=0; j<3; j++)
+    for (k=0; k<3; k++) U[j][k] = U[j][k] / dref - ((j==k) ? 1.0 : 0.0);
+  for (j=0; j<3; j++)
+    for (k=0; k<3; k++) {
+      eps[j][k] = 0.0;
+      for (i=0; i<3; i++)
+        for (l=0; l<3; l++) eps[j][k] += R[j][i] * U[i][l] * R[k][l];
+    }
+
+  return sqrt(d2 / T->n) / len;
+}
+
+/******************************************************************************
+*
+*  match the n nearest neighbors x (sorted by distance) to template T
+*
+******************************************************************************/
+
+static real ptm_match(ptm_templ *T, real x[][3], real R[3][3], real eps[3][3])
+{
+  real len = 0.0, c01 = 0.0, best = 1e10, Rc[3][3], epsc[3][3];
+  int  i, j, k, l, r, m = 1, perm[PTM_MAXNB], used[PTM_MAXNB];
+
+  for (i=0; i<T->n; i++)
+    len += sqrt(SQR(x[i][0]) + SQR(x[i][1]) + SQR(x[i][2]));
+  len /= T->n;
+
+  /* the nearest and the nearest non-collinear neighbor */
+  for (m=1; m<T->n; m++) {
+    c01 = ptm_cos(x[0], x[m]);
+    if (ABS(c01) < 0.95) break;
+  }
+  if (m == T->n) return best;
+
+  for (r=0; r<T->nrep; r++)
+    for (k=0; k<T->n; k++) {
+      real Q[3][3];
+      if ((k == T->rep[r]) || (ABS(T->cosr[r][k] - c01) > PTM_COSTOL))
+        continue;
+
+      /* rotation Q taking the neighbor frame onto the template frame */
+      ptm_rot(x[0], x[m], T->t[T->rep[r]], T->t[k], Q);
+
+      /* assign each neighbor to the nearest template vector */
+      for (l=0; l<T->n; l++) used[l] = 0;
+      for (i=0; i<T->n; i++) {
+        real y[3], d2min = 1e10;
+        int  lmin = 0;
+        for (j=0; j<3; j++)
+          y[j] = (Q[j][0]*x[i][0] + Q[j][1]*x[i][1] + Q[j][2]*x[i][2]) / len;
+        for (l=0; l<T->n; l++) {
+          real d2 = SQR(y[0] - T->t[l][0]) + SQR(y[1] - T->t[l][1]) +
+                    SQR(y[2] - T->t[l][2]);
+          if (d2 < d2min) { d2min = d2; lmin = l; }
+        }
+        if (used[lmin]) break;
+        used[lmin] = 1;
+        perm[i] = lmin;
+      }
+      if (i < T->n) continue;
+
+      /* keep the best fit */
+      {
+        real d = ptm_fit(T, x, perm, len, Rc, epsc);
+        if (d < best) {
+          best = d;
+          for (j=0; j<3; j++)
+            for (l=0; l<3; l++) {
+              R  [j][l] = Rc  [j][l];
+              eps[j][l] = epsc[j][l];
+            }
+        }
+      }
+    }
+  return best;
+}
+
+/******************************************************************************
+*
+*  classify one atom
+*
+******************************************************************************/
+
+static void ptm_atom(cell *p, int i)
+{
+  neightab *nb = NEIGH(p,i);
+  real     x[PTM_MAXNB][3], r2[PTM_MAXNB], R[3][3], eps[3][3];
+  real     best = ptm_rmsd_max, Rb[3][3], epsb[3][3], q[4], tr, trmax;
+  int      n = 0, j, k, l, type = PTM_OTHER, kb = 0, g, gb = 0;
+
+  /* the nearest neighbors, sorted by distance */
+  for (j=0; j<nb->n; j++) {
+    real *d = nb->dist + 3*j, d2 = SQR(d[0]) + SQR(d[1]) + SQR(d[2]);
+    if (d2 > ptm_r2cut) continue;
+    if ((n == PTM_MAXNB) && (d2 >= r2[n-1])) continue;
+    if (n < PTM_MAXNB) n++;
+    for (k=n-1; (k > 0) && (r2[k-1] > d2); k--) {
+      r2[k] = r2[k-1];
+      for (l=0; l<3; l++) x[k][l] = x[k-1][l];
+    }
+    r2[k] = d2;
+    for (l=0; l<3; l++) x[k][l] = d[l];
+  }
+
+  for (k=0; k<PTM_NTEMPL; k++) {
+    ptm_templ *T = ptm_tmpl + k;
+    real d;
+    if (T->n > n) continue;
+    d = ptm_match(T, x, R, eps);
+    if (d < best) {
+      best = d;
+      type = T->type;
+      kb   = k;
+      for (j=0; j<3; j++)
+        for (l=0; l<3; l++) {
+          Rb  [j][l] = R  [j][l];
+          epsb[j][l] = eps[j][l];
+        }
+    }
+  }
+
+  PTM_TYPE(p,i) = type;
+  for (k=0; k<PTM_NDAT; k++) PTM_DAT(p,i,k) = 0.0;
+  if (PTM_OTHER == type) return;
+
+  /* among the equivalent orientations R G take the smallest rotation */
+  trmax = -3.0;
+  for (g=0; g<ptm_tmpl[kb].nsym; g++) {
+    real (*G)[3] = ptm_tmpl[kb].sym[g];
+    tr = 0.0;
+    for (j=0; j<3; j++)
+      for (l=0; l<3; l++) tr += Rb[j][l] * G[l][j];
+    if (tr > trmax) { trmax = tr; gb = g; }
+  }
+  for (j=0; j<3; j++) {
+    real (*G)[3] = ptm_tmpl[kb].sym[gb], r[3];
+    for (l=0; l<3; l++)
+      r[l] = Rb[j][0] * G[0][l] + Rb[j][1] * G[1][l] + Rb[j][2] * G[2][l];
+    for (l=0; l<3; l++) Rb[j][l] = r[l];
+  }
+
+  /* orientation as unit quaternion */
+  tr = Rb[0][0] + Rb[1][1] + Rb[2][2];
+  if (tr > 0.0) {
+    real s = 0.5 / sqrt(tr + 1.0);
+    q[0] = 0.25 / s;
+    q[1] = (Rb[2][1] - Rb[1][2]) * s;
+    q[2] = (Rb[0][2] - Rb[2][0]) * s;
+    q[3] = (Rb[1][0] - Rb[0][1]) * s;
+  }
+  else if ((Rb[0][0] > Rb[1][1]) && (Rb[0][0] > Rb[2][2])) {
+    real s = 2.0 * sqrt(1.0 + Rb[0][0] - Rb[1][1] - Rb[2][2]);
+    q[0] = (Rb[2][1] - Rb[1][2]) / s;
+    q[1] = 0.25 * s;
+    q[2] = (Rb[0][1] + Rb[1][0]) / s;
+    q[3] = (Rb[0][2] + Rb[2][0]) / s;
+  }
+  else if (Rb[1][1] > Rb[2][2]) {
+    real s = 2.0 * sqrt(1.0 + Rb[1][1] - Rb[0][0] - Rb[2][2]);
+    q[0] = (Rb[0][2] - Rb[2][0]) / s;
+    q[1] = (Rb[0][1] + Rb[1][0]) / s;
+    q[2] = 0.25 * s;
+    q[3] = (Rb[1][2] + Rb[2][1]) / s;
+  }
+  else {
+    real s = 2.0 * sqrt(1.0 + Rb[2][2] - Rb[0][0] - Rb[1][1]);
+    q[0] = (Rb[1][0] - Rb[0][1]) / s;
+    q[1] = (Rb[0][2] + Rb[2][0]) / s;
+    q[2] = (Rb[1][2] + Rb[2][1]) / s;
+    q[3] = 0.25 * s;
+  }
+  if (q[0] < 0.0) for (k=0; k<4; k++) q[k] = -q[k];
+
+  PTM_DAT(p,i,0) = best;
+  for (k=0; k<4; k++) PTM_DAT(p,i,1+k) = q[k];
+  PTM_DAT(p,i, 5) = epsb[0][0];
+  PTM_DAT(p,i, 6) = epsb[1][1];
+  PTM_DAT(p,i, 7) = epsb[2][2];
+  PTM_DAT(p,i, 8) = epsb[1][2];
+  PTM_DAT(p,i, 9) = epsb[2][0];
+  PTM_DAT(p,i,10) = epsb[0][1];
+}
+
+/******************************************************************************
+*
+*  classify all atoms
+*
+******************************************************************************/
+
+void do_ptm(void)
+{
+  int k;
+
+  do_neightab_complete();
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (k=0; k<ncells; k++) {
+    cell *p = CELLPTR(k);
+    int  i;
+    for (i=0; i<p->n; i++) ptm_atom(p, i);
+  }
+}
@@ -0,0 +1,298 @@
+/******************************************************************************
+*
+* IMD -- The ITAP Molecular Dynamics Program
+*
+* Copyright 1996-2013 Institute for Theoretical and Applied Physics,
+* University of Stuttgart, D-70550 Stuttgart
+*
+******************************************************************************/
+
+/******************************************************************************
+*
+* imd_rdf.c -- pair distribution, bond angle and coordination statistics
+*
+* The partial pair distribution functions g_ab(r), the bond angle
+* distribution and the coordination numbers are accumulated during the
+* run from the complete neighbor table, which is shared with the other
+* structure analyses and built from the cell pairs (or the NBL cell pairs)
+* of the force computation. Every atom is seen from each of its neighbors,
+* so no pair has to be counted twice. The counts of each sample are
+* weighted with the current volume and summed up locally; only at output
+* time the sums are reduced over the CPUs, written and reset.
+*
+******************************************************************************/
+
+/******************************************************************************
+* $Revision$
+* $Date$
+******************************************************************************/
+
+#include "imd.h"
+
+#define RDF_MAXBOND 64     /* max. number of bonds of an atom */
+
+static int    rdf_nsamp = 0;          /* number of samples since last write */
+static int    rdf_len   = 0;          /* length of the sums */
+static int    rdf_cnt_len = 0;        /* length of the counts of a thread */
+static double *rdf_sum  = NULL;       /* g(r), angles, bonds, coordination */
+static long   *rdf_cnt  = NULL;       /* counts of one sample, per thread */
+static real   rdf_scale = 0.0;        /* inverse bin width of g(r) */
+
+/* offsets of the different histograms in rdf_sum and rdf_cnt */
+#define RDF_G(k,a,b)   (((k) * ntypes + (a)) * ntypes + (b))
+#define RDF_ANG(k,a)   (rdf_nbins * ntypes * ntypes + (k) * ntypes + (a))
+#define RDF_BOND(a,b)  (rdf_nbins * ntypes * ntypes + rdf_angle_nbins * ntypes \
+                        + (a) * ntypes + (b))
+#define RDF_COORD(a,n) (rdf_nbins * ntypes * ntypes + rdf_angle_nbins * ntypes \
+                        + ntypes * ntypes + (a) * (RDF_MAXBOND+1) + (n))
+
+/******************************************************************************
+*
+*  init_rdf
+*
+******************************************************************************/
+
+void init_rdf(void)
+{
+  int nthreads = 1, i;
+
+#ifdef _OPENMP
+  nthreads = omp_get_max_threads();
+#endif
+  rdf_cnt_len = rdf_nbins * ntypes * ntypes + rdf_angle_nbins * ntypes
+                + ntypes * ntypes + ntypes * (RDF_MAXBOND+1);
+  /* the total g(r) is kept behind the counted histograms */
+  rdf_len = rdf_cnt_len + rdf_nbins;
+  rdf_sum = (double *) calloc( rdf_len, sizeof(double) );
+  rdf_cnt = (long   *) calloc( nthreads * rdf_cnt_len, sizeof(long) );
+  if ((NULL==rdf_sum) || (NULL==rdf_cnt))
+    error("cannot allocate pair distribution histograms");
+  rdf_scale = rdf_nbins / sqrt(rdf_r2cut);
+  rdf_nsamp = 0;
+
+  /* the neighbor table must reach the g(r) cutoff */
+  nnbr_r2cut = MAX(nnbr_r2cut, rdf_r2cut);
+#ifdef NYETENSOR
+  if (rdf_r2cut > ada_nbr_r2cut)
+    error("rdf_rcut must not exceed the ADA neighbor cutoff with nye");
+#endif
+#if defined(COVALENT) && !defined(CNA)
+  /* the force loop builds the neighbor table, up to the potential cutoff */
+  for (i=0; i<ntypes*ntypes; i++)
+    if (rdf_r2cut > neightab_r2cut[i])
+      error("rdf_rcut must not exceed the cutoff of the covalent potential");
+#endif
+
+  if (0==myid) {
+    printf("RDF: g(r) cut-off radius: %f, %d bins\n", sqrt(rdf_r2cut),
+           rdf_nbins);
+    if (rdf_bond_r2cut > 0.0)
+      printf("RDF: bond cut-off radius: %f, %d angle bins\n",
+             sqrt(rdf_bond_r2cut), rdf_angle_nbins);
+    printf("RDF: sample interval: %d, write interval: %d\n",
+           rdf_int, rdf_write_int);
+  }
+}
+
+/******************************************************************************
+*
+*  sample the histograms of one atom
+*
+******************************************************************************/
+
+static void rdf_atom(cell *p, int i, long *cnt)
+{
+  neightab *nb = NEIGH(p, i);
+  real *bond[RDF_MAXBOND], blen[RDF_MAXBOND];
+  int  a = SORTE(p, i), j, l, k, nbond = 0;
+
+  for (j=0; j<nb->n; j++) {
+    real *d = nb->dist + 3*j;
+    real r2 = SPRODA3D(d, d);
+    int  b  = nb->typ[j];
+    if (r2 >= rdf_r2cut) continue;
+    k = (int) (sqrt(r2) * rdf_scale);
+    if (k < rdf_nbins) cnt[RDF_G(k,a,b)]++;
+    if (r2 < rdf_bond_r2cut) {
+      if (nbond == RDF_MAXBOND)
+        error("RDF: too many bonds - decrease rdf_bond_rcut");
+      bond[nbond] = d;
+      blen[nbond] = sqrt(r2);
+      nbond++;
+      cnt[RDF_BOND(a,b)]++;
+    }
+  }
+  if (rdf_bond_r2cut <= 0.0) return;
+
+  cnt[RDF_COORD(a,nbond)]++;
+  for (j=0; j<nbond; j++)
+    for (l=j+1; l<nbond; l++) {
+      real c = SPRODA3D(bond[j], bond[l]) / (blen[j] * blen[l]);
+      c = MAX(-1.0, MIN(1.0, c));
+      k = (int) (acos(c) / M_PI * rdf_angle_nbins);
+      if (k >= rdf_angle_nbins) k = rdf_angle_nbins - 1;
+      cnt[RDF_ANG(k,a)]++;
+    }
+}
+
+/******************************************************************************
+*
+*  do_rdf -- take one sample
+*
+******************************************************************************/
+
+void do_rdf(void)
+{
+  int  nthreads = 1, k, t, a, b;
+  long *cnt = rdf_cnt;
+  double w;
+
+#ifdef _OPENMP
+  nthreads = omp_get_max_threads();
+#endif
+  for (k=0; k<nthreads*rdf_cnt_len; k++) rdf_cnt[k] = 0;
+
+  do_neightab_complete();
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (k=0; k<ncells; k++) {
+    cell *p = CELLPTR(k);
+    long *c = rdf_cnt;
+    int  i;
+#ifdef _OPENMP
+    c += rdf_cnt_len * omp_get_thread_num();
+#endif
+    for (i=0; i<p->n; i++) rdf_atom(p, i, c);
+  }
+
+  /* add up the threads */
+  for (t=1; t<nthreads; t++)
+    for (k=0; k<rdf_cnt_len; k++) cnt[k] += rdf_cnt[t*rdf_cnt_len+k];
+
+  /* g(r) counts are weighted with V / (N_a N_b) of this sample */
+  for (a=0; a<ntypes; a++)
+    for (b=0; b<ntypes; b++) {
+      if ((0==num_sort[a]) || (0==num_sort[b])) continue;
+      w = volume / ((real) num_sort[a] * num_sort[b]);
+      for (k=0; k<rdf_nbins; k++)
+        rdf_sum[RDF_G(k,a,b)] += w * cnt[RDF_G(k,a,b)];
+    }
+  w = volume / ((real) natoms * natoms);
+  for (k=0; k<rdf_nbins; k++)
+    for (a=0; a<ntypes*ntypes; a++)
+      rdf_sum[rdf_cnt_len+k] += w * cnt[k*ntypes*ntypes+a];
+  for (k=rdf_nbins*ntypes*ntypes; k<rdf_cnt_len; k++)
+    rdf_sum[k] += cnt[k];
+  rdf_nsamp++;
+}
+
+/******************************************************************************
+*
+*  write_rdf -- reduce the sums over the CPUs, write and reset them
+*
+*  file .rdf:   r, g_ab(r) for a <= b, total g(r)
+*  file .angle: angle (degrees), bond angle distribution per bin for each
+*               type of the central atom, and for all atoms
+*  file .coord: fraction of atoms with n bonds for each type; the mean
+*               partial coordination numbers are given in the header
+*
+******************************************************************************/
+
+void write_rdf(int nr)
+{
+  str255 fname;
+  FILE   *out;
+  int    k, a, b, nmax;
+  double f, shell, r, dr, tot;
+
+  if (0==rdf_nsamp) return;
+
+#ifdef MPI
+  if (0==myid)
+    MPI_Reduce( MPI_IN_PLACE, rdf_sum, rdf_len, MPI_DOUBLE, MPI_SUM, 0,
+                cpugrid);
+  else
+    MPI_Reduce( rdf_sum, NULL, rdf_len, MPI_DOUBLE, MPI_SUM, 0, cpugrid);
+#endif
+
+  if (0==myid) {
+
+    /* pair distribution functions */
+    sprintf(fname, "%s.%05d.rdf", outfilename, nr);
+    out = fopen(fname, "w");
+    if (NULL == out) error("Cannot open rdf file.");
+    fprintf(out, "# r");
+    for (a=0; a<ntypes; a++)
+      for (b=a; b<ntypes; b++) fprintf(out, " g_%d%d", a, b);
+    fprintf(out, " g\n");
+    dr = 1.0 / rdf_scale;
+    for (k=0; k<rdf_nbins; k++) {
+      r     = (k + 0.5) * dr;
+      shell = 4.0 / 3.0 * M_PI * dr * dr * dr * (3 * k * (k + 1) + 1) * rdf_nsamp;
+      fprintf(out, "%10.4e", r);
+      for (a=0; a<ntypes; a++)
+        for (b=a; b<ntypes; b++)
+          fprintf(out, " %10.4e", rdf_sum[RDF_G(k,a,b)] / shell);
+      fprintf(out, " %10.4e\n", rdf_sum[rdf_cnt_len+k] / shell);
+    }
+    fclose(out);
+
+    if (rdf_bond_r2cut > 0.0) {
+
+      /* bond angle distributions */
+      sprintf(fname, "%s.%05d.angle", outfilename, nr);
+      out = fopen(fname, "w");
+      if (NULL == out) error("Cannot open angle file.");
+      fprintf(out, "# angle");
+      for (a=0; a<ntypes; a++) fprintf(out, " p_%d", a);
+      fprintf(out, " p\n");
+      tot = 0.0;
+      for (k=0; k<rdf_angle_nbins*ntypes; k++)
+        tot += rdf_sum[RDF_ANG(0,0)+k];
+      for (k=0; k<rdf_angle_nbins; k++) {
+        fprintf(out, "%10.4e", (k + 0.5) * 180.0 / rdf_angle_nbins);
+        f = 0.0;
+        for (a=0; a<ntypes; a++) {
+          double n = 0.0;
+          for (b=0; b<rdf_angle_nbins; b++) n += rdf_sum[RDF_ANG(b,a)];
+          fprintf(out, " %10.4e", (n > 0.0) ? rdf_sum[RDF_ANG(k,a)] / n : 0.0);
+          f += rdf_sum[RDF_ANG(k,a)];
+        }
+        fprintf(out, " %10.4e\n", (tot > 0.0) ? f / tot : 0.0);
+      }
+      fclose(out);
+
+      /* coordination numbers */
+      sprintf(fname, "%s.%05d.coord", outfilename, nr);
+      out = fopen(fname, "w");
+      if (NULL == out) error("Cannot open coord file.");
+      for (a=0; a<ntypes; a++) {
+        fprintf(out, "# Z_%d", a);
+        for (b=0; b<ntypes; b++)
+          fprintf(out, " %10.4e", (num_sort[a] > 0) ?
+            rdf_sum[RDF_BOND(a,b)] / ((double) num_sort[a] * rdf_nsamp) : 0.0);
+        fprintf(out, "\n");
+      }
+      fprintf(out, "# n");
+      for (a=0; a<ntypes; a++) fprintf(out, " f_%d", a);
+      fprintf(out, "\n");
+      nmax = 0;
+      for (a=0; a<ntypes; a++)
+        for (k=0; k<=RDF_MAXBOND; k++)
+          if (rdf_sum[RDF_COORD(a,k)] > 0.0) nmax = MAX(nmax, k);
+      for (k=0; k<=nmax; k++) {
+        fprintf(out, "%d", k);
+        for (a=0; a<ntypes; a++)
+          fprintf(out, " %10.4e", (num_sort[a] > 0) ?
+            rdf_sum[RDF_COORD(a,k)] / ((double) num_sort[a] * rdf_nsamp) : 0.0);
+        fprintf(out, "\n");
+      }
+      fclose(out);
+    }
+  }
+
+  for (k=0; k<rdf_len; k++) rdf_sum[k] = 0.0;
+  rdf_nsamp = 0;
+}
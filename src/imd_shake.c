@@ -0,0 +1,464 @@
+/******************************************************************************
+*
+* IMD -- The ITAP Molecular Dynamics Program
+*
+* Copyright 1996-2013 Institute for Theoretical and Applied Physics,
+* University of Stuttgart, D-70550 Stuttgart
+*
+******************************************************************************/
+
+/******************************************************************************
+*
+* imd_shake.c -- bond length constraints (SHAKE)
+*
+* The constraints are read from shake_file, one per line:
+*
+*   number_a  number_b  distance
+*
+* With the leapfrog scheme of the integrators, the momenta at the half
+* step follow from the constrained positions, so that no separate
+* velocity stage (RATTLE) is needed. The iteration is of Jacobi type:
+* all corrections of one sweep are computed from the same positions.
+* Each constraint is treated by exactly one CPU which holds one of its
+* atoms and sees the other one, if necessary in the buffer cells.
+* Corrections of buffer atoms are sent back like forces.
+*
+******************************************************************************/
+
+/******************************************************************************
+* $Revision$
+* $Date$
+******************************************************************************/
+
+#include "imd.h"
+
+/* a constraint treated on this CPU */
+typedef struct {
+  int    c;          /* index into shake_atoms, shake_dist */
+  cell   *p, *q;     /* cells of atom a and b */
+  int    i, j;       /* index of atom a and b in their cells */
+  vektor r0;         /* bond vector at the beginning of the step */
+  real   g;          /* Lagrange multiplier (times dt^2) of this sweep */
+} shake_con;
+
+/* a local atom with constraints */
+typedef struct {
+  cell   *p;
+  int    i;
+} shake_atom;
+
+static shake_con  *shake_act  = NULL;  /* constraints treated here */
+static int         shake_nact = 0;
+static shake_atom *shake_own  = NULL;  /* local constrained atoms */
+static int         shake_nown = 0;
+static cell     **shake_cell  = NULL;  /* atom number -> local cell */
+static int       *shake_ind   = NULL;  /* atom number -> index in cell */
+static char      *shake_own_f = NULL;  /* atom number -> is in shake_own */
+static int        shake_nmap  = 0;     /* size of the above maps */
+static real      *shake_imass = NULL;  /* inverse masses of the atoms of
+                                          the constraints; the masses are
+                                          not sent to the buffer cells */
+
+/******************************************************************************
+*
+*  minimum image of a distance vector
+*
+******************************************************************************/
+
+static void shake_pbc(vektor *d)
+{
+  real x;
+
+  if (1==pbc_dirs.x) {
+    x = - round( SPROD(*d,tbox_x) );
+    d->x += x * box_x.x;
+    d->y += x * box_x.y;
+    d->z += x * box_x.z;
+  }
+  if (1==pbc_dirs.y) {
+    x = - round( SPROD(*d,tbox_y) );
+    d->x += x * box_y.x;
+    d->y += x * box_y.y;
+    d->z += x * box_y.z;
+  }
+  if (1==pbc_dirs.z) {
+    x = - round( SPROD(*d,tbox_z) );
+    d->x += x * box_z.x;
+    d->y += x * box_z.y;
+    d->z += x * box_z.z;
+  }
+}
+
+/******************************************************************************
+*
+*  current bond vector of a constraint
+*
+******************************************************************************/
+
+static void shake_bond(shake_con *s, vektor *d)
+{
+  d->x = ORT(s->p,s->i,X) - ORT(s->q,s->j,X);
+  d->y = ORT(s->p,s->i,Y) - ORT(s->q,s->j,Y);
+  d->z = ORT(s->p,s->i,Z) - ORT(s->q,s->j,Z);
+  shake_pbc(d);
+}
+
+/******************************************************************************
+*
+*  read the constraints and set up the maps
+*
+******************************************************************************/
+
+void init_shake(void)
+{
+  int  k, n, nmax = 0;
+  FILE *fp;
+  char line[255];
+
+  /* read constraints */
+  if (0==myid) {
+    int    a, b;
+    double d;
+    fp = fopen(shake_file, "r");
+    if (NULL==fp) error_str("Cannot open SHAKE constraint file %s", shake_file);
+    for (n=0; n<2; n++) {
+      shake_n = 0;
+      rewind(fp);
+      while (fgets(line, 255, fp)) {
+        if (('#'==line[0]) || (3!=sscanf(line, "%d %d %lf", &a, &b, &d)))
+          continue;
+        if ((a==b) || (d<=0.0))
+          error_str("Invalid SHAKE constraint: %s", line);
+        if (1==n) {
+          /* smaller atom number first */
+          shake_atoms[2*shake_n  ] = MIN(a,b);
+          shake_atoms[2*shake_n+1] = MAX(a,b);
+          shake_dist [  shake_n  ] = d;
+        }
+        shake_n++;
+      }
+      if (0==n) {
+        shake_atoms = (int  *) malloc( 2 * MAX(1,shake_n) * sizeof(int ) );
+        shake_dist  = (real *) malloc(     MAX(1,shake_n) * sizeof(real) );
+        if ((NULL==shake_atoms) || (NULL==shake_dist))
+          error("Cannot allocate SHAKE constraints");
+      }
+    }
+    fclose(fp);
+    printf("Read %d SHAKE constraints from file %s\n", shake_n, shake_file);
+  }
+#ifdef MPI
+  MPI_Bcast( &shake_n, 1, MPI_INT, 0, cpugrid);
+  if (0!=myid) {
+    shake_atoms = (int  *) malloc( 2 * MAX(1,shake_n) * sizeof(int ) );
+    shake_dist  = (real *) malloc(     MAX(1,shake_n) * sizeof(real) );
+    if ((NULL==shake_atoms) || (NULL==shake_dist))
+      error("Cannot allocate SHAKE constraints");
+  }
+  MPI_Bcast( shake_atoms, 2 * shake_n, MPI_INT, 0, cpugrid);
+  MPI_Bcast( shake_dist,      shake_n, REAL,    0, cpugrid);
+#endif
+
+  /* maps from atom numbers to atoms */
+  for (k=0; k<NCELLS; ++k) {
+    int  i;
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; ++i) nmax = MAX( nmax, NUMMER(p,i) );
+  }
+#ifdef MPI
+  MPI_Allreduce( &nmax, &shake_nmap, 1, MPI_INT, MPI_MAX, cpugrid);
+#else
+  shake_nmap = nmax;
+#endif
+  shake_nmap++;
+  for (n=0; n<shake_n; n++)
+    if (shake_atoms[2*n+1] >= shake_nmap)
+      error("SHAKE constraint refers to a non-existing atom");
+  shake_cell = (cell **) malloc( shake_nmap * sizeof(cell *) );
+  shake_ind  = (int   *) malloc( shake_nmap * sizeof(int   ) );
+  shake_own_f = (char *) malloc( shake_nmap * sizeof(char  ) );
+  shake_act  = (shake_con  *) malloc(   MAX(1,shake_n) * sizeof(shake_con ) );
+  shake_own  = (shake_atom *) malloc( 2*MAX(1,shake_n) * sizeof(shake_atom) );
+  if ((NULL==shake_cell) || (NULL==shake_ind) || (NULL==shake_own_f) ||
+      (NULL==shake_act)  || (NULL==shake_own))
+    error("Cannot allocate SHAKE maps");
+  for (n=0; n<shake_nmap; n++) {
+    shake_cell [n] = NULL;
+    shake_own_f[n] = 0;
+  }
+
+#if defined(BUFCELLS) && defined(AR) && !defined(COVALENT) && !defined(NNBR_TABLE)
+  /* otherwise, a constraint could be seen in both directions */
+  if ((cpu_dim.x <= 2) && (cell_dim.x < 4))
+    error("SHAKE needs more than one cell per CPU in x direction");
+#endif
+
+  /* inverse masses of the constrained atoms */
+  shake_imass = (real *) malloc( 2 * MAX(1,shake_n) * sizeof(real) );
+  if (NULL==shake_imass) error("Cannot allocate SHAKE maps");
+  for (k=0; k<NCELLS; ++k) {
+    int  i;
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; ++i) {
+      shake_cell[ NUMMER(p,i) ] = p;
+      shake_ind [ NUMMER(p,i) ] = i;
+    }
+  }
+  for (n=0; n<2*shake_n; n++) {
+    int a = shake_atoms[n];
+    shake_imass[n] = (NULL==shake_cell[a]) ? 0.0 :
+      1.0 / MASSE(shake_cell[a], shake_ind[a]);
+  }
+  for (n=0; n<shake_nmap; n++) shake_cell[n] = NULL;
+#ifdef MPI
+  {
+    real *tmp = (real *) malloc( 2 * MAX(1,shake_n) * sizeof(real) );
+    if (NULL==tmp) error("Cannot allocate SHAKE maps");
+    MPI_Allreduce( shake_imass, tmp, 2 * shake_n, REAL, MPI_MAX, cpugrid);
+    for (n=0; n<2*shake_n; n++) shake_imass[n] = tmp[n];
+    free(tmp);
+  }
+#endif
+
+  /* each constraint removes one degree of freedom */
+  nactive -= shake_n;
+}
+
+#ifdef BUFCELLS
+
+/******************************************************************************
+*
+*  find atom number n in the cells neighbouring cell p, which include
+*  the buffer cells; if east is set, only in the east buffer wall
+*
+******************************************************************************/
+
+static int shake_find(cell *p, int n, int east, cell **q, int *j)
+{
+  int k = p - cell_array, ix, iy, iz, dx, dy, dz, i;
+
+  ix = k / (cell_dim.y * cell_dim.z);
+  iy = (k / cell_dim.z) % cell_dim.y;
+  iz = k % cell_dim.z;
+  for (dx=-1; dx<=1; dx++) {
+    if ((ix+dx < 0) || (ix+dx >= cell_dim.x)) continue;
+    if ((east) && (ix+dx != cell_dim.x-1))    continue;
+    for (dy=-1; dy<=1; dy++) {
+      if ((iy+dy < 0) || (iy+dy >= cell_dim.y)) continue;
+      for (dz=-1; dz<=1; dz++) {
+        cell *r;
+        if ((iz+dz < 0) || (iz+dz >= cell_dim.z)) continue;
+        r = PTR_3D_V(cell_array, ix+dx, iy+dy, iz+dz, cell_dim);
+        for (i=0; i<r->n; ++i)
+          if (NUMMER(r,i)==n) {
+            *q = r;
+            *j = i;
+            return 1;
+          }
+      }
+    }
+  }
+  return 0;
+}
+
+#endif
+
+/******************************************************************************
+*
+*  before the step: find the constraints treated here, and store
+*  their bond vectors
+*
+******************************************************************************/
+
+void shake_prepare(void)
+{
+  int k, n;
+
+#ifdef BUFCELLS
+  send_cells(copy_cell,pack_cell,unpack_cell);
+#endif
+
+  for (k=0; k<NCELLS; ++k) {
+    int  i;
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; ++i) {
+      n = NUMMER(p,i);
+      shake_cell[n] = p;
+      shake_ind [n] = i;
+    }
+  }
+
+  /* a constraint is treated where atom a is local, if atom b is in a
+     neighbouring cell there. Otherwise, b is in the west buffer wall,
+     which is not filled with AR; then the constraint is treated where
+     b is local, with a in the east buffer wall */
+  shake_nact = 0;
+  shake_nown = 0;
+  for (n=0; n<shake_n; n++) {
+    int a = shake_atoms[2*n], b = shake_atoms[2*n+1];
+    shake_con *s = shake_act + shake_nact;
+    if (NULL!=shake_cell[a]) {
+      s->p = shake_cell[a];  s->i = shake_ind[a];
+#ifdef BUFCELLS
+      if (!shake_find(s->p, b, 0, &s->q, &s->j)) continue;
+#else
+      /* all atoms are local */
+      s->q = shake_cell[b];  s->j = shake_ind[b];
+#endif
+    }
+#if defined(BUFCELLS) && defined(AR) && !defined(COVALENT) && !defined(NNBR_TABLE)
+    else if (NULL!=shake_cell[b]) {
+      s->q = shake_cell[b];  s->j = shake_ind[b];
+      if (!shake_find(s->q, a, 1, &s->p, &s->i)) continue;
+    }
+#endif
+    else continue;
+    s->c = n;
+    shake_bond(s, &s->r0);
+    shake_nact++;
+  }
+
+#ifdef MPI
+  MPI_Allreduce( &shake_nact, &k, 1, MPI_INT, MPI_SUM, cpugrid);
+#else
+  k = shake_nact;
+#endif
+  if (k != shake_n)
+    error("SHAKE constraint longer than the width of the buffer cells");
+
+  /* local atoms with constraints, each once */
+  for (n=0; n<2*shake_n; n++) {
+    int a = shake_atoms[n];
+    if ((NULL==shake_cell[a]) || (shake_own_f[a])) continue;
+    shake_own[shake_nown].p = shake_cell[a];
+    shake_own[shake_nown].i = shake_ind [a];
+    shake_nown++;
+    shake_own_f[a] = 1;
+  }
+}
+
+/******************************************************************************
+*
+*  after the step: iterate the constrained positions, and correct
+*  the momenta and the kinetic energy and virial accordingly
+*
+******************************************************************************/
+
+void shake(void)
+{
+  int  k, n, it, notconv = 1;
+  real dekin = 0.0, vir[7] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+#ifdef MPI
+  int  tmp;
+  real tmpvec[7];
+#endif
+
+  for (it=0; it<shake_maxit; it++) {
+
+#ifdef BUFCELLS
+    /* positions of the partners on other CPUs */
+    if (it > 0) send_cells(copy_cell,pack_cell,unpack_cell);
+#endif
+
+    /* all corrections of a sweep refer to the same positions */
+    notconv = 0;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:notconv)
+#endif
+    for (n=0; n<shake_nact; n++) {
+      shake_con *s = shake_act + n;
+      real   d2 = SQR( shake_dist[s->c] ), dd;
+      vektor d;
+      shake_bond(s, &d);
+      dd = SPROD(d,d) - d2;
+      if (FABS(dd) > shake_tol * d2) notconv++;
+      s->g = dd / (2.0 * (shake_imass[2*s->c] + shake_imass[2*s->c+1])
+                       * SPROD(d,s->r0));
+    }
+#ifdef MPI
+    MPI_Allreduce( &notconv, &tmp, 1, MPI_INT, MPI_SUM, cpugrid);
+    notconv = tmp;
+#endif
+    if (0==notconv) break;
+
+    /* collect the corrections; an atom may be in several constraints */
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (k=0; k<nallcells; ++k) {
+      int  i;
+      cell *p = cell_array + k;
+      for (i=0; i<p->n; ++i) {
+        SHAKE_D(p,i,X) = 0.0;
+        SHAKE_D(p,i,Y) = 0.0;
+        SHAKE_D(p,i,Z) = 0.0;
+      }
+    }
+    for (n=0; n<shake_nact; n++) {
+      shake_con *s = shake_act + n;
+      real fa = s->g * shake_imass[2*s->c], fb = s->g * shake_imass[2*s->c+1];
+      real w  = - s->g / SQR(timestep);
+      SHAKE_D(s->p,s->i,X) -= fa * s->r0.x;
+      SHAKE_D(s->p,s->i,Y) -= fa * s->r0.y;
+      SHAKE_D(s->p,s->i,Z) -= fa * s->r0.z;
+      SHAKE_D(s->q,s->j,X) += fb * s->r0.x;
+      SHAKE_D(s->q,s->j,Y) += fb * s->r0.y;
+      SHAKE_D(s->q,s->j,Z) += fb * s->r0.z;
+      /* virial of the constraint force -g r0 / dt^2 */
+      vir[1] += w * s->r0.x * s->r0.x;
+      vir[2] += w * s->r0.y * s->r0.y;
+      vir[3] += w * s->r0.z * s->r0.z;
+      vir[4] += w * s->r0.y * s->r0.z;
+      vir[5] += w * s->r0.z * s->r0.x;
+      vir[6] += w * s->r0.x * s->r0.y;
+    }
+#ifdef BUFCELLS
+    send_forces(add_shake,pack_shake,unpack_add_shake);
+#endif
+
+    /* move the local atoms, and make the momenta consistent */
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:dekin)
+#endif
+    for (n=0; n<shake_nown; n++) {
+      cell *p = shake_own[n].p;
+      int   i = shake_own[n].i;
+      real  m = MASSE(p,i), e = SPRODN(IMPULS,p,i,IMPULS,p,i);
+      ORT   (p,i,X) += SHAKE_D(p,i,X);
+      ORT   (p,i,Y) += SHAKE_D(p,i,Y);
+      ORT   (p,i,Z) += SHAKE_D(p,i,Z);
+      IMPULS(p,i,X) += m * SHAKE_D(p,i,X) / timestep;
+      IMPULS(p,i,Y) += m * SHAKE_D(p,i,Y) / timestep;
+      IMPULS(p,i,Z) += m * SHAKE_D(p,i,Z) / timestep;
+      dekin += (SPRODN(IMPULS,p,i,IMPULS,p,i) - e) / m;
+    }
+  }
+  if (notconv) error("SHAKE did not converge - reduce timestep");
+  vir[0] = vir[1] + vir[2] + vir[3];
+
+  /* clear the maps for the next step */
+  for (k=0; k<NCELLS; ++k) {
+    int  i;
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; ++i) {
+      shake_cell [ NUMMER(p,i) ] = NULL;
+      shake_own_f[ NUMMER(p,i) ] = 0;
+    }
+  }
+
+#ifdef MPI
+  MPI_Allreduce( vir, tmpvec, 7, REAL, MPI_SUM, cpugrid);
+  for (n=0; n<7; n++) vir[n] = tmpvec[n];
+  MPI_Allreduce( &dekin, tmpvec, 1, REAL, MPI_SUM, cpugrid);
+  dekin = tmpvec[0];
+#endif
+  /* the integrators average the kinetic energy before and after */
+  tot_kin_energy += dekin / 4.0;
+  virial += vir[0];
+  vir_xx += vir[1];
+  vir_yy += vir[2];
+  vir_zz += vir[3];
+  vir_yz += vir[4];
+  vir_zx += vir[5];
+  vir_xy += vir[6];
+}
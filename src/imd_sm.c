@@ -710,14 +710,20 @@ void do_charge_update(void)
 *   Q_SM stores the subsequent charge corrections (with Q_0 the negative
 *   of the chemical potential), R_SM the residuals of the system above.
 *
+*   With sm_adapt, the residual of the current charges is predicted from
+*   the residual of the last solution plus sm_tol for each sm_adapt_dmax
+*   of maximal displacement since then. If the prediction is below
+*   sm_tol, the update is skipped; if the atoms have moved less than
+*   sm_adapt_dmax, at most sm_adapt_itr iterations are done.
+*
 ******************************************************************************/
 
 void charge_update_sm(void) {
 
   real tmpvec1[3], tmpvec2[3], *tmpvec;
   real r_old, r_new, alpha, beta;
-  real Q_0, V_0, R_0, sm_tol = 1e-5;
-  int  i, k, itr=0, sm_max_itr = 10;
+  real Q_0, V_0, R_0;
+  int  i, k, itr=0, max_itr = sm_max_itr;
 
 #ifdef MPI
   tmpvec = tmpvec2;
@@ -725,6 +731,20 @@ void charge_update_sm(void) {
   tmpvec = tmpvec1;
 #endif
 
+  if ((sm_adapt) && (sm_have_ref)) {
+    real dmax = sm_max_displacement();
+    if (sm_res + sm_tol * dmax / sm_adapt_dmax < sm_tol) {
+      sm_nskip++;
+      return;
+    }
+    if (dmax < sm_adapt_dmax) {
+      max_itr = MIN(sm_adapt_itr, sm_max_itr);
+      sm_ntrunc++;
+    }
+    else sm_nsolve++;
+  }
+  else sm_nsolve++;
+
   /* assign initial charges */
   for (k=0; k<ncells; ++k) {
     cell *p = CELLPTR(k);
@@ -770,7 +790,7 @@ void charge_update_sm(void) {
   if (myid==0) printf("itr: %d, r_new: %f\n", itr, r_new);
 
   /* now the iteration starts ... */
-  while ((r_new > sm_tol) && (itr++ < sm_max_itr)) {
+  while ((r_new > sm_tol) && (itr++ < max_itr)) {
 
 #ifdef NBLIST
     calc_sm_pot();
@@ -814,7 +834,7 @@ void charge_update_sm(void) {
     if (myid==0) printf("itr: %d, r_new: %f\n", itr, r_new);
 
     /* stop if already close enough */
-    if ((r_new < sm_tol) || (itr >= sm_max_itr)) break;
+    if ((r_new < sm_tol) || (itr >= max_itr)) break;
 
     beta  = r_new / r_old; 
     r_old = r_new;
@@ -829,6 +849,20 @@ void charge_update_sm(void) {
     Q_0 = R_0 + beta * Q_0;
   }
 
+  /* reference for the next adaptive update */
+  if (sm_adapt) {
+    for (k=0; k<ncells; ++k) {
+      cell *p = CELLPTR(k);
+      for (i=0; i<p->n; ++i) {
+        SM_POS(p,i,X) = ORT(p,i,X);
+        SM_POS(p,i,Y) = ORT(p,i,Y);
+        SM_POS(p,i,Z) = ORT(p,i,Z);
+      }
+    }
+    sm_res      = r_new;
+    sm_have_ref = 1;
+  }
+
   /* print average charges for each atom type */
   tmpvec1[0] = tmpvec1[1] = 0.0;
   for (k=0; k<ncells; ++k) {
@@ -848,3 +882,30 @@ void charge_update_sm(void) {
 
 }
 
+/*****************************************************************************
+*
+* sm_max_displacement -- maximal displacement since the last charge update
+*
+******************************************************************************/
+
+real sm_max_displacement(void)
+{
+  real max1 = 0.0, max2;
+  int  i, k;
+
+  for (k=0; k<ncells; ++k) {
+    cell *p = CELLPTR(k);
+    for (i=0; i<p->n; ++i) {
+      real r2 = SQR(ORT(p,i,X) - SM_POS(p,i,X))
+              + SQR(ORT(p,i,Y) - SM_POS(p,i,Y))
+              + SQR(ORT(p,i,Z) - SM_POS(p,i,Z));
+      if (r2 > max1) max1 = r2;
+    }
+  }
+#ifdef MPI
+  MPI_Allreduce( &max1, &max2, 1, REAL, MPI_MAX, cpugrid);
+#else
+  max2 = max1;
+#endif
+  return SQRT(max2);
+}
@@ -21,31 +21,76 @@
 
 #include "imd.h"
 
-#ifdef HC
+#if defined(HC) || defined(NVX)
 
 /******************************************************************************
 *
-*  add up microscopic heat current
+*  layer profile of heat transport runs
+*
+*  One threaded sweep over the atoms after the force computation bins the
+*  atoms into hc_nlayers layers along x and accumulates for each layer
+*  the number of atoms, kinetic and total energy, momentum and (HC) the
+*  microscopic heat current. The sums of the sweeps are kept in memory
+*  until the profile is written; only then they are reduced over the CPUs,
+*  in a single reduction.
 *
 ******************************************************************************/
 
-void do_heat_cond(int steps)
+#define HCP_NUM  0              /* number of atoms */
+#define HCP_EKIN 1              /* kinetic energy */
+#define HCP_ENG  2              /* total energy */
+#define HCP_P    3              /* momentum */
+#define HCP_J    (3 + DIM)      /* heat current */
+#define HCP_LEN  (3 + 2 * DIM)  /* quantities per layer */
+#define HCP_FIT  5              /* data for temperature gradient fit */
+
+static int    hc_len  = 0;      /* length of the sums of one sweep */
+static int    hc_nsum = 0;      /* number of sweeps in hc_sum */
+static double *hc_sum = NULL;   /* running sums of the layer profile */
+static double *hc_buf = NULL;   /* sums of one sweep, per thread */
+
+/******************************************************************************
+*
+*  sweep over all atoms; adds the sweep to the running sums if add is set
+*
+******************************************************************************/
+
+static void hc_sweep(int steps, int add)
 {
-  int    i, k;
-  real   e, tmp;
-  vektor pp, vv, tmpv;
-  static real fac = 0.0;
+  int  nl = MAX(hc_nlayers, 1), nthreads = 1, i, k, t;
+  real scale = nl / box_x.x;
 
-#ifdef TWOD
-  hc.x = 0.0; hc.y = 0.0;
-#else
-  hc.x = 0.0; hc.y = 0.0; hc.z = 0.0;
+#ifdef _OPENMP
+  nthreads = omp_get_max_threads();
 #endif
 
+  /* allocate arrays */
+  if (NULL==hc_sum) {
+    hc_len = nl * HCP_LEN + HCP_FIT;
+    hc_sum = (double *) calloc( hc_len,            sizeof(double) );
+    hc_buf = (double *) malloc( nthreads * hc_len * sizeof(double) );
+    if ((NULL==hc_sum) || (NULL==hc_buf))
+      error("Cannot allocate heat transport profile.");
+  }
+  for (i=0; i<nthreads*hc_len; i++) hc_buf[i] = 0.0;
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
   for (k=0; k<NCELLS; ++k) { /* loop over all cells */
 
-    cell *p = CELLPTR(k);
+    cell   *p = CELLPTR(k);
+    double *b = hc_buf, *d;
+    int    i, num;
+    real   e, ekin, xx;
+    vektor pp;
+#ifdef HC
+    vektor vv;
+#endif
 
+#ifdef _OPENMP
+    b += hc_len * omp_get_thread_num();
+#endif
     for (i=0; i<p->n; ++i) { /* loop over all atoms in the cell */
 
       /* momenta at the time of the force computation */
@@ -55,10 +100,26 @@ void do_heat_cond(int steps)
       pp.z = IMPULS(p,i,Z) + 0.5 * timestep * KRAFT(p,i,Z); 
 #endif
       /* current total energy */ 
-      e = SPROD(pp,pp) / (2*MASSE(p,i));
-      if (steps < hc_start) fac += e; /* add up kin. Energy for av. temp. */
-      e += POTENG(p,i);
+      ekin = SPROD(pp,pp) / (2*MASSE(p,i));
+      e    = ekin + POTENG(p,i);
+
+      /* which layer? */
+      xx = ORT(p,i,X);
+      if (xx<0.0) xx += box_x.x;
+      num = (int) (scale * xx);
+      if (num >= nl) num -= nl;
+      d = b + num * HCP_LEN;
+
+      d[HCP_NUM ] += 1.0;
+      d[HCP_EKIN] += ekin;
+      d[HCP_ENG ] += e;
+      d[HCP_P   ] += pp.x;
+      d[HCP_P+1 ] += pp.y;
+#ifndef TWOD
+      d[HCP_P+2 ] += pp.z;
+#endif
 
+#ifdef HC
       /* average total energy of each atom */
       if   (steps == hc_av_start) HCAVENG(p,i)  = e;
       else if (steps <  hc_start) HCAVENG(p,i) += e;
@@ -79,26 +140,161 @@ void do_heat_cond(int steps)
                                         + PRESSTENS(p,i,zz) * pp.z;
 #endif
         e -= HCAVENG(p,i);  /* subtract average energy */
-        hc.x += (pp.x * e + 0.5 * vv.x) / MASSE(p,i);
-        hc.y += (pp.y * e + 0.5 * vv.y) / MASSE(p,i);
+        d[HCP_J  ] += (pp.x * e + 0.5 * vv.x) / MASSE(p,i);
+        d[HCP_J+1] += (pp.y * e + 0.5 * vv.y) / MASSE(p,i);
 #ifndef TWOD
-        hc.z += (pp.z * e + 0.5 * vv.z) / MASSE(p,i);
+        d[HCP_J+2] += (pp.z * e + 0.5 * vv.z) / MASSE(p,i);
 #endif
       }
+#endif /* HC */
+
+#ifdef NVX
+      /* data for temperature gradient fitting, in the folded profile */
+      if (num > nl / 2) {
+        num = nl - num;
+        xx  = box_x.x - xx + box_x.x / nl; 
+      }
+      if ((num>2) && (num<nl/2-2)) {
+        d = b + nl * HCP_LEN;
+        d[0] += xx;
+        d[1] += ekin;
+        d[2] += ekin * xx;
+        d[3] += xx * xx;
+        d[4] += 1.0;
+      }
+#endif
     }
   }
+
+  /* add up the threads */
+  for (t=1; t<nthreads; t++)
+    for (i=0; i<hc_len; i++) hc_buf[i] += hc_buf[t*hc_len+i];
+
+  if (add) {
+    for (i=0; i<hc_len; i++) hc_sum[i] += hc_buf[i];
+    hc_nsum++;
+  }
+}
+
+/******************************************************************************
+*
+*  reduce the running sums over the CPUs; the result is on CPU 0
+*
+******************************************************************************/
+
+static void hc_reduce(void)
+{
 #ifdef MPI
-  if (steps == hc_start) {
-    MPI_Allreduce( &fac, &tmp, 1, REAL, MPI_SUM, cpugrid);
-    fac = tmp;
+  if (0==myid)
+    MPI_Reduce( MPI_IN_PLACE, hc_sum, hc_len, MPI_DOUBLE, MPI_SUM, 0, cpugrid);
+  else
+    MPI_Reduce( hc_sum, NULL, hc_len, MPI_DOUBLE, MPI_SUM, 0, cpugrid);
+#endif
+}
+
+/******************************************************************************
+*
+*  clear the running sums
+*
+******************************************************************************/
+
+static void hc_clear(void)
+{
+  int i;
+  for (i=0; i<hc_len; i++) hc_sum[i] = 0.0;
+  hc_nsum = 0;
+}
+
+/******************************************************************************
+*
+*  append the layer profile, averaged over the sweeps, to the .hclayers file
+*
+*  columns: x, atoms, temperature, energy density, momentum density
+*           and (HC) heat current density
+*
+******************************************************************************/
+
+static void write_hc_layers(void)
+{
+  FILE   *out;
+  str255 fname;
+  int    i, j, nl = MAX(hc_nlayers, 1);
+  double *d, n, vol = volume * hc_nsum / nl;
+  static int first = 1;
+
+  sprintf(fname, "%s.hclayers", outfilename);
+  out = fopen(fname, "a");
+  if (NULL == out) error("Cannot open heat transport layer file.");
+  if (first && (0==imdrestart)) {
+#ifdef HC
+    fprintf(out, "# x n T e px py%s jx jy%s\n", 
+            (DIM==3) ? " pz" : "", (DIM==3) ? " jz" : "");
+#else
+    fprintf(out, "# x n T e px py%s\n", (DIM==3) ? " pz" : "");
+#endif
   }
-  MPI_Allreduce( &hc, &tmpv, DIM, REAL, MPI_SUM, cpugrid);
-  hc = tmpv;
+  first = 0;
+
+  fprintf(out, "\n");
+  for (i=0; i<nl; i++) {
+    d = hc_sum + i * HCP_LEN;
+    n = d[HCP_NUM];
+    fprintf(out, "%10.4e %10.4e %10.4e %10.4e", (i+0.5) * box_x.x / nl,
+            n / hc_nsum, (n > 0.0) ? 2.0 * d[HCP_EKIN] / (DIM * n) : 0.0,
+            d[HCP_ENG] / vol);
+    for (j=0; j<DIM; j++) fprintf(out, " %10.4e", d[HCP_P+j] / vol);
+#ifdef HC
+    for (j=0; j<DIM; j++) fprintf(out, " %10.4e", d[HCP_J+j] / vol);
+#endif
+    fprintf(out, "\n");
+  }
+  fclose(out);
+}
+
+#endif /* HC || NVX */
+
+#ifdef HC
+
+/******************************************************************************
+*
+*  add up microscopic heat current
+*
+******************************************************************************/
+
+void do_heat_cond(int steps)
+{
+  int    i, j;
+  real   red[DIM+1];
+  static real fac = 0.0;
+#ifdef MPI
+  real   tmp[DIM+1];
+#endif
+
+  /* the layer profile is accumulated during the measurement */
+  hc_sweep(steps, (hc_nlayers > 0) && (steps >= hc_start));
+
+  /* heat current, and kin. energy for av. temp. */
+  for (j=0; j<=DIM; j++) red[j] = 0.0;
+  for (i=0; i<MAX(hc_nlayers, 1); i++) {
+    double *d = hc_buf + i * HCP_LEN;
+    for (j=0; j<DIM; j++) red[j] += d[HCP_J+j];
+    red[DIM] += d[HCP_EKIN];
+  }
+  if (steps < hc_start) fac += red[DIM];
+  red[DIM] = fac;
+#ifdef MPI
+  MPI_Allreduce( red, tmp, DIM+1, REAL, MPI_SUM, cpugrid);
+  for (j=0; j<=DIM; j++) red[j] = tmp[j];
+#endif
+  hc.x = red[0];
+  hc.y = red[1];
+#ifndef TWOD
+  hc.z = red[2];
 #endif
 
   /* scaling factor: 1 / (sqrt(volume) * temperature) */
   if (steps == hc_start) {
-    real temp = 2 * fac / (DIM * natoms * (hc_start - hc_av_start));
+    real temp = 2 * red[DIM] / (DIM * natoms * (hc_start - hc_av_start));
     fac = 1.0 / (SQRT(volume) * temp);
   }
 
@@ -110,8 +306,18 @@ void do_heat_cond(int steps)
     hc.x *= fac;  hc.y *= fac;  hc.z *= fac;
 #endif
     write_heat_current(steps);
+#ifdef MTAU
+    if ((mtau_int > 0) && (mtau_hc)) update_mtau_hc(hc);
+#endif
   }
 
+  /* write layer profile */
+  if ((hc_nlayers > 0) && (steps >= hc_start) && 
+      ((steps - hc_start) % hc_prof_int == 0)) {
+    hc_reduce();
+    if (0==myid) write_hc_layers();
+    hc_clear();
+  }
 }
 
 #endif /* HC */
@@ -120,7 +326,18 @@ void do_heat_cond(int steps)
 
 /******************************************************************************
 *
-*  update and write temperature profile
+*  accumulate temperature profile
+*
+******************************************************************************/
+
+void do_heat_cond(int steps)
+{
+  hc_sweep(steps, 1);
+}
+
+/******************************************************************************
+*
+*  write temperature profile
 *
 ******************************************************************************/
 
@@ -128,42 +345,13 @@ void write_temp_dist(int steps)
 {
   FILE   *outtemp;
   str255 fnametemp;
-  real   scale;
-  int    i, k, nhalf;
-  static real    *temp_hist_1 = NULL, *temp_hist_2 = NULL;
-  static integer  *num_hist_1 = NULL,  *num_hist_2 = NULL;
-#ifdef MPI
-  static real grad_fit_1[5], grad_fit_2[5];
-#else
-  static real grad_fit_1[5], *grad_fit_2;
-#endif
+  int    i, nhalf;
+  static int first = 1;
   
-  /* the temp bins are orthogonal boxes in space */
   nhalf = hc_nlayers / 2;
-  scale = hc_nlayers / box_x.x;
 
-  /* allocate and clear histogram arrays */
-  if (NULL==temp_hist_1) {
-    temp_hist_1 = (real    *) malloc( (nhalf+1) * sizeof(real   ) );
-     num_hist_1 = (integer *) malloc( (nhalf+1) * sizeof(integer) );
-#ifdef MPI
-    temp_hist_2 = (real    *) malloc( (nhalf+1) * sizeof(real   ) );
-     num_hist_2 = (integer *) malloc( (nhalf+1) * sizeof(integer) );
-#else
-    temp_hist_2 = temp_hist_1;
-     num_hist_2 =  num_hist_1;
-     grad_fit_2 =  grad_fit_1;
-#endif
-    if ( (NULL==temp_hist_1) || (NULL==num_hist_1) 
-#ifdef MPI
-      || (NULL==temp_hist_2) || (NULL==num_hist_2)
-#endif
-      ) error("Cannot allocate temperature array.");
-    for (i=0; i<=nhalf; i++) {
-      temp_hist_1[i] = 0.0;
-       num_hist_1[i] = 0;
-    }
-    for (i=0; i<5; i++) grad_fit_1[i] = 0.0;
+  if (first) {
+    first = 0;
     /* write header of temperature gradient file */
     if ((0==myid) && (0==imdrestart)) {
       sprintf(fnametemp, "%s.hcgrad", outfilename);
@@ -182,60 +370,23 @@ void write_temp_dist(int steps)
     }
   }
 
-  /* construct temperature profile */
-  for (k=0; k<NCELLS; ++k) {
-
-    cell *p = CELLPTR(k);
-
-    for (i=0; i<p->n; ++i) {
-
-      real xx, temp;
-      int  num;
-
-      /* which layer? */
-      xx = ORT(p,i,X);
-      if (xx<0.0) xx += box_x.x;
-      num = (int) (scale * xx);
-      if (num >= hc_nlayers) num -= hc_nlayers;
-      if (num > nhalf) {
-        num = hc_nlayers - num;
-        xx  = box_x.x - xx + box_x.x / hc_nlayers; 
-      }
-      temp = SPRODN(IMPULS,p,i,IMPULS,p,i) / (2*MASSE(p,i));
-      temp_hist_1[num] += temp;
-       num_hist_1[num]++;
-
-      /* data for temperature gradient fitting */
-      if ((num>2) && (num<nhalf-2)) {
-        grad_fit_1[0] += xx;
-        grad_fit_1[1] += temp;
-        grad_fit_1[2] += temp * xx;
-        grad_fit_1[3] += xx * xx;
-        grad_fit_1[4] += 1.0;
-      }
-    }
-  }
-
   /* write temperature profile, and clear arrays afterwards */
-  if (0 == steps % hc_int) {
+  if ((0 == steps % hc_int) && (hc_nsum > 0)) {
 
-#ifdef MPI
     /* add up results form different CPUs */
-    MPI_Reduce(temp_hist_1, temp_hist_2, nhalf+1, REAL,    MPI_SUM,0,cpugrid);
-    MPI_Reduce(num_hist_1,  num_hist_2,  nhalf+1, INTEGER, MPI_SUM,0,cpugrid);
-    MPI_Reduce(grad_fit_1,  grad_fit_2,        5, REAL,    MPI_SUM,0,cpugrid);
-#endif
+    hc_reduce();
 
     /* write temperature profile */
     if (myid==0) {
 
-      real Sxi, STi, SxiTi, Sxi2, a, fact, kappa;
+      real Sxi, STi, SxiTi, Sxi2, a, fact, kappa, temp, num;
+      double *fit = hc_sum + hc_nlayers * HCP_LEN;
 
       /* get estimate of temperature gradient */
-      Sxi   = grad_fit_2[0] / grad_fit_2[4];
-      STi   = grad_fit_2[1] / grad_fit_2[4];
-      SxiTi = grad_fit_2[2] / grad_fit_2[4];
-      Sxi2  = grad_fit_2[3] / grad_fit_2[4];
+      Sxi   = fit[0] / fit[4];
+      STi   = fit[1] / fit[4];
+      SxiTi = fit[2] / fit[4];
+      Sxi2  = fit[3] / fit[4];
       a     = (SxiTi - Sxi * STi) / (Sxi2 - Sxi * Sxi);
 
       /* write temperature gradient file */
@@ -254,28 +405,31 @@ void write_temp_dist(int steps)
       outtemp = fopen(fnametemp, "a");
       if (NULL == outtemp) error("Cannot open temperature profile file.");
 
-      /* write temperature profile */
+      /* write temperature profile, folded at the middle layer */
       fprintf(outtemp, "\n");
       for (i=0; i<=nhalf; i++) {
-        if (num_hist_2[i] > 0) temp_hist_2[i] /= num_hist_2[i];
-#ifndef TWOD
-        temp_hist_2[i] *= (2.0/DIM);
-#endif
-        fprintf(outtemp, "%10.4e %10.4e\n", (i+0.5) / scale, temp_hist_2[i] );
+        temp = hc_sum[i * HCP_LEN + HCP_EKIN];
+        num  = hc_sum[i * HCP_LEN + HCP_NUM ];
+        if ((i > 0) && (hc_nlayers-i > nhalf)) {
+          temp += hc_sum[(hc_nlayers-i) * HCP_LEN + HCP_EKIN];
+          num  += hc_sum[(hc_nlayers-i) * HCP_LEN + HCP_NUM ];
+        }
+        if (num > 0) temp /= num;
+        temp *= (2.0/DIM);
+        fprintf(outtemp, "%10.4e %10.4e\n", (i+0.5) * box_x.x / hc_nlayers, 
+                temp);
       }
 
       /* close file */
       fprintf(outtemp,"\n");
       fclose(outtemp);
-    }
 
-    /* clear arrays */
-    for (i=0; i<=nhalf; i++) {
-      temp_hist_1[i] = 0.0;  
-       num_hist_1[i] = 0;
+      /* complete layer profile */
+      write_hc_layers();
     }
-    for (i=0; i<5; i++) grad_fit_1[i] = 0.0;
 
+    /* clear arrays */
+    hc_clear();
   }
 }
 
@@ -29,9 +29,9 @@
 #define NBUFFC 0
 #endif /*BUFCELLS*/
 
-/* Macro to allow electr. heat capacity to vary
- * with electronic temperature (C_e=gamma*T_e) */
-#define FD_C ((fd_c==0)?(fd_gamma*l1[i][j][k].temp):(fd_c))
+/* index into the field arrays fd_t1, fd_act, ..., which are laid
+ * out like the lattices, including the ghost layers */
+#define FD_IDX(i,j,k) (((i)*local_fd_dim.y+(j))*local_fd_dim.z+(k))
 
 /* update_fd(): update natoms_local, fd_min_atoms and natoms,
  * md_temp and v_com in FD lattice cells 
@@ -128,8 +128,8 @@ void update_fd()
           /* Cell deactivated. Deduce its electronic energy from E_new_local */
 	  l1[i][j][k].xi=0.0;
 	  E_new_local -= (fd_c==0)?
-	                 (0.5*fd_gamma*SQR(l1[i][j][k].temp)):
-			 (fd_c*l1[i][j][k].temp);
+	                 (0.5*fd_gamma*SQR(fd_t1[FD_IDX(i,j,k)])):
+			 (fd_c*fd_t1[FD_IDX(i,j,k)]);
 	}
 
 	if (natoms_previous<fd_min_atoms && l1[i][j][k].natoms>=fd_min_atoms)
@@ -141,67 +141,70 @@ void update_fd()
              neighbor cells, the created energy is added to E_new_local */
 	  int n_neighbors=0;
 	  double E_el_neighbors=0.0;
-	  /* 6 indices: -x,x,-y,y,-z,z */
+	  /* 6 indices: -x,x,-y,y,-z,z; neighbors, possibly in a ghost
+	     layer, are looked up in the field arrays */
 
-	  if (l1[i+1][j][k].natoms >= fd_min_atoms)
+	  if (fd_act[FD_IDX(i+1,j,k)] > 0.0)
 	  {
 	    E_el_neighbors += (fd_c==0)?
-	                      (SQR(l1[i+1][j][k].temp)):
-			      (l1[i+1][j][k].temp);
+	                      (SQR(fd_t1[FD_IDX(i+1,j,k)])):
+			      (fd_t1[FD_IDX(i+1,j,k)]);
 	    n_neighbors++;
 	  }
-	  if (l1[i-1][j][k].natoms >= fd_min_atoms)
+	  if (fd_act[FD_IDX(i-1,j,k)] > 0.0)
 	  {
 	    E_el_neighbors += (fd_c==0)?
-	                      (SQR(l1[i-1][j][k].temp)):
-			      (l1[i-1][j][k].temp);
+	                      (SQR(fd_t1[FD_IDX(i-1,j,k)])):
+			      (fd_t1[FD_IDX(i-1,j,k)]);
 	    n_neighbors++;
 	  }
-	  if (l1[i][j+1][k].natoms >= fd_min_atoms)
+	  if (fd_act[FD_IDX(i,j+1,k)] > 0.0)
 	  {
 	    E_el_neighbors += (fd_c==0)?
-	                      (SQR(l1[i][j+1][k].temp)):
-			      (l1[i][j+1][k].temp);
+	                      (SQR(fd_t1[FD_IDX(i,j+1,k)])):
+			      (fd_t1[FD_IDX(i,j+1,k)]);
 	    n_neighbors++;
 	  }
-	  if (l1[i][j-1][k].natoms >= fd_min_atoms)
+	  if (fd_act[FD_IDX(i,j-1,k)] > 0.0)
 	  {
 	    E_el_neighbors += (fd_c==0)?
-	                      (SQR(l1[i][j-1][k].temp)):
-			      (l1[i][j-1][k].temp);
+	                      (SQR(fd_t1[FD_IDX(i,j-1,k)])):
+			      (fd_t1[FD_IDX(i,j-1,k)]);
 	    n_neighbors++;
 	  }
-	  if (l1[i][j][k+1].natoms >= fd_min_atoms)
+	  if (fd_act[FD_IDX(i,j,k+1)] > 0.0)
 	  {
 	    E_el_neighbors += (fd_c==0)?
-	                      (SQR(l1[i][j][k+1].temp)):
-			      (l1[i][j][k+1].temp);
+	                      (SQR(fd_t1[FD_IDX(i,j,k+1)])):
+			      (fd_t1[FD_IDX(i,j,k+1)]);
 	    n_neighbors++;
 	  }
-	  if (l1[i][j][k-1].natoms >= fd_min_atoms)
+	  if (fd_act[FD_IDX(i,j,k-1)] > 0.0)
 	  {
 	    E_el_neighbors +=(fd_c==0)?
-	                     (SQR(l1[i][j][k-1].temp)):
-			     (l1[i][j][k-1].temp);
+	                     (SQR(fd_t1[FD_IDX(i,j,k-1)])):
+			     (fd_t1[FD_IDX(i,j,k-1)]);
 	    n_neighbors++;
 	  }
 
 	  E_new_local += (fd_c==0)?
-	                 (0.5*fd_gamma*SQR(l1[i][j][k].temp)):
-			 (fd_c*l1[i][j][k].temp);
+	                 (0.5*fd_gamma*SQR(fd_t1[FD_IDX(i,j,k)])):
+			 (fd_c*fd_t1[FD_IDX(i,j,k)]);
 
 	  if (n_neighbors != 0)
 	  {
-	    l1[i][j][k].temp = (fd_c==0)?
+	    fd_t1[FD_IDX(i,j,k)] = (fd_c==0)?
 	                       (sqrt(E_el_neighbors/n_neighbors)):
 			       (E_el_neighbors/n_neighbors);
 	  }
 	  else{
-	    l1[i][j][k].temp=l1[i][j][k].md_temp;
+	    fd_t1[FD_IDX(i,j,k)]=l1[i][j][k].md_temp;
 	  }
+	  /* ttm_fill_ghost_layers refreshes fd_t1 from the lattice */
+	  l1[i][j][k].temp=l2[i][j][k].temp=fd_t1[FD_IDX(i,j,k)];
 	  E_new_local += (fd_c==0)?
-	                 (0.5*fd_gamma*SQR(l1[i][j][k].temp)):
-			 (fd_c*l1[i][j][k].temp);
+	                 (0.5*fd_gamma*SQR(fd_t1[FD_IDX(i,j,k)])):
+			 (fd_c*fd_t1[FD_IDX(i,j,k)]);
 
 	}
       }
@@ -405,6 +408,26 @@ void init_ttm()
            natoms_local, myid );
 #endif
 
+  /* contiguous field arrays for the stencil, laid out like the lattices;
+     ghost layers without neighbor stay zero, i.e. inactive */
+  fd_n = local_fd_dim.x * local_fd_dim.y * local_fd_dim.z;
+  fd_t1      = (real*) calloc( fd_n, sizeof(real) );
+  fd_t2      = (real*) calloc( fd_n, sizeof(real) );
+  fd_md_temp = (real*) calloc( fd_n, sizeof(real) );
+  fd_source  = (real*) calloc( fd_n, sizeof(real) );
+  fd_xi      = (real*) calloc( fd_n, sizeof(real) );
+  fd_act     = (real*) calloc( fd_n, sizeof(real) );
+  if ((NULL==fd_t1) || (NULL==fd_t2) || (NULL==fd_md_temp) ||
+      (NULL==fd_source) || (NULL==fd_xi) || (NULL==fd_act))
+    error("Cannot allocate TTM field arrays");
+
+  /* work arrays of the implicit solver */
+  if (fd_implicit)
+  {
+    fd_cg_buf = (real*) calloc( 6 * fd_n, sizeof(real) );
+    if (NULL==fd_cg_buf) error("Cannot allocate TTM solver arrays");
+  }
+
   update_fd(); /* get md_temp and v_com etc. */
 
   ttm_overwrite(); /* electron temperature is initialized */
@@ -433,29 +456,208 @@ void init_ttm()
 
 }
 
+/* ttm_implicit_step(): advance T_el by one FD step of length dt with the
+ * theta scheme
+ *
+ *   C (T'-T)/dt = theta F(T') + (1-theta) F(T),
+ *   F(T)        = k Lap(T) - g (T-T_md) + source,
+ *
+ * C taken at the old T_el. The increment T'-T solves a symmetric positive
+ * definite system, which is done by Jacobi preconditioned CG. Deactivated
+ * cells drop out and act as insulating walls, as in the explicit scheme.
+ * Reads fd_t1, writes the new T_el to fd_t2 and adds the theta-weighted
+ * coupling to fd_xi. Each CG iteration costs one ghost exchange of the
+ * search direction; the iteration count is returned. */
+int ttm_implicit_step(real dt)
+{
+  int i,j,k,itr;
+  int sx=local_fd_dim.y*local_fd_dim.z, sy=local_fd_dim.z;
+  real hx2=1.0/(fd_h.x*fd_h.x), hy2=1.0/(fd_h.y*fd_h.y),
+       hz2=1.0/(fd_h.z*fd_h.z);
+  real *t=fd_t1, *a=fd_act;
+  real *dT=fd_cg_buf, *r=dT+fd_n, *z=r+fd_n,
+       *ap=z+fd_n, *dinv=ap+fd_n, *p=dinv+fd_n;
+  real alpha, beta;
+  double sum[2], tmp[2], s0, s1, rz, rr, rr0, pap;
+
+  /* for dT=0 the residual is just the explicit right hand side F(T) */
+  s0=s1=0.0;
+#ifdef _OPENMP
+#pragma omp parallel for private(j,k) reduction(+:s0,s1)
+#endif
+  for (i=1; i<local_fd_dim.x-1; ++i)
+  {
+    for (j=1; j<local_fd_dim.y-1; ++j)
+    {
+      int m0=FD_IDX(i,j,0);
+      for (k=1; k<local_fd_dim.z-1; ++k)
+      {
+	int  m=m0+k;
+	real c=(fd_c==0)?(fd_gamma*t[m]):(fd_c);
+	real lap, nb;
+
+	lap = hx2*( a[m-sx]*(t[m-sx]-t[m]) + a[m+sx]*(t[m+sx]-t[m]) )
+	    + hy2*( a[m-sy]*(t[m-sy]-t[m]) + a[m+sy]*(t[m+sy]-t[m]) )
+	    + hz2*( a[m-1 ]*(t[m-1 ]-t[m]) + a[m+1 ]*(t[m+1 ]-t[m]) );
+	nb  = hx2*(a[m-sx]+a[m+sx]) + hy2*(a[m-sy]+a[m+sy])
+	    + hz2*(a[m-1 ]+a[m+1 ]);
+	dT[m]   = 0.0;
+	r[m]    = a[m]*( fd_k*lap - fd_g*(t[m]-fd_md_temp[m]) + fd_source[m] );
+	dinv[m] = (a[m]>0.0)?(1.0/(c/dt + fd_theta*(fd_g + fd_k*nb))):(0.0);
+	z[m]    = dinv[m]*r[m];
+	p[m]    = z[m];
+	s0 += r[m]*z[m];
+	s1 += r[m]*r[m];
+      }
+    }
+  }
+  tmp[0]=s0; tmp[1]=s1;
+#ifdef MPI
+  MPI_Allreduce(tmp, sum, 2, MPI_DOUBLE, MPI_SUM, cpugrid);
+#else
+  sum[0]=tmp[0]; sum[1]=tmp[1];
+#endif
+  rz=sum[0]; rr=rr0=sum[1];
+
+  for (itr=0; (itr<fd_cg_max_itr) && (rr > SQR(fd_cg_tol)*rr0); ++itr)
+  {
+    ttm_exchange_ghosts(p);
+
+    s0=0.0;
+#ifdef _OPENMP
+#pragma omp parallel for private(j,k) reduction(+:s0)
+#endif
+    for (i=1; i<local_fd_dim.x-1; ++i)
+    {
+      for (j=1; j<local_fd_dim.y-1; ++j)
+      {
+	int m0=FD_IDX(i,j,0);
+	for (k=1; k<local_fd_dim.z-1; ++k)
+	{
+	  int  m=m0+k;
+	  real c=(fd_c==0)?(fd_gamma*t[m]):(fd_c);
+	  real lap;
+
+	  lap = hx2*( a[m-sx]*(p[m-sx]-p[m]) + a[m+sx]*(p[m+sx]-p[m]) )
+	      + hy2*( a[m-sy]*(p[m-sy]-p[m]) + a[m+sy]*(p[m+sy]-p[m]) )
+	      + hz2*( a[m-1 ]*(p[m-1 ]-p[m]) + a[m+1 ]*(p[m+1 ]-p[m]) );
+	  ap[m] = a[m]*( (c/dt + fd_theta*fd_g)*p[m] - fd_theta*fd_k*lap );
+	  s0 += p[m]*ap[m];
+	}
+      }
+    }
+    tmp[0]=s0;
+#ifdef MPI
+    MPI_Allreduce(tmp, sum, 1, MPI_DOUBLE, MPI_SUM, cpugrid);
+#else
+    sum[0]=tmp[0];
+#endif
+    pap=sum[0];
+    if (pap<=0.0) break;
+    alpha = rz/pap;
+
+    s0=s1=0.0;
+#ifdef _OPENMP
+#pragma omp parallel for private(j,k) reduction(+:s0,s1)
+#endif
+    for (i=1; i<local_fd_dim.x-1; ++i)
+    {
+      for (j=1; j<local_fd_dim.y-1; ++j)
+      {
+	int m0=FD_IDX(i,j,0);
+	for (k=1; k<local_fd_dim.z-1; ++k)
+	{
+	  int m=m0+k;
+	  dT[m] += alpha*p[m];
+	  r[m]  -= alpha*ap[m];
+	  z[m]   = dinv[m]*r[m];
+	  s0 += r[m]*z[m];
+	  s1 += r[m]*r[m];
+	}
+      }
+    }
+    tmp[0]=s0; tmp[1]=s1;
+#ifdef MPI
+    MPI_Allreduce(tmp, sum, 2, MPI_DOUBLE, MPI_SUM, cpugrid);
+#else
+    sum[0]=tmp[0]; sum[1]=tmp[1];
+#endif
+    beta = sum[0]/rz;
+    rz = sum[0];
+    rr = sum[1];
+
+#ifdef _OPENMP
+#pragma omp parallel for private(j,k)
+#endif
+    for (i=1; i<local_fd_dim.x-1; ++i)
+    {
+      for (j=1; j<local_fd_dim.y-1; ++j)
+      {
+	int m0=FD_IDX(i,j,0);
+	for (k=1; k<local_fd_dim.z-1; ++k)
+	  p[m0+k] = z[m0+k] + beta*p[m0+k];
+      }
+    }
+  }
+
+  if ((rr > SQR(fd_cg_tol)*rr0) && (0==myid))
+    warning("Implicit TTM solver did not converge\n");
+
+  /* new temperature; deactivated cells keep theirs */
+#ifdef _OPENMP
+#pragma omp parallel for private(j,k)
+#endif
+  for (i=1; i<local_fd_dim.x-1; ++i)
+  {
+    for (j=1; j<local_fd_dim.y-1; ++j)
+    {
+      int m0=FD_IDX(i,j,0);
+      for (k=1; k<local_fd_dim.z-1; ++k)
+      {
+	int m=m0+k;
+	fd_t2[m] = t[m] + dT[m];
+	fd_xi[m] += a[m] * ( fd_theta*fd_t2[m] + (1.0-fd_theta)*t[m]
+	                     - fd_md_temp[m] );
+      }
+    }
+  }
+
+  return itr;
+}
+
 /* solve heat diffusion equation for electronic system */
 void calc_ttm()
 {
   int i,j,k;
   int fd_timestep;
-  int xmin, xmax, /* these are neighboring indices           */
-      ymin, ymax, /* (to account for bc & deactivated cells) */
-      zmin, zmax;
+  int sx=local_fd_dim.y*local_fd_dim.z, sy=local_fd_dim.z;
+  real hx2=1.0/(fd_h.x*fd_h.x), hy2=1.0/(fd_h.y*fd_h.y),
+       hz2=1.0/(fd_h.z*fd_h.z);
+  real dt=timestep/fd_n_timesteps;
+  real *tmp;
 
   if(fix_t_el==0) /* T_el is not fixed, otherwise no big calculations needed */
   {
     if (steps%fd_update_steps==0)
     { /* we need new lattice temperature and number of atoms etc. */
       update_fd();
+      /* activity mask and T_el of (re)activated cells */
+      ttm_fill_ghost_layers();
     }
 
-    /* set all xi to zero */
+    /* the stencil works on the field arrays only; get md_temp and
+       source, which may be changed by the laser, and set all xi to zero */
     for (i=1; i<local_fd_dim.x-1; ++i)
     {
       for (j=1; j<local_fd_dim.y-1; ++j)
       {
 	for (k=1; k<local_fd_dim.z-1; ++k)
-	  l1[i][j][k].xi = l2[i][j][k].xi = 0.0;
+	{
+	  int m=FD_IDX(i,j,k);
+	  fd_md_temp[m] = l1[i][j][k].md_temp;
+	  fd_source[m]  = l1[i][j][k].source;
+	  fd_xi[m]      = 0.0;
+	}
       }
     }
 
@@ -466,100 +668,81 @@ void calc_ttm()
     for (fd_timestep=1; fd_timestep<=fd_n_timesteps; ++fd_timestep)
     {
 
+#ifdef DEBUG
       for (i=1; i<local_fd_dim.x-1; ++i)
-      {
 	for (j=1; j<local_fd_dim.y-1; ++j)
-	{
 	  for (k=1; k<local_fd_dim.z-1; ++k)
-	  {
-	    /* only do calculation if cell is not deactivated */
-	    if (l1[i][j][k].natoms < fd_min_atoms) 
-	    {
-	      continue;
-	    }
-
-	    if (l1[i-1][j][k].natoms < fd_min_atoms)
-	      xmin=i;
-	    else
-	      xmin=i-1;
-
-	    if (l1[i+1][j][k].natoms < fd_min_atoms)
-	      xmax=i;
-	    else
-	      xmax=i+1;
-
-	    if (l1[i][j-1][k].natoms < fd_min_atoms)
-	      ymin=j;
-	    else
-	      ymin=j-1;
-
-	    if (l1[i][j+1][k].natoms < fd_min_atoms)
-	      ymax=j;
-	    else
-	      ymax=j+1;
-
-	    if (l1[i][j][k-1].natoms < fd_min_atoms)
-	      zmin=k;
-	    else
-	      zmin=k-1;
-
-	    if (l1[i][j][k+1].natoms < fd_min_atoms)
-	      zmax=k;
-	    else
-	      zmax=k+1;
-
-#ifdef DEBUG
-	    E_el_ab_local += l1[i][j][k].temp - l1[i][j][k].md_temp ;
+	    E_el_ab_local += fd_act[FD_IDX(i,j,k)] *
+	                     (fd_t1[FD_IDX(i,j,k)] - fd_md_temp[FD_IDX(i,j,k)]);
 #endif
 
-	    /* NOW calculate */
-
-	    l2[i][j][k].temp = timestep/fd_n_timesteps *
-	      ( fd_k/FD_C *
-		(   1.0/(fd_h.x * fd_h.x) * ( l1[xmin][j][k].temp + l1[xmax][j][k].temp - 2*l1[i][j][k].temp )
-		    + 1.0/(fd_h.y * fd_h.y) * ( l1[i][ymin][k].temp + l1[i][ymax][k].temp - 2*l1[i][j][k].temp )
-		    + 1.0/(fd_h.z * fd_h.z) * ( l1[i][j][zmin].temp + l1[i][j][zmax].temp - 2*l1[i][j][k].temp ) )
-		- 1.0/FD_C * fd_g * ( l1[i][j][k].temp - l1[i][j][k].md_temp )
-		+ 1.0/FD_C * l1[i][j][k].source )
-	      + l1[i][j][k].temp;
-
+      if (fd_implicit)
+      {
+	ttm_implicit_step(dt);
+      }
+      else
+      {
+#ifdef _OPENMP
+#pragma omp parallel for private(j,k)
+#endif
+	for (i=1; i<local_fd_dim.x-1; ++i)
+	{
+	  for (j=1; j<local_fd_dim.y-1; ++j)
+	  {
+	    int  m0=FD_IDX(i,j,0);
+	    real *t=fd_t1, *a=fd_act;
 
-	    l2[i][j][k].xi += (l2[i][j][k].temp-l2[i][j][k].md_temp);
-	    l1[i][j][k].xi = l2[i][j][k].xi;
+	    /* deactivated neighbors have a==0 and do not conduct */
+	    for (k=1; k<local_fd_dim.z-1; ++k)
+	    {
+	      int  m=m0+k;
+	      real c=(fd_c==0)?(fd_gamma*t[m]):(fd_c);
+	      real lap, rhs;
+
+	      lap = hx2*( a[m-sx]*(t[m-sx]-t[m]) + a[m+sx]*(t[m+sx]-t[m]) )
+		  + hy2*( a[m-sy]*(t[m-sy]-t[m]) + a[m+sy]*(t[m+sy]-t[m]) )
+		  + hz2*( a[m-1 ]*(t[m-1 ]-t[m]) + a[m+1 ]*(t[m+1 ]-t[m]) );
+	      rhs = fd_k*lap - fd_g*(t[m]-fd_md_temp[m]) + fd_source[m];
+
+	      /* only update cells that are not deactivated */
+	      fd_t2[m] = (a[m]>0.0)?(t[m] + dt*rhs/c):(t[m]);
+	      fd_xi[m] += a[m] * (fd_t2[m]-fd_md_temp[m]);
+	    }
 	  }
 	}
       }
 
-
-      /* take care - l1 must always be the updated lattice */
-      l3=l1;
-      l1=l2;
-      l2=l3;
+      /* take care - fd_t1 must always be the updated temperature */
+      tmp=fd_t1;
+      fd_t1=fd_t2;
+      fd_t2=tmp;
 
       /* MPI communication / pbc / reflecting bc */
-      ttm_fill_ghost_layers();
+      ttm_exchange_ghosts(fd_t1);
 
     }
 
     ttm_eng=0.0;
 
-    /* summed xi still need a factor,
-     * and we update ttm_eng */
+    /* summed xi still need a factor, copy the results
+     * back to the lattice, and we update ttm_eng */
     for (i=1; i<local_fd_dim.x-1; ++i)
     {
       for (j=1; j<local_fd_dim.y-1; ++j)
       {
 	for (k=1; k<local_fd_dim.z-1; ++k)
 	{
+	  int m=FD_IDX(i,j,k);
 	  if(l1[i][j][k].natoms>=fd_min_atoms)
 	  {
-	    l1[i][j][k].xi *= fd_g * fd_h.x*fd_h.y*fd_h.z / 
+	    l1[i][j][k].xi = fd_xi[m] * fd_g * fd_h.x*fd_h.y*fd_h.z / 
 	      (fd_n_timesteps * l1[i][j][k].md_temp * 3 * l1[i][j][k].natoms);
 	  } else 
 	  {
 	    l1[i][j][k].xi = 0.0;
 	  }
 	  l2[i][j][k].xi = l1[i][j][k].xi;
+	  l1[i][j][k].temp = l2[i][j][k].temp = fd_t1[m];
 	  /* E=\gamma/2*T^2 or E=c_e*T?*/
 	  ttm_eng += (fd_c==0)?
 	             (0.5*fd_gamma*SQR(l1[i][j][k].temp)):
@@ -662,9 +845,7 @@ void ttm_writeout(int number)
 #endif /*MPI2*/
   }
 
-  /* Note: This only works because mpi_element2 includes the last element
-   * of ttm_Element (v_com.z). If this is changed, you need to work with
-   * displacements or something (e.g. MPI standard, Ex. 4.5) */
+  /* Note: mpi_element2 is resized to the extent of ttm_Element */
   MPI_Gather( llocal, nlocal, mpi_element2,
       lglobal, nlocal, mpi_element2, 0, cpugrid );
 
@@ -742,36 +923,6 @@ void ttm_writeout(int number)
 #ifdef MPI
 void ttm_create_mpi_datatypes(void)
 {
-  { /* type for our basic struct */
-
-    /* we don't send unneeded elements of struct, i.e. 
-     *                             md_cellptrs, xi, md_temp, v_com, source */
-
-    /* elements to be sent:        natoms (to determine if cell is active)
-     *                             temp (electron temperature).
-     *                             (MPI_UB to set upper bound and skip the rest) */
-
-    ttm_Element tmpelement;
-    ttm_Element * tmpelement_pointer;
-    tmpelement_pointer=&tmpelement;
-    MPI_Aint tmpaddr;
-    int blockcounts[3]={1,1,1};
-    MPI_Datatype types[3]={MPI_INT, MPI_DOUBLE, MPI_UB};
-    MPI_Aint displs[3];  
-
-    MPI_Address(tmpelement_pointer, &tmpaddr);
-    MPI_Address(&tmpelement.natoms, &displs[0]);
-    MPI_Address(&tmpelement.temp, &displs[1]);
-    tmpelement_pointer++;
-    MPI_Address(tmpelement_pointer, &displs[2]);
-
-    displs[2]-=tmpaddr;
-    displs[1]-=tmpaddr;
-    displs[0]-=tmpaddr;
-
-    MPI_Type_struct(3,blockcounts,displs,types,&mpi_element);
-    MPI_Type_commit(&mpi_element);
-  }
   { /* type for our basic struct, used for ttm file output */
 
     /* we don't send unneeded elements of struct, i.e. 
@@ -782,215 +933,63 @@ void ttm_create_mpi_datatypes(void)
 
     int i;
     ttm_Element tmpelement;
-    ttm_Element * tmpelement_pointer;
-    tmpelement_pointer=&tmpelement;
     MPI_Aint tmpaddr;
-    int blockcounts[9]={1,1,1,1,1,1,1,1,1};
-    MPI_Datatype types[9]={MPI_INT,
+    int blockcounts[8]={1,1,1,1,1,1,1,1};
+    MPI_Datatype types[8]={MPI_INT,
                            MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, 
-                           MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_UB};
-    MPI_Aint displs[9];  
-
-    MPI_Address(&tmpelement, &tmpaddr);
-    MPI_Address(&tmpelement.natoms, &displs[0]);
-    MPI_Address(&tmpelement.temp, &displs[1]);
-    MPI_Address(&tmpelement.xi, &displs[2]);
-    MPI_Address(&tmpelement.md_temp, &displs[3]);
-    MPI_Address(&tmpelement.source, &displs[4]);
-    MPI_Address(&tmpelement.v_com.x, &displs[5]);
-    MPI_Address(&tmpelement.v_com.y, &displs[6]);
-    MPI_Address(&tmpelement.v_com.z, &displs[7]);
-    tmpelement_pointer++;
-    MPI_Address(tmpelement_pointer, &displs[8]);
-
-    for (i=0; i<9; ++i)
+                           MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE};
+    MPI_Aint displs[8];  
+    MPI_Datatype tmptype;
+
+    MPI_Get_address(&tmpelement, &tmpaddr);
+    MPI_Get_address(&tmpelement.natoms, &displs[0]);
+    MPI_Get_address(&tmpelement.temp, &displs[1]);
+    MPI_Get_address(&tmpelement.xi, &displs[2]);
+    MPI_Get_address(&tmpelement.md_temp, &displs[3]);
+    MPI_Get_address(&tmpelement.source, &displs[4]);
+    MPI_Get_address(&tmpelement.v_com.x, &displs[5]);
+    MPI_Get_address(&tmpelement.v_com.y, &displs[6]);
+    MPI_Get_address(&tmpelement.v_com.z, &displs[7]);
+
+    for (i=0; i<8; ++i)
     {
       displs[i]-=tmpaddr;
     }
 
-    MPI_Type_struct(9,blockcounts,displs,types,&mpi_element2);
+    /* extent of the whole struct, so that arrays of elements work */
+    MPI_Type_create_struct(8,blockcounts,displs,types,&tmptype);
+    MPI_Type_create_resized(tmptype, 0, sizeof(ttm_Element), &mpi_element2);
+    MPI_Type_free(&tmptype);
     MPI_Type_commit(&mpi_element2);
   }
 
-  /* datatype for one string of elements along z (short of 2 lattice points) */
-  MPI_Type_contiguous(local_fd_dim.z-2, mpi_element, &mpi_zrow);
-  MPI_Type_commit(&mpi_zrow);
-
-  { /* add displacements to skip ghost layers (mpi_zrow_block) */
-    ttm_Element tmpel;
-    ttm_Element * tmpstore;
-    tmpstore=&tmpel;
-
-    int blockcounts[3]={1,1,1};
-    MPI_Datatype types[3]={MPI_LB, mpi_zrow, MPI_UB};
-    MPI_Aint displs[3];
-
-    MPI_Address(tmpstore,&displs[0]);
-    tmpstore += 1;
-    MPI_Address(tmpstore,&displs[1]);
-    tmpstore += 1 + (local_fd_dim.z-2);
-    MPI_Address(tmpstore,&displs[2]);
-
-    displs[2]-=displs[0];	
-    displs[1]-=displs[0];
-    displs[0]-=displs[0];
-
-    MPI_Type_struct(3, blockcounts, displs, types, &mpi_zrow_block);
-    MPI_Type_commit(&mpi_zrow_block);
-  }
-
-
-  /* datatype for one layer of elements perpendicular to x
-   * (short of 2 strings along z-axis)                    */
-  MPI_Type_contiguous(local_fd_dim.y-2, mpi_zrow_block, &mpi_xplane);
-  MPI_Type_commit(&mpi_xplane);
-
-  { /* add displacements to skip ghost layers (mpi_xplane_block) */
-    ttm_Element tmpel;
-    ttm_Element * tmpstore;
-    tmpstore=&tmpel;
-
-    int blockcounts[3]={1,1,1};
-    MPI_Datatype types[3]={MPI_LB, mpi_xplane, MPI_UB};
-    MPI_Aint displs[3];
-
-    MPI_Address(tmpstore,&displs[0]);
-    tmpstore += 2 + (local_fd_dim.z-2);
-    MPI_Address(tmpstore,&displs[1]);
-    tmpstore += (2 + (local_fd_dim.z-2))*((local_fd_dim.y-2) + 1);
-    MPI_Address(tmpstore,&displs[2]);
-
-    displs[2]-=displs[0];	
-    displs[1]-=displs[0];
-    displs[0]-=displs[0];
+  /* Ghost planes of the field arrays (fd_t1 etc.), short of the
+   * edges, which the 7 point stencil does not need. The planes start
+   * at index (i,1,1), (1,j,1) and (1,1,k), respectively. */
+  {
+    MPI_Datatype zrow;
+    int lx=local_fd_dim.x, ly=local_fd_dim.y, lz=local_fd_dim.z;
 
-    MPI_Type_struct(3, blockcounts, displs, types, &mpi_xplane_block);
+    /* perpendicular to x: ly-2 strings of lz-2 elements along z */
+    MPI_Type_vector(ly-2, lz-2, lz, REAL, &mpi_xplane_block);
     MPI_Type_commit(&mpi_xplane_block);
-  }
 
-  /* datatype for one layer of elements perpendicular to y (short of 2) */
-  MPI_Type_vector((local_fd_dim.x-2), 1, 2+(local_fd_dim.y-2),
-                  mpi_zrow_block, &mpi_yplane);
-  MPI_Type_commit(&mpi_yplane);
-
-  { /* add displacements to skip ghost layers (mpi_yplane_block) */
-    ttm_Element tmpel;
-    ttm_Element * tmpstore;
-    tmpstore=&tmpel;
-
-    int blockcounts[3]={1,1,1};
-    MPI_Datatype types[3]={MPI_LB, mpi_yplane, MPI_UB};
-    MPI_Aint displs[3];
-
-    MPI_Address(tmpstore,&displs[0]);
-    tmpstore += (2 + (local_fd_dim.z-2))*
-                (2 + (local_fd_dim.y-2));
-    MPI_Address(tmpstore,&displs[1]);
-    tmpstore += (1 + (local_fd_dim.x-2))*
-                (2 + (local_fd_dim.z-2))*
-		(2 + (local_fd_dim.y-2));
-    MPI_Address(tmpstore,&displs[2]);
-
-    displs[2]-=displs[0];	
-    displs[1]-=displs[0];
-    displs[0]-=displs[0];
-
-    MPI_Type_struct(3, blockcounts, displs, types, &mpi_yplane_block);
+    /* perpendicular to y: lx-2 strings of lz-2 elements along z */
+    MPI_Type_vector(lx-2, lz-2, ly*lz, REAL, &mpi_yplane_block);
     MPI_Type_commit(&mpi_yplane_block);
-  }
-
-
-  /* datatype for one string of elements along y (short of 2) */
-  MPI_Type_vector((local_fd_dim.y-2), 1, 2+(local_fd_dim.z-2),
-                  mpi_element, &mpi_yrow);
-  MPI_Type_commit(&mpi_yrow);  
 
-  /* add displacements to create datatype from which mpi_zplane will be built
-   * (again, skipping ghost layers) */
-  { /* mpi_yrow_block */ 
-    ttm_Element tmpel;
-    ttm_Element * tmpstore;
-    tmpstore=&tmpel;
-
-    int blockcounts[3] = {1,1,1};
-    MPI_Datatype types[3]={MPI_LB, mpi_yrow, MPI_UB};
-    MPI_Aint displs[3];
-
-    MPI_Address(tmpstore,&displs[0]);
-    tmpstore += 2 + (local_fd_dim.z-2);
-    MPI_Address(tmpstore,&displs[1]);
-    tmpstore += (1 + (local_fd_dim.y-2)) *
-                (2 + (local_fd_dim.z-2));
-    MPI_Address(tmpstore,&displs[2]);
-
-    displs[2]-=displs[0];
-    displs[1]-=displs[0];
-    displs[0]-=displs[0];
-
-    MPI_Type_struct(3, blockcounts, displs, types, &mpi_yrow_block);
-    MPI_Type_commit(&mpi_yrow_block);
-  }
-
-#ifdef DEBUG
-  if(myid==0)
-  { /* output size/extent comparisons */
-    int size;
-    MPI_Aint extent;
-
-    MPI_Type_size(mpi_zrow, &size);
-    MPI_Type_extent(mpi_zrow, &extent);
-    printf("Size / Extent of mpi_zrow: %d / %ld\n", size, (long)extent);
-
-    MPI_Type_size(mpi_yrow, &size);
-    MPI_Type_extent(mpi_yrow, &extent);
-    printf("Size / Extent of mpi_yrow: %d / %ld\n", size, (long)extent);
-
-    MPI_Type_size(mpi_yrow_block, &size);
-    MPI_Type_extent(mpi_yrow_block, &extent);
-    printf("Size / Extent of mpi_yrow_block: %d / %ld\n", size, (long)extent);
-
-    MPI_Type_size(mpi_element, &size);
-    MPI_Type_extent(mpi_element, &extent);
-    printf("Size / Extent of mpi_element: %d / %ld\n", size, (long)extent);
-
-  }
-#endif /*DEBUG*/
-
-  /* datatype for one layer of elements perpendicular to z
-   * (short of 2 strings) */
-  MPI_Type_contiguous((local_fd_dim.x-2), mpi_yrow_block, &mpi_zplane);
-  MPI_Type_commit(&mpi_zplane); 
-
-  { /* add displacements to skip ghost layers (mpi_zplane_block) */
-    ttm_Element tmpel;
-    ttm_Element * tmpstore;
-    tmpstore=&tmpel;
-
-    int blockcounts[3]={1,1,1};
-    MPI_Datatype types[3]={MPI_LB, mpi_zplane, MPI_UB};
-    MPI_Aint displs[3];
-
-    MPI_Address(tmpstore,&displs[0]);
-    tmpstore += (2 + (local_fd_dim.z-2)) *
-                (2 + (local_fd_dim.y-2));
-    MPI_Address(tmpstore,&displs[1]);
-    tmpstore += (1 + (local_fd_dim.x-2)) *
-                (2 + (local_fd_dim.z-2)) *
-		(2 + (local_fd_dim.y-2));
-    MPI_Address(tmpstore,&displs[2]);
-
-    displs[2]-=displs[0];	
-    displs[1]-=displs[0];
-    displs[0]-=displs[0];
-
-    MPI_Type_struct(3, blockcounts, displs, types, &mpi_zplane_block);
+    /* perpendicular to z: lx-2 strings of ly-2 single elements */
+    MPI_Type_vector(ly-2, 1, lz, REAL, &zrow);
+    MPI_Type_create_hvector(lx-2, 1, (MPI_Aint) (ly*lz*sizeof(real)),
+                            zrow, &mpi_zplane_block);
+    MPI_Type_free(&zrow);
     MPI_Type_commit(&mpi_zplane_block);
   }
 }
 
-void ttm_fill_ghost_layers(void)
+void ttm_exchange_ghosts(real *f)
 {
-  /** MPI communication (can occur before and/or during MD calculations?) */
+  /** MPI communication of one field array */
   /* Remember:
    * east -> -x
    * west -> +x
@@ -998,258 +997,119 @@ void ttm_fill_ghost_layers(void)
    * south-> +y
    * up   -> -z
    * down -> +z
+   * At a surface without pbc there is no neighbor, and the ghost
+   * layer keeps its zeros (no atoms -> no conduction).
    * *************/
-  int i,j,k;
+  int nx=local_fd_dim.x-2, ny=local_fd_dim.y-2, nz=local_fd_dim.z-2;
+  int lo, hi;
 
   /* x direction */
-  if(pbc_dirs.x==1 || (my_coord.x != 0 && my_coord.x != cpu_dim.x-1) )
-  {
-    /* send left slice to left neighbor. */
-    /* Simultaneously receive slice from right neighbor */
-    MPI_Sendrecv(&l1[1][0][0],1,mpi_xplane_block,nbeast,7100,
-	&l1[(local_fd_dim.x-2)+1][0][0],1,mpi_xplane_block,nbwest,7100,
-	cpugrid,&stati[0]);
-
-
-    /* send right slice to right neighbor. */
-    /* Simultaneously receive slice from left neighbor */
-    MPI_Sendrecv(&l1[(local_fd_dim.x-2)][0][0],1,mpi_xplane_block,nbwest,7200,
-	&l1[0][0][0],1,mpi_xplane_block,nbeast,7200,
-	cpugrid,&stati[1]); 
-  }
-  else /* no pbc and we are at the surface */
-    if (my_coord.x==0 && my_coord.x!=cpu_dim.x-1) /* left surface */
-    { 
-
-
-      /* only receive from right */
-      MPI_Recv(&l1[(local_fd_dim.x-2)+1][0][0],1,mpi_xplane_block,nbwest,7100,
-	  cpugrid,&stati[0]);
-
-      /* only send to right */
-      MPI_Send(&l1[(local_fd_dim.x-2)][0][0],1,mpi_xplane_block,nbwest,7200,
-	  cpugrid);
-
-      /* left ghost layer receives reflecting bc */
-      for (j=1;j<=(local_fd_dim.y-2);j++)
-      {
-	for (k=1;k<=(local_fd_dim.z-2);k++)
-	{
-	  /* no atoms -> no conduction. */
-	  l1[0][j][k].natoms=0;
-	}
-      }
-
-
-    }
-    else if (my_coord.x==cpu_dim.x-1 && my_coord.x!=0) /* right surface */
-    { 
-
-      /* only send to left */
-      MPI_Send(&l1[1][0][0],1,mpi_xplane_block,nbeast,7100,
-	  cpugrid);
-
-      /* only receive from left */
-      MPI_Recv(&l1[0][0][0],1,mpi_xplane_block,nbeast,7200,
-	  cpugrid,&stati[1]);
-
-      /* right ghost layer receives reflecting bc */
-      for (j=1;j<=(local_fd_dim.y-2);j++)
-      {
-	for (k=1;k<=(local_fd_dim.z-2);k++)
-	{
-	  /* no atoms -> no conduction. */
-	  l1[local_fd_dim.x-1][j][k].natoms=0;
-	}
-      }
-
-
-    } else
-    { /* two surfaces, just apply reflecting bc */
-      for (j=1;j<=(local_fd_dim.y-2);j++)
-      {
-	for (k=1;k<=(local_fd_dim.z-2);k++)
-	{
-	  l1[0][j][k].natoms=l1[local_fd_dim.x-1][j][k].natoms=0;
-	}
-      }
-
-    }
-
-
-
-    /* y direction */
-    if(pbc_dirs.y==1 || (my_coord.y != 0 && my_coord.y != cpu_dim.y-1) )
-    {
-      /* send left slice to left neighbor. */
-      /* Simultaneously receive slice from right neighbor */
-      MPI_Sendrecv(&l1[0][1][0],1,mpi_yplane_block,nbnorth,710,
-	  &l1[0][(local_fd_dim.y-2)+1][0],1,mpi_yplane_block,nbsouth,710,
-	  cpugrid,&stati[2]);
-      /* send right slice to right neighbor. */
-      /* Simultaneously receive slice from left neighbor */
-      MPI_Sendrecv(&l1[0][(local_fd_dim.y-2)][0],1,mpi_yplane_block,nbsouth,720,
-	  &l1[0][0][0],1,mpi_yplane_block,nbnorth,720,
-	  cpugrid,&stati[3]);
-    }
-    else /* no pbc and we are at the surface */
-      if (my_coord.y==0) /* left surface */
-      { 
-	/* only receive from right */
-	MPI_Recv(&l1[0][(local_fd_dim.y-2)+1][0],1,mpi_yplane_block,nbsouth,710,
-	    cpugrid,&stati[2]);
-	/* only send to right */
-	MPI_Send(&l1[0][(local_fd_dim.y-2)][0],1,mpi_yplane_block,nbsouth,720,
-	    cpugrid);
-
-	/* left ghost layer receives reflecting bc */
-	for (i=1;i<=(local_fd_dim.x-2);i++)
-	{
-	  for (k=1;k<=(local_fd_dim.z-2);k++)
-	  {
-	    /* no atoms -> no conduction. */
-	    l1[i][0][k].natoms=0;
-	  }
-	}
-      }
-      else if (my_coord.y==cpu_dim.y-1) /* right surface */
-      { 
-	/* only send to left */
-	MPI_Send(&l1[0][1][0],1,mpi_yplane_block,nbnorth,710,
-	    cpugrid);
-	/* only receive from left */
-	MPI_Recv(&l1[0][0][0],1,mpi_yplane_block,nbnorth,720,
-	    cpugrid,&stati[3]);
-
-	/* right ghost layer receives reflecting bc */
-	for (i=1;i<=(local_fd_dim.x-2);i++)
-	{
-	  for (k=1;k<=(local_fd_dim.z-2);k++)
-	  {
-	    /* no atoms -> no conduction. */
-	    l1[i][local_fd_dim.y-1][k].natoms=0;
-	  }
-	}
-      } else { error("This should be logically impossible.\n");}
+  lo = (pbc_dirs.x==1 || my_coord.x != 0)           ? nbeast : MPI_PROC_NULL;
+  hi = (pbc_dirs.x==1 || my_coord.x != cpu_dim.x-1) ? nbwest : MPI_PROC_NULL;
+  /* send left slice to left neighbor. */
+  /* Simultaneously receive slice from right neighbor */
+  MPI_Sendrecv(f+FD_IDX(1,1,1),    1, mpi_xplane_block, lo, 7100,
+               f+FD_IDX(nx+1,1,1), 1, mpi_xplane_block, hi, 7100,
+               cpugrid, &stati[0]);
+  /* send right slice to right neighbor. */
+  /* Simultaneously receive slice from left neighbor */
+  MPI_Sendrecv(f+FD_IDX(nx,1,1),   1, mpi_xplane_block, hi, 7200,
+               f+FD_IDX(0,1,1),    1, mpi_xplane_block, lo, 7200,
+               cpugrid, &stati[1]);
 
+  /* y direction */
+  lo = (pbc_dirs.y==1 || my_coord.y != 0)           ? nbnorth : MPI_PROC_NULL;
+  hi = (pbc_dirs.y==1 || my_coord.y != cpu_dim.y-1) ? nbsouth : MPI_PROC_NULL;
+  MPI_Sendrecv(f+FD_IDX(1,1,1),    1, mpi_yplane_block, lo, 710,
+               f+FD_IDX(1,ny+1,1), 1, mpi_yplane_block, hi, 710,
+               cpugrid, &stati[2]);
+  MPI_Sendrecv(f+FD_IDX(1,ny,1),   1, mpi_yplane_block, hi, 720,
+               f+FD_IDX(1,0,1),    1, mpi_yplane_block, lo, 720,
+               cpugrid, &stati[3]);
 
-    /* z direction */
-    if(pbc_dirs.z==1 || (my_coord.z != 0 && my_coord.z != cpu_dim.z-1) )
-    {
-      /* send left slice to left neighbor. */
-      /* Simultaneously receive slice from right neighbor */
-      MPI_Sendrecv(&l1[0][0][1],1,mpi_zplane_block,nbup,71,
-	  &l1[0][0][(local_fd_dim.z-2)+1],1,mpi_zplane_block,nbdown,71,
-	  cpugrid,&stati[4]);
-      /* send right slice to right neighbor. */
-      /* Simultaneously receive slice from left neighbor */
-      MPI_Sendrecv(&l1[0][0][(local_fd_dim.z-2)],1,mpi_zplane_block,nbdown,72,
-	  &l1[0][0][0],1,mpi_zplane_block,nbup,72,
-	  cpugrid,&stati[5]);
-    }
-    else /* no pbc and we are at the surface */
-      if (my_coord.z==0) /* left surface */
-      { 
-	/* only receive from right */
-	MPI_Recv(&l1[0][0][(local_fd_dim.z-2)+1],1,mpi_zplane_block,nbdown,71,
-	    cpugrid,&stati[4]);
-	/* only send to right */
-	MPI_Send(&l1[0][0][(local_fd_dim.x-2)],1,mpi_zplane_block,nbdown,72,
-	    cpugrid);
-
-	/* left ghost layer receives reflecting bc */
-	for (i=1;i<=(local_fd_dim.x-2);i++)
-	{
-	  for (j=1;j<=(local_fd_dim.y-2);j++)
-	  {
-	    /* no atoms -> no conduction. */
-	    l1[i][j][0].natoms=0;
-	  }
-	}
-      }
-      else if (my_coord.z==cpu_dim.z-1) /* right surface */
-      { 
-	/* only send to left */
-	MPI_Send(&l1[0][0][1],1,mpi_zplane_block,nbup,71,
-	    cpugrid);
-	/* only receive from left */
-	MPI_Recv(&l1[0][0][0],1,mpi_zplane_block,nbup,72,
-	    cpugrid,&stati[5]);
-
-	/* right ghost layer receives reflecting bc */
-	for (i=1;i<=(local_fd_dim.x-2);i++)
-	{
-	  for (j=1;j<=(local_fd_dim.y-2);j++)
-	  {
-	    /* no atoms -> no conduction. */
-	    l1[i][j][local_fd_dim.z-1].natoms=0;
-	  }
-	}
-      } else { error("This should be logically impossible.\n");}
-
+  /* z direction */
+  lo = (pbc_dirs.z==1 || my_coord.z != 0)           ? nbup   : MPI_PROC_NULL;
+  hi = (pbc_dirs.z==1 || my_coord.z != cpu_dim.z-1) ? nbdown : MPI_PROC_NULL;
+  MPI_Sendrecv(f+FD_IDX(1,1,1),    1, mpi_zplane_block, lo, 71,
+               f+FD_IDX(1,1,nz+1), 1, mpi_zplane_block, hi, 71,
+               cpugrid, &stati[4]);
+  MPI_Sendrecv(f+FD_IDX(1,1,nz),   1, mpi_zplane_block, hi, 72,
+               f+FD_IDX(1,1,0),    1, mpi_zplane_block, lo, 72,
+               cpugrid, &stati[5]);
 }
 
 #else
 
 /* Serial version */
-void ttm_fill_ghost_layers(void)
+void ttm_exchange_ghosts(real *f)
 {
   /** Serial computation.
-   * Copy into ghost layers on opposite sides of the sample
+   * Copy into ghost layers on opposite sides of the sample.
+   * Without pbc the ghost layers keep their zeros
+   * (no atoms -> no conduction).
    ***/
   int i,j,k;
+  int nx=local_fd_dim.x-2, ny=local_fd_dim.y-2, nz=local_fd_dim.z-2;
 
   /* x direction */
-  for (j=1;j<=(local_fd_dim.y-2);j++)
+  if (pbc_dirs.x==1)
   {
-    for (k=1;k<=(local_fd_dim.z-2);k++)
+    for (j=1;j<=ny;j++)
     {
-      if (pbc_dirs.x==1)
-      {
-	l1[0][j][k]=l1[local_fd_dim.x-2][j][k];
-	l1[local_fd_dim.x-1][j][k]=l1[1][j][k];
-      } else
+      for (k=1;k<=nz;k++)
       {
-	/* no atoms -> no conduction. */
-	l1[0][j][k].natoms=l1[local_fd_dim.x-1][j][k].natoms=0;
+	f[FD_IDX(0,j,k)]    = f[FD_IDX(nx,j,k)];
+	f[FD_IDX(nx+1,j,k)] = f[FD_IDX(1,j,k)];
       }
     }
   }
   /* y direction */
-  for (i=1;i<=(local_fd_dim.x-2);i++)
+  if (pbc_dirs.y==1)
   {
-    for (k=1;k<=(local_fd_dim.z-2);k++)
-    {	
-      if (pbc_dirs.y==1)
-      {
-	l1[i][0][k]=l1[i][local_fd_dim.y-2][k];
-	l1[i][local_fd_dim.y-1][k]=l1[i][1][k];
-      } else
-      {
-	/* no atoms -> no conduction. */
-	l1[i][0][k].natoms=l1[i][local_fd_dim.y-1][k].natoms=0;
+    for (i=1;i<=nx;i++)
+    {
+      for (k=1;k<=nz;k++)
+      {	
+	f[FD_IDX(i,0,k)]    = f[FD_IDX(i,ny,k)];
+	f[FD_IDX(i,ny+1,k)] = f[FD_IDX(i,1,k)];
       }
-
     }
   }
   /* z direction */
-  for (i=1;i<=(local_fd_dim.x-2);i++)
+  if (pbc_dirs.z==1)
   {
-    for (j=1;j<=(local_fd_dim.y-2);j++)
+    for (i=1;i<=nx;i++)
     {
-      if (pbc_dirs.z==1)
-      {
-	l1[i][j][0]=l1[i][j][local_fd_dim.z-2];
-	l1[i][j][local_fd_dim.z-1]=l1[i][j][1];
-      } else
+      for (j=1;j<=ny;j++)
       {
-	/* no atoms -> no conduction. */
-	l1[i][j][0].natoms=l1[i][j][local_fd_dim.z-1].natoms=0;
+	f[FD_IDX(i,j,0)]    = f[FD_IDX(i,j,nz)];
+	f[FD_IDX(i,j,nz+1)] = f[FD_IDX(i,j,1)];
       }
     }
   }
-
-
 }
 #endif /*MPI*/
 
+/* ttm_fill_ghost_layers(): copy T_el and the activity of the cells from
+ * the lattice to the field arrays and fill their ghost layers. Needed
+ * whenever natoms or T_el in the lattice have been changed outside of
+ * calc_ttm, i.e. after update_fd() or ttm_overwrite(). */
+void ttm_fill_ghost_layers(void)
+{
+  int i,j,k;
+
+  for (i=1; i<local_fd_dim.x-1; ++i)
+  {
+    for (j=1; j<local_fd_dim.y-1; ++j)
+    {
+      for (k=1; k<local_fd_dim.z-1; ++k)
+      {
+	fd_t1[FD_IDX(i,j,k)]  = l1[i][j][k].temp;
+	fd_act[FD_IDX(i,j,k)] = 
+	  (l1[i][j][k].natoms >= fd_min_atoms) ? (1.0) : (0.0);
+      }
+    }
+  }
+  ttm_exchange_ghosts(fd_act);
+  ttm_exchange_ghosts(fd_t1);
+}
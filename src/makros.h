@@ -121,6 +121,7 @@ INLINE static int MOD(shortint p, int q)
 #define D_SM(cell,i)         (atoms.d_sm [(cell)->ind[i]])
 #define S_SM(cell,i)         (atoms.s_sm [(cell)->ind[i]])
 #define Q_SM(cell,i)         (atoms.q_sm [(cell)->ind[i]])
+#define SM_POS(cell,i,sub)   (atoms.sm_pos sub((cell)->ind[i]))
 #endif
 
 #ifdef DIPOLE
@@ -138,6 +139,18 @@ INLINE static int MOD(shortint p, int q)
 #define CG_H(cell,i,sub)        (atoms.h       sub((cell)->ind[i]))
 #define OLD_ORT(cell,i,sub)     (atoms.old_ort sub((cell)->ind[i]))
 #endif
+#ifdef LBFGS
+#define LBFGS_HIST(cell,i,k)    (atoms.lbfgs[((cell)->ind[i])*lbfgs_len+(k)])
+#endif
+#ifdef PRD
+#define PRD_SAVE(cell,i,k)      (atoms.prd_save[((cell)->ind[i])*PRD_NSAVE+(k)])
+#endif
+#ifdef MTAU
+#define MTAU_BUF(cell,i,k)      (atoms.mtau[((cell)->ind[i])*mtau_len+(k)])
+#endif
+#ifdef SHAKE
+#define SHAKE_D(cell,i,sub)     (atoms.shake_d sub((cell)->ind[i]))
+#endif
 
 #ifdef DAMP
 #define DAMPF(cell,i)           (atoms.damp_f[(cell)->ind[i]])
@@ -261,6 +274,7 @@ INLINE static int MOD(shortint p, int q)
 #define D_SM(cell,i)          ((cell)->d_sm[i])
 #define S_SM(cell,i)          ((cell)->s_sm[i])
 #define Q_SM(cell,i)          ((cell)->q_sm[i])
+#define SM_POS(cell,i,sub)    ((cell)->sm_pos sub(i))
 #endif
 
 #ifdef DIPOLE
@@ -278,6 +292,18 @@ INLINE static int MOD(shortint p, int q)
 #define CG_H(cell,i,sub)        ((cell)->h sub(i))
 #define OLD_ORT(cell,i,sub)     ((cell)->old_ort sub(i))
 #endif
+#ifdef LBFGS
+#define LBFGS_HIST(cell,i,k)    ((cell)->lbfgs[(i)*lbfgs_len+(k)])
+#endif
+#ifdef PRD
+#define PRD_SAVE(cell,i,k)      ((cell)->prd_save[(i)*PRD_NSAVE+(k)])
+#endif
+#ifdef MTAU
+#define MTAU_BUF(cell,i,k)      ((cell)->mtau[(i)*mtau_len+(k)])
+#endif
+#ifdef SHAKE
+#define SHAKE_D(cell,i,sub)     ((cell)->shake_d sub(i))
+#endif
 #ifdef DISLOC
 #define EPOT_REF(cell,i)        ((cell)->Epot_ref[i])
 #define ORT_REF(cell,i,sub)     ((cell)->ort_ref sub(i))
@@ -332,8 +358,12 @@ INLINE static int MOD(shortint p, int q)
 #define ADATYPE(cell,i)			 (((cell)->adaType[i]))
 #define HOPSTODEFECT(cell,i)     (((cell)->hopsToDefect[i]))
 #endif
+#ifdef PTM
+#define PTM_TYPE(cell,i)        ((cell)->ptm_type[i])
+#define PTM_DAT(cell,i,k)       ((cell)->ptm_dat[(i)*PTM_NDAT+(k)])
+#endif
 #ifdef NYETENSOR
-#define NYE(cell,i)		((cell)->nyeTens[i])
+#define NYE(cell,i)		(&((cell)->nyeTens[i]))
 #endif
 
 #endif /* VEC */
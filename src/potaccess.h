@@ -75,6 +75,83 @@
     * ( sig_d_rad12 - sig_d_rad6 );					\
 }
 
+#ifdef ANAPOT
+
+/*****************************************************************************
+*
+*  Evaluate analytic pair potentials directly, without a table, including
+*  shift and quadratic tail. The tail is selected without branching, so
+*  that the compiler can vectorize. With LJ, only the Lennard-Jones family
+*  is compiled in; otherwise Lennard-Jones(-Gauss), Morse and Buckingham
+*  are summed up, skipping families not used by any type pair. Beyond
+*  r2_cut, which may be smaller than the end of the pair loop with Ewald
+*  or Coulomb interactions, potential and gradient vanish.
+*  col is p_typ * ntypes + q_typ.
+*
+******************************************************************************/
+
+#ifdef LJ
+
+#define PAIR_INT_ANA(pot, grad, col, r2)                                   \
+{                                                                          \
+  const ana_pot_t *ap = ana_pot + (col);                                   \
+  real sr2, sr6, sr12, dc, pp, gg;                                         \
+                                                                           \
+  sr2  = ap->lj_sig2 / (r2);                                               \
+  sr6  = sr2 * sr2 * sr2;                                                  \
+  sr12 = sr6 * sr6;                                                        \
+  pp   = ap->lj_eps * (sr12 - 2.0 * sr6) - ap->shift;                      \
+  gg   = - 12.0 * ap->lj_eps * (sr12 - sr6) / (r2);                        \
+  dc   = MAX(ap->r2_cut - (r2), 0.0);                                      \
+  pot  = ((r2) < ap->r2_tail) ? pp :  ap->aaa * dc * dc;                   \
+  grad = ((r2) < ap->r2_tail) ? gg : -4.0 * ap->aaa * dc;                  \
+}
+
+#else
+
+#define PAIR_INT_ANA(pot, grad, col, r2)                                   \
+{                                                                          \
+  const ana_pot_t *ap = ana_pot + (col);                                   \
+  real r, ir, sr2, sr6, sr12, dr, eg, em, cm, eb, pb, dc, pp, gg;          \
+                                                                           \
+  r    = SQRT(r2);                                                         \
+  ir   = 1.0 / r;                                                          \
+  /* Lennard-Jones-Gauss */                                                \
+  sr2  = ap->lj_sig2 / (r2);                                               \
+  sr6  = sr2 * sr2 * sr2;                                                  \
+  sr12 = sr6 * sr6;                                                        \
+  pp   = ap->lj_eps * (sr12 - 2.0 * sr6);                                  \
+  gg   = - 12.0 * ap->lj_eps * (sr12 - sr6) / (r2);                        \
+  if (ana_have_ljg) {                                                      \
+    dr   = (r - ap->ljg_r0) * ap->ljg_isig;                                \
+    eg   = ap->ljg_eps * exp( - 0.5 * dr * dr );                           \
+    pp  -= eg;                                                             \
+    gg  += eg * dr * ap->ljg_isig * ir;                                    \
+  }                                                                        \
+  /* Morse */                                                              \
+  if (ana_have_morse) {                                                    \
+    em   = exp( - ap->morse_alpha * (r - ap->morse_sig) );                 \
+    cm   = 1.0 - em;                                                       \
+    pp  += ap->morse_eps * (cm * cm - 1.0);                                \
+    gg  += 2.0 * ap->morse_alpha * ap->morse_eps * em * cm * ir;           \
+  }                                                                        \
+  /* Buckingham */                                                         \
+  if (ana_have_buck) {                                                     \
+    eb   = ap->buck_a * exp( - r * ap->buck_isig );                        \
+    pb   = ap->buck_c6 / ((r2) * (r2) * (r2));                             \
+    pp  += eb - pb;                                                        \
+    gg  += - eb * ap->buck_isig * ir + 6.0 * pb / (r2);                    \
+  }                                                                        \
+  /* shift and tail */                                                     \
+  dc   = MAX(ap->r2_cut - (r2), 0.0);                                      \
+  pot  = ((r2) < ap->r2_tail) ? pp - ap->shift :  ap->aaa * dc * dc;       \
+  grad = ((r2) < ap->r2_tail) ? gg             : -4.0 * ap->aaa * dc;      \
+}
+
+#endif /* LJ */
+
+#endif /* ANAPOT */
+
 #ifdef VEC
 
 #define PAIR_INT_LJ_VEC(pot, grad, col, r2)		                   \
@@ -109,6 +109,8 @@ void imd_init_timer(imd_timer *timer, int flag, char *desc, char *color);
 void imd_start_timer(imd_timer *timer);
 void imd_stop_timer(imd_timer *timer);
 void maxwell(real TEMP);
+void imd_random4(int, int, int, int, real *);
+void imd_gauss4(int, int, int, int, real *);
 int  endian(void);
 integer SwappedInteger(integer);
 float   SwappedFloat  (float  );
@@ -308,6 +310,7 @@ void move_atoms_stm(void);
 void move_atoms_ftg(void);
 void move_atoms_finnis(void);
 void move_atoms_ttm(void);
+void move_atoms_langevin(void);
 #ifdef SHOCK
 void calc_pxavg(void);
 #endif
@@ -364,8 +367,6 @@ void write_config_dsp(int nr);
 #endif
 #ifdef CNA
 void do_cna(void);
-void do_cna_func(cell *p, cell* q, vektor pbc);
-void domino(int start, int end, int listlength, int *max_chain, int *chain);
 void write_atoms_cna(FILE *out);
 void write_header_cna(FILE *out);
 void write_atoms_crist(FILE *out);
@@ -449,34 +450,13 @@ int bb_minimize(int);
 
 
 /* write distributions - file imd_distrib.c */
-void make_distrib_density(void); 
-void write_distrib_density(int, int);
-void make_write_distrib_select(int, void (*fun)(float*, cell*, int), 
-			       int, int, char*, char*);
-void write_distrib_header(FILE*, int, int, char*);
 void write_distrib(int);
-void dist_Ekin_fun       (float*, cell*, int);
-void dist_Epot_fun       (float*, cell*, int);
-void dist_Ekin_long_fun  (float*, cell*, int);
-void dist_Ekin_trans_fun (float*, cell*, int);
-void dist_Ekin_comp_fun (float*, cell*, int);
-void dist_shock_shear_fun(float*, cell*, int);
-void dist_shear_aniso_fun(float*, cell*, int);
-void dist_press_fun      (float*, cell*, int);
-void dist_presstens_fun  (float*, cell*, int);
-void dist_presstens_xx_fun  (float*, cell*, int);
-void dist_presstens_yy_fun  (float*, cell*, int);
-#ifndef TWOD
-void dist_presstens_zz_fun  (float*, cell*, int);
-void dist_presstens_yz_fun  (float*, cell*, int);
-void dist_presstens_zx_fun  (float*, cell*, int);
-#endif
-void dist_presstens_xy_fun  (float*, cell*, int);
-void dist_pressoff_fun   (float*, cell*, int);
-void dist_pressxy_fun   (float*, cell*, int);
-void dist_pressyz_fun   (float*, cell*, int);
-void dist_presszx_fun   (float*, cell*, int);
-void dist_vxavg_fun   (float*, cell*, int);
+void update_distrib(void);
+void dist_add_quant(int, int, int, char*, char*);
+void make_distrib(int);
+void reduce_distrib(int);
+void write_distrib_file(int, int);
+void write_distrib_header(FILE*, int, int, char*);
 
 #ifdef ATDIST
 void   init_atdist(void);
@@ -490,6 +470,7 @@ void write_config_atdist_pos(int nr);
 #ifdef DIFFPAT
 void   init_diffpat(void);
 void update_diffpat(int );
+void transform_diffpat(void);
 void  write_diffpat(void);
 #endif
 
@@ -549,6 +530,21 @@ void write_header_ada(FILE *out);
 void write_atoms_ada(FILE *out);
 #endif
 
+/* Polyhedral template matching imd_ptm.c */
+#ifdef PTM
+void init_ptm(void);
+void do_ptm(void);
+void write_header_ptm(FILE *out);
+void write_atoms_ptm(FILE *out);
+#endif
+
+/* In-situ pair distribution statistics imd_rdf.c */
+#ifdef RDF
+void init_rdf(void);
+void do_rdf(void);
+void write_rdf(int nr);
+#endif
+
 /* Nye Tensor Analysis imd_nyeTensorAnalysis_3d.c*/
 #ifdef NYETENSOR
 void init_NyeTensor();
@@ -609,11 +605,13 @@ void write_add_corr(int it, int steps, unsigned seqnum);
 #endif
 
 /* support for heat transport - file imd_transport.c */
+#if defined(HC) || defined(NVX)
+void do_heat_cond(int steps);
+#endif
 #ifdef NVX
 void write_temp_dist(int steps);
 #endif
 #ifdef HC
-void do_heat_cond(int steps);
 void write_heat_current(int steps);
 #endif
 
@@ -644,13 +642,22 @@ void update_glok(void);
 void reset_glok(void);
 #endif
 
+#ifdef LBFGS
+void move_atoms_lbfgs(void);
+void reset_lbfgs(void);
+#endif
+
+#ifdef FIRE2
+void move_atoms_fire2(void);
+void reset_fire2(void);
+#endif
+
 #ifdef NMOLDYN
 void init_nmoldyn(void);
 void write_nmoldyn(int);
 #endif
 
 #ifdef DSF
-void update_dsf(void);
 void write_dsf(void);
 #endif
 
@@ -723,8 +730,10 @@ void init_cycle(void);
 void init_ttm(void);
 void ttm_create_mpi_datatypes(void);
 void ttm_fill_ghost_layers(void);
+void ttm_exchange_ghosts(real *);
 void ttm_writeout(int);
 void calc_ttm(void);
+int  ttm_implicit_step(real);
 void update_fd(void);
 /* TODO allow variable K */
 void ttm_overwrite(void);
@@ -738,6 +747,7 @@ void do_v_real(void);
 void do_cg(void);
 void do_charge_update(void);
 void charge_update_sm(void);
+real sm_max_displacement(void);
 void calc_sm_pot(void);
 void calc_sm_chi(void);
 void copy_sm_charge(int, int, int, int, int, int, vektor);
@@ -795,4 +805,32 @@ void read_atoms_neb(str255);
 void calc_forces_neb(void);
 void write_neb_eng_file(int);
 void constrain_move(void);
+void neb_sendrecv_pos(void);
+void neb_recv_tangent(void);
+#ifdef MPI
+void neb_split_images(void);
+#endif
+#endif
+#ifdef SHAKE
+void init_shake(void);
+void shake_prepare(void);
+void shake(void);
+void add_shake(int, int, int, int, int, int);
+void pack_shake(msgbuf *, int, int, int);
+void unpack_add_shake(msgbuf *, int, int, int);
+#endif
+#ifdef PRD
+void init_prd(void);
+void prd_step(void);
+#ifdef MPI
+void prd_split_replicas(void);
+#endif
+#endif
+#ifdef MTAU
+void init_mtau(void);
+void update_mtau(void);
+void write_mtau(int);
+#ifdef HC
+void update_mtau_hc(vektor);
+#endif
 #endif
@@ -110,6 +110,7 @@ typedef struct {
 	real nyeTensor[3][3]; /* Nye tensor */
 	real bv[3];			  /* Burgers vector */
 	real ls[3];           /* Line sense / Line direction of dislocation */
+	int  valid;           /* Record is computed in this step */
 } nyeTensorInfo;
 typedef struct {
 	real n[14][3];		  /* Reference nearest neighbors in perfect crystal */
@@ -220,6 +221,7 @@ typedef struct {
   real *d_sm;                /* conjugate directions Ax=b */
   real *s_sm;                /* auxiliary variable Ax=b */
   real *q_sm;                /* initial value */
+  real *sm_pos;              /* position at last charge update */
 
 #endif
 #ifdef DIPOLE
@@ -236,6 +238,18 @@ typedef struct {
   real        *g;           /* Conjugated Gradient: old forces */
   real        *old_ort;     /* CG: old locations, needed for linmin */
 #endif
+#ifdef LBFGS
+  real        *lbfgs;       /* L-BFGS: old forces and step history */
+#endif
+#ifdef PRD
+  real        *prd_save;    /* PRD: reference minimum, saved x and p */
+#endif
+#ifdef MTAU
+  real        *mtau;        /* MTAU: multi-tau correlation histories */
+#endif
+#ifdef SHAKE
+  real        *shake_d;     /* SHAKE: position corrections */
+#endif
 #ifdef DAMP
   real        *damp_f; /* damping function for that atom, position dependent */
 #endif
@@ -297,8 +311,12 @@ typedef struct {
   char *adaType;
   char *hopsToDefect;
 #endif
+#ifdef PTM
+  shortint *ptm_type;
+  real     *ptm_dat;
+#endif
 #ifdef NYETENSOR
-  nyeTensorInfo **nyeTens;
+  nyeTensorInfo *nyeTens;
 #endif
 
 } cell;
@@ -428,6 +446,28 @@ typedef struct {
 } lin_pot_table_t;
 #endif
 
+#ifdef ANAPOT
+/* parameters of the analytic pair potentials for one pair of types;
+   the shifts and tails of all families are summed up */
+typedef struct {
+  real r2_cut;      /* cutoff radius squared */
+  real r2_tail;     /* beginning of the quadratic tail */
+  real shift;       /* potential shift */
+  real aaa;         /* tail coefficient */
+  real lj_eps;      /* Lennard-Jones */
+  real lj_sig2;
+  real ljg_eps;     /* Gauss part of Lennard-Jones-Gauss */
+  real ljg_r0;
+  real ljg_isig;
+  real morse_eps;   /* Morse */
+  real morse_alpha;
+  real morse_sig;
+  real buck_a;      /* Buckingham */
+  real buck_c6;
+  real buck_isig;
+} ana_pot_t;
+#endif
+
 /* data structure for timers */
 typedef struct {
 #ifdef MPI                  /* with MPI_Wtime */